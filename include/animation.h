@@ -8,6 +8,8 @@
 #include "assimp/postprocess.h"
 #include "assimp/scene.h"
 #include "bone.h"
+#include "clip.h"
+#include "clip_compression.h"
 #include "model.h"
 
 #define MAX_NAME_LEN 64
@@ -20,16 +22,41 @@ struct AssimpNodeData
     struct AssimpNodeData *children;
 };
 
+/*
+ * Flattened node hierarchy. Joints are stored in depth-first order so a
+ * parent always precedes its children, which lets the pose be evaluated in a
+ * single linear pass. Channel and bone info indices are resolved once at load
+ * time (-1 when the node has no animation channel / no skinning offset).
+ * Joints keep the node's name rather than a pointer to it, because the
+ * Animation holding the node tree is returned and copied by value.
+ */
+struct SkeletonJoint
+{
+    mat4 transformation;
+    int parent;
+    int channel;
+    int bone_info;
+    char name[MAX_NAME_LEN];
+};
+
+struct Skeleton
+{
+    struct SkeletonJoint *joints;
+    unsigned int num_joints;
+};
+
 struct Animation
 {
     char name[MAX_NAME_LEN];
     float duration;
     int ticks_per_second;
-    struct Bone bones[MAX_BONES];
+    struct Bone bones[MAX_MODEL_BONES];
     unsigned int num_bones;
     struct AssimpNodeData root_node;
     struct BoneInfo *bone_info;
     unsigned int bone_info_size;
+    struct Skeleton skeleton;
+    struct AnimationClip clip;
 };
 
 void seel_load_intermediate_bones(struct Animation *animation, const struct aiAnimation *ai_animation, struct Model *model)
@@ -55,18 +82,25 @@ void seel_load_intermediate_bones(struct Animation *animation, const struct aiAn
 
         if (bone_id == -1)
         {
-            struct BoneInfo new_bone_info;
-            strcpy(new_bone_info.name, bone_name);
-            bones_info = (struct BoneInfo *)realloc(bones_info, sizeof(struct BoneInfo) * (model->bone_counter + 1));
-            if (!bones_info)
+            /* animated node without skinned vertices: track it with an identity offset */
+            if (model->bone_counter >= MAX_MODEL_BONES)
             {
-                fprintf(stderr, "Failed to reallocate memory for bone info!\n");
-                return;
+                fprintf(stderr, "Too many bones in model, skipping channel %s!\n", bone_name);
+                continue;
             }
-            bones_info[model->bone_counter++] = new_bone_info;
-            bone_id = model->bone_counter - 1;
+            struct BoneInfo *new_bone_info = &bones_info[model->bone_counter];
+            memset(new_bone_info, 0, sizeof(struct BoneInfo));
+            strncpy(new_bone_info->name, bone_name, MAX_BONE_NAME_LEN - 1);
+            new_bone_info->id = model->bone_counter;
+            glm_mat4_identity(new_bone_info->offset);
+            bone_id = model->bone_counter++;
         }
 
+        if (animation->num_bones >= MAX_MODEL_BONES)
+        {
+            fprintf(stderr, "Too many animation channels, skipping channel %s!\n", bone_name);
+            continue;
+        }
         animation->bones[animation->num_bones++] = seel_bone_create(bone_name, bone_id, channel);
     }
 
@@ -96,6 +130,71 @@ void seel_generate_bone_tree(struct AssimpNodeData *parent, const struct aiNode
     }
 }
 
+int seel_animation_find_channel(const struct Animation *animation, const char *name)
+{
+    unsigned int i;
+    for (i = 0; i < animation->num_bones; i++)
+    {
+        if (!strcmp(animation->bones[i].name, name))
+            return i;
+    }
+    return -1;
+}
+
+int seel_animation_find_bone_info(const struct Animation *animation, const char *name)
+{
+    unsigned int i;
+    for (i = 0; i < animation->bone_info_size && i < MAX_MODEL_BONES; i++)
+    {
+        if (!strcmp(animation->bone_info[i].name, name))
+            return i;
+    }
+    return -1;
+}
+
+static unsigned int seel_count_bone_tree(const struct AssimpNodeData *node)
+{
+    unsigned int count = 1;
+    unsigned int i;
+    for (i = 0; node->children && i < node->children_count; i++)
+        count += seel_count_bone_tree(&node->children[i]);
+    return count;
+}
+
+static void seel_flatten_bone_tree(struct Animation *animation, const struct AssimpNodeData *node, int parent)
+{
+    int index = animation->skeleton.num_joints++;
+    struct SkeletonJoint *joint = &animation->skeleton.joints[index];
+
+    glm_mat4_copy((vec4 *)node->transformation, joint->transformation);
+    joint->parent = parent;
+    joint->channel = seel_animation_find_channel(animation, node->name);
+    joint->bone_info = seel_animation_find_bone_info(animation, node->name);
+    strcpy(joint->name, node->name);
+
+    unsigned int i;
+    for (i = 0; node->children && i < node->children_count; i++)
+        seel_flatten_bone_tree(animation, &node->children[i], index);
+}
+
+bool seel_skeleton_bind(struct Animation *animation)
+{
+    unsigned int num_nodes = seel_count_bone_tree(&animation->root_node);
+
+    animation->skeleton.num_joints = 0;
+    animation->skeleton.joints = (struct SkeletonJoint *)malloc(sizeof(struct SkeletonJoint) * num_nodes);
+    if (!animation->skeleton.joints)
+    {
+        fprintf(stderr, "Failed to allocate memory for skeleton joints!\n");
+        return false;
+    }
+
+    seel_flatten_bone_tree(animation, &animation->root_node, -1);
+    return true;
+}
+
+void seel_animation_destroy(struct Animation *animation);
+
 struct Animation seel_animation_create(const char *path, struct Model *model)
 {
     struct Animation animation = {0};
@@ -118,26 +217,84 @@ struct Animation seel_animation_create(const char *path, struct Model *model)
     seel_generate_bone_tree(&animation.root_node, scene->mRootNode);
     glm_mat4_copy(GLM_MAT4_IDENTITY, animation.root_node.transformation);
     seel_load_intermediate_bones(&animation, ai_animation, model);
-
     aiReleaseImport(scene);
 
+    if (!seel_skeleton_bind(&animation))
+    {
+        seel_animation_destroy(&animation);
+        return animation;
+    }
+    seel_clip_create_from_bones(&animation.clip, animation.bones, animation.num_bones);
+
     return animation;
 }
 
-struct Bone seel_find_bone(struct Animation *animation, const char *name)
+/*
+ * Compresses the animation's clip and releases the per-bone keys it was
+ * built from; bone names stay for lookups. Everything that samples the
+ * animation goes through the clip afterwards.
+ */
+bool seel_animation_compress(struct Animation *animation, const struct ClipCompressionSettings *settings, struct ClipCompressionStats *stats)
 {
-    struct Bone bone = {0};
-    bone.id = -1;
+    if (!seel_clip_compress(&animation->clip, settings, stats))
+        return false;
 
     unsigned int i;
     for (i = 0; i < animation->num_bones; i++)
     {
-        if (!strcmp(animation->bones[i].name, name))
-        {
-            return animation->bones[i];
-        }
+        struct Bone *bone = &animation->bones[i];
+        free(bone->positions);
+        free(bone->rotations);
+        free(bone->scalings);
+        bone->positions = NULL;
+        bone->rotations = NULL;
+        bone->scalings = NULL;
+        bone->num_positions = 0;
+        bone->num_rotations = 0;
+        bone->num_scalings = 0;
+    }
+    return true;
+}
+
+static void seel_bone_tree_destroy(struct AssimpNodeData *node)
+{
+    unsigned int i;
+    for (i = 0; node->children && i < node->children_count; i++)
+        seel_bone_tree_destroy(&node->children[i]);
+    free(node->children);
+    node->children = NULL;
+}
+
+/* Bytes held by the animation, including its clip and bone keys */
+size_t seel_animation_cpu_size(const struct Animation *animation)
+{
+    size_t size = sizeof(struct Animation) + seel_clip_size(&animation->clip) +
+                  animation->skeleton.num_joints * (sizeof(struct SkeletonJoint) + sizeof(struct AssimpNodeData));
+
+    unsigned int i;
+    for (i = 0; i < animation->num_bones; i++)
+    {
+        const struct Bone *bone = &animation->bones[i];
+        size += bone->num_positions * sizeof(struct KeyPosition) + bone->num_rotations * sizeof(struct KeyRotation) +
+                bone->num_scalings * sizeof(struct KeyScale);
+    }
+    return size;
+}
+
+/* Frees everything seel_animation_create allocated; bone_info belongs to the model */
+void seel_animation_destroy(struct Animation *animation)
+{
+    unsigned int i;
+    for (i = 0; i < animation->num_bones; i++)
+    {
+        free(animation->bones[i].positions);
+        free(animation->bones[i].rotations);
+        free(animation->bones[i].scalings);
     }
-    return bone;
+    seel_bone_tree_destroy(&animation->root_node);
+    free(animation->skeleton.joints);
+    seel_clip_destroy(&animation->clip);
+    memset(animation, 0, sizeof(struct Animation));
 }
 
 #endif /* ANIMATION_H */
\ No newline at end of file
@@ -4,6 +4,26 @@
 #include "cglm/cglm.h"
 #include "animation.h"
 #include "bone.h"
+#include "job_pool.h"
+
+/* Channel and bone info indices of the next animation, per joint of the current one */
+struct TransitionJoint
+{
+    int channel;
+    int bone_info;
+};
+
+/*
+ * How often an animator's pose is evaluated: every frame, every few frames
+ * with the two latest poses blended in between, or not at all (the last
+ * pose is kept).
+ */
+enum AnimationLod
+{
+    ANIMATION_LOD_FULL,
+    ANIMATION_LOD_REDUCED,
+    ANIMATION_LOD_FROZEN
+};
 
 struct Animator
 {
@@ -16,42 +36,123 @@ struct Animator
     float halt_time;
     float inter_time;
     unsigned int interpolating;
+    mat4 *local_transforms;
+    unsigned int num_local_transforms;
+    mat4 *global_transforms;
+    unsigned int num_global_transforms;
+    struct TransitionJoint *transition_joints;
+    unsigned int num_transition_joints;
+    struct KeyCursor *cursors;
+    unsigned int num_cursors;
+    mat4 *pose_from;
+    unsigned int num_pose_from;
+    mat4 *pose_to;
+    unsigned int num_pose_to;
+    bool poses_valid;
+    unsigned int update_phase;
+    float pending_time;
+    unsigned int bones_evaluated; /* joints evaluated by the last update */
+    mat4 *shared_palette;         /* palette of another animator in the same pose this frame, or NULL */
 };
 
-struct KeyPosition seel_get_positions(struct Bone *bone, float animation_time)
+/* Everything the evaluated pose depends on; animators with equal keys have equal palettes */
+struct PoseKey
 {
-    unsigned int pos_index = (animation_time == 0.0f) ? 0 : seel_get_position_index(bone, animation_time) + 1;
-    if (pos_index + 1 >= bone->num_positions)
+    const struct Animation *current_animation;
+    const struct Animation *next_animation;
+    unsigned int interpolating;
+    float time;
+    float halt_time;
+};
+
+/*
+ * Scratch transforms are cache line aligned and padded, so animators updated
+ * on different threads never write to the same line.
+ */
+static bool seel_reserve_transforms(mat4 **transforms, unsigned int *capacity, unsigned int count)
+{
+    if (count <= *capacity)
+        return true;
+
+    size_t size = (sizeof(mat4) * count + SEEL_CACHE_LINE_SIZE - 1) / SEEL_CACHE_LINE_SIZE * SEEL_CACHE_LINE_SIZE;
+    mat4 *resized = (mat4 *)aligned_alloc(SEEL_CACHE_LINE_SIZE, size);
+    if (!resized)
     {
-        pos_index = bone->num_positions - 1;
+        fprintf(stderr, "Failed to allocate memory for bone transforms!\n");
+        return false;
     }
-    return bone->positions[pos_index];
+
+    if (*transforms)
+        memcpy(resized, *transforms, sizeof(mat4) * *capacity);
+    free(*transforms);
+
+    *transforms = resized;
+    *capacity = count;
+    return true;
 }
 
-struct KeyRotation seel_get_rotations(struct Bone *bone, float animation_time)
+static bool seel_animator_reserve_joints(struct Animator *animator, unsigned int num_joints)
 {
-    unsigned int rot_index = (animation_time == 0.0f) ? 0 : seel_get_rotation_index(bone, animation_time) + 1;
-    return bone->rotations[rot_index];
+    return seel_reserve_transforms(&animator->global_transforms, &animator->num_global_transforms, num_joints);
 }
 
-struct KeyScale seel_get_scalings(struct Bone *bone, float animation_time)
+static bool seel_animator_reserve_cursors(struct Animator *animator, unsigned int num_channels)
 {
-    unsigned int scl_index = (animation_time == 0.0f) ? 0 : seel_get_scale_index(bone, animation_time) + 1;
-    return bone->scalings[scl_index];
+    if (num_channels <= animator->num_cursors)
+        return true;
+
+    struct KeyCursor *cursors = (struct KeyCursor *)realloc(animator->cursors, sizeof(struct KeyCursor) * num_channels);
+    if (!cursors)
+    {
+        fprintf(stderr, "Failed to allocate memory for keyframe cursors!\n");
+        return false;
+    }
+
+    memset(&cursors[animator->num_cursors], 0, sizeof(struct KeyCursor) * (num_channels - animator->num_cursors));
+    animator->cursors = cursors;
+    animator->num_cursors = num_channels;
+    return true;
+}
+
+/* Resolves the current animation's joints against the next animation once, when a transition starts */
+static bool seel_animator_bind_transition(struct Animator *animator)
+{
+    struct Animation *prev_animation = animator->current_animation;
+    struct Animation *next_animation = animator->next_animation;
+    if (!prev_animation || !next_animation)
+        return false;
+
+    struct Skeleton *skeleton = &prev_animation->skeleton;
+    if (skeleton->num_joints > animator->num_transition_joints)
+    {
+        struct TransitionJoint *joints = (struct TransitionJoint *)realloc(animator->transition_joints, sizeof(struct TransitionJoint) * skeleton->num_joints);
+        if (!joints)
+        {
+            fprintf(stderr, "Failed to allocate memory for transition joints!\n");
+            return false;
+        }
+        animator->transition_joints = joints;
+        animator->num_transition_joints = skeleton->num_joints;
+    }
+
+    unsigned int i;
+    for (i = 0; i < skeleton->num_joints; i++)
+    {
+        const char *name = skeleton->joints[i].name;
+        animator->transition_joints[i].channel = seel_animation_find_channel(next_animation, name);
+        animator->transition_joints[i].bone_info = seel_animation_find_bone_info(next_animation, name);
+    }
+
+    return true;
 }
 
 void seel_calculate_bone_transition(struct Animator *animator,
-                                    struct AssimpNodeData *cur_node,
-                                    vec4 *parent_transform,
-                                    struct Animation *prev_animation,
-                                    struct Animation *next_animation,
                                     float halt_time,
                                     float current_time,
                                     float transition_time)
 {
-    char *node_name = cur_node->name;
-    mat4 transform;
-    glm_mat4_copy(cur_node->transformation, transform);
+    struct Animation *prev_animation = animator->current_animation;
+    struct Animation *next_animation = animator->next_animation;
 
     if (!prev_animation || !next_animation)
     {
@@ -59,151 +160,260 @@ void seel_calculate_bone_transition(struct Animator *animator,
         return;
     }
 
-    struct Bone prev_bone = seel_find_bone(prev_animation, node_name);
-    struct Bone next_bone = seel_find_bone(next_animation, node_name);
+    struct Skeleton *skeleton = &prev_animation->skeleton;
+    if (!animator->transition_joints || !seel_animator_reserve_joints(animator, skeleton->num_joints))
+        return;
 
-    if (prev_bone.id != -1 && next_bone.id != -1)
+    unsigned int i;
+    for (i = 0; i < skeleton->num_joints; i++)
     {
-        struct KeyPosition prev_pos = seel_get_positions(&prev_bone, halt_time);
-        struct KeyRotation prev_rot = seel_get_rotations(&prev_bone, halt_time);
-        struct KeyScale prev_scl = seel_get_scalings(&prev_bone, halt_time);
-
-        struct KeyPosition next_pos = seel_get_positions(&next_bone, 0.0f);
-        struct KeyRotation next_rot = seel_get_rotations(&next_bone, 0.0f);
-        struct KeyScale next_scl = seel_get_scalings(&next_bone, 0.0f);
+        struct SkeletonJoint *joint = &skeleton->joints[i];
+        struct TransitionJoint *binding = &animator->transition_joints[i];
+        mat4 transform;
+        glm_mat4_copy(joint->transformation, transform);
 
-        prev_pos.time_stamp = 0.0f;
-        prev_rot.time_stamp = 0.0f;
-        prev_scl.time_stamp = 0.0f;
-
-        next_pos.time_stamp = transition_time;
-        next_rot.time_stamp = transition_time;
-        next_scl.time_stamp = transition_time;
+        if (joint->channel != -1 && binding->channel != -1)
+        {
+            /* sample through the clips, which may be compressed and no longer have bone keys */
+            vec3 prev_position, prev_scale, next_position, next_scale;
+            versor prev_rotation, next_rotation;
+            seel_clip_sample_trs(&prev_animation->clip, joint->channel, halt_time, prev_position, prev_rotation, prev_scale);
+            seel_clip_sample_trs(&next_animation->clip, binding->channel, 0.0f, next_position, next_rotation, next_scale);
+
+            float factor = transition_time > 0.0f ? glm_clamp(current_time / transition_time, 0.0f, 1.0f) : 1.0f;
+            vec3 blended_position, blended_scale;
+            versor blended_rotation;
+            glm_vec3_lerp(prev_position, next_position, factor, blended_position);
+            glm_vec3_lerp(prev_scale, next_scale, factor, blended_scale);
+            glm_quat_slerp(prev_rotation, next_rotation, factor, blended_rotation);
+            glm_quat_normalize(blended_rotation);
+
+            mat4 position, rotation, scale;
+            glm_translate_make(position, blended_position);
+            glm_quat_mat4(blended_rotation, rotation);
+            glm_scale_make(scale, blended_scale);
+
+            glm_mat4_mulN((mat4 *[]){&position, &rotation, &scale}, 3, transform);
+        }
 
-        mat4 position, rotation, scale;
-        seel_interpolate_position(current_time, prev_pos, next_pos, position);
-        seel_interpolate_rotation(current_time, prev_rot, next_rot, rotation);
-        seel_interpolate_scaling(current_time, prev_scl, next_scl, scale);
+        mat4 *global_transformation = &animator->global_transforms[i];
+        if (joint->parent < 0)
+            glm_mat4_copy(transform, *global_transformation);
+        else
+            glm_mat4_mul(animator->global_transforms[joint->parent], transform, *global_transformation);
 
-        glm_mat4_mulN((mat4 *[]){&position, &rotation, &scale}, 3, transform);
+        if (binding->bone_info != -1)
+            glm_mat4_mul(*global_transformation, next_animation->bone_info[binding->bone_info].offset, animator->final_bone_matrices[binding->bone_info]);
     }
 
-    mat4 global_transformation;
-    glm_mat4_mul(parent_transform, transform, global_transformation);
+    animator->bones_evaluated += skeleton->num_joints;
+}
 
-    struct BoneInfo *bone_info = next_animation->bone_info;
-    unsigned int bone_info_size = next_animation->num_bones;
+void seel_calculate_bone_transform(struct Animator *animator, struct Animation *animation, float current_time)
+{
+    struct Skeleton *skeleton = &animation->skeleton;
+    struct AnimationClip *clip = &animation->clip;
+    if (!seel_animator_reserve_joints(animator, skeleton->num_joints) ||
+        !seel_reserve_transforms(&animator->local_transforms, &animator->num_local_transforms, clip->num_channels) ||
+        !seel_animator_reserve_cursors(animator, clip->num_channels))
+        return;
+
+    /* sample every channel in SIMD batches, then walk the hierarchy once */
+    seel_clip_sample(clip, 0, clip->num_channels, current_time, animator->cursors, animator->local_transforms);
 
     unsigned int i;
-    for (i = 0; i < bone_info_size; i++)
+    for (i = 0; i < skeleton->num_joints; i++)
     {
-        if (!strcmp(bone_info[i].name, node_name))
-        {
-            mat4 offset;
-            glm_mat4_copy(bone_info[i].offset, offset);
-            glm_mat4_mul(global_transformation, offset, animator->final_bone_matrices[i]);
-            break;
-        }
+        struct SkeletonJoint *joint = &skeleton->joints[i];
+        vec4 *bone_transform = joint->channel != -1 ? animator->local_transforms[joint->channel] : joint->transformation;
+
+        mat4 *global_transformation = &animator->global_transforms[i];
+        if (joint->parent < 0)
+            glm_mat4_copy(bone_transform, *global_transformation);
+        else
+            glm_mat4_mul(animator->global_transforms[joint->parent], bone_transform, *global_transformation);
+
+        if (joint->bone_info != -1)
+            glm_mat4_mul(*global_transformation, animation->bone_info[joint->bone_info].offset, animator->final_bone_matrices[joint->bone_info]);
     }
 
-    for (i = 0; i < cur_node->children_count; i++)
+    animator->bones_evaluated += skeleton->num_joints;
+}
+
+/* Number of palette entries the current and next animation write to */
+static unsigned int seel_animator_palette_size(struct Animator *animator)
+{
+    unsigned int size = animator->current_animation ? animator->current_animation->bone_info_size : 0;
+    if (animator->next_animation && animator->next_animation->bone_info_size > size)
+        size = animator->next_animation->bone_info_size;
+    return size < (unsigned int)animator->num_matrices ? size : (unsigned int)animator->num_matrices;
+}
+
+/* The palette to draw with this frame */
+mat4 *seel_animator_palette(struct Animator *animator)
+{
+    return animator->shared_palette ? animator->shared_palette : animator->final_bone_matrices;
+}
+
+/* Stops sharing another animator's palette, keeping a private copy of the pose */
+void seel_animator_unshare(struct Animator *animator)
+{
+    if (!animator->shared_palette)
+        return;
+
+    memcpy(animator->final_bone_matrices, animator->shared_palette, sizeof(mat4) * seel_animator_palette_size(animator));
+    animator->shared_palette = NULL;
+}
+
+/* Advances the clock and transition state; returns false on frames without a pose to evaluate */
+bool seel_animator_advance(struct Animator *animator, float delta_time)
+{
+    if (!animator->current_animation)
+        return false;
+
+    animator->current_time = fmod(animator->current_time + animator->current_animation->ticks_per_second * delta_time, animator->current_animation->duration);
+
+    float transition_time = animator->current_animation->ticks_per_second * 0.2f;
+    if (animator->interpolating && animator->inter_time <= transition_time)
+    {
+        animator->inter_time += animator->current_animation->ticks_per_second * delta_time;
+        return true;
+    }
+    else if (animator->interpolating)
     {
-        if (!cur_node->children)
+        if (animator->queue_animation)
         {
-            return;
+            animator->current_animation = animator->next_animation;
+            animator->halt_time = 0.0f;
+            animator->next_animation = animator->queue_animation;
+            animator->queue_animation = NULL;
+            animator->current_time = 0.0f;
+            animator->inter_time = 0.0;
+            seel_animator_bind_transition(animator);
+            return false;
         }
-        seel_calculate_bone_transition(animator,
-                                       &cur_node->children[i],
-                                       global_transformation,
-                                       prev_animation,
-                                       next_animation,
-                                       halt_time,
-                                       current_time,
-                                       transition_time);
+
+        animator->interpolating = false;
+        animator->current_animation = animator->next_animation;
+        animator->current_time = 0.0;
+        animator->inter_time = 0.0;
     }
+
+    return true;
 }
 
-void seel_calculate_bone_transform(struct Animator *animator,
-                                   struct AssimpNodeData *node,
-                                   vec4 *parent_transform,
-                                   struct Animation *animation,
-                                   float current_time)
+static float seel_quantize_time(float time, float quantum)
 {
-    char *node_name = node->name;
-    mat4 bone_transform = GLM_MAT4_IDENTITY_INIT;
-    assert(node != NULL && node->transformation != NULL);
-    glm_mat4_copy(node->transformation, bone_transform);
+    return quantum > 0.0f ? floorf(time / quantum) * quantum : time;
+}
 
-    struct Bone bone = seel_find_bone(animation, node_name);
+/* time_quantum in seconds snaps the clock down to a grid so nearby animators share poses; 0 keeps it exact */
+void seel_animator_pose_key(struct Animator *animator, float time_quantum, struct PoseKey *key)
+{
+    memset(key, 0, sizeof(struct PoseKey));
+    struct Animation *animation = animator->current_animation;
+    if (!animation)
+        return;
 
-    if (bone.id != -1)
+    float quantum = time_quantum * animation->ticks_per_second;
+    key->current_animation = animation;
+    key->interpolating = animator->interpolating;
+    if (animator->interpolating)
     {
-        seel_bone_update(&bone, current_time);
-        glm_mat4_copy(bone.transform, bone_transform);
+        key->next_animation = animator->next_animation;
+        key->time = seel_quantize_time(animator->inter_time, quantum);
+        key->halt_time = seel_quantize_time(animator->halt_time, quantum);
     }
-
-    mat4 global_transformation;
-    glm_mat4_mul(parent_transform, bone_transform, global_transformation);
-
-    struct BoneInfo *bone_info = animation->bone_info;
-    unsigned int bone_info_size = animation->num_bones;
-
-    unsigned int i;
-    for (i = 0; i < bone_info_size; i++)
+    else
     {
-        if (!strcmp(bone_info[i].name, node_name))
-        {
-            mat4 offset;
-            glm_mat4_copy(bone_info[i].offset, offset);
-            glm_mat4_mul(global_transformation, offset, animator->final_bone_matrices[i]);
-            break;
-        }
+        key->time = seel_quantize_time(animator->current_time, quantum);
     }
+}
 
-    for (i = 0; i < node->children_count; i++)
-        seel_calculate_bone_transform(animator, &node->children[i], global_transformation, animation, current_time);
+/* Evaluates the pose at the animator's current state into its own palette */
+void seel_animator_evaluate(struct Animator *animator, float time_quantum)
+{
+    struct PoseKey key;
+    seel_animator_pose_key(animator, time_quantum, &key);
+    if (!key.current_animation)
+        return;
+
+    if (key.interpolating)
+        seel_calculate_bone_transition(animator, key.halt_time, key.time, animator->current_animation->ticks_per_second * 0.2f);
+    else
+        seel_calculate_bone_transform(animator, animator->current_animation, key.time);
 }
 
 void seel_update_animation(struct Animator *animator, float delta_time)
 {
-    if (animator->current_animation)
+    animator->bones_evaluated = 0;
+    seel_animator_unshare(animator);
+    if (seel_animator_advance(animator, delta_time))
+        seel_animator_evaluate(animator, 0.0f);
+}
+
+/*
+ * Level-of-detail update. ANIMATION_LOD_REDUCED evaluates the pose once every
+ * interval frames and blends the two latest poses on the frames in between,
+ * so the displayed pose trails the clock by one interval. stagger offsets the
+ * evaluation frame so animators sharing an interval don't all update at once.
+ * ANIMATION_LOD_FROZEN stops the clock and keeps the last pose.
+ */
+void seel_update_animation_lod(struct Animator *animator, float delta_time, enum AnimationLod lod, unsigned int interval, unsigned int stagger)
+{
+    animator->bones_evaluated = 0;
+    seel_animator_unshare(animator);
+    if (!animator->current_animation || lod == ANIMATION_LOD_FROZEN)
     {
-        animator->current_time = fmod(animator->current_time + animator->current_animation->ticks_per_second * delta_time, animator->current_animation->duration);
+        animator->poses_valid = false;
+        return;
+    }
 
-        float transition_time = animator->current_animation->ticks_per_second * 0.2f;
-        if (animator->interpolating && animator->inter_time <= transition_time)
-        {
-            animator->inter_time += animator->current_animation->ticks_per_second * delta_time;
-            seel_calculate_bone_transition(animator,
-                                           &animator->current_animation->root_node,
-                                           GLM_MAT4_IDENTITY,
-                                           animator->current_animation,
-                                           animator->next_animation,
-                                           animator->halt_time,
-                                           animator->inter_time,
-                                           transition_time);
-            return;
-        }
-        else if (animator->interpolating)
-        {
-            if (animator->queue_animation)
-            {
-                animator->current_animation = animator->next_animation;
-                animator->halt_time = 0.0f;
-                animator->next_animation = animator->queue_animation;
-                animator->queue_animation = NULL;
-                animator->current_time = 0.0f;
-                animator->inter_time = 0.0;
-                return;
-            }
-
-            animator->interpolating = false;
-            animator->current_animation = animator->next_animation;
-            animator->current_time = 0.0;
-            animator->inter_time = 0.0;
-        }
+    if (lod == ANIMATION_LOD_FULL || interval <= 1)
+    {
+        animator->poses_valid = false;
+        seel_update_animation(animator, delta_time);
+        return;
+    }
+
+    unsigned int num_bones = seel_animator_palette_size(animator);
+    if (!seel_reserve_transforms(&animator->pose_from, &animator->num_pose_from, num_bones) ||
+        !seel_reserve_transforms(&animator->pose_to, &animator->num_pose_to, num_bones))
+        return;
 
-        seel_calculate_bone_transform(animator, &animator->current_animation->root_node, GLM_MAT4_IDENTITY, animator->current_animation, animator->current_time);
+    animator->pending_time += delta_time;
+    if (!animator->poses_valid)
+    {
+        /* entering the reduced rate: start from a fresh pose */
+        seel_update_animation(animator, animator->pending_time);
+        memcpy(animator->pose_from, animator->final_bone_matrices, sizeof(mat4) * num_bones);
+        memcpy(animator->pose_to, animator->final_bone_matrices, sizeof(mat4) * num_bones);
+        animator->pending_time = 0.0f;
+        animator->update_phase = stagger % interval;
+        animator->poses_valid = true;
+        return;
+    }
+
+    if (++animator->update_phase >= interval)
+    {
+        animator->update_phase = 0;
+        seel_update_animation(animator, animator->pending_time);
+        animator->pending_time = 0.0f;
+
+        memcpy(animator->pose_from, animator->pose_to, sizeof(mat4) * num_bones);
+        memcpy(animator->pose_to, animator->final_bone_matrices, sizeof(mat4) * num_bones);
+    }
+
+    float t = (float)(animator->update_phase + 1) / (float)interval;
+    unsigned int i;
+    for (i = 0; i < num_bones; i++)
+    {
+        float *from = animator->pose_from[i][0];
+        float *to = animator->pose_to[i][0];
+        float *dest = animator->final_bone_matrices[i][0];
+        unsigned int j;
+        for (j = 0; j < 16; j++)
+            dest[j] = from[j] + (to[j] - from[j]) * t;
     }
 }
 
@@ -234,6 +444,8 @@ void seel_play_animation(struct Animator *animator, struct Animation *pAnimation
             animator->next_animation = pAnimation;
             animator->current_time = 0.0f;
             animator->inter_time = 0.0;
+            animator->poses_valid = false;
+            seel_animator_bind_transition(animator);
         }
     }
 }
@@ -242,7 +454,7 @@ void seel_animator_create(struct Animator *animator)
 {
     memset(animator, 0, sizeof(struct Animator));
 
-    animator->final_bone_matrices = calloc(MAX_BONES, sizeof(mat4));
+    animator->final_bone_matrices = calloc(MAX_MODEL_BONES, sizeof(mat4));
     if (!animator->final_bone_matrices)
     {
         fprintf(stderr, "Failed to allocate memory for final bone matrices!\n");
@@ -250,12 +462,24 @@ void seel_animator_create(struct Animator *animator)
     }
 
     unsigned int i;
-    for (i = 0; i < MAX_BONES; i++)
+    for (i = 0; i < MAX_MODEL_BONES; i++)
     {
         glm_mat4_copy(GLM_MAT4_IDENTITY, animator->final_bone_matrices[i]);
     }
 
-    animator->num_matrices = MAX_BONES;
+    animator->num_matrices = MAX_MODEL_BONES;
+}
+
+void seel_animator_destroy(struct Animator *animator)
+{
+    free(animator->final_bone_matrices);
+    free(animator->local_transforms);
+    free(animator->global_transforms);
+    free(animator->transition_joints);
+    free(animator->cursors);
+    free(animator->pose_from);
+    free(animator->pose_to);
+    memset(animator, 0, sizeof(struct Animator));
 }
 
 #endif /* ANIMATOR_H */
\ No newline at end of file
@@ -2,24 +2,42 @@
 #define ASSET_MANAGER_H
 
 #include <stdbool.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "shader.h"
 #include "texture.h"
 #include "model.h"
+#include "mesh_file.h"
 #include "animation.h"
+#include "asset_stream.h"
 
 #define MAX_ASSET_NAME_LEN 128
+#define SEEL_INVALID_ASSET_INDEX UINT_MAX
+/* Assets live in pages that never move, so pointers to them survive growth */
+#define SEEL_ASSET_PAGE_SIZE 64
+/* First size of the name table, which doubles before it gets more than half full */
+#define SEEL_ASSET_TABLE_MIN_SIZE 64
 
 enum AssetType
 {
     ASSET_SHADER,
     ASSET_TEXTURE,
     ASSET_MODEL,
+    ASSET_ANIMATION,
     ASSET_TYPE_COUNT
 };
 
+enum AssetState
+{
+    ASSET_STATE_READY,
+    ASSET_STATE_LOADING, /* streaming in, data holds a placeholder */
+    ASSET_STATE_FAILED   /* streaming failed, data keeps the placeholder */
+};
+
 union AssetData
 {
     struct Shader *shader;
@@ -28,23 +46,87 @@ union AssetData
     struct Animation *animation;
 };
 
+/*
+ * Slot of an asset plus the generation it had when the handle was made.
+ * Resolving one is O(1); generation 0 is never valid, so a zeroed handle
+ * resolves to NULL.
+ */
+struct AssetHandle
+{
+    unsigned int index;
+    unsigned int generation;
+};
+
 struct Asset
 {
     char name[MAX_ASSET_NAME_LEN];
     union AssetData data;
     enum AssetType type;
+    enum AssetState state;
+    unsigned int generation; /* changes whenever the slot is given to another asset */
+    unsigned int ref_count;  /* referenced assets are never evicted */
+    unsigned long last_used; /* manager frame of the last acquire, release or resolve */
+    size_t cpu_bytes;
+    size_t gpu_bytes;
+    struct AssetHandle dependency; /* asset this one points into, referenced while it lives */
+    unsigned int next_free;        /* free slot list, while type is ASSET_TYPE_COUNT */
+};
+
+/* Open-addressing entry of the (type, name) table */
+struct AssetTableEntry
+{
+    uint32_t hash;
+    unsigned int index; /* SEEL_INVALID_ASSET_INDEX when empty */
+};
+
+/* Per asset type limits; 0 leaves that kind of memory unlimited */
+struct AssetBudget
+{
+    size_t cpu_bytes;
+    size_t gpu_bytes;
+};
+
+/* Live assets of one type and the memory they hold */
+struct AssetMemoryStats
+{
+    unsigned int count;
+    size_t cpu_bytes;
+    size_t gpu_bytes;
 };
 
 struct AssetManager
 {
-    struct Asset *assets;
-    unsigned int num_assets;
+    struct Asset **pages; /* SEEL_ASSET_PAGE_SIZE assets each */
+    unsigned int num_pages;
+    unsigned int num_assets; /* slots in use or on the free list */
+    unsigned int free_slot;  /* head of the free slot list */
+    struct AssetTableEntry *table;
+    unsigned int table_size; /* power of two */
+    struct AssetBudget budgets[ASSET_TYPE_COUNT];
+    struct AssetMemoryStats memory[ASSET_TYPE_COUNT];
+    unsigned long frame;
+    struct JobPool *job_pool; /* decodes model textures in parallel when set */
+    struct AssetStreamer streamer;
+    bool log_evictions; /* prints every asset evicted to meet a budget */
 };
 
 struct AssetManager seel_asset_manager_create(void);
 void seel_asset_manager_cleanup(struct AssetManager *manager);
 bool seel_asset_manager_load(struct AssetManager *manager, enum AssetType type, const char *name, ...);
 void *seel_asset_manager_get(const struct AssetManager *manager, enum AssetType type, const char *name);
+struct AssetHandle seel_asset_manager_load_async(struct AssetManager *manager, enum AssetType type, const char *name, ...);
+struct AssetHandle seel_asset_manager_find(const struct AssetManager *manager, enum AssetType type, const char *name);
+void *seel_asset_manager_resolve(struct AssetManager *manager, struct AssetHandle handle);
+bool seel_asset_manager_acquire(struct AssetManager *manager, struct AssetHandle handle);
+void seel_asset_manager_release(struct AssetManager *manager, struct AssetHandle handle);
+void seel_asset_manager_set_dependency(struct AssetManager *manager, struct AssetHandle handle, struct AssetHandle dependency);
+bool seel_asset_manager_unload(struct AssetManager *manager, struct AssetHandle handle);
+void seel_asset_manager_set_budget(struct AssetManager *manager, enum AssetType type, size_t cpu_bytes, size_t gpu_bytes);
+struct AssetMemoryStats seel_asset_manager_memory(const struct AssetManager *manager, enum AssetType type);
+void seel_asset_manager_print_memory(const struct AssetManager *manager);
+enum AssetState seel_asset_manager_state(const struct AssetManager *manager, struct AssetHandle handle);
+const char *seel_asset_manager_name(const struct AssetManager *manager, struct AssetHandle handle);
+void seel_asset_manager_update(struct AssetManager *manager);
 
 #define SEEL_ASSET_MANAGER_LOAD(manager, type, name, ...) \
     seel_asset_manager_load(manager, type, name, __VA_ARGS__)
@@ -52,37 +134,327 @@ void *seel_asset_manager_get(const struct AssetManager *manager, enum AssetType
 #define SEEL_ASSET_MANAGER_GET(manager, type, name) \
     (seel_asset_manager_get(manager, ASSET_##type, name))
 
+#define SEEL_ASSET_MANAGER_LOAD_ASYNC(manager, type, name, ...) \
+    seel_asset_manager_load_async(manager, type, name, __VA_ARGS__)
+
 struct AssetManager seel_asset_manager_create(void)
 {
-    return (struct AssetManager){.assets = NULL, .num_assets = 0};
+    struct AssetManager manager = {.pages = NULL, .num_pages = 0, .num_assets = 0, .free_slot = SEEL_INVALID_ASSET_INDEX,
+                                   .table = NULL, .table_size = 0, .frame = 0, .job_pool = NULL,
+                                   .log_evictions = false};
+    memset(manager.budgets, 0, sizeof(manager.budgets));
+    memset(manager.memory, 0, sizeof(manager.memory));
+    seel_asset_stream_init(&manager.streamer);
+    return manager;
 }
 
-void seel_asset_manager_cleanup(struct AssetManager *manager)
+static struct Asset *seel_asset_manager_at(const struct AssetManager *manager, unsigned int index)
 {
-    for (unsigned int i = 0; i < manager->num_assets; i++)
+    return &manager->pages[index / SEEL_ASSET_PAGE_SIZE][index % SEEL_ASSET_PAGE_SIZE];
+}
+
+/* The asset a handle was made for, or NULL once its slot holds another asset */
+static struct Asset *seel_asset_manager_handle_asset(const struct AssetManager *manager, struct AssetHandle handle)
+{
+    if (handle.index >= manager->num_assets)
+        return NULL;
+
+    struct Asset *asset = seel_asset_manager_at(manager, handle.index);
+    return asset->generation == handle.generation && asset->type != ASSET_TYPE_COUNT ? asset : NULL;
+}
+
+static uint32_t seel_asset_hash(enum AssetType type, const char *name)
+{
+    /* FNV-1a over the type and the name */
+    uint32_t hash = (2166136261u ^ (uint32_t)type) * 16777619u;
+    for (; *name; name++)
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    return hash;
+}
+
+/* Index of the asset with this type and name, SEEL_INVALID_ASSET_INDEX if there is none */
+static unsigned int seel_asset_manager_lookup(const struct AssetManager *manager, enum AssetType type, const char *name)
+{
+    if (!manager->table_size)
+        return SEEL_INVALID_ASSET_INDEX;
+
+    uint32_t hash = seel_asset_hash(type, name);
+    unsigned int mask = manager->table_size - 1;
+    unsigned int slot;
+    for (slot = hash & mask; manager->table[slot].index != SEEL_INVALID_ASSET_INDEX; slot = (slot + 1) & mask)
+    {
+        const struct AssetTableEntry *entry = &manager->table[slot];
+        if (entry->hash != hash)
+            continue;
+
+        const struct Asset *asset = seel_asset_manager_at(manager, entry->index);
+        if (asset->type == type && strcmp(asset->name, name) == 0)
+            return entry->index;
+    }
+    return SEEL_INVALID_ASSET_INDEX;
+}
+
+static void seel_asset_table_insert(struct AssetTableEntry *table, unsigned int size, uint32_t hash, unsigned int index)
+{
+    unsigned int mask = size - 1;
+    unsigned int slot = hash & mask;
+    while (table[slot].index != SEEL_INVALID_ASSET_INDEX)
+        slot = (slot + 1) & mask;
+    table[slot].hash = hash;
+    table[slot].index = index;
+}
+
+/* Backward-shift deletion, so probes never need tombstones */
+static void seel_asset_table_remove(struct AssetManager *manager, uint32_t hash, unsigned int index)
+{
+    unsigned int mask = manager->table_size - 1;
+    unsigned int slot = hash & mask;
+    while (manager->table[slot].index != index)
+    {
+        if (manager->table[slot].index == SEEL_INVALID_ASSET_INDEX)
+            return;
+        slot = (slot + 1) & mask;
+    }
+
+    unsigned int next = slot;
+    for (;;)
+    {
+        next = (next + 1) & mask;
+        if (manager->table[next].index == SEEL_INVALID_ASSET_INDEX)
+            break;
+
+        /* an entry may move back into the hole unless its home lies cyclically in (slot, next] */
+        unsigned int home = manager->table[next].hash & mask;
+        bool stays = slot <= next ? (home > slot && home <= next) : (home > slot || home <= next);
+        if (!stays)
+        {
+            manager->table[slot] = manager->table[next];
+            slot = next;
+        }
+    }
+    manager->table[slot].index = SEEL_INVALID_ASSET_INDEX;
+}
+
+/* Doubles the table and reinserts every entry with its stored hash */
+static bool seel_asset_manager_grow_table(struct AssetManager *manager)
+{
+    unsigned int size = manager->table_size ? manager->table_size * 2 : SEEL_ASSET_TABLE_MIN_SIZE;
+    struct AssetTableEntry *table = (struct AssetTableEntry *)malloc(sizeof(struct AssetTableEntry) * size);
+    if (!table)
+    {
+        fprintf(stderr, "Failed to allocate memory for the asset table!\n");
+        return false;
+    }
+
+    unsigned int i;
+    for (i = 0; i < size; i++)
+        table[i].index = SEEL_INVALID_ASSET_INDEX;
+    for (i = 0; i < manager->table_size; i++)
+    {
+        if (manager->table[i].index != SEEL_INVALID_ASSET_INDEX)
+            seel_asset_table_insert(table, size, manager->table[i].hash, manager->table[i].index);
+    }
+
+    free(manager->table);
+    manager->table = table;
+    manager->table_size = size;
+    return true;
+}
+
+static void *seel_asset_data(const struct Asset *asset)
+{
+    switch (asset->type)
+    {
+    case ASSET_SHADER:
+        return asset->data.shader;
+    case ASSET_TEXTURE:
+        return asset->data.texture;
+    case ASSET_MODEL:
+        return asset->data.model;
+    case ASSET_ANIMATION:
+        return asset->data.animation;
+    default:
+        return NULL;
+    }
+}
+
+/* Size of a ready asset's data, added to the manager's totals */
+static void seel_asset_manager_measure(struct AssetManager *manager, struct Asset *asset)
+{
+    asset->cpu_bytes = 0;
+    asset->gpu_bytes = 0;
+    if (asset->state == ASSET_STATE_READY)
     {
-        struct Asset *asset = &manager->assets[i];
         switch (asset->type)
         {
         case ASSET_SHADER:
-            free(asset->data.shader);
+            asset->cpu_bytes = sizeof(struct Shader);
             break;
         case ASSET_TEXTURE:
-            free(asset->data.texture);
+            asset->cpu_bytes = sizeof(struct Texture);
+            asset->gpu_bytes = seel_texture_gpu_size(asset->data.texture->id);
             break;
         case ASSET_MODEL:
-            free(asset->data.model);
+            asset->cpu_bytes = seel_model_cpu_size(asset->data.model);
+            asset->gpu_bytes = seel_model_gpu_size(asset->data.model);
+            break;
+        case ASSET_ANIMATION:
+            asset->cpu_bytes = seel_animation_cpu_size(asset->data.animation);
             break;
         default:
             break;
         }
     }
-    free(manager->assets);
-    manager->assets = NULL;
+
+    manager->memory[asset->type].cpu_bytes += asset->cpu_bytes;
+    manager->memory[asset->type].gpu_bytes += asset->gpu_bytes;
+}
+
+/*
+ * Releases what the asset owns, GL objects included. Assets that are not
+ * ready only hold a copy of a streaming placeholder, owned by the streamer.
+ */
+static void seel_asset_release_data(struct Asset *asset)
+{
+    bool owned = asset->state == ASSET_STATE_READY;
+    switch (asset->type)
+    {
+    case ASSET_SHADER:
+        seel_shader_delete(asset->data.shader);
+        break;
+    case ASSET_TEXTURE:
+        if (owned)
+            glDeleteTextures(1, &asset->data.texture->id);
+        break;
+    case ASSET_MODEL:
+        if (owned)
+            seel_model_destroy(asset->data.model);
+        break;
+    case ASSET_ANIMATION:
+        seel_animation_destroy(asset->data.animation);
+        break;
+    default:
+        break;
+    }
+    free(asset->data.shader);
+    asset->data.shader = NULL;
+}
+
+static bool seel_asset_manager_over_budget(const struct AssetManager *manager, enum AssetType type)
+{
+    const struct AssetBudget *budget = &manager->budgets[type];
+    const struct AssetMemoryStats *memory = &manager->memory[type];
+    return (budget->cpu_bytes && memory->cpu_bytes > budget->cpu_bytes) ||
+           (budget->gpu_bytes && memory->gpu_bytes > budget->gpu_bytes);
+}
+
+/*
+ * Evicts unreferenced assets of the type, least recently used first, until
+ * it fits its budget again. Assets used this frame, referenced or still
+ * streaming are kept even if that leaves the type over budget.
+ */
+static void seel_asset_manager_enforce_budget(struct AssetManager *manager, enum AssetType type)
+{
+    while (seel_asset_manager_over_budget(manager, type))
+    {
+        struct Asset *victim = NULL;
+        unsigned int victim_index = 0;
+        for (unsigned int i = 0; i < manager->num_assets; i++)
+        {
+            struct Asset *asset = seel_asset_manager_at(manager, i);
+            if (asset->type != type || asset->ref_count || asset->state == ASSET_STATE_LOADING || asset->last_used >= manager->frame)
+                continue;
+            if (!victim || asset->last_used < victim->last_used)
+            {
+                victim = asset;
+                victim_index = i;
+            }
+        }
+        if (!victim)
+            return;
+
+        if (manager->log_evictions)
+            printf("Evicting asset %s (%zu bytes CPU, %zu bytes GPU)\n", victim->name, victim->cpu_bytes, victim->gpu_bytes);
+        seel_asset_manager_unload(manager, (struct AssetHandle){victim_index, victim->generation});
+    }
+}
+
+/* Unloads every asset, referenced or not */
+void seel_asset_manager_cleanup(struct AssetManager *manager)
+{
+    seel_asset_stream_destroy(&manager->streamer);
+
+    for (unsigned int i = 0; i < manager->num_assets; i++)
+    {
+        struct Asset *asset = seel_asset_manager_at(manager, i);
+        if (asset->type != ASSET_TYPE_COUNT)
+            seel_asset_release_data(asset);
+    }
+    for (unsigned int i = 0; i < manager->num_pages; i++)
+        free(manager->pages[i]);
+    free(manager->pages);
+    free(manager->table);
+    manager->pages = NULL;
+    manager->num_pages = 0;
     manager->num_assets = 0;
+    manager->free_slot = SEEL_INVALID_ASSET_INDEX;
+    manager->table = NULL;
+    manager->table_size = 0;
+    memset(manager->memory, 0, sizeof(manager->memory));
 }
 
-bool seel_asset_manager_load(struct AssetManager *manager, enum AssetType type, const char *name, ...)
+/* Stores the asset in the next free slot and indexes it by type and name */
+static bool seel_asset_manager_append(struct AssetManager *manager, struct Asset *asset, struct AssetHandle *handle)
+{
+    if ((manager->num_assets + 1) * 2 > manager->table_size && !seel_asset_manager_grow_table(manager))
+        return false;
+
+    unsigned int index = manager->free_slot != SEEL_INVALID_ASSET_INDEX ? manager->free_slot : manager->num_assets;
+    if (index / SEEL_ASSET_PAGE_SIZE == manager->num_pages)
+    {
+        struct Asset **pages = realloc(manager->pages, sizeof(struct Asset *) * (manager->num_pages + 1));
+        if (!pages)
+        {
+            fprintf(stderr, "Failed to reallocate asset manager memory.\n");
+            return false;
+        }
+        manager->pages = pages;
+        manager->pages[manager->num_pages] = (struct Asset *)malloc(sizeof(struct Asset) * SEEL_ASSET_PAGE_SIZE);
+        if (!manager->pages[manager->num_pages])
+        {
+            fprintf(stderr, "Failed to allocate asset manager memory.\n");
+            return false;
+        }
+        manager->num_pages++;
+    }
+
+    struct Asset *slot = seel_asset_manager_at(manager, index);
+    unsigned int generation = 1;
+    if (index == manager->free_slot)
+    {
+        manager->free_slot = slot->next_free;
+        generation = slot->generation + 1 ? slot->generation + 1 : 1;
+    }
+    else
+    {
+        manager->num_assets++;
+    }
+
+    *slot = *asset;
+    slot->generation = generation;
+    slot->ref_count = 0;
+    slot->last_used = manager->frame;
+    slot->dependency = (struct AssetHandle){SEEL_INVALID_ASSET_INDEX, 0};
+    seel_asset_table_insert(manager->table, manager->table_size, seel_asset_hash(slot->type, slot->name), index);
+    manager->memory[slot->type].count++;
+    seel_asset_manager_measure(manager, slot);
+
+    if (handle)
+        *handle = (struct AssetHandle){index, slot->generation};
+    return true;
+}
+
+static bool seel_asset_manager_load_args(struct AssetManager *manager, enum AssetType type, const char *name, va_list args)
 {
     if (seel_asset_manager_get(manager, type, name) != NULL)
     {
@@ -94,9 +466,8 @@ bool seel_asset_manager_load(struct AssetManager *manager, enum AssetType type,
     strncpy(asset.name, name, MAX_ASSET_NAME_LEN - 1);
     asset.name[MAX_ASSET_NAME_LEN - 1] = '\0';
     asset.type = type;
+    asset.state = ASSET_STATE_READY;
 
-    va_list args;
-    va_start(args, name);
     bool success = true;
 
     switch (type)
@@ -125,7 +496,7 @@ bool seel_asset_manager_load(struct AssetManager *manager, enum AssetType type,
         asset.data.texture = malloc(sizeof(struct Texture));
         if (asset.data.texture)
         {
-            *asset.data.texture = seel_texture_create(path, tex_type);
+            *asset.data.texture = seel_texture_create_cached(path, tex_type);
         }
         else
         {
@@ -141,7 +512,7 @@ bool seel_asset_manager_load(struct AssetManager *manager, enum AssetType type,
         asset.data.model = malloc(sizeof(struct Model));
         if (asset.data.model)
         {
-            *asset.data.model = seel_model_load(path);
+            *asset.data.model = seel_model_load_cached(path, manager->job_pool);
         }
         else
         {
@@ -151,49 +522,289 @@ bool seel_asset_manager_load(struct AssetManager *manager, enum AssetType type,
         }
         break;
     }
+    case ASSET_ANIMATION:
+    {
+        /* Animations are loaded once per clip and shared read-only by every animator playing them */
+        const char *path = va_arg(args, const char *);
+        struct Model *model = va_arg(args, struct Model *);
+        asset.data.animation = malloc(sizeof(struct Animation));
+        if (asset.data.animation)
+        {
+            *asset.data.animation = seel_animation_create(path, model);
+        }
+        else
+        {
+            fprintf(stderr, "Failed to load animation: %s\n", name);
+            free(asset.data.animation);
+            success = false;
+        }
+        break;
+    }
     default:
         fprintf(stderr, "Unknown asset type.\n");
         success = false;
         break;
     }
-    va_end(args);
 
+    if (success && !seel_asset_manager_append(manager, &asset, NULL))
+    {
+        free(asset.data.shader);
+        return false;
+    }
+
+    return success;
+}
+
+bool seel_asset_manager_load(struct AssetManager *manager, enum AssetType type, const char *name, ...)
+{
+    va_list args;
+    va_start(args, name);
+    bool success = seel_asset_manager_load_args(manager, type, name, args);
+    va_end(args);
     if (success)
+        seel_asset_manager_enforce_budget(manager, type);
+    return success;
+}
+
+/*
+ * Same arguments as seel_asset_manager_load, but textures and models are
+ * read and decoded on the stream threads and uploaded over the following
+ * frames by seel_asset_manager_update. Until then the asset's data is a
+ * placeholder (a grey texture or a unit cube) that is replaced in place, so
+ * pointers taken from seel_asset_manager_get stay valid. Shaders compile on
+ * the GL thread and animations need their model, so those load right away.
+ */
+struct AssetHandle seel_asset_manager_load_async(struct AssetManager *manager, enum AssetType type, const char *name, ...)
+{
+    struct AssetHandle handle = seel_asset_manager_find(manager, type, name);
+    if (handle.index != SEEL_INVALID_ASSET_INDEX)
+        return handle;
+
+    va_list args;
+    va_start(args, name);
+    if (type != ASSET_TEXTURE && type != ASSET_MODEL)
+    {
+        bool success = seel_asset_manager_load_args(manager, type, name, args);
+        va_end(args);
+        return success ? seel_asset_manager_find(manager, type, name) : handle;
+    }
+
+    struct StreamRequest *request = calloc(1, sizeof(struct StreamRequest));
+    if (!request)
+    {
+        fprintf(stderr, "Failed to allocate memory for stream request!\n");
+        va_end(args);
+        return handle;
+    }
+    request->type = type == ASSET_TEXTURE ? STREAM_REQUEST_TEXTURE : STREAM_REQUEST_MODEL;
+    snprintf(request->path, sizeof(request->path), "%s", va_arg(args, const char *));
+    if (type == ASSET_TEXTURE)
+        request->texture.type = va_arg(args, enum TextureType);
+    va_end(args);
+
+    if (!seel_asset_stream_start(&manager->streamer))
+    {
+        free(request);
+        return handle;
+    }
+
+    struct Asset asset;
+    strncpy(asset.name, name, MAX_ASSET_NAME_LEN - 1);
+    asset.name[MAX_ASSET_NAME_LEN - 1] = '\0';
+    asset.type = type;
+    asset.state = ASSET_STATE_LOADING;
+    if (type == ASSET_TEXTURE)
     {
-        struct Asset *new_assets = realloc(manager->assets, (manager->num_assets + 1) * sizeof(struct Asset));
-        if (!new_assets)
+        asset.data.texture = malloc(sizeof(struct Texture));
+        if (asset.data.texture)
         {
-            fprintf(stderr, "Failed to reallocate asset manager memory.\n");
-            free(asset.data.shader);
-            return false;
+            *asset.data.texture = manager->streamer.placeholder_texture;
+            asset.data.texture->type = request->texture.type;
         }
-        manager->assets = new_assets;
-        manager->assets[manager->num_assets++] = asset;
+    }
+    else
+    {
+        asset.data.model = malloc(sizeof(struct Model));
+        if (asset.data.model && manager->streamer.placeholder_model)
+            *asset.data.model = *manager->streamer.placeholder_model;
+        else if (asset.data.model)
+            memset(asset.data.model, 0, sizeof(struct Model));
     }
 
-    return success;
+    if (!asset.data.shader || !seel_asset_manager_append(manager, &asset, &handle))
+    {
+        fprintf(stderr, "Failed to load asset: %s\n", name);
+        free(asset.data.shader);
+        free(request);
+        return handle;
+    }
+
+    request->asset = handle.index;
+    seel_asset_stream_submit(&manager->streamer, request);
+    return handle;
 }
 
-void *seel_asset_manager_get(const struct AssetManager *manager, enum AssetType type, const char *name)
+/*
+ * Swaps finished streamed assets in for their placeholders, uploading at
+ * most the streamer's upload_budget bytes. Call once per frame on the GL thread.
+ */
+void seel_asset_manager_update(struct AssetManager *manager)
 {
-    for (unsigned int i = 0; i < manager->num_assets; i++)
+    manager->frame++;
+
+    size_t budget = manager->streamer.upload_budget;
+    struct StreamRequest *request;
+    while ((request = seel_asset_stream_poll(&manager->streamer, &budget)))
     {
-        if (manager->assets[i].type == type && strcmp(manager->assets[i].name, name) == 0)
+        struct Asset *asset = seel_asset_manager_at(manager, request->asset);
+        if (!request->ok)
         {
-            switch (type)
-            {
-            case ASSET_SHADER:
-                return manager->assets[i].data.shader;
-            case ASSET_TEXTURE:
-                return manager->assets[i].data.texture;
-            case ASSET_MODEL:
-                return manager->assets[i].data.model;
-            default:
-                return NULL;
-            }
+            fprintf(stderr, "Failed to stream asset %s from %s!\n", asset->name, request->path);
+            asset->state = ASSET_STATE_FAILED;
         }
+        else if (request->type == STREAM_REQUEST_TEXTURE)
+        {
+            *asset->data.texture = request->texture;
+            request->texture.id = 0; /* the asset owns it now */
+            asset->state = ASSET_STATE_READY;
+        }
+        else
+        {
+            *asset->data.model = *request->model;
+            free(request->model);
+            request->model = NULL;
+            asset->state = ASSET_STATE_READY;
+        }
+        seel_asset_manager_measure(manager, asset);
+        seel_asset_stream_request_free(request);
+    }
+
+    for (unsigned int type = 0; type < ASSET_TYPE_COUNT; type++)
+        seel_asset_manager_enforce_budget(manager, (enum AssetType)type);
+}
+
+void *seel_asset_manager_get(const struct AssetManager *manager, enum AssetType type, const char *name)
+{
+    unsigned int index = seel_asset_manager_lookup(manager, type, name);
+    if (index == SEEL_INVALID_ASSET_INDEX)
+        return NULL;
+    return seel_asset_data(seel_asset_manager_at(manager, index));
+}
+
+/* Looks the name up once; keep the handle and resolve it instead of calling seel_asset_manager_get every frame */
+struct AssetHandle seel_asset_manager_find(const struct AssetManager *manager, enum AssetType type, const char *name)
+{
+    unsigned int index = seel_asset_manager_lookup(manager, type, name);
+    if (index == SEEL_INVALID_ASSET_INDEX)
+        return (struct AssetHandle){SEEL_INVALID_ASSET_INDEX, 0};
+    return (struct AssetHandle){index, seel_asset_manager_at(manager, index)->generation};
+}
+
+void *seel_asset_manager_resolve(struct AssetManager *manager, struct AssetHandle handle)
+{
+    struct Asset *asset = seel_asset_manager_handle_asset(manager, handle);
+    if (!asset)
+        return NULL;
+
+    asset->last_used = manager->frame;
+    return seel_asset_data(asset);
+}
+
+/* Keeps the asset from being evicted or unloaded until the matching release */
+bool seel_asset_manager_acquire(struct AssetManager *manager, struct AssetHandle handle)
+{
+    struct Asset *asset = seel_asset_manager_handle_asset(manager, handle);
+    if (!asset)
+        return false;
+
+    asset->ref_count++;
+    asset->last_used = manager->frame;
+    return true;
+}
+
+/* Unreferenced assets stay loaded until a budget needs their memory */
+void seel_asset_manager_release(struct AssetManager *manager, struct AssetHandle handle)
+{
+    struct Asset *asset = seel_asset_manager_handle_asset(manager, handle);
+    if (!asset || !asset->ref_count)
+        return;
+
+    asset->ref_count--;
+    asset->last_used = manager->frame;
+}
+
+/* The asset keeps a reference on dependency, e.g. an animation on the model whose bone info it uses */
+void seel_asset_manager_set_dependency(struct AssetManager *manager, struct AssetHandle handle, struct AssetHandle dependency)
+{
+    struct Asset *asset = seel_asset_manager_handle_asset(manager, handle);
+    if (!asset || !seel_asset_manager_acquire(manager, dependency))
+        return;
+
+    seel_asset_manager_release(manager, asset->dependency);
+    asset->dependency = dependency;
+}
+
+/*
+ * Releases an unreferenced asset's memory and GL objects and frees its slot;
+ * handles to it resolve to NULL from then on. Assets still streaming in
+ * cannot be unloaded.
+ */
+bool seel_asset_manager_unload(struct AssetManager *manager, struct AssetHandle handle)
+{
+    struct Asset *asset = seel_asset_manager_handle_asset(manager, handle);
+    if (!asset || asset->ref_count || asset->state == ASSET_STATE_LOADING)
+        return false;
+
+    struct AssetMemoryStats *memory = &manager->memory[asset->type];
+    memory->count--;
+    memory->cpu_bytes -= asset->cpu_bytes;
+    memory->gpu_bytes -= asset->gpu_bytes;
+
+    seel_asset_table_remove(manager, seel_asset_hash(asset->type, asset->name), handle.index);
+    seel_asset_release_data(asset);
+    struct AssetHandle dependency = asset->dependency;
+
+    asset->type = ASSET_TYPE_COUNT;
+    asset->next_free = manager->free_slot;
+    manager->free_slot = handle.index;
+
+    seel_asset_manager_release(manager, dependency);
+    return true;
+}
+
+void seel_asset_manager_set_budget(struct AssetManager *manager, enum AssetType type, size_t cpu_bytes, size_t gpu_bytes)
+{
+    manager->budgets[type].cpu_bytes = cpu_bytes;
+    manager->budgets[type].gpu_bytes = gpu_bytes;
+    seel_asset_manager_enforce_budget(manager, type);
+}
+
+struct AssetMemoryStats seel_asset_manager_memory(const struct AssetManager *manager, enum AssetType type)
+{
+    return manager->memory[type];
+}
+
+void seel_asset_manager_print_memory(const struct AssetManager *manager)
+{
+    static const char *names[ASSET_TYPE_COUNT] = {"shaders", "textures", "models", "animations"};
+    for (unsigned int type = 0; type < ASSET_TYPE_COUNT; type++)
+    {
+        const struct AssetMemoryStats *memory = &manager->memory[type];
+        printf("%-10s %4u live, %8.2f MiB CPU, %8.2f MiB GPU\n", names[type], memory->count,
+               memory->cpu_bytes / (1024.0 * 1024.0), memory->gpu_bytes / (1024.0 * 1024.0));
     }
-    return NULL;
+}
+
+enum AssetState seel_asset_manager_state(const struct AssetManager *manager, struct AssetHandle handle)
+{
+    struct Asset *asset = seel_asset_manager_handle_asset(manager, handle);
+    return asset ? asset->state : ASSET_STATE_FAILED;
+}
+
+const char *seel_asset_manager_name(const struct AssetManager *manager, struct AssetHandle handle)
+{
+    struct Asset *asset = seel_asset_manager_handle_asset(manager, handle);
+    return asset ? asset->name : NULL;
 }
 
 #endif /* ASSET_MANAGER_H */
\ No newline at end of file
@@ -0,0 +1,547 @@
+#ifndef ASSET_STREAM_H
+#define ASSET_STREAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "glad/gl.h"
+#include "cglm/cglm.h"
+#include "texture.h"
+#include "texture_file.h"
+#include "mesh.h"
+#include "model.h"
+#include "mesh_file.h"
+
+/* Threads reading and decoding streamed assets */
+#define SEEL_ASSET_STREAM_THREADS 2
+/* Bytes uploaded to GL per frame by default; every frame makes progress on at least one step */
+#define SEEL_ASSET_UPLOAD_BUDGET (4 * 1024 * 1024)
+
+enum StreamRequestType
+{
+    STREAM_REQUEST_TEXTURE,
+    STREAM_REQUEST_MODEL
+};
+
+/*
+ * One asset on its way in. A stream thread reads and decodes it without
+ * touching GL; the main thread then uploads it step by step, a mesh or a
+ * band of texture rows at a time, and hands it back once it is complete.
+ */
+struct StreamRequest
+{
+    enum StreamRequestType type;
+    unsigned int asset; /* asset the result replaces the placeholder of */
+    char path[MAX_DIRECTORY_LEN];
+    bool ok;
+
+    struct Texture texture;      /* texture requests */
+    struct Model *model;         /* model requests, imported for the CPU only */
+    struct TextureImage *images; /* the texture's image, or one per textures_loaded entry of the model */
+    unsigned int num_images;
+
+    /* upload progress, main thread only */
+    unsigned int next_mesh;
+    unsigned int next_image;
+    int next_row; /* mip level for compressed images */
+
+    struct StreamRequest *next;
+};
+
+/* Queue in front of the stream threads and the uploads they leave for the main thread */
+struct AssetStreamer
+{
+    pthread_t threads[SEEL_ASSET_STREAM_THREADS];
+    unsigned int num_threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_ready;
+    pthread_mutex_t import_mutex; /* Assimp's C API keeps its last error in a global */
+    bool running;
+
+    struct StreamRequest *queued; /* waiting for a stream thread */
+    struct StreamRequest *queued_tail;
+    struct StreamRequest *decoded; /* waiting for the main thread */
+    struct StreamRequest *decoded_tail;
+    struct StreamRequest *uploading; /* main thread only */
+
+    unsigned int pbo; /* orphaned for every band of texture rows */
+    size_t upload_budget;
+
+    struct Texture placeholder_texture;
+    struct Model *placeholder_model;
+};
+
+void seel_asset_stream_init(struct AssetStreamer *streamer);
+bool seel_asset_stream_start(struct AssetStreamer *streamer);
+void seel_asset_stream_submit(struct AssetStreamer *streamer, struct StreamRequest *request);
+struct StreamRequest *seel_asset_stream_poll(struct AssetStreamer *streamer, size_t *budget);
+void seel_asset_stream_request_free(struct StreamRequest *request);
+void seel_asset_stream_destroy(struct AssetStreamer *streamer);
+
+/* Nothing is started until the first request, so the streamer may still be copied */
+void seel_asset_stream_init(struct AssetStreamer *streamer)
+{
+    memset(streamer, 0, sizeof(struct AssetStreamer));
+    streamer->upload_budget = SEEL_ASSET_UPLOAD_BUDGET;
+}
+
+static void seel_stream_request_decode(struct AssetStreamer *streamer, struct StreamRequest *request)
+{
+    if (request->type == STREAM_REQUEST_TEXTURE)
+    {
+        request->images = calloc(1, sizeof(struct TextureImage));
+        request->num_images = request->images ? 1 : 0;
+        request->ok = request->images && seel_texture_decode_cached(request->path, &request->images[0]);
+        return;
+    }
+
+    request->model = malloc(sizeof(struct Model));
+    if (!request->model)
+    {
+        fprintf(stderr, "Failed to allocate memory for streamed model!\n");
+        return;
+    }
+
+    pthread_mutex_lock(&streamer->import_mutex);
+    *request->model = seel_model_import_cached(request->path);
+    pthread_mutex_unlock(&streamer->import_mutex);
+
+    struct Model *model = request->model;
+    request->ok = model->num_meshes > 0;
+    if (!request->ok || !model->num_textures)
+        return;
+
+    request->images = calloc(model->num_textures, sizeof(struct TextureImage));
+    if (!request->images)
+    {
+        fprintf(stderr, "Failed to allocate memory for decoded textures!\n");
+        return;
+    }
+    request->num_images = model->num_textures;
+
+    /* a texture that fails to decode stays empty, as with seel_model_load */
+    unsigned int i;
+    for (i = 0; i < model->num_textures; i++)
+    {
+        char path[MAX_DIRECTORY_LEN + MAX_TEXTURE_NAME_LEN];
+        snprintf(path, sizeof(path), "%s%s", model->directory, model->textures_loaded[i].name);
+        seel_texture_decode_cached(path, &request->images[i]);
+    }
+}
+
+static void *seel_asset_stream_main(void *arg)
+{
+    struct AssetStreamer *streamer = (struct AssetStreamer *)arg;
+
+    pthread_mutex_lock(&streamer->mutex);
+    for (;;)
+    {
+        while (streamer->running && !streamer->queued)
+            pthread_cond_wait(&streamer->work_ready, &streamer->mutex);
+        if (!streamer->running)
+            break;
+
+        struct StreamRequest *request = streamer->queued;
+        streamer->queued = request->next;
+        if (!streamer->queued)
+            streamer->queued_tail = NULL;
+        pthread_mutex_unlock(&streamer->mutex);
+
+        seel_stream_request_decode(streamer, request);
+
+        pthread_mutex_lock(&streamer->mutex);
+        request->next = NULL;
+        if (streamer->decoded_tail)
+            streamer->decoded_tail->next = request;
+        else
+            streamer->decoded = request;
+        streamer->decoded_tail = request;
+    }
+    pthread_mutex_unlock(&streamer->mutex);
+
+    return NULL;
+}
+
+/* Unit cube around the origin with the placeholder texture as its diffuse map */
+static struct Model *seel_asset_stream_create_placeholder_model(struct Texture texture)
+{
+    struct Model *model = calloc(1, sizeof(struct Model));
+    struct Vertex *vertices = malloc(sizeof(struct Vertex) * 24);
+    unsigned int *indices = malloc(sizeof(unsigned int) * 36);
+    struct Texture *textures = malloc(sizeof(struct Texture));
+    struct Mesh *meshes = malloc(sizeof(struct Mesh));
+    if (!model || !vertices || !indices || !textures || !meshes)
+    {
+        fprintf(stderr, "Failed to allocate memory for the placeholder model!\n");
+        free(model);
+        free(vertices);
+        free(indices);
+        free(textures);
+        free(meshes);
+        return NULL;
+    }
+
+    static const float corners[4][2] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f}};
+    unsigned int face, corner;
+    for (face = 0; face < 6; face++)
+    {
+        vec3 normal = {0.0f, 0.0f, 0.0f};
+        normal[face / 2] = face % 2 ? -1.0f : 1.0f;
+        vec3 up = {0.0f, face / 2 == 1 ? 0.0f : 1.0f, face / 2 == 1 ? 1.0f : 0.0f};
+        vec3 u, v;
+        glm_vec3_cross(up, normal, u);
+        glm_vec3_cross(normal, u, v);
+
+        for (corner = 0; corner < 4; corner++)
+        {
+            struct Vertex *vertex = &vertices[face * 4 + corner];
+            seel_set_vertex_bone_data_to_default(vertex);
+            glm_vec3_scale(normal, 0.5f, vertex->position);
+            glm_vec3_muladds(u, corners[corner][0] * 0.5f, vertex->position);
+            glm_vec3_muladds(v, corners[corner][1] * 0.5f, vertex->position);
+            glm_vec3_copy(normal, vertex->normal);
+            glm_vec3_copy(u, vertex->tangent);
+            glm_vec3_copy(v, vertex->bitangent);
+            vertex->tex_coords[0] = corners[corner][0] * 0.5f + 0.5f;
+            vertex->tex_coords[1] = corners[corner][1] * 0.5f + 0.5f;
+        }
+
+        static const unsigned int quad[6] = {0, 1, 2, 0, 2, 3};
+        for (corner = 0; corner < 6; corner++)
+            indices[face * 6 + corner] = face * 4 + quad[corner];
+    }
+
+    textures[0] = texture;
+    meshes[0] = seel_mesh_init(vertices, indices, textures, 24, 36, 1);
+    model->meshes = meshes;
+    model->num_meshes = 1;
+    seel_model_update_bounds(model);
+    strcpy(model->name, "placeholder");
+    return model;
+}
+
+/* Starts the stream threads and creates the placeholders; call on the GL thread */
+bool seel_asset_stream_start(struct AssetStreamer *streamer)
+{
+    if (streamer->running)
+        return true;
+
+    static const unsigned char grey[4] = {128, 128, 128, 255};
+    struct TextureImage image = {.data = (unsigned char *)grey, .width = 1, .height = 1, .channels = 4, .compressed_format = 0, .levels = 1};
+    glGenTextures(1, &streamer->placeholder_texture.id);
+    seel_texture_upload(streamer->placeholder_texture.id, &image);
+    streamer->placeholder_texture.type = DIFFUSE;
+    strcpy(streamer->placeholder_texture.name, "placeholder");
+    streamer->placeholder_model = seel_asset_stream_create_placeholder_model(streamer->placeholder_texture);
+
+    glGenBuffers(1, &streamer->pbo);
+
+    pthread_mutex_init(&streamer->mutex, NULL);
+    pthread_mutex_init(&streamer->import_mutex, NULL);
+    pthread_cond_init(&streamer->work_ready, NULL);
+    streamer->running = true;
+
+    unsigned int i;
+    for (i = 0; i < SEEL_ASSET_STREAM_THREADS; i++)
+    {
+        if (pthread_create(&streamer->threads[i], NULL, seel_asset_stream_main, streamer) != 0)
+        {
+            fprintf(stderr, "Failed to create asset stream thread!\n");
+            break;
+        }
+        streamer->num_threads++;
+    }
+
+    if (!streamer->num_threads)
+    {
+        seel_asset_stream_destroy(streamer);
+        return false;
+    }
+    return true;
+}
+
+/* Takes ownership of the request; the streamer must have been started */
+void seel_asset_stream_submit(struct AssetStreamer *streamer, struct StreamRequest *request)
+{
+    request->next = NULL;
+
+    pthread_mutex_lock(&streamer->mutex);
+    if (streamer->queued_tail)
+        streamer->queued_tail->next = request;
+    else
+        streamer->queued = request;
+    streamer->queued_tail = request;
+    pthread_cond_signal(&streamer->work_ready);
+    pthread_mutex_unlock(&streamer->mutex);
+}
+
+static void seel_asset_stream_spend(size_t *budget, size_t bytes)
+{
+    *budget = bytes < *budget ? *budget - bytes : 0;
+}
+
+/* Uploads as many rows of the current image as the budget allows, at least one */
+static void seel_asset_stream_upload_rows(struct AssetStreamer *streamer, struct StreamRequest *request, size_t *budget)
+{
+    struct TextureImage *image = &request->images[request->next_image];
+    unsigned int *id = request->model ? &request->model->textures_loaded[request->next_image].id : &request->texture.id;
+    unsigned int format = seel_texture_image_format(image);
+
+    if (request->next_row == 0)
+    {
+        /* allocates level 0 only; rows follow over as many frames as they need */
+        struct TextureImage storage = *image;
+        storage.data = NULL;
+        glGenTextures(1, id);
+        seel_texture_upload(*id, &storage);
+        if (image->data)
+        {
+            glBindTexture(GL_TEXTURE_2D, *id);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image->width, image->height, 0, format, GL_UNSIGNED_BYTE, NULL);
+        }
+    }
+
+    if (!image->data)
+    {
+        request->next_image++;
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return;
+    }
+
+    size_t row_size = (size_t)image->width * image->channels;
+    size_t rows = row_size ? *budget / row_size : 0;
+    if (rows < 1)
+        rows = 1;
+    if (rows > (size_t)(image->height - request->next_row))
+        rows = image->height - request->next_row;
+    size_t size = rows * row_size;
+    const unsigned char *source = image->data + request->next_row * row_size;
+
+    glBindTexture(GL_TEXTURE_2D, *id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamer->pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped)
+    {
+        memcpy(mapped, source, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, request->next_row, image->width, rows, format, GL_UNSIGNED_BYTE, (void *)0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, request->next_row, image->width, rows, format, GL_UNSIGNED_BYTE, source);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    request->next_row += rows;
+    seel_asset_stream_spend(budget, size);
+    if (request->next_row >= image->height)
+    {
+        glGenerateMipmap(GL_TEXTURE_2D);
+        seel_texture_image_free(image);
+        request->next_image++;
+        request->next_row = 0;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/* Uploads as many mip levels of the current compressed image as the budget allows, at least one */
+static void seel_asset_stream_upload_levels(struct AssetStreamer *streamer, struct StreamRequest *request, size_t *budget)
+{
+    struct TextureImage *image = &request->images[request->next_image];
+    unsigned int *id = request->model ? &request->model->textures_loaded[request->next_image].id : &request->texture.id;
+
+    if (request->next_row == 0)
+    {
+        struct TextureImage storage = *image;
+        storage.data = NULL;
+        glGenTextures(1, id);
+        seel_texture_upload(*id, &storage);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, *id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image->levels - 1);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamer->pbo);
+    do
+    {
+        size_t offset = seel_texture_level_offset(image, request->next_row);
+        size_t size = seel_texture_level_offset(image, request->next_row + 1) - offset;
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped)
+        {
+            memcpy(mapped, image->data + offset, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            seel_texture_upload_level(image, request->next_row, (void *)0);
+        }
+        else
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            seel_texture_upload_level(image, request->next_row, image->data + offset);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamer->pbo);
+        }
+        seel_asset_stream_spend(budget, size);
+        request->next_row++;
+    } while (*budget && request->next_row < image->levels);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (request->next_row >= image->levels)
+    {
+        seel_texture_image_free(image);
+        request->next_image++;
+        request->next_row = 0;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/* Returns true once the whole request is on the GPU */
+static bool seel_asset_stream_upload_step(struct AssetStreamer *streamer, struct StreamRequest *request, size_t *budget)
+{
+    struct Model *model = request->model;
+    if (model && request->next_mesh < model->num_meshes)
+    {
+        struct Mesh *mesh = &model->meshes[request->next_mesh++];
+        seel_mesh_setup(mesh);
+        seel_asset_stream_spend(budget, seel_mesh_vertex_buffer_size(mesh) + seel_mesh_index_buffer_size(mesh));
+        return false;
+    }
+
+    if (request->next_image < request->num_images)
+    {
+        if (request->images[request->next_image].compressed_format)
+            seel_asset_stream_upload_levels(streamer, request, budget);
+        else
+            seel_asset_stream_upload_rows(streamer, request, budget);
+        return false;
+    }
+
+    if (model)
+    {
+        seel_model_bind_texture_ids(model);
+        model->cpu_only = false;
+    }
+    return true;
+}
+
+/*
+ * Main thread side: uploads decoded requests in order until budget runs
+ * out. Returns a request once it is complete or has failed, NULL when
+ * nothing is ready this frame; the caller frees it with
+ * seel_asset_stream_request_free after taking its result.
+ */
+struct StreamRequest *seel_asset_stream_poll(struct AssetStreamer *streamer, size_t *budget)
+{
+    if (!streamer->running)
+        return NULL;
+
+    if (!streamer->uploading)
+    {
+        pthread_mutex_lock(&streamer->mutex);
+        streamer->uploading = streamer->decoded;
+        if (streamer->decoded)
+        {
+            streamer->decoded = streamer->decoded->next;
+            if (!streamer->decoded)
+                streamer->decoded_tail = NULL;
+        }
+        pthread_mutex_unlock(&streamer->mutex);
+    }
+
+    struct StreamRequest *request = streamer->uploading;
+    if (!request)
+        return NULL;
+
+    if (request->ok)
+    {
+        bool done = false;
+        while (*budget > 0 && !done)
+            done = seel_asset_stream_upload_step(streamer, request, budget);
+        if (!done)
+            return NULL;
+    }
+
+    streamer->uploading = NULL;
+    return request;
+}
+
+/*
+ * Frees the request with whatever it still owns: a model, even a failed or
+ * partly uploaded one, and a generated texture. A caller taking the result
+ * clears texture.id or frees and clears model first. Call on the GL thread.
+ */
+void seel_asset_stream_request_free(struct StreamRequest *request)
+{
+    unsigned int i;
+    for (i = 0; i < request->num_images; i++)
+        seel_texture_image_free(&request->images[i]);
+    free(request->images);
+    if (request->model)
+    {
+        seel_model_destroy(request->model);
+        free(request->model);
+    }
+    if (request->texture.id)
+        glDeleteTextures(1, &request->texture.id);
+    free(request);
+}
+
+static void seel_asset_stream_free_list(struct StreamRequest *request)
+{
+    while (request)
+    {
+        struct StreamRequest *next = request->next;
+        seel_asset_stream_request_free(request);
+        request = next;
+    }
+}
+
+/* Joins the stream threads and drops every request still in flight */
+void seel_asset_stream_destroy(struct AssetStreamer *streamer)
+{
+    if (!streamer->running)
+        return;
+
+    pthread_mutex_lock(&streamer->mutex);
+    streamer->running = false;
+    pthread_cond_broadcast(&streamer->work_ready);
+    pthread_mutex_unlock(&streamer->mutex);
+
+    unsigned int i;
+    for (i = 0; i < streamer->num_threads; i++)
+        pthread_join(streamer->threads[i], NULL);
+
+    seel_asset_stream_free_list(streamer->queued);
+    seel_asset_stream_free_list(streamer->decoded);
+    if (streamer->uploading)
+        seel_asset_stream_request_free(streamer->uploading);
+
+    if (streamer->placeholder_model)
+    {
+        struct Mesh *mesh = &streamer->placeholder_model->meshes[0];
+        seel_mesh_release(mesh);
+        free(mesh->vertices);
+        free(mesh->indices);
+        free(mesh->textures);
+        free(mesh->bone_bounds);
+        free(streamer->placeholder_model->meshes);
+        free(streamer->placeholder_model);
+    }
+    glDeleteTextures(1, &streamer->placeholder_texture.id);
+    glDeleteBuffers(1, &streamer->pbo);
+
+    pthread_cond_destroy(&streamer->work_ready);
+    pthread_mutex_destroy(&streamer->import_mutex);
+    pthread_mutex_destroy(&streamer->mutex);
+
+    size_t budget = streamer->upload_budget;
+    seel_asset_stream_init(streamer);
+    streamer->upload_budget = budget;
+}
+
+#endif /* ASSET_STREAM_H */
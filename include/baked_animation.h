@@ -0,0 +1,154 @@
+#ifndef BAKED_ANIMATION_H
+#define BAKED_ANIMATION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "glad/gl.h"
+#include "cglm/cglm.h"
+#include "animation.h"
+#include "animator.h"
+
+#define MAX_BAKED_CLIPS 16
+#define SEEL_BAKE_SAMPLE_RATE 30.0f
+/* Texture unit the baked bone texture is bound to, above any material texture */
+#define SEEL_BAKED_ANIMATION_TEXTURE_UNIT 15
+
+struct BakedClip
+{
+    unsigned int first_frame;
+    unsigned int num_frames;
+};
+
+/*
+ * Skinning palettes of one or more clips sampled at a fixed rate into a
+ * RGBA32F texture. Every row is one frame; every bone takes three texels
+ * holding the first three rows of its affine skinning matrix.
+ */
+struct BakedAnimationSet
+{
+    unsigned int texture;
+    unsigned int num_bones;
+    unsigned int num_frames;
+    float sample_rate;
+    struct BakedClip clips[MAX_BAKED_CLIPS];
+    unsigned int num_clips;
+    float *frames;
+};
+
+/* Per-instance data of a skinned-instanced draw, read by default.vert at locations 7-12 */
+struct CrowdInstance
+{
+    mat4 transform;
+    int clip;
+    float time; /* seconds into the clip */
+};
+
+void seel_baked_animation_init(struct BakedAnimationSet *set, unsigned int num_bones, float sample_rate)
+{
+    memset(set, 0, sizeof(struct BakedAnimationSet));
+    set->num_bones = num_bones < MAX_MODEL_BONES ? num_bones : MAX_MODEL_BONES;
+    set->sample_rate = sample_rate > 0.0f ? sample_rate : SEEL_BAKE_SAMPLE_RATE;
+}
+
+/*
+ * Samples the clip's bone palette at the set's rate; returns the clip id or -1.
+ * All clips have to be added before the set is uploaded.
+ */
+int seel_baked_animation_add_clip(struct BakedAnimationSet *set, struct Animation *animation)
+{
+    if (set->texture || set->num_clips >= MAX_BAKED_CLIPS || !animation || animation->ticks_per_second <= 0)
+    {
+        fprintf(stderr, "Failed to bake animation clip!\n");
+        return -1;
+    }
+
+    float duration = animation->duration / animation->ticks_per_second;
+    unsigned int num_frames = (unsigned int)ceilf(duration * set->sample_rate);
+    if (num_frames == 0)
+        num_frames = 1;
+
+    unsigned int row_floats = set->num_bones * 3 * 4;
+    float *frames = (float *)realloc(set->frames, sizeof(float) * row_floats * (set->num_frames + num_frames));
+    if (!frames)
+    {
+        fprintf(stderr, "Failed to allocate memory for baked animation frames!\n");
+        return -1;
+    }
+    set->frames = frames;
+
+    struct Animator animator;
+    seel_animator_create(&animator);
+
+    unsigned int frame;
+    for (frame = 0; frame < num_frames; frame++)
+    {
+        float time = fmodf((float)frame / set->sample_rate * animation->ticks_per_second, animation->duration);
+        seel_calculate_bone_transform(&animator, animation, time);
+
+        float *row = &set->frames[(set->num_frames + frame) * row_floats];
+        unsigned int bone;
+        for (bone = 0; bone < set->num_bones; bone++)
+        {
+            mat4 *m = &animator.final_bone_matrices[bone];
+            unsigned int r;
+            for (r = 0; r < 3; r++)
+            {
+                float *texel = &row[(bone * 3 + r) * 4];
+                texel[0] = (*m)[0][r];
+                texel[1] = (*m)[1][r];
+                texel[2] = (*m)[2][r];
+                texel[3] = (*m)[3][r];
+            }
+        }
+    }
+
+    seel_animator_destroy(&animator);
+
+    struct BakedClip *clip = &set->clips[set->num_clips];
+    clip->first_frame = set->num_frames;
+    clip->num_frames = num_frames;
+    set->num_frames += num_frames;
+    return set->num_clips++;
+}
+
+/* Uploads every baked clip; the CPU copy is released afterwards */
+bool seel_baked_animation_upload(struct BakedAnimationSet *set)
+{
+    if (!set->frames || !set->num_frames)
+        return false;
+
+    if (!set->texture)
+        glGenTextures(1, &set->texture);
+
+    glBindTexture(GL_TEXTURE_2D, set->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, set->num_bones * 3, set->num_frames, 0, GL_RGBA, GL_FLOAT, set->frames);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    free(set->frames);
+    set->frames = NULL;
+    return true;
+}
+
+float seel_baked_clip_duration(const struct BakedAnimationSet *set, int clip)
+{
+    if (clip < 0 || (unsigned int)clip >= set->num_clips)
+        return 0.0f;
+    return (float)set->clips[clip].num_frames / set->sample_rate;
+}
+
+void seel_baked_animation_destroy(struct BakedAnimationSet *set)
+{
+    if (set->texture)
+        glDeleteTextures(1, &set->texture);
+    free(set->frames);
+    memset(set, 0, sizeof(struct BakedAnimationSet));
+}
+
+#endif /* BAKED_ANIMATION_H */
@@ -34,6 +34,14 @@ struct BoneInfo
     mat4 offset;
 };
 
+/* Key segments used by the last sample of a channel, kept per animator */
+struct KeyCursor
+{
+    unsigned int position;
+    unsigned int rotation;
+    unsigned int scale;
+};
+
 struct Bone
 {
     struct KeyPosition *positions;
@@ -122,42 +130,47 @@ struct Bone seel_bone_create(const char *name, int id, const struct aiNodeAnim *
     return bone;
 }
 
-unsigned int seel_get_position_index(struct Bone *bone, float animation_time)
-{
-        for (int index = 0; index < bone->num_positions - 1; ++index)
-        {
-            if (animation_time < bone->positions[index + 1].time_stamp)
-                return index;
-        }
-        assert(0);
-}
+#define SEEL_KEY_TIME(keys, stride, index) (*(const float *)((const char *)(keys) + (size_t)(index) * (stride)))
 
-unsigned int seel_get_rotation_index(struct Bone *bone, float animation_time)
+/*
+ * Returns the index of the key segment [index, index + 1] that contains
+ * animation_time. `hint` is the segment returned by the previous sample:
+ * regular playback stays in it or moves on to the next one, so both are
+ * checked first. Seeks, loop wraps and large time steps fall back to a binary
+ * search over the time stamps.
+ */
+unsigned int seel_find_key_index(const float *first_time_stamp, size_t stride, unsigned int num_keys, float animation_time, unsigned int hint)
 {
-    if (bone->num_rotations <= 1)
+    if (num_keys <= 1)
         return 0;
 
-    unsigned int index;
-    for (index = 0; index < bone->num_rotations - 1; index++)
+    unsigned int last = num_keys - 2;
+    if (hint > last)
+        hint = last;
+
+    if (animation_time >= SEEL_KEY_TIME(first_time_stamp, stride, hint))
     {
-        if (animation_time < bone->rotations[index + 1].time_stamp)
-            return index;
+        if (animation_time < SEEL_KEY_TIME(first_time_stamp, stride, hint + 1))
+            return hint;
+        if (hint < last && animation_time < SEEL_KEY_TIME(first_time_stamp, stride, hint + 2))
+            return hint + 1;
     }
-    return bone->num_rotations - 2;
-}
 
-unsigned int seel_get_scale_index(struct Bone *bone, float animation_time)
-{
-    if (bone->num_scalings <= 1)
-        return 0;
-
-    for (int index = 0; index < bone->num_scalings - 1; index++)
+    /* first key in [1, num_keys - 1] whose time stamp is past animation_time */
+    unsigned int low = 1;
+    unsigned int high = num_keys - 1;
+    while (low < high)
     {
-        if (animation_time < bone->scalings[index + 1].time_stamp)
-            return index;
+        unsigned int mid = low + (high - low) / 2;
+        if (animation_time < SEEL_KEY_TIME(first_time_stamp, stride, mid))
+            high = mid;
+        else
+            low = mid + 1;
     }
 
-    return bone->num_scalings - 2;
+    if (animation_time >= SEEL_KEY_TIME(first_time_stamp, stride, low))
+        return last;
+    return low - 1;
 }
 
 float seel_get_scale_factor(float last_time_stamp, float next_time_stamp, float animation_time)
@@ -194,36 +207,59 @@ void seel_interpolate_scaling(float animation_time, struct KeyScale from, struct
     glm_scale_to(GLM_MAT4_IDENTITY, final_scale, dest);
 }
 
-void seel_bone_update(struct Bone *bone, float animation_time)
+/*
+ * Samples the channel at animation_time into dest. `cursor` keeps the key
+ * segments of the previous sample for this channel so consecutive frames skip
+ * the search entirely; pass NULL for a one-off sample.
+ */
+void seel_bone_sample(struct Bone *bone, float animation_time, struct KeyCursor *cursor, mat4 dest)
 {
-    unsigned int pos_index = seel_get_position_index(bone, animation_time);
+    struct KeyCursor scratch = {0};
+    if (!cursor)
+        cursor = &scratch;
+
     mat4 translation;
-    if (bone->num_positions)
+    if (bone->num_positions == 1)
     {
         glm_translate_to(GLM_MAT4_IDENTITY, bone->positions[0].position, translation);
     }
     else
+    {
+        unsigned int pos_index = seel_find_key_index(&bone->positions[0].time_stamp, sizeof(struct KeyPosition), bone->num_positions, animation_time, cursor->position);
+        cursor->position = pos_index;
         seel_interpolate_position(animation_time, bone->positions[pos_index], bone->positions[pos_index + 1], translation);
+    }
 
-    unsigned int rot_index = seel_get_rotation_index(bone, animation_time);
     mat4 rotation;
     if (bone->num_rotations == 1)
     {
         vec4 norm;
-        glm_normalize_to(bone->rotations[0].rotation, norm);
+        glm_quat_normalize_to(bone->rotations[0].rotation, norm);
         glm_quat_mat4(norm, rotation);
     }
     else
+    {
+        unsigned int rot_index = seel_find_key_index(&bone->rotations[0].time_stamp, sizeof(struct KeyRotation), bone->num_rotations, animation_time, cursor->rotation);
+        cursor->rotation = rot_index;
         seel_interpolate_rotation(animation_time, bone->rotations[rot_index], bone->rotations[rot_index + 1], rotation);
+    }
 
-    unsigned int scl_index = seel_get_scale_index(bone, animation_time);
     mat4 scale;
     if (bone->num_scalings == 1)
         glm_scale_to(GLM_MAT4_IDENTITY, bone->scalings[0].scale, scale);
     else
+    {
+        unsigned int scl_index = seel_find_key_index(&bone->scalings[0].time_stamp, sizeof(struct KeyScale), bone->num_scalings, animation_time, cursor->scale);
+        cursor->scale = scl_index;
         seel_interpolate_scaling(animation_time, bone->scalings[scl_index], bone->scalings[scl_index + 1], scale);
+    }
+
+    glm_mat4_mulN((mat4 *[]){&translation, &rotation, &scale}, 3, dest);
+}
 
-    glm_mat4_mulN((mat4 *[]){&translation, &rotation, &scale}, 3, bone->transform);
+void seel_bone_update(struct Bone *bone, float animation_time)
+{
+    seel_bone_sample(bone, animation_time, NULL, bone->transform);
 }
 
 #endif /* BONE_H */
\ No newline at end of file
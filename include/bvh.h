@@ -0,0 +1,427 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <float.h>
+
+#include "cglm/cglm.h"
+#include "frustum.h"
+
+/*
+ * Dynamic AABB tree over items identified by an index. Leaves keep a box
+ * enlarged by a margin, so items moving a little only need a containment
+ * check; items leaving their box are removed and reinserted. Insertion
+ * descends towards the sibling with the least surface area cost, and every
+ * ancestor is then rotated when swapping a child with a grandchild
+ * shrinks it, which keeps the tree balanced without rebuilds.
+ */
+
+#define SEEL_BVH_NULL -1
+/* Leaf boxes grow by this fraction of their size on every side, at least SEEL_BVH_MIN_MARGIN */
+#define SEEL_BVH_MARGIN 0.1f
+#define SEEL_BVH_MIN_MARGIN 0.01f
+
+struct BvhNode
+{
+    vec3 aabb[2];
+    int parent; /* next free node while on the free list */
+    int children[2];
+    int height;        /* 0 for leaves, -1 while free */
+    unsigned int item; /* leaves only */
+};
+
+struct Bvh
+{
+    struct BvhNode *nodes;
+    int *stack; /* traversal scratch, one entry per node */
+    unsigned int capacity;
+    unsigned int num_leaves;
+    int root;
+    int free_list;
+};
+
+/* Called for every item whose leaf box passes a query */
+typedef void (*BvhVisit)(void *context, unsigned int item);
+/* Tests the ray against an item and returns the distance of the hit, or max_distance to keep it */
+typedef float (*BvhRayHit)(void *context, unsigned int item, vec3 origin, vec3 direction, float max_distance);
+
+void seel_bvh_init(struct Bvh *bvh)
+{
+    memset(bvh, 0, sizeof(struct Bvh));
+    bvh->root = SEEL_BVH_NULL;
+    bvh->free_list = SEEL_BVH_NULL;
+}
+
+void seel_bvh_destroy(struct Bvh *bvh)
+{
+    free(bvh->nodes);
+    free(bvh->stack);
+    seel_bvh_init(bvh);
+}
+
+static float seel_bvh_area(vec3 aabb[2])
+{
+    vec3 size;
+    glm_vec3_sub(aabb[1], aabb[0], size);
+    return 2.0f * (size[0] * size[1] + size[1] * size[2] + size[2] * size[0]);
+}
+
+static float seel_bvh_union_area(vec3 a[2], vec3 b[2])
+{
+    vec3 merged[2];
+    glm_aabb_merge(a, b, merged);
+    return seel_bvh_area(merged);
+}
+
+static int seel_bvh_allocate_node(struct Bvh *bvh)
+{
+    if (bvh->free_list == SEEL_BVH_NULL)
+    {
+        unsigned int capacity = bvh->capacity ? bvh->capacity * 2 : 64;
+        struct BvhNode *nodes = realloc(bvh->nodes, sizeof(struct BvhNode) * capacity);
+        if (nodes)
+            bvh->nodes = nodes;
+        int *stack = realloc(bvh->stack, sizeof(int) * capacity);
+        if (stack)
+            bvh->stack = stack;
+        if (!nodes || !stack)
+        {
+            fprintf(stderr, "Failed to allocate memory for BVH nodes!\n");
+            return SEEL_BVH_NULL;
+        }
+
+        unsigned int i;
+        for (i = bvh->capacity; i < capacity; i++)
+        {
+            bvh->nodes[i].parent = i + 1 < capacity ? (int)i + 1 : SEEL_BVH_NULL;
+            bvh->nodes[i].height = -1;
+        }
+        bvh->free_list = bvh->capacity;
+        bvh->capacity = capacity;
+    }
+
+    int index = bvh->free_list;
+    struct BvhNode *node = &bvh->nodes[index];
+    bvh->free_list = node->parent;
+    node->parent = SEEL_BVH_NULL;
+    node->children[0] = node->children[1] = SEEL_BVH_NULL;
+    node->height = 0;
+    node->item = 0;
+    return index;
+}
+
+static void seel_bvh_free_node(struct Bvh *bvh, int index)
+{
+    bvh->nodes[index].parent = bvh->free_list;
+    bvh->nodes[index].height = -1;
+    bvh->free_list = index;
+}
+
+static void seel_bvh_fit(struct Bvh *bvh, int index)
+{
+    struct BvhNode *node = &bvh->nodes[index];
+    struct BvhNode *left = &bvh->nodes[node->children[0]], *right = &bvh->nodes[node->children[1]];
+    glm_aabb_merge(left->aabb, right->aabb, node->aabb);
+    node->height = 1 + glm_max(left->height, right->height);
+}
+
+/*
+ * Tries swapping each child of index with a grandchild under its sibling
+ * and keeps the swap that shrinks the sibling the most, if any does.
+ */
+static void seel_bvh_rotate(struct Bvh *bvh, int index)
+{
+    struct BvhNode *node = &bvh->nodes[index];
+    int best_child = -1, best_grandchild = SEEL_BVH_NULL;
+    float best_saving = 0.0f;
+
+    int side;
+    for (side = 0; side < 2; side++)
+    {
+        int child = node->children[side], sibling = node->children[1 - side];
+        struct BvhNode *other = &bvh->nodes[sibling];
+        if (other->height == 0)
+            continue;
+
+        /* child takes the place of one of sibling's children, which moves up next to sibling */
+        float area = seel_bvh_area(other->aabb);
+        int g;
+        for (g = 0; g < 2; g++)
+        {
+            int grandchild = other->children[g], kept = other->children[1 - g];
+            float saving = area - seel_bvh_union_area(bvh->nodes[child].aabb, bvh->nodes[kept].aabb);
+            if (saving > best_saving)
+            {
+                best_saving = saving;
+                best_child = side;
+                best_grandchild = grandchild;
+            }
+        }
+    }
+    if (best_child < 0)
+        return;
+
+    int child = node->children[best_child], sibling = node->children[1 - best_child];
+    struct BvhNode *other = &bvh->nodes[sibling];
+    int slot = other->children[0] == best_grandchild ? 0 : 1;
+    other->children[slot] = child;
+    bvh->nodes[child].parent = sibling;
+    node->children[best_child] = best_grandchild;
+    bvh->nodes[best_grandchild].parent = index;
+    seel_bvh_fit(bvh, sibling);
+    seel_bvh_fit(bvh, index);
+}
+
+/* Refits and rotates every ancestor from index up to the root */
+static void seel_bvh_refit(struct Bvh *bvh, int index)
+{
+    while (index != SEEL_BVH_NULL)
+    {
+        seel_bvh_fit(bvh, index);
+        seel_bvh_rotate(bvh, index);
+        index = bvh->nodes[index].parent;
+    }
+}
+
+/* Sibling for a new leaf: descends while the cost of merging lower beats merging here */
+static int seel_bvh_find_sibling(struct Bvh *bvh, vec3 aabb[2])
+{
+    int index = bvh->root;
+    while (bvh->nodes[index].height > 0)
+    {
+        struct BvhNode *node = &bvh->nodes[index];
+        float area = seel_bvh_area(node->aabb);
+        float combined = seel_bvh_union_area(node->aabb, aabb);
+        /* a new parent here costs the combined box; every ancestor below grows by the same amount */
+        float cost = 2.0f * combined;
+        float inherited = 2.0f * (combined - area);
+
+        float child_cost[2];
+        int i;
+        for (i = 0; i < 2; i++)
+        {
+            struct BvhNode *child = &bvh->nodes[node->children[i]];
+            float merged = seel_bvh_union_area(child->aabb, aabb);
+            child_cost[i] = (child->height == 0 ? merged : merged - seel_bvh_area(child->aabb)) + inherited;
+        }
+
+        if (cost < child_cost[0] && cost < child_cost[1])
+            break;
+        index = node->children[child_cost[1] < child_cost[0]];
+    }
+    return index;
+}
+
+static void seel_bvh_insert_leaf(struct Bvh *bvh, int leaf)
+{
+    if (bvh->root == SEEL_BVH_NULL)
+    {
+        bvh->root = leaf;
+        bvh->nodes[leaf].parent = SEEL_BVH_NULL;
+        return;
+    }
+
+    int sibling = seel_bvh_find_sibling(bvh, bvh->nodes[leaf].aabb);
+    int parent = seel_bvh_allocate_node(bvh);
+    if (parent == SEEL_BVH_NULL)
+        return;
+
+    int old_parent = bvh->nodes[sibling].parent;
+    bvh->nodes[parent].parent = old_parent;
+    bvh->nodes[parent].children[0] = sibling;
+    bvh->nodes[parent].children[1] = leaf;
+    bvh->nodes[sibling].parent = parent;
+    bvh->nodes[leaf].parent = parent;
+    if (old_parent == SEEL_BVH_NULL)
+        bvh->root = parent;
+    else
+        bvh->nodes[old_parent].children[bvh->nodes[old_parent].children[1] == sibling] = parent;
+
+    seel_bvh_refit(bvh, parent);
+}
+
+static void seel_bvh_remove_leaf(struct Bvh *bvh, int leaf)
+{
+    if (leaf == bvh->root)
+    {
+        bvh->root = SEEL_BVH_NULL;
+        return;
+    }
+
+    int parent = bvh->nodes[leaf].parent;
+    int grandparent = bvh->nodes[parent].parent;
+    int sibling = bvh->nodes[parent].children[bvh->nodes[parent].children[0] == leaf];
+    bvh->nodes[sibling].parent = grandparent;
+    if (grandparent == SEEL_BVH_NULL)
+        bvh->root = sibling;
+    else
+    {
+        bvh->nodes[grandparent].children[bvh->nodes[grandparent].children[1] == parent] = sibling;
+        seel_bvh_refit(bvh, grandparent);
+    }
+    seel_bvh_free_node(bvh, parent);
+}
+
+static void seel_bvh_fatten(vec3 aabb[2], vec3 fat[2])
+{
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        float margin = glm_max((aabb[1][i] - aabb[0][i]) * SEEL_BVH_MARGIN, SEEL_BVH_MIN_MARGIN);
+        fat[0][i] = aabb[0][i] - margin;
+        fat[1][i] = aabb[1][i] + margin;
+    }
+}
+
+/* Adds an item with the given box; returns its proxy, or SEEL_BVH_NULL when out of memory */
+int seel_bvh_insert(struct Bvh *bvh, vec3 aabb[2], unsigned int item)
+{
+    int leaf = seel_bvh_allocate_node(bvh);
+    if (leaf == SEEL_BVH_NULL)
+        return SEEL_BVH_NULL;
+
+    seel_bvh_fatten(aabb, bvh->nodes[leaf].aabb);
+    bvh->nodes[leaf].item = item;
+    seel_bvh_insert_leaf(bvh, leaf);
+    bvh->num_leaves++;
+    return leaf;
+}
+
+void seel_bvh_remove(struct Bvh *bvh, int proxy)
+{
+    seel_bvh_remove_leaf(bvh, proxy);
+    seel_bvh_free_node(bvh, proxy);
+    bvh->num_leaves--;
+}
+
+/*
+ * Updates the box of a proxy. Nothing changes while it stays inside the
+ * leaf's box and fills a fair part of it; returns whether the leaf moved.
+ */
+bool seel_bvh_move(struct Bvh *bvh, int proxy, vec3 aabb[2])
+{
+    struct BvhNode *leaf = &bvh->nodes[proxy];
+    vec3 fat[2];
+    seel_bvh_fatten(aabb, fat);
+    /* a box much larger than needed, e.g. after a model shrank, is refitted too */
+    if (glm_aabb_contains(leaf->aabb, aabb) && seel_bvh_area(leaf->aabb) <= 4.0f * seel_bvh_area(fat))
+        return false;
+
+    seel_bvh_remove_leaf(bvh, proxy);
+    glm_vec3_copy(fat[0], leaf->aabb[0]);
+    glm_vec3_copy(fat[1], leaf->aabb[1]);
+    seel_bvh_insert_leaf(bvh, proxy);
+    return true;
+}
+
+/* Visits every item whose leaf box is not entirely outside the frustum */
+void seel_bvh_query_frustum(struct Bvh *bvh, const struct Frustum *frustum, BvhVisit visit, void *context)
+{
+    if (bvh->root == SEEL_BVH_NULL)
+        return;
+
+    unsigned int top = 0;
+    bvh->stack[top++] = bvh->root;
+    while (top)
+    {
+        struct BvhNode *node = &bvh->nodes[bvh->stack[--top]];
+        if (!seel_frustum_test_aabb(frustum, node->aabb))
+            continue;
+        if (node->height == 0)
+            visit(context, node->item);
+        else
+        {
+            bvh->stack[top++] = node->children[0];
+            bvh->stack[top++] = node->children[1];
+        }
+    }
+}
+
+/* Visits every item whose leaf box overlaps the sphere */
+void seel_bvh_query_sphere(struct Bvh *bvh, vec3 center, float radius, BvhVisit visit, void *context)
+{
+    if (bvh->root == SEEL_BVH_NULL)
+        return;
+
+    unsigned int top = 0;
+    bvh->stack[top++] = bvh->root;
+    while (top)
+    {
+        struct BvhNode *node = &bvh->nodes[bvh->stack[--top]];
+        vec3 closest;
+        glm_vec3_maxv(node->aabb[0], center, closest);
+        glm_vec3_minv(node->aabb[1], closest, closest);
+        if (glm_vec3_distance2(closest, center) > radius * radius)
+            continue;
+        if (node->height == 0)
+            visit(context, node->item);
+        else
+        {
+            bvh->stack[top++] = node->children[0];
+            bvh->stack[top++] = node->children[1];
+        }
+    }
+}
+
+/*
+ * Distance along the ray to the box, FLT_MAX when it misses within
+ * max_distance; 0 when the origin is inside. Distances are in units of the
+ * direction's length.
+ */
+float seel_bvh_ray_box(vec3 aabb[2], vec3 origin, vec3 inverse_direction, float max_distance)
+{
+    float near = 0.0f, far = max_distance;
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        float t0 = (aabb[0][i] - origin[i]) * inverse_direction[i];
+        float t1 = (aabb[1][i] - origin[i]) * inverse_direction[i];
+        /* a zero direction gives nan when the origin lies on the slab's face; that counts as inside */
+        if (t0 != t0 || t1 != t1)
+            continue;
+        near = glm_max(near, glm_min(t0, t1));
+        far = glm_min(far, glm_max(t0, t1));
+    }
+    return near <= far ? near : FLT_MAX;
+}
+
+/*
+ * Casts a ray, direction normalized, through the items whose leaf boxes it
+ * passes, nearest subtrees first. hit narrows the search to the closest hit
+ * so far; returns the distance of the closest hit, max_distance if none.
+ */
+float seel_bvh_ray_cast(struct Bvh *bvh, vec3 origin, vec3 direction, float max_distance, BvhRayHit hit, void *context)
+{
+    if (bvh->root == SEEL_BVH_NULL)
+        return max_distance;
+
+    vec3 inverse_direction = {1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2]};
+    unsigned int top = 0;
+    bvh->stack[top++] = bvh->root;
+    while (top)
+    {
+        struct BvhNode *node = &bvh->nodes[bvh->stack[--top]];
+        if (seel_bvh_ray_box(node->aabb, origin, inverse_direction, max_distance) == FLT_MAX)
+            continue;
+        if (node->height == 0)
+        {
+            max_distance = glm_min(max_distance, hit(context, node->item, origin, direction, max_distance));
+            continue;
+        }
+
+        /* the nearer child goes on top, so it can shorten the ray before the other is tested */
+        float distance[2];
+        int i;
+        for (i = 0; i < 2; i++)
+            distance[i] = seel_bvh_ray_box(bvh->nodes[node->children[i]].aabb, origin, inverse_direction, max_distance);
+        int nearer = distance[1] < distance[0];
+        bvh->stack[top++] = node->children[1 - nearer];
+        bvh->stack[top++] = node->children[nearer];
+    }
+    return max_distance;
+}
+
+#endif /* BVH_H */
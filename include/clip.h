@@ -0,0 +1,558 @@
+#ifndef CLIP_H
+#define CLIP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cglm/cglm.h"
+#include "bone.h"
+
+/*
+ * Structure-of-arrays clip storage. Every key track of every channel lives in
+ * one shared time stream plus one value stream per component kind, so the
+ * sampler reads tightly packed floats instead of walking KeyPosition /
+ * KeyRotation / KeyScale records.
+ */
+struct ClipChannel
+{
+    unsigned int position_offset;
+    unsigned int num_positions;
+    unsigned int rotation_offset;
+    unsigned int num_rotations;
+    unsigned int scale_offset;
+    unsigned int num_scales;
+};
+
+/* Quantization range of a compressed channel: value = min + packed * extent / 65535 */
+struct ClipChannelRange
+{
+    float position_min[3];
+    float position_extent[3];
+    float scale_min[3];
+    float scale_extent[3];
+};
+
+struct AnimationClip
+{
+    struct ClipChannel *channels;
+    unsigned int num_channels;
+    float *position_times;
+    float *positions; /* xyz per key */
+    float *rotation_times;
+    float *rotations; /* xyzw per key */
+    float *scale_times;
+    float *scales; /* xyz per key */
+    unsigned int num_position_keys;
+    unsigned int num_rotation_keys;
+    unsigned int num_scale_keys;
+
+    /*
+     * Compressed form written by seel_clip_compress, which frees the float
+     * streams above. Keys store an index into a timeline shared by every
+     * track plus three 16-bit words: positions and scales quantized against
+     * the channel's range, rotations as smallest three.
+     */
+    bool compressed;
+    struct ClipChannelRange *ranges;
+    float *timeline;
+    unsigned int num_timeline_keys;
+    uint16_t *position_keys;
+    uint16_t *packed_positions;
+    uint16_t *rotation_keys;
+    uint16_t *packed_rotations;
+    uint16_t *scale_keys;
+    uint16_t *packed_scales;
+};
+
+/*
+ * The batch sampler evaluates SEEL_CLIP_LANES channels at once: one lane per
+ * bone, every arithmetic op applied to all lanes. AVX runs 8 bones per batch,
+ * SSE 4, and the scalar fallback goes through the same code one bone at a time.
+ */
+#if defined(CGLM_AVX_FP)
+#define SEEL_CLIP_LANES 8
+typedef __m256 seel_lane;
+#define seel_lane_load(p) _mm256_load_ps(p)
+#define seel_lane_store(p, a) _mm256_store_ps(p, a)
+#define seel_lane_set1(x) _mm256_set1_ps(x)
+#define seel_lane_add(a, b) _mm256_add_ps(a, b)
+#define seel_lane_sub(a, b) _mm256_sub_ps(a, b)
+#define seel_lane_mul(a, b) _mm256_mul_ps(a, b)
+#define seel_lane_div(a, b) _mm256_div_ps(a, b)
+#define seel_lane_sqrt(a) _mm256_sqrt_ps(a)
+#define seel_lane_min(a, b) _mm256_min_ps(a, b)
+#define seel_lane_max(a, b) _mm256_max_ps(a, b)
+/* flips the sign of b wherever the sign bit of s is set */
+#define seel_lane_xorsign(b, s) _mm256_xor_ps(b, _mm256_and_ps(s, _mm256_set1_ps(-0.0f)))
+#elif defined(CGLM_SSE_FP)
+#define SEEL_CLIP_LANES 4
+typedef __m128 seel_lane;
+#define seel_lane_load(p) _mm_load_ps(p)
+#define seel_lane_store(p, a) _mm_store_ps(p, a)
+#define seel_lane_set1(x) _mm_set1_ps(x)
+#define seel_lane_add(a, b) _mm_add_ps(a, b)
+#define seel_lane_sub(a, b) _mm_sub_ps(a, b)
+#define seel_lane_mul(a, b) _mm_mul_ps(a, b)
+#define seel_lane_div(a, b) _mm_div_ps(a, b)
+#define seel_lane_sqrt(a) _mm_sqrt_ps(a)
+#define seel_lane_min(a, b) _mm_min_ps(a, b)
+#define seel_lane_max(a, b) _mm_max_ps(a, b)
+#define seel_lane_xorsign(b, s) _mm_xor_ps(b, _mm_and_ps(s, _mm_set1_ps(-0.0f)))
+#else
+#define SEEL_CLIP_LANES 1
+typedef float seel_lane;
+#define seel_lane_load(p) (*(p))
+#define seel_lane_store(p, a) (*(p) = (a))
+#define seel_lane_set1(x) (x)
+#define seel_lane_add(a, b) ((a) + (b))
+#define seel_lane_sub(a, b) ((a) - (b))
+#define seel_lane_mul(a, b) ((a) * (b))
+#define seel_lane_div(a, b) ((a) / (b))
+#define seel_lane_sqrt(a) sqrtf(a)
+#define seel_lane_min(a, b) ((a) < (b) ? (a) : (b))
+#define seel_lane_max(a, b) ((a) > (b) ? (a) : (b))
+#define seel_lane_xorsign(b, s) ((s) < 0.0f ? -(b) : (b))
+#endif
+
+/*
+ * Keys of one batch, gathered per component so every row is a lane vector.
+ * The time stamps around the sample are gathered too; blend factors are
+ * computed for all lanes at once.
+ */
+struct ClipBatch
+{
+    CGLM_ALIGN(32) float position_from[3][SEEL_CLIP_LANES];
+    CGLM_ALIGN(32) float position_to[3][SEEL_CLIP_LANES];
+    CGLM_ALIGN(32) float position_time[2][SEEL_CLIP_LANES];
+    CGLM_ALIGN(32) float rotation_from[4][SEEL_CLIP_LANES];
+    CGLM_ALIGN(32) float rotation_to[4][SEEL_CLIP_LANES];
+    CGLM_ALIGN(32) float rotation_time[2][SEEL_CLIP_LANES];
+    CGLM_ALIGN(32) float scale_from[3][SEEL_CLIP_LANES];
+    CGLM_ALIGN(32) float scale_to[3][SEEL_CLIP_LANES];
+    CGLM_ALIGN(32) float scale_time[2][SEEL_CLIP_LANES];
+    CGLM_ALIGN(32) float matrix[16][SEEL_CLIP_LANES];
+    float animation_time;
+};
+
+void seel_clip_destroy(struct AnimationClip *clip)
+{
+    free(clip->channels);
+    free(clip->position_times);
+    free(clip->positions);
+    free(clip->rotation_times);
+    free(clip->rotations);
+    free(clip->scale_times);
+    free(clip->scales);
+    free(clip->ranges);
+    free(clip->timeline);
+    free(clip->position_keys);
+    free(clip->packed_positions);
+    free(clip->rotation_keys);
+    free(clip->packed_rotations);
+    free(clip->scale_keys);
+    free(clip->packed_scales);
+    memset(clip, 0, sizeof(struct AnimationClip));
+}
+
+/* Heap memory of the clip's tracks, compressed or not */
+size_t seel_clip_size(const struct AnimationClip *clip)
+{
+    if (clip->compressed)
+        return clip->num_channels * (sizeof(struct ClipChannel) + sizeof(struct ClipChannelRange)) +
+               clip->num_timeline_keys * sizeof(float) +
+               (clip->num_position_keys + clip->num_rotation_keys + clip->num_scale_keys) * 4 * sizeof(uint16_t);
+
+    return clip->num_channels * sizeof(struct ClipChannel) +
+           (clip->num_position_keys * 4 + clip->num_rotation_keys * 5 + clip->num_scale_keys * 4) * sizeof(float);
+}
+
+bool seel_clip_create_from_bones(struct AnimationClip *clip, const struct Bone *bones, unsigned int num_bones)
+{
+    memset(clip, 0, sizeof(struct AnimationClip));
+
+    unsigned int i;
+    for (i = 0; i < num_bones; i++)
+    {
+        clip->num_position_keys += bones[i].num_positions;
+        clip->num_rotation_keys += bones[i].num_rotations;
+        clip->num_scale_keys += bones[i].num_scalings;
+    }
+
+    clip->num_channels = num_bones;
+    clip->channels = (struct ClipChannel *)malloc(sizeof(struct ClipChannel) * (num_bones ? num_bones : 1));
+    clip->position_times = (float *)malloc(sizeof(float) * (clip->num_position_keys + 1));
+    clip->positions = (float *)malloc(sizeof(float) * 3 * (clip->num_position_keys + 1));
+    clip->rotation_times = (float *)malloc(sizeof(float) * (clip->num_rotation_keys + 1));
+    clip->rotations = (float *)malloc(sizeof(float) * 4 * (clip->num_rotation_keys + 1));
+    clip->scale_times = (float *)malloc(sizeof(float) * (clip->num_scale_keys + 1));
+    clip->scales = (float *)malloc(sizeof(float) * 3 * (clip->num_scale_keys + 1));
+    if (!clip->channels || !clip->position_times || !clip->positions || !clip->rotation_times ||
+        !clip->rotations || !clip->scale_times || !clip->scales)
+    {
+        fprintf(stderr, "Failed to allocate memory for animation clip streams!\n");
+        seel_clip_destroy(clip);
+        return false;
+    }
+
+    unsigned int position_offset = 0, rotation_offset = 0, scale_offset = 0;
+    for (i = 0; i < num_bones; i++)
+    {
+        const struct Bone *bone = &bones[i];
+        struct ClipChannel *channel = &clip->channels[i];
+        int k;
+
+        channel->position_offset = position_offset;
+        channel->num_positions = bone->num_positions;
+        for (k = 0; k < bone->num_positions; k++, position_offset++)
+        {
+            clip->position_times[position_offset] = bone->positions[k].time_stamp;
+            glm_vec3_copy((float *)bone->positions[k].position, &clip->positions[position_offset * 3]);
+        }
+
+        channel->rotation_offset = rotation_offset;
+        channel->num_rotations = bone->num_rotations;
+        for (k = 0; k < bone->num_rotations; k++, rotation_offset++)
+        {
+            clip->rotation_times[rotation_offset] = bone->rotations[k].time_stamp;
+            glm_vec4_copy((float *)bone->rotations[k].rotation, &clip->rotations[rotation_offset * 4]);
+        }
+
+        channel->scale_offset = scale_offset;
+        channel->num_scales = bone->num_scalings;
+        for (k = 0; k < bone->num_scalings; k++, scale_offset++)
+        {
+            clip->scale_times[scale_offset] = bone->scalings[k].time_stamp;
+            glm_vec3_copy((float *)bone->scalings[k].scale, &clip->scales[scale_offset * 3]);
+        }
+    }
+
+    return true;
+}
+
+/* Gathers the keys around animation_time of one track into the given lane */
+static inline void seel_clip_gather_track(const float *times, const float *values, unsigned int components, unsigned int num_keys,
+                                          float animation_time, unsigned int *cursor,
+                                          float *from, float *to, float *time_stamps, unsigned int lane)
+{
+    unsigned int index = 0, next = 0, c;
+    if (num_keys > 1)
+    {
+        index = seel_find_key_index(times, sizeof(float), num_keys, animation_time, *cursor);
+        next = index + 1;
+        *cursor = index;
+    }
+
+    for (c = 0; c < components; c++)
+    {
+        from[c * SEEL_CLIP_LANES + lane] = values[index * components + c];
+        to[c * SEEL_CLIP_LANES + lane] = values[next * components + c];
+    }
+    time_stamps[lane] = times[index];
+    time_stamps[SEEL_CLIP_LANES + lane] = times[next];
+}
+
+/* seel_find_key_index over a compressed track, whose keys index the shared timeline */
+unsigned int seel_find_packed_key_index(const float *timeline, const uint16_t *keys, unsigned int num_keys, float animation_time, unsigned int hint)
+{
+    if (num_keys <= 1)
+        return 0;
+
+    unsigned int last = num_keys - 2;
+    if (hint > last)
+        hint = last;
+
+    if (animation_time >= timeline[keys[hint]])
+    {
+        if (animation_time < timeline[keys[hint + 1]])
+            return hint;
+        if (hint < last && animation_time < timeline[keys[hint + 2]])
+            return hint + 1;
+    }
+
+    unsigned int low = 1;
+    unsigned int high = num_keys - 1;
+    while (low < high)
+    {
+        unsigned int mid = low + (high - low) / 2;
+        if (animation_time < timeline[keys[mid]])
+            high = mid;
+        else
+            low = mid + 1;
+    }
+
+    if (animation_time >= timeline[keys[low]])
+        return last;
+    return low - 1;
+}
+
+static inline void seel_clip_unpack_vec3(const uint16_t *packed, const float *min, const float *extent, float *dest)
+{
+    unsigned int c;
+    for (c = 0; c < 3; c++)
+        dest[c] = min[c] + (float)packed[c] * (extent[c] * (1.0f / 65535.0f));
+}
+
+/*
+ * Smallest three: the two top bits name the largest component, which is
+ * rebuilt from the unit length; the other three are 15-bit values in
+ * [-1/sqrt(2), 1/sqrt(2)].
+ */
+static inline void seel_clip_unpack_rotation(const uint16_t *packed, float *dest)
+{
+    unsigned int largest = ((packed[0] >> 15) << 1) | (packed[1] >> 15);
+    float sum = 0.0f;
+    unsigned int c, k = 0;
+    for (c = 0; c < 4; c++)
+    {
+        if (c == largest)
+            continue;
+        float v = ((float)(packed[k++] & 0x7fff) * (2.0f / 32767.0f) - 1.0f) * 0.70710678f;
+        dest[c] = v;
+        sum += v * v;
+    }
+    dest[largest] = sqrtf(fmaxf(1.0f - sum, 0.0f));
+}
+
+/* Decodes the keys around animation_time of one compressed track; components is 3, or 4 for rotations */
+static inline void seel_clip_gather_packed_track(const float *timeline, const uint16_t *keys, const uint16_t *packed, unsigned int components,
+                                                 const float *min, const float *extent, unsigned int num_keys,
+                                                 float animation_time, unsigned int *cursor,
+                                                 float *from, float *to, float *time_stamps, unsigned int lane)
+{
+    unsigned int index = 0, next = 0, c;
+    if (num_keys > 1)
+    {
+        index = seel_find_packed_key_index(timeline, keys, num_keys, animation_time, *cursor);
+        next = index + 1;
+        *cursor = index;
+    }
+
+    float a[4], b[4];
+    if (components == 4)
+    {
+        seel_clip_unpack_rotation(&packed[index * 3], a);
+        seel_clip_unpack_rotation(&packed[next * 3], b);
+    }
+    else
+    {
+        seel_clip_unpack_vec3(&packed[index * 3], min, extent, a);
+        seel_clip_unpack_vec3(&packed[next * 3], min, extent, b);
+    }
+
+    for (c = 0; c < components; c++)
+    {
+        from[c * SEEL_CLIP_LANES + lane] = a[c];
+        to[c * SEEL_CLIP_LANES + lane] = b[c];
+    }
+    time_stamps[lane] = timeline[keys[index]];
+    time_stamps[SEEL_CLIP_LANES + lane] = timeline[keys[next]];
+}
+
+static void seel_clip_gather(const struct AnimationClip *clip, const struct ClipChannel *channel, float animation_time, struct KeyCursor *cursor, struct ClipBatch *batch, unsigned int lane)
+{
+    if (clip->compressed)
+    {
+        const struct ClipChannelRange *range = &clip->ranges[channel - clip->channels];
+        seel_clip_gather_packed_track(clip->timeline, &clip->position_keys[channel->position_offset], &clip->packed_positions[channel->position_offset * 3], 3,
+                                      range->position_min, range->position_extent, channel->num_positions, animation_time, &cursor->position,
+                                      &batch->position_from[0][0], &batch->position_to[0][0], &batch->position_time[0][0], lane);
+        seel_clip_gather_packed_track(clip->timeline, &clip->rotation_keys[channel->rotation_offset], &clip->packed_rotations[channel->rotation_offset * 3], 4,
+                                      NULL, NULL, channel->num_rotations, animation_time, &cursor->rotation,
+                                      &batch->rotation_from[0][0], &batch->rotation_to[0][0], &batch->rotation_time[0][0], lane);
+        seel_clip_gather_packed_track(clip->timeline, &clip->scale_keys[channel->scale_offset], &clip->packed_scales[channel->scale_offset * 3], 3,
+                                      range->scale_min, range->scale_extent, channel->num_scales, animation_time, &cursor->scale,
+                                      &batch->scale_from[0][0], &batch->scale_to[0][0], &batch->scale_time[0][0], lane);
+        return;
+    }
+
+    seel_clip_gather_track(&clip->position_times[channel->position_offset], &clip->positions[channel->position_offset * 3], 3,
+                           channel->num_positions, animation_time, &cursor->position,
+                           &batch->position_from[0][0], &batch->position_to[0][0], &batch->position_time[0][0], lane);
+    seel_clip_gather_track(&clip->rotation_times[channel->rotation_offset], &clip->rotations[channel->rotation_offset * 4], 4,
+                           channel->num_rotations, animation_time, &cursor->rotation,
+                           &batch->rotation_from[0][0], &batch->rotation_to[0][0], &batch->rotation_time[0][0], lane);
+    seel_clip_gather_track(&clip->scale_times[channel->scale_offset], &clip->scales[channel->scale_offset * 3], 3,
+                           channel->num_scales, animation_time, &cursor->scale,
+                           &batch->scale_from[0][0], &batch->scale_to[0][0], &batch->scale_time[0][0], lane);
+}
+
+/* Blend factor of every lane, clamped to [0, 1]; single key tracks have equal time stamps and get 0 */
+static inline seel_lane seel_clip_factor(float time_stamps[2][SEEL_CLIP_LANES], seel_lane animation_time)
+{
+    seel_lane from = seel_lane_load(time_stamps[0]);
+    seel_lane length = seel_lane_max(seel_lane_sub(seel_lane_load(time_stamps[1]), from), seel_lane_set1(1e-6f));
+    seel_lane t = seel_lane_div(seel_lane_sub(animation_time, from), length);
+    return seel_lane_min(seel_lane_max(t, seel_lane_set1(0.0f)), seel_lane_set1(1.0f));
+}
+
+/*
+ * Blends the gathered keys and composes T * R * S for every lane. Positions
+ * and scales are lerped, rotations are nlerped along the shortest arc, which
+ * stays within a fraction of a degree of slerp at animation key spacing.
+ */
+static void seel_clip_blend(struct ClipBatch *batch)
+{
+    seel_lane t, a, b, x, y, z, w, sx, sy, sz, dot, inv_len;
+    seel_lane one = seel_lane_set1(1.0f);
+    seel_lane two = seel_lane_set1(2.0f);
+    seel_lane zero = seel_lane_set1(0.0f);
+    seel_lane animation_time = seel_lane_set1(batch->animation_time);
+
+    t = seel_clip_factor(batch->rotation_time, animation_time);
+    seel_lane q0[4], q1[4];
+    unsigned int c;
+    for (c = 0; c < 4; c++)
+    {
+        q0[c] = seel_lane_load(batch->rotation_from[c]);
+        q1[c] = seel_lane_load(batch->rotation_to[c]);
+    }
+    dot = seel_lane_add(seel_lane_add(seel_lane_mul(q0[0], q1[0]), seel_lane_mul(q0[1], q1[1])),
+                        seel_lane_add(seel_lane_mul(q0[2], q1[2]), seel_lane_mul(q0[3], q1[3])));
+    for (c = 0; c < 4; c++)
+    {
+        b = seel_lane_xorsign(q1[c], dot);
+        q1[c] = seel_lane_add(q0[c], seel_lane_mul(seel_lane_sub(b, q0[c]), t));
+    }
+    inv_len = seel_lane_div(one, seel_lane_sqrt(seel_lane_add(seel_lane_add(seel_lane_mul(q1[0], q1[0]), seel_lane_mul(q1[1], q1[1])),
+                                                              seel_lane_add(seel_lane_mul(q1[2], q1[2]), seel_lane_mul(q1[3], q1[3])))));
+    x = seel_lane_mul(q1[0], inv_len);
+    y = seel_lane_mul(q1[1], inv_len);
+    z = seel_lane_mul(q1[2], inv_len);
+    w = seel_lane_mul(q1[3], inv_len);
+
+    t = seel_clip_factor(batch->scale_time, animation_time);
+    a = seel_lane_load(batch->scale_from[0]);
+    sx = seel_lane_add(a, seel_lane_mul(seel_lane_sub(seel_lane_load(batch->scale_to[0]), a), t));
+    a = seel_lane_load(batch->scale_from[1]);
+    sy = seel_lane_add(a, seel_lane_mul(seel_lane_sub(seel_lane_load(batch->scale_to[1]), a), t));
+    a = seel_lane_load(batch->scale_from[2]);
+    sz = seel_lane_add(a, seel_lane_mul(seel_lane_sub(seel_lane_load(batch->scale_to[2]), a), t));
+
+    seel_lane xx = seel_lane_mul(two, seel_lane_mul(x, x)), yy = seel_lane_mul(two, seel_lane_mul(y, y)), zz = seel_lane_mul(two, seel_lane_mul(z, z));
+    seel_lane xy = seel_lane_mul(two, seel_lane_mul(x, y)), yz = seel_lane_mul(two, seel_lane_mul(y, z)), xz = seel_lane_mul(two, seel_lane_mul(x, z));
+    seel_lane wx = seel_lane_mul(two, seel_lane_mul(w, x)), wy = seel_lane_mul(two, seel_lane_mul(w, y)), wz = seel_lane_mul(two, seel_lane_mul(w, z));
+
+    /* column-major, matching glm_quat_mat4 followed by the scale columns */
+    seel_lane_store(batch->matrix[0], seel_lane_mul(seel_lane_sub(one, seel_lane_add(yy, zz)), sx));
+    seel_lane_store(batch->matrix[1], seel_lane_mul(seel_lane_add(xy, wz), sx));
+    seel_lane_store(batch->matrix[2], seel_lane_mul(seel_lane_sub(xz, wy), sx));
+    seel_lane_store(batch->matrix[3], zero);
+    seel_lane_store(batch->matrix[4], seel_lane_mul(seel_lane_sub(xy, wz), sy));
+    seel_lane_store(batch->matrix[5], seel_lane_mul(seel_lane_sub(one, seel_lane_add(xx, zz)), sy));
+    seel_lane_store(batch->matrix[6], seel_lane_mul(seel_lane_add(yz, wx), sy));
+    seel_lane_store(batch->matrix[7], zero);
+    seel_lane_store(batch->matrix[8], seel_lane_mul(seel_lane_add(xz, wy), sz));
+    seel_lane_store(batch->matrix[9], seel_lane_mul(seel_lane_sub(yz, wx), sz));
+    seel_lane_store(batch->matrix[10], seel_lane_mul(seel_lane_sub(one, seel_lane_add(xx, yy)), sz));
+    seel_lane_store(batch->matrix[11], zero);
+
+    t = seel_clip_factor(batch->position_time, animation_time);
+    for (c = 0; c < 3; c++)
+    {
+        a = seel_lane_load(batch->position_from[c]);
+        seel_lane_store(batch->matrix[12 + c], seel_lane_add(a, seel_lane_mul(seel_lane_sub(seel_lane_load(batch->position_to[c]), a), t)));
+    }
+    seel_lane_store(batch->matrix[15], one);
+}
+
+/* Writes the first `lanes` lane matrices of the batch out as column-major mat4s */
+static void seel_clip_store(struct ClipBatch *batch, unsigned int lanes, mat4 *dest)
+{
+    unsigned int lane = 0;
+#if defined(CGLM_SSE_FP)
+    /* transpose four lanes at a time: rows of one column become that column of four matrices */
+    for (; lane + 4 <= lanes; lane += 4)
+    {
+        unsigned int column;
+        for (column = 0; column < 4; column++)
+        {
+            __m128 r0 = _mm_load_ps(&batch->matrix[column * 4 + 0][lane]);
+            __m128 r1 = _mm_load_ps(&batch->matrix[column * 4 + 1][lane]);
+            __m128 r2 = _mm_load_ps(&batch->matrix[column * 4 + 2][lane]);
+            __m128 r3 = _mm_load_ps(&batch->matrix[column * 4 + 3][lane]);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(dest[lane + 0][column], r0);
+            _mm_storeu_ps(dest[lane + 1][column], r1);
+            _mm_storeu_ps(dest[lane + 2][column], r2);
+            _mm_storeu_ps(dest[lane + 3][column], r3);
+        }
+    }
+#endif
+    for (; lane < lanes; lane++)
+    {
+        float *out = &dest[lane][0][0];
+        unsigned int c;
+        for (c = 0; c < 16; c++)
+            out[c] = batch->matrix[c][lane];
+    }
+}
+
+/*
+ * Samples channels [first_channel, first_channel + count) of the clip at
+ * animation_time into dest[first_channel...]. `cursors` holds one KeyCursor
+ * per channel of the clip.
+ */
+void seel_clip_sample(const struct AnimationClip *clip, unsigned int first_channel, unsigned int count, float animation_time, struct KeyCursor *cursors, mat4 *dest)
+{
+    struct ClipBatch batch;
+    batch.animation_time = animation_time;
+    unsigned int end = first_channel + count;
+    if (end > clip->num_channels)
+        end = clip->num_channels;
+
+    unsigned int base;
+    for (base = first_channel; base < end; base += SEEL_CLIP_LANES)
+    {
+        unsigned int lanes = end - base < SEEL_CLIP_LANES ? end - base : SEEL_CLIP_LANES;
+        unsigned int lane;
+        for (lane = 0; lane < SEEL_CLIP_LANES; lane++)
+        {
+            /* pad a partial batch by repeating its last channel */
+            unsigned int channel = base + (lane < lanes ? lane : lanes - 1);
+            seel_clip_gather(clip, &clip->channels[channel], animation_time, &cursors[channel], &batch, lane);
+        }
+
+        seel_clip_blend(&batch);
+        seel_clip_store(&batch, lanes, &dest[base]);
+    }
+}
+
+/*
+ * Translation, rotation and scale of one channel at animation_time, from
+ * either storage form. Used where components are blended separately, such
+ * as animation transitions.
+ */
+void seel_clip_sample_trs(const struct AnimationClip *clip, unsigned int channel, float animation_time, vec3 position, versor rotation, vec3 scale)
+{
+    struct ClipBatch batch;
+    struct KeyCursor cursor = {0};
+    seel_clip_gather(clip, &clip->channels[channel], animation_time, &cursor, &batch, 0);
+
+    float t[3];
+    float(*times[3])[SEEL_CLIP_LANES] = {batch.position_time, batch.rotation_time, batch.scale_time};
+    unsigned int k, c;
+    for (k = 0; k < 3; k++)
+    {
+        float length = fmaxf(times[k][1][0] - times[k][0][0], 1e-6f);
+        t[k] = fminf(fmaxf((animation_time - times[k][0][0]) / length, 0.0f), 1.0f);
+    }
+
+    for (c = 0; c < 3; c++)
+    {
+        position[c] = batch.position_from[c][0] + (batch.position_to[c][0] - batch.position_from[c][0]) * t[0];
+        scale[c] = batch.scale_from[c][0] + (batch.scale_to[c][0] - batch.scale_from[c][0]) * t[2];
+    }
+
+    versor from, to;
+    for (c = 0; c < 4; c++)
+    {
+        from[c] = batch.rotation_from[c][0];
+        to[c] = batch.rotation_to[c][0];
+    }
+    glm_quat_slerp(from, to, t[1], rotation);
+    glm_quat_normalize(rotation);
+}
+
+#endif /* CLIP_H */
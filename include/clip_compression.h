@@ -0,0 +1,440 @@
+#ifndef CLIP_COMPRESSION_H
+#define CLIP_COMPRESSION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "cglm/cglm.h"
+#include "clip.h"
+
+#define SEEL_CLIP_POSITION_TOLERANCE 0.001f
+#define SEEL_CLIP_ROTATION_TOLERANCE 0.001f /* radians */
+#define SEEL_CLIP_SCALE_TOLERANCE 0.0001f
+#define SEEL_CLIP_MAX_TIMELINE_KEYS 65536
+
+/* Largest error a removed key may have when rebuilt from its neighbours */
+struct ClipCompressionSettings
+{
+    float position_tolerance;
+    float rotation_tolerance;
+    float scale_tolerance;
+};
+
+/* Errors are measured at every original key time after quantization */
+struct ClipCompressionStats
+{
+    size_t raw_bytes;
+    size_t compressed_bytes;
+    unsigned int raw_keys;
+    unsigned int compressed_keys;
+    unsigned int timeline_keys;
+    float max_position_error;
+    float max_rotation_error; /* radians */
+    float max_scale_error;
+};
+
+void seel_clip_compression_defaults(struct ClipCompressionSettings *settings)
+{
+    settings->position_tolerance = SEEL_CLIP_POSITION_TOLERANCE;
+    settings->rotation_tolerance = SEEL_CLIP_ROTATION_TOLERANCE;
+    settings->scale_tolerance = SEEL_CLIP_SCALE_TOLERANCE;
+}
+
+/* Angle between two rotations; the chord form stays precise where acos of the dot product does not */
+static float seel_rotation_angle(const float *a, const float *b)
+{
+    float sign = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.0f ? -1.0f : 1.0f;
+    float chord = 0.0f;
+    unsigned int c;
+    for (c = 0; c < 4; c++)
+        chord += (a[c] - b[c] * sign) * (a[c] - b[c] * sign);
+    return 4.0f * asinf(fminf(sqrtf(chord) * 0.5f, 1.0f));
+}
+
+static float seel_vec3_error(const float *a, const float *b, bool scale)
+{
+    if (scale)
+        return fmaxf(fabsf(a[0] - b[0]), fmaxf(fabsf(a[1] - b[1]), fabsf(a[2] - b[2])));
+    return glm_vec3_distance((float *)a, (float *)b);
+}
+
+/* Value of a track between keys from and to, the way the sampler blends it */
+static void seel_track_lerp(const float *values, unsigned int components, float t, unsigned int from, unsigned int to, float *dest)
+{
+    const float *a = &values[from * components];
+    const float *b = &values[to * components];
+    unsigned int c;
+    if (components == 3)
+    {
+        for (c = 0; c < 3; c++)
+            dest[c] = a[c] + (b[c] - a[c]) * t;
+        return;
+    }
+
+    float sign = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.0f ? -1.0f : 1.0f;
+    float length = 0.0f;
+    for (c = 0; c < 4; c++)
+    {
+        dest[c] = a[c] + (b[c] * sign - a[c]) * t;
+        length += dest[c] * dest[c];
+    }
+    length = sqrtf(length);
+    for (c = 0; c < 4; c++)
+        dest[c] /= length;
+}
+
+static float seel_track_error(const float *values, unsigned int components, bool scale, unsigned int key, const float *value)
+{
+    if (components == 4)
+        return seel_rotation_angle(&values[key * 4], value);
+    return seel_vec3_error(&values[key * 3], value, scale);
+}
+
+/*
+ * Greedy key reduction: from each kept key, extends the segment as far as
+ * every key inside it is rebuilt by interpolation within tolerance. Writes
+ * the kept key indices and returns their count. A constant track keeps one key.
+ */
+static unsigned int seel_reduce_track(const float *times, const float *values, unsigned int components, bool scale,
+                                      unsigned int num_keys, float tolerance, unsigned int *kept)
+{
+    unsigned int num_kept = 0;
+    if (num_keys == 0)
+        return 0;
+
+    bool constant = true;
+    unsigned int k;
+    for (k = 1; k < num_keys && constant; k++)
+        constant = seel_track_error(values, components, scale, k, &values[0]) <= tolerance;
+    if (constant)
+    {
+        kept[0] = 0;
+        return 1;
+    }
+
+    unsigned int anchor = 0;
+    kept[num_kept++] = 0;
+    while (anchor < num_keys - 1)
+    {
+        unsigned int end = anchor + 1;
+        while (end + 1 < num_keys)
+        {
+            unsigned int candidate = end + 1;
+            float length = fmaxf(times[candidate] - times[anchor], 1e-6f);
+            bool fits = true;
+            for (k = anchor + 1; k < candidate && fits; k++)
+            {
+                float value[4];
+                seel_track_lerp(values, components, (times[k] - times[anchor]) / length, anchor, candidate, value);
+                fits = seel_track_error(values, components, scale, k, value) <= tolerance;
+            }
+            if (!fits)
+                break;
+            end = candidate;
+        }
+        kept[num_kept++] = end;
+        anchor = end;
+    }
+
+    return num_kept;
+}
+
+static int seel_compare_floats(const void *a, const void *b)
+{
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static uint16_t seel_timeline_index(const float *timeline, unsigned int num_timeline_keys, float time)
+{
+    unsigned int low = 0, high = num_timeline_keys - 1;
+    while (low < high)
+    {
+        unsigned int mid = low + (high - low) / 2;
+        if (timeline[mid] < time)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return (uint16_t)low;
+}
+
+static void seel_clip_pack_vec3(const float *value, const float *min, const float *extent, uint16_t *dest)
+{
+    unsigned int c;
+    for (c = 0; c < 3; c++)
+    {
+        float t = extent[c] > 0.0f ? (value[c] - min[c]) / extent[c] : 0.0f;
+        dest[c] = (uint16_t)lroundf(fminf(fmaxf(t, 0.0f), 1.0f) * 65535.0f);
+    }
+}
+
+static void seel_clip_pack_rotation(const float *value, uint16_t *dest)
+{
+    unsigned int largest = 0, c, k = 0;
+    for (c = 1; c < 4; c++)
+    {
+        if (fabsf(value[c]) > fabsf(value[largest]))
+            largest = c;
+    }
+
+    /* q and -q are the same rotation, make the dropped component positive */
+    float sign = value[largest] < 0.0f ? -1.0f : 1.0f;
+    for (c = 0; c < 4; c++)
+    {
+        if (c == largest)
+            continue;
+        float t = (value[c] * sign * 1.41421356f + 1.0f) * 0.5f;
+        dest[k++] = (uint16_t)lroundf(fminf(fmaxf(t, 0.0f), 1.0f) * 32767.0f);
+    }
+    dest[0] |= (uint16_t)((largest >> 1) << 15);
+    dest[1] |= (uint16_t)((largest & 1) << 15);
+}
+
+/* Compressed size of the clip's tracks, for the statistics */
+static size_t seel_clip_compressed_size(const struct AnimationClip *clip)
+{
+    return clip->num_channels * (sizeof(struct ClipChannel) + sizeof(struct ClipChannelRange)) +
+           clip->num_timeline_keys * sizeof(float) +
+           (clip->num_position_keys + clip->num_rotation_keys + clip->num_scale_keys) * 4 * sizeof(uint16_t);
+}
+
+/* Measures the compressed clip against the float streams it was built from */
+static void seel_clip_measure_error(const struct AnimationClip *compressed, const struct AnimationClip *raw, struct ClipCompressionStats *stats)
+{
+    unsigned int i, k;
+    for (i = 0; i < raw->num_channels; i++)
+    {
+        const struct ClipChannel *channel = &raw->channels[i];
+        vec3 position, scale;
+        versor rotation;
+
+        for (k = 0; k < channel->num_positions; k++)
+        {
+            unsigned int key = channel->position_offset + k;
+            seel_clip_sample_trs(compressed, i, raw->position_times[key], position, rotation, scale);
+            stats->max_position_error = fmaxf(stats->max_position_error, seel_vec3_error(&raw->positions[key * 3], position, false));
+        }
+        for (k = 0; k < channel->num_rotations; k++)
+        {
+            unsigned int key = channel->rotation_offset + k;
+            seel_clip_sample_trs(compressed, i, raw->rotation_times[key], position, rotation, scale);
+            stats->max_rotation_error = fmaxf(stats->max_rotation_error, seel_rotation_angle(&raw->rotations[key * 4], rotation));
+        }
+        for (k = 0; k < channel->num_scales; k++)
+        {
+            unsigned int key = channel->scale_offset + k;
+            seel_clip_sample_trs(compressed, i, raw->scale_times[key], position, rotation, scale);
+            stats->max_scale_error = fmaxf(stats->max_scale_error, seel_vec3_error(&raw->scales[key * 3], scale, true));
+        }
+    }
+}
+
+/*
+ * Replaces the clip's float streams with the compressed form: keys that
+ * interpolation rebuilds within tolerance are dropped, key times move to one
+ * shared timeline and values are quantized to 48 bits per key. The sampler
+ * decodes the compressed form directly. stats may be NULL.
+ */
+bool seel_clip_compress(struct AnimationClip *clip, const struct ClipCompressionSettings *settings, struct ClipCompressionStats *stats)
+{
+    if (clip->compressed)
+        return true;
+
+    struct ClipCompressionSettings defaults;
+    if (!settings)
+    {
+        seel_clip_compression_defaults(&defaults);
+        settings = &defaults;
+    }
+
+    struct AnimationClip packed;
+    memset(&packed, 0, sizeof(struct AnimationClip));
+    packed.compressed = true;
+    packed.num_channels = clip->num_channels;
+
+    unsigned int total_keys = clip->num_position_keys + clip->num_rotation_keys + clip->num_scale_keys;
+    unsigned int *kept = (unsigned int *)malloc(sizeof(unsigned int) * (total_keys + 1));
+    float *times = (float *)malloc(sizeof(float) * (total_keys + 1));
+    packed.channels = (struct ClipChannel *)malloc(sizeof(struct ClipChannel) * (clip->num_channels ? clip->num_channels : 1));
+    packed.ranges = (struct ClipChannelRange *)malloc(sizeof(struct ClipChannelRange) * (clip->num_channels ? clip->num_channels : 1));
+    if (!kept || !times || !packed.channels || !packed.ranges)
+    {
+        fprintf(stderr, "Failed to allocate memory for clip compression!\n");
+        free(kept);
+        free(times);
+        seel_clip_destroy(&packed);
+        return false;
+    }
+
+    /* key reduction: kept holds source key indices, channel offsets index kept */
+    unsigned int i, k, c, num_kept = 0;
+    for (i = 0; i < clip->num_channels; i++)
+    {
+        const struct ClipChannel *source = &clip->channels[i];
+        struct ClipChannel *channel = &packed.channels[i];
+
+        channel->position_offset = num_kept;
+        channel->num_positions = seel_reduce_track(&clip->position_times[source->position_offset], &clip->positions[source->position_offset * 3], 3, false,
+                                                   source->num_positions, settings->position_tolerance, &kept[num_kept]);
+        for (k = 0; k < channel->num_positions; k++)
+            kept[num_kept + k] += source->position_offset;
+        num_kept += channel->num_positions;
+    }
+    packed.num_position_keys = num_kept;
+    for (i = 0; i < clip->num_channels; i++)
+    {
+        const struct ClipChannel *source = &clip->channels[i];
+        struct ClipChannel *channel = &packed.channels[i];
+
+        channel->rotation_offset = num_kept - packed.num_position_keys;
+        channel->num_rotations = seel_reduce_track(&clip->rotation_times[source->rotation_offset], &clip->rotations[source->rotation_offset * 4], 4, false,
+                                                   source->num_rotations, settings->rotation_tolerance, &kept[num_kept]);
+        for (k = 0; k < channel->num_rotations; k++)
+            kept[num_kept + k] += source->rotation_offset;
+        num_kept += channel->num_rotations;
+    }
+    packed.num_rotation_keys = num_kept - packed.num_position_keys;
+    for (i = 0; i < clip->num_channels; i++)
+    {
+        const struct ClipChannel *source = &clip->channels[i];
+        struct ClipChannel *channel = &packed.channels[i];
+
+        channel->scale_offset = num_kept - packed.num_position_keys - packed.num_rotation_keys;
+        channel->num_scales = seel_reduce_track(&clip->scale_times[source->scale_offset], &clip->scales[source->scale_offset * 3], 3, true,
+                                                source->num_scales, settings->scale_tolerance, &kept[num_kept]);
+        for (k = 0; k < channel->num_scales; k++)
+            kept[num_kept + k] += source->scale_offset;
+        num_kept += channel->num_scales;
+    }
+    packed.num_scale_keys = num_kept - packed.num_position_keys - packed.num_rotation_keys;
+
+    unsigned int *kept_positions = kept;
+    unsigned int *kept_rotations = &kept[packed.num_position_keys];
+    unsigned int *kept_scales = &kept[packed.num_position_keys + packed.num_rotation_keys];
+
+    /* shared timeline of every kept key time */
+    unsigned int num_times = 0;
+    for (k = 0; k < packed.num_position_keys; k++)
+        times[num_times++] = clip->position_times[kept_positions[k]];
+    for (k = 0; k < packed.num_rotation_keys; k++)
+        times[num_times++] = clip->rotation_times[kept_rotations[k]];
+    for (k = 0; k < packed.num_scale_keys; k++)
+        times[num_times++] = clip->scale_times[kept_scales[k]];
+    qsort(times, num_times, sizeof(float), seel_compare_floats);
+
+    unsigned int unique = 0;
+    for (k = 0; k < num_times; k++)
+    {
+        if (unique == 0 || times[k] != times[unique - 1])
+            times[unique++] = times[k];
+    }
+    if (unique > SEEL_CLIP_MAX_TIMELINE_KEYS)
+    {
+        fprintf(stderr, "Too many distinct key times to compress clip!\n");
+        free(kept);
+        free(times);
+        seel_clip_destroy(&packed);
+        return false;
+    }
+    packed.timeline = times;
+    packed.num_timeline_keys = unique;
+
+    packed.position_keys = (uint16_t *)malloc(sizeof(uint16_t) * (packed.num_position_keys + 1));
+    packed.packed_positions = (uint16_t *)malloc(sizeof(uint16_t) * 3 * (packed.num_position_keys + 1));
+    packed.rotation_keys = (uint16_t *)malloc(sizeof(uint16_t) * (packed.num_rotation_keys + 1));
+    packed.packed_rotations = (uint16_t *)malloc(sizeof(uint16_t) * 3 * (packed.num_rotation_keys + 1));
+    packed.scale_keys = (uint16_t *)malloc(sizeof(uint16_t) * (packed.num_scale_keys + 1));
+    packed.packed_scales = (uint16_t *)malloc(sizeof(uint16_t) * 3 * (packed.num_scale_keys + 1));
+    if (!packed.position_keys || !packed.packed_positions || !packed.rotation_keys ||
+        !packed.packed_rotations || !packed.scale_keys || !packed.packed_scales)
+    {
+        fprintf(stderr, "Failed to allocate memory for compressed clip streams!\n");
+        free(kept);
+        seel_clip_destroy(&packed);
+        return false;
+    }
+
+    /* quantize against each channel's range */
+    for (i = 0; i < packed.num_channels; i++)
+    {
+        struct ClipChannel *channel = &packed.channels[i];
+        struct ClipChannelRange *range = &packed.ranges[i];
+        vec3 max;
+
+        glm_vec3_fill(range->position_min, FLT_MAX);
+        glm_vec3_fill(max, -FLT_MAX);
+        for (k = 0; k < channel->num_positions; k++)
+        {
+            const float *value = &clip->positions[kept_positions[channel->position_offset + k] * 3];
+            for (c = 0; c < 3; c++)
+            {
+                range->position_min[c] = fminf(range->position_min[c], value[c]);
+                max[c] = fmaxf(max[c], value[c]);
+            }
+        }
+        glm_vec3_sub(max, range->position_min, range->position_extent);
+
+        glm_vec3_fill(range->scale_min, FLT_MAX);
+        glm_vec3_fill(max, -FLT_MAX);
+        for (k = 0; k < channel->num_scales; k++)
+        {
+            const float *value = &clip->scales[kept_scales[channel->scale_offset + k] * 3];
+            for (c = 0; c < 3; c++)
+            {
+                range->scale_min[c] = fminf(range->scale_min[c], value[c]);
+                max[c] = fmaxf(max[c], value[c]);
+            }
+        }
+        glm_vec3_sub(max, range->scale_min, range->scale_extent);
+
+        for (k = 0; k < channel->num_positions; k++)
+        {
+            unsigned int key = channel->position_offset + k;
+            packed.position_keys[key] = seel_timeline_index(times, unique, clip->position_times[kept_positions[key]]);
+            seel_clip_pack_vec3(&clip->positions[kept_positions[key] * 3], range->position_min, range->position_extent, &packed.packed_positions[key * 3]);
+        }
+        for (k = 0; k < channel->num_rotations; k++)
+        {
+            unsigned int key = channel->rotation_offset + k;
+            packed.rotation_keys[key] = seel_timeline_index(times, unique, clip->rotation_times[kept_rotations[key]]);
+            seel_clip_pack_rotation(&clip->rotations[kept_rotations[key] * 4], &packed.packed_rotations[key * 3]);
+        }
+        for (k = 0; k < channel->num_scales; k++)
+        {
+            unsigned int key = channel->scale_offset + k;
+            packed.scale_keys[key] = seel_timeline_index(times, unique, clip->scale_times[kept_scales[key]]);
+            seel_clip_pack_vec3(&clip->scales[kept_scales[key] * 3], range->scale_min, range->scale_extent, &packed.packed_scales[key * 3]);
+        }
+    }
+    free(kept);
+
+    if (stats)
+    {
+        memset(stats, 0, sizeof(struct ClipCompressionStats));
+        stats->raw_keys = total_keys;
+        stats->compressed_keys = packed.num_position_keys + packed.num_rotation_keys + packed.num_scale_keys;
+        stats->timeline_keys = packed.num_timeline_keys;
+        stats->raw_bytes = clip->num_channels * sizeof(struct ClipChannel) +
+                           (clip->num_position_keys * 4 + clip->num_rotation_keys * 5 + clip->num_scale_keys * 4) * sizeof(float);
+        stats->compressed_bytes = seel_clip_compressed_size(&packed);
+        seel_clip_measure_error(&packed, clip, stats);
+    }
+
+    seel_clip_destroy(clip);
+    *clip = packed;
+    return true;
+}
+
+void seel_clip_print_compression_stats(const char *name, const struct ClipCompressionStats *stats)
+{
+    printf("Clip %s: %u -> %u keys (%u shared times), %zu -> %zu bytes (%.1f%%), max error %.5f pos %.5f rad %.5f scale\n",
+           name, stats->raw_keys, stats->compressed_keys, stats->timeline_keys, stats->raw_bytes, stats->compressed_bytes,
+           stats->raw_bytes ? 100.0 * (double)stats->compressed_bytes / (double)stats->raw_bytes : 0.0,
+           stats->max_position_error, stats->max_rotation_error, stats->max_scale_error);
+}
+
+#endif /* CLIP_COMPRESSION_H */
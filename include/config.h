@@ -6,6 +6,7 @@
 
 #include "cglm/cglm.h"
 #include "camera.h"
+#include "mesh.h"
 
 struct WindowConfig
 {
@@ -21,9 +22,14 @@ struct RendererConfig
     vec3 clear_color;
     unsigned int max_vertex_buffer;
     unsigned int max_element_buffer;
+    unsigned int bone_palette_buffer_size;
     bool enable_debug_output;
     bool enable_depth_test;
     bool enable_blending;
+    bool enable_compute_skinning; /* skin animated meshes once per frame in a compute pre-pass */
+    enum VertexLayout vertex_layout; /* GPU vertex format of meshes loaded from then on */
+    bool enable_cluster_culling;     /* skip meshlets of static meshes outside the view or facing away */
+    bool enable_frustum_culling;     /* skip nodes and meshes whose bounds are outside the view */
 };
 
 struct CameraConfig
@@ -68,11 +74,16 @@ void seel_config_init_defaults(struct EngineConfig *engine_config)
     glm_vec3_copy((vec3){0.0f, 0.0f, 0.0f}, engine_config->renderer.clear_color);
     engine_config->renderer.max_element_buffer = 512 * 1024;
     engine_config->renderer.max_vertex_buffer = 128 * 1024;
+    engine_config->renderer.bone_palette_buffer_size = 4 * 1024 * 1024;
     engine_config->renderer.width = engine_config->window.width;
     engine_config->renderer.height = engine_config->window.height;
     engine_config->renderer.enable_debug_output = true;
     engine_config->renderer.enable_depth_test = true;
     engine_config->renderer.enable_blending = true;
+    engine_config->renderer.enable_compute_skinning = false;
+    engine_config->renderer.vertex_layout = VERTEX_LAYOUT_COMPACT;
+    engine_config->renderer.enable_cluster_culling = true;
+    engine_config->renderer.enable_frustum_culling = true;
 
     engine_config->camera.fov = 45.0f;
     engine_config->camera.near_clip = 0.1f;
@@ -86,6 +97,8 @@ void seel_config_init_defaults(struct EngineConfig *engine_config)
     engine_config->camera.mode = CAMERA_MODE_FREE;
     engine_config->camera.yaw = -90.0f;
     engine_config->camera.pitch = 0.0f;
+
+    engine_config->enable_debug = false;
 };
 
 #endif /* CONFIG_H */
\ No newline at end of file
@@ -15,6 +15,17 @@
 #include "config.h"
 #include "ui.h"
 
+/* Assets used every frame, looked up by name once at startup and referenced until cleanup */
+struct EngineAssets
+{
+    struct AssetHandle default_shader;
+    struct AssetHandle particle_shader;
+    struct AssetHandle text_shader;
+    struct AssetHandle billboard_shader;
+    struct AssetHandle billboard_text_shader;
+    struct AssetHandle doge_texture;
+};
+
 struct Engine
 {
     struct EngineConfig config;
@@ -23,9 +34,11 @@ struct Engine
     struct Camera camera;
     struct Input input;
     struct AssetManager asset_manager;
+    struct EngineAssets assets;
     struct TimeManager time_manager;
     struct UIManager ui_manager;
     struct Scene scene;
+    struct JobPool job_pool;
     struct ParticleEmitter particle_emitter;
 };
 
@@ -33,6 +46,20 @@ bool seel_engine_init(struct Engine *e);
 void seel_engine_update(struct Engine *e);
 void seel_engine_cleanup(struct Engine *e);
 
+/* References or releases every engine asset, so budgets never evict them */
+static void seel_engine_acquire_assets(struct Engine *e, bool acquire)
+{
+    struct AssetHandle handles[] = {e->assets.default_shader, e->assets.particle_shader, e->assets.text_shader,
+                                    e->assets.billboard_shader, e->assets.billboard_text_shader, e->assets.doge_texture};
+    for (unsigned int i = 0; i < sizeof(handles) / sizeof(handles[0]); i++)
+    {
+        if (acquire)
+            seel_asset_manager_acquire(&e->asset_manager, handles[i]);
+        else
+            seel_asset_manager_release(&e->asset_manager, handles[i]);
+    }
+}
+
 bool seel_engine_init(struct Engine *e)
 {
     seel_config_init_defaults(&e->config);
@@ -50,7 +77,12 @@ bool seel_engine_init(struct Engine *e)
 
     seel_input_init(&e->input, e->window, &e->camera);
 
+    seel_mesh_default_layout = e->config.renderer.vertex_layout;
     e->asset_manager = seel_asset_manager_create();
+    e->asset_manager.log_evictions = e->config.enable_debug;
+    bool have_job_pool = seel_job_pool_create(&e->job_pool, 0);
+    if (have_job_pool)
+        e->asset_manager.job_pool = &e->job_pool;
 
     if (!SEEL_ASSET_MANAGER_LOAD(&e->asset_manager, ASSET_SHADER, "default", "../shaders/default.vert", "../shaders/default.frag"))
         return -1;
@@ -71,10 +103,20 @@ bool seel_engine_init(struct Engine *e)
     if (!SEEL_ASSET_MANAGER_LOAD(&e->asset_manager, ASSET_MODEL, "vampire", "../assets/models/vampire/dancing_vampire.dae"))
         return -1;
 
-    if (!SEEL_ASSET_MANAGER_LOAD(&e->asset_manager, ASSET_TEXTURE, "doge", "../assets/doge.png"))
-        return -1;
+    /* the particles draw with the placeholder until the image has streamed in */
+    e->assets.doge_texture = SEEL_ASSET_MANAGER_LOAD_ASYNC(&e->asset_manager, ASSET_TEXTURE, "doge", "../assets/doge.png", DIFFUSE);
+
+    e->assets.default_shader = seel_asset_manager_find(&e->asset_manager, ASSET_SHADER, "default");
+    e->assets.particle_shader = seel_asset_manager_find(&e->asset_manager, ASSET_SHADER, "particle");
+    e->assets.text_shader = seel_asset_manager_find(&e->asset_manager, ASSET_SHADER, "text");
+    e->assets.billboard_shader = seel_asset_manager_find(&e->asset_manager, ASSET_SHADER, "billboard");
+    e->assets.billboard_text_shader = seel_asset_manager_find(&e->asset_manager, ASSET_SHADER, "billboardText");
+    seel_engine_acquire_assets(e, true);
 
     seel_scene_init(&e->scene);
+    e->scene.log_compression = e->config.enable_debug;
+    if (have_job_pool)
+        e->scene.job_pool = &e->job_pool;
 
     seel_scene_add_model(&e->scene, &e->asset_manager, "vampire1", "vampire", (vec3){0.01f, 0.01f, 0.01f}, (vec3){0.0f, 0.0f, 0.0f});
     seel_scene_add_model(&e->scene, &e->asset_manager, "vampire2", "vampire", (vec3){0.01f, 0.01f, 0.01f}, (vec3){300.0f, 0.0f, 0.0f});
@@ -82,10 +124,12 @@ bool seel_engine_init(struct Engine *e)
     seel_scene_add_model(&e->scene, &e->asset_manager, "vampire4", "vampire", (vec3){0.01f, 0.01f, 0.01f}, (vec3){900.0f, 0.0f, 0.0f});
 
     seel_renderer_init(&e->renderer, &e->config.renderer, &e->camera);
-    seel_renderer_set_active_shader(&e->renderer, (struct Shader *)SEEL_ASSET_MANAGER_GET(&e->asset_manager, SHADER, "default"));
+    seel_renderer_set_active_shader(&e->renderer, (struct Shader *)seel_asset_manager_resolve(&e->asset_manager, e->assets.default_shader));
+    if (e->config.renderer.enable_compute_skinning)
+        seel_renderer_enable_compute_skinning(&e->renderer, "../shaders/skinning.comp");
 
-    e->particle_emitter = seel_particle_emitter_create((struct Shader *)SEEL_ASSET_MANAGER_GET(&e->asset_manager, SHADER, "particle"),
-                                                       (struct Texture *)SEEL_ASSET_MANAGER_GET(&e->asset_manager, TEXTURE, "doge"), 1000, (vec3){0.0f, 0.0f, 0.0f});
+    e->particle_emitter = seel_particle_emitter_create((struct Shader *)seel_asset_manager_resolve(&e->asset_manager, e->assets.particle_shader),
+                                                       (struct Texture *)seel_asset_manager_resolve(&e->asset_manager, e->assets.doge_texture), 1000, (vec3){0.0f, 0.0f, 0.0f});
 
     seel_time_init(&e->time_manager);
 
@@ -160,7 +204,10 @@ void seel_engine_update(struct Engine *e)
 
     seel_renderer_begin_frame(&e->renderer);
 
-    seel_scene_update(&e->scene, e->time_manager.delta_time);
+    seel_asset_manager_update(&e->asset_manager);
+    seel_scene_refresh_assets(&e->scene, &e->asset_manager);
+
+    seel_scene_update(&e->scene, e->renderer.camera, e->time_manager.delta_time);
 
     seel_scene_render(&e->scene, &e->renderer);
 
@@ -176,24 +223,44 @@ void seel_engine_update(struct Engine *e)
 
     seel_particle_emitter_render(&e->particle_emitter, &e->camera);
 
-    seel_renderer_draw_billboard((struct Shader *)SEEL_ASSET_MANAGER_GET(&e->asset_manager, SHADER, "billboard"),
-                                 (struct Texture *)SEEL_ASSET_MANAGER_GET(&e->asset_manager, TEXTURE, "doge"),
+    struct Shader *text_shader = (struct Shader *)seel_asset_manager_resolve(&e->asset_manager, e->assets.text_shader);
+
+    seel_renderer_draw_billboard((struct Shader *)seel_asset_manager_resolve(&e->asset_manager, e->assets.billboard_shader),
+                                 (struct Texture *)seel_asset_manager_resolve(&e->asset_manager, e->assets.doge_texture),
                                  (vec3){0.0f}, 1.0f, (vec3){1.0f, 1.0f, 1.0f}, &e->camera);
 
-    seel_render_text_billboard((struct Shader *)SEEL_ASSET_MANAGER_GET(&e->asset_manager, SHADER, "billboardText"), "Jamestiago", (vec3){1.0f, 2.0f, 3.0f}, 0.01f, (vec3){1.0f, 0.0f, 1.0f}, &e->camera);
+    seel_render_text_billboard((struct Shader *)seel_asset_manager_resolve(&e->asset_manager, e->assets.billboard_text_shader), "Jamestiago", (vec3){1.0f, 2.0f, 3.0f}, 0.01f, (vec3){1.0f, 0.0f, 1.0f}, &e->camera);
 
-    seel_render_text((struct Shader *)SEEL_ASSET_MANAGER_GET(&e->asset_manager, SHADER, "text"),
+    seel_render_text(text_shader,
                      e->config.window.title, 10.0f, e->renderer.height - 35.0f, 0.5f, (vec3){1.0f, 1.0f, 1.0f}, e->renderer.width, e->renderer.height);
     char fps_text[32];
     sprintf(fps_text, "Framerate: %.f", e->time_manager.frame_rate);
-    seel_render_text((struct Shader *)SEEL_ASSET_MANAGER_GET(&e->asset_manager, SHADER, "text"), fps_text, 10.0f, e->renderer.height - 60.0f, 0.5f, (vec3){1.0f, 1.0f, 1.0f}, e->renderer.width, e->renderer.height);
+    seel_render_text(text_shader, fps_text, 10.0f, e->renderer.height - 60.0f, 0.5f, (vec3){1.0f, 1.0f, 1.0f}, e->renderer.width, e->renderer.height);
+    char bones_text[64];
+    sprintf(bones_text, "Bones evaluated: %u", e->scene.animation_stats.bones_evaluated);
+    seel_render_text(text_shader, bones_text, 10.0f, e->renderer.height - 85.0f, 0.5f, (vec3){1.0f, 1.0f, 1.0f}, e->renderer.width, e->renderer.height);
+    char triangles_text[64];
+    sprintf(triangles_text, "Triangles: %u", e->renderer.triangles);
+    seel_render_text(text_shader, triangles_text, 10.0f, e->renderer.height - 110.0f, 0.5f, (vec3){1.0f, 1.0f, 1.0f}, e->renderer.width, e->renderer.height);
+    char culling_text[128];
+    sprintf(culling_text, "Nodes: %u visible, %u culled  Meshes: %u visible, %u culled", e->renderer.cull_stats.nodes_visible,
+            e->renderer.cull_stats.nodes_culled, e->renderer.cull_stats.meshes_visible, e->renderer.cull_stats.meshes_culled);
+    seel_render_text(text_shader, culling_text, 10.0f, e->renderer.height - 135.0f, 0.5f, (vec3){1.0f, 1.0f, 1.0f}, e->renderer.width, e->renderer.height);
 
     seel_renderer_end_frame();
 }
 
 void seel_engine_cleanup(struct Engine *e)
 {
+    seel_scene_cleanup(&e->scene, &e->asset_manager);
+    seel_engine_acquire_assets(e, false);
+    if (e->config.enable_debug)
+        seel_asset_manager_print_memory(&e->asset_manager);
+    if (e->scene.job_pool)
+        seel_job_pool_destroy(e->scene.job_pool);
+    seel_renderer_cleanup(&e->renderer);
     seel_asset_manager_cleanup(&e->asset_manager);
+    seel_mesh_pools_destroy();
     seel_ui_cleanup();
     seel_particle_emitter_destroy(&e->particle_emitter);
     seel_destroy_window(e->window);
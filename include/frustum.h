@@ -0,0 +1,81 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <stdbool.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "cglm/cglm.h"
+#include "mesh.h"
+
+/*
+ * The six planes of a view frustum, a * x + b * y + c * z + d >= 0 inside,
+ * stored by component so a box is tested against four planes at once. The
+ * last two lanes repeat the first two planes.
+ */
+struct Frustum
+{
+    float a[8];
+    float b[8];
+    float c[8];
+    float d[8];
+};
+
+/* Extracts the planes of clip_from_space, so bounds are tested in that space */
+void seel_frustum_init(struct Frustum *frustum, mat4 clip_from_space)
+{
+    vec4 planes[6];
+    glm_frustum_planes(clip_from_space, planes);
+
+    unsigned int i;
+    for (i = 0; i < 8; i++)
+    {
+        frustum->a[i] = planes[i % 6][0];
+        frustum->b[i] = planes[i % 6][1];
+        frustum->c[i] = planes[i % 6][2];
+        frustum->d[i] = planes[i % 6][3];
+    }
+}
+
+/* False when the box lies entirely outside one of the planes; empty boxes are never visible */
+bool seel_frustum_test_aabb(const struct Frustum *frustum, vec3 aabb[2])
+{
+    if (!glm_aabb_isvalid(aabb))
+        return false;
+
+    vec3 center, extent;
+    glm_vec3_center(aabb[0], aabb[1], center);
+    glm_vec3_sub(aabb[1], center, extent);
+
+#if defined(__SSE__)
+    /* distance of the center plus the box's reach towards the plane's normal */
+    __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 cx = _mm_set1_ps(center[0]), cy = _mm_set1_ps(center[1]), cz = _mm_set1_ps(center[2]);
+    __m128 ex = _mm_set1_ps(extent[0]), ey = _mm_set1_ps(extent[1]), ez = _mm_set1_ps(extent[2]);
+    unsigned int i;
+    for (i = 0; i < 8; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(&frustum->a[i]), b = _mm_loadu_ps(&frustum->b[i]), c = _mm_loadu_ps(&frustum->c[i]);
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, cx), _mm_mul_ps(b, cy)), _mm_add_ps(_mm_mul_ps(c, cz), _mm_loadu_ps(&frustum->d[i])));
+        __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, a), ex), _mm_mul_ps(_mm_andnot_ps(sign, b), ey)),
+                                  _mm_mul_ps(_mm_andnot_ps(sign, c), ez));
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps())))
+            return false;
+    }
+    return true;
+#else
+    unsigned int i;
+    for (i = 0; i < 6; i++)
+    {
+        float distance = frustum->a[i] * center[0] + frustum->b[i] * center[1] + frustum->c[i] * center[2] + frustum->d[i];
+        float reach = fabsf(frustum->a[i]) * extent[0] + fabsf(frustum->b[i]) * extent[1] + fabsf(frustum->c[i]) * extent[2];
+        if (distance + reach < 0.0f)
+            return false;
+    }
+    return true;
+#endif
+}
+
+#endif /* FRUSTUM_H */
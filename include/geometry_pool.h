@@ -0,0 +1,303 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "glad/gl.h"
+
+/*
+ * Geometry pools sub-allocate the vertices and indices of many meshes of
+ * one vertex format from a single vertex and index buffer, drawn through a
+ * single VAO with base vertex draws. Buffers grow and shrink by copying
+ * into storage re-specified under the same name, so the VAO, and every
+ * mesh holding the buffer names, stays valid.
+ */
+
+/* Smallest capacity of a pool buffer, in bytes */
+#define SEEL_GEOMETRY_POOL_MIN_BYTES (4u << 20)
+/* Index allocations start on this boundary, so 16 and 32 bit indices both line up */
+#define SEEL_GEOMETRY_POOL_INDEX_ALIGN 4
+
+struct GeometryRange
+{
+    size_t offset;
+    size_t size;
+};
+
+/* One buffer and its free ranges, sorted by offset and never touching */
+struct GeometryArena
+{
+    unsigned int buffer;
+    size_t capacity; /* bytes, a multiple of align */
+    size_t align;    /* every allocation is a multiple of it, and so is every offset */
+    struct GeometryRange *free;
+    unsigned int num_free;
+    unsigned int free_capacity;
+};
+
+struct GeometryPool
+{
+    unsigned int VAO;
+    struct GeometryArena vertices;
+    struct GeometryArena indices;
+    unsigned int stride;
+    unsigned int num_allocations;
+};
+
+static size_t seel_geometry_align(size_t size, size_t align)
+{
+    return (size + align - 1) / align * align;
+}
+
+static bool seel_geometry_arena_insert(struct GeometryArena *arena, unsigned int at, struct GeometryRange range)
+{
+    if (arena->num_free == arena->free_capacity)
+    {
+        unsigned int capacity = arena->free_capacity ? arena->free_capacity * 2 : 16;
+        struct GeometryRange *grown = realloc(arena->free, sizeof(struct GeometryRange) * capacity);
+        if (!grown)
+        {
+            fprintf(stderr, "Failed to allocate memory for geometry pool free list!\n");
+            return false;
+        }
+        arena->free = grown;
+        arena->free_capacity = capacity;
+    }
+
+    memmove(&arena->free[at + 1], &arena->free[at], sizeof(struct GeometryRange) * (arena->num_free - at));
+    arena->free[at] = range;
+    arena->num_free++;
+    return true;
+}
+
+static void seel_geometry_arena_remove(struct GeometryArena *arena, unsigned int at)
+{
+    memmove(&arena->free[at], &arena->free[at + 1], sizeof(struct GeometryRange) * (arena->num_free - at - 1));
+    arena->num_free--;
+}
+
+/* Returns a range to the free list, merging it with the free ranges it touches */
+static bool seel_geometry_arena_give(struct GeometryArena *arena, size_t offset, size_t size)
+{
+    if (!size)
+        return true;
+
+    unsigned int at = 0;
+    while (at < arena->num_free && arena->free[at].offset < offset)
+        at++;
+
+    bool joins_previous = at > 0 && arena->free[at - 1].offset + arena->free[at - 1].size == offset;
+    bool joins_next = at < arena->num_free && offset + size == arena->free[at].offset;
+    if (joins_previous && joins_next)
+    {
+        arena->free[at - 1].size += size + arena->free[at].size;
+        seel_geometry_arena_remove(arena, at);
+        return true;
+    }
+    if (joins_previous)
+    {
+        arena->free[at - 1].size += size;
+        return true;
+    }
+    if (joins_next)
+    {
+        arena->free[at].offset = offset;
+        arena->free[at].size += size;
+        return true;
+    }
+    return seel_geometry_arena_insert(arena, at, (struct GeometryRange){offset, size});
+}
+
+/* First fit; false when no free range is large enough */
+static bool seel_geometry_arena_take(struct GeometryArena *arena, size_t size, size_t *offset)
+{
+    unsigned int i;
+    for (i = 0; i < arena->num_free; i++)
+    {
+        if (arena->free[i].size < size)
+            continue;
+
+        *offset = arena->free[i].offset;
+        arena->free[i].offset += size;
+        arena->free[i].size -= size;
+        if (!arena->free[i].size)
+            seel_geometry_arena_remove(arena, i);
+        return true;
+    }
+    return false;
+}
+
+/* End of the last allocation; the buffer can shrink down to it */
+static size_t seel_geometry_arena_used_end(const struct GeometryArena *arena)
+{
+    if (!arena->num_free)
+        return arena->capacity;
+    const struct GeometryRange *last = &arena->free[arena->num_free - 1];
+    return last->offset + last->size == arena->capacity ? last->offset : arena->capacity;
+}
+
+/*
+ * Re-specifies the buffer with capacity bytes, keeping everything below the
+ * smaller of both sizes. Shrinking must not cut into an allocation.
+ */
+static bool seel_geometry_arena_resize(struct GeometryArena *arena, size_t capacity)
+{
+    size_t kept = seel_geometry_arena_used_end(arena);
+    if (capacity < kept)
+        return false;
+
+    unsigned int staging = 0;
+    if (kept)
+    {
+        glGenBuffers(1, &staging);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, staging);
+        glBufferData(GL_COPY_WRITE_BUFFER, kept, NULL, GL_STREAM_COPY);
+        glBindBuffer(GL_COPY_READ_BUFFER, arena->buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, kept);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, GL_STATIC_DRAW);
+    if (kept)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, staging);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, kept);
+        glDeleteBuffers(1, &staging);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    /* the free tail ends at the new capacity */
+    if (arena->num_free && arena->free[arena->num_free - 1].offset + arena->free[arena->num_free - 1].size == arena->capacity)
+        seel_geometry_arena_remove(arena, arena->num_free - 1);
+    arena->capacity = capacity;
+    return seel_geometry_arena_give(arena, kept, capacity - kept);
+}
+
+/* Takes size bytes, doubling the buffer until they fit */
+static bool seel_geometry_arena_alloc(struct GeometryArena *arena, size_t size, size_t *offset)
+{
+    size = seel_geometry_align(size, arena->align);
+    if (seel_geometry_arena_take(arena, size, offset))
+        return true;
+
+    /* a free tail counts toward the new allocation */
+    size_t needed = seel_geometry_arena_used_end(arena) + size;
+    size_t capacity = arena->capacity;
+    while (capacity < needed)
+        capacity *= 2;
+    return seel_geometry_arena_resize(arena, seel_geometry_align(capacity, arena->align)) &&
+           seel_geometry_arena_take(arena, size, offset);
+}
+
+/* Halves the buffer while at most a quarter of it is in use */
+static void seel_geometry_arena_compact(struct GeometryArena *arena)
+{
+    size_t used = seel_geometry_arena_used_end(arena);
+    size_t minimum = seel_geometry_align(SEEL_GEOMETRY_POOL_MIN_BYTES, arena->align);
+    size_t capacity = arena->capacity;
+    while (capacity / 2 >= minimum && used <= capacity / 4)
+        capacity /= 2;
+    if (capacity < arena->capacity)
+        seel_geometry_arena_resize(arena, seel_geometry_align(capacity, arena->align));
+}
+
+static void seel_geometry_arena_init(struct GeometryArena *arena, size_t align)
+{
+    memset(arena, 0, sizeof(struct GeometryArena));
+    arena->align = align;
+    arena->capacity = seel_geometry_align(SEEL_GEOMETRY_POOL_MIN_BYTES, align);
+    glGenBuffers(1, &arena->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, arena->capacity, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    seel_geometry_arena_give(arena, 0, arena->capacity);
+}
+
+/*
+ * Creates the pool's buffers and VAO and leaves the VAO bound with both
+ * buffers attached, for the caller to point the vertex attributes at.
+ */
+bool seel_geometry_pool_init(struct GeometryPool *pool, unsigned int stride)
+{
+    memset(pool, 0, sizeof(struct GeometryPool));
+    pool->stride = stride;
+    seel_geometry_arena_init(&pool->vertices, stride);
+    seel_geometry_arena_init(&pool->indices, SEEL_GEOMETRY_POOL_INDEX_ALIGN);
+    if (!pool->vertices.num_free || !pool->indices.num_free)
+    {
+        fprintf(stderr, "Failed to create geometry pool!\n");
+        glDeleteBuffers(1, &pool->vertices.buffer);
+        glDeleteBuffers(1, &pool->indices.buffer);
+        free(pool->vertices.free);
+        free(pool->indices.free);
+        memset(pool, 0, sizeof(struct GeometryPool));
+        return false;
+    }
+
+    glGenVertexArrays(1, &pool->VAO);
+    glBindVertexArray(pool->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, pool->vertices.buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool->indices.buffer);
+    return true;
+}
+
+/*
+ * Uploads a mesh's vertices and indices into the pool. Returns the first
+ * vertex, to draw with as base vertex, and the byte offset of the first
+ * index; false leaves the pool as it was.
+ */
+bool seel_geometry_pool_alloc(struct GeometryPool *pool, const void *vertices, unsigned int num_vertices, const void *indices, size_t index_bytes,
+                              unsigned int *base_vertex, size_t *index_base)
+{
+    size_t vertex_offset, index_offset;
+    size_t vertex_bytes = (size_t)num_vertices * pool->stride;
+    if (!seel_geometry_arena_alloc(&pool->vertices, vertex_bytes, &vertex_offset))
+        return false;
+    if (!seel_geometry_arena_alloc(&pool->indices, index_bytes, &index_offset))
+    {
+        seel_geometry_arena_give(&pool->vertices, vertex_offset, vertex_bytes);
+        return false;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool->vertices.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertex_offset, vertex_bytes, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool->indices.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, index_offset, index_bytes, indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    *base_vertex = (unsigned int)(vertex_offset / pool->stride);
+    *index_base = index_offset;
+    pool->num_allocations++;
+    return true;
+}
+
+/* Gives an allocation back and shrinks buffers that are mostly empty */
+void seel_geometry_pool_free(struct GeometryPool *pool, unsigned int base_vertex, unsigned int num_vertices, size_t index_base, size_t index_bytes)
+{
+    seel_geometry_arena_give(&pool->vertices, (size_t)base_vertex * pool->stride,
+                             seel_geometry_align((size_t)num_vertices * pool->stride, pool->vertices.align));
+    seel_geometry_arena_give(&pool->indices, index_base, seel_geometry_align(index_bytes, pool->indices.align));
+    pool->num_allocations--;
+
+    seel_geometry_arena_compact(&pool->vertices);
+    seel_geometry_arena_compact(&pool->indices);
+}
+
+void seel_geometry_pool_destroy(struct GeometryPool *pool)
+{
+    if (pool->VAO)
+    {
+        glDeleteVertexArrays(1, &pool->VAO);
+        glDeleteBuffers(1, &pool->vertices.buffer);
+        glDeleteBuffers(1, &pool->indices.buffer);
+    }
+    free(pool->vertices.free);
+    free(pool->indices.free);
+    memset(pool, 0, sizeof(struct GeometryPool));
+}
+
+#endif /* GEOMETRY_POOL_H */
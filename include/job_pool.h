@@ -0,0 +1,191 @@
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SEEL_MAX_JOB_WORKERS 32
+#define SEEL_CACHE_LINE_SIZE 64
+
+/* Processes items [begin, end) of a dispatched job; worker 0 is the thread that waits on the job */
+typedef void (*JobCallback)(void *context, unsigned int begin, unsigned int end, unsigned int worker);
+
+/* Padded to a cache line so workers never write to a line another worker uses */
+struct JobWorker
+{
+    _Alignas(SEEL_CACHE_LINE_SIZE) pthread_t thread;
+    struct JobPool *pool;
+    unsigned int index;
+    unsigned int generation;
+};
+
+/*
+ * Fixed set of worker threads that split one job at a time into chunks of
+ * consecutive items. Dispatch returns immediately; the dispatching thread
+ * joins in on the remaining chunks when it waits for the job.
+ */
+struct JobPool
+{
+    struct JobWorker workers[SEEL_MAX_JOB_WORKERS];
+    unsigned int num_workers; /* including the waiting thread */
+    pthread_mutex_t mutex;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    unsigned int generation;
+    unsigned int busy_workers;
+    bool running;
+    bool dispatched;
+
+    JobCallback callback;
+    void *context;
+    unsigned int count;
+    unsigned int chunk;
+    _Alignas(SEEL_CACHE_LINE_SIZE) atomic_uint next;
+};
+
+bool seel_job_pool_create(struct JobPool *pool, unsigned int num_workers);
+void seel_job_pool_dispatch(struct JobPool *pool, JobCallback callback, void *context, unsigned int count, unsigned int chunk);
+void seel_job_pool_wait(struct JobPool *pool);
+void seel_job_pool_destroy(struct JobPool *pool);
+
+static void seel_job_pool_run(struct JobPool *pool, unsigned int worker)
+{
+    for (;;)
+    {
+        unsigned int begin = atomic_fetch_add_explicit(&pool->next, pool->chunk, memory_order_relaxed);
+        if (begin >= pool->count)
+            break;
+
+        unsigned int end = begin + pool->chunk < pool->count ? begin + pool->chunk : pool->count;
+        pool->callback(pool->context, begin, end, worker);
+    }
+}
+
+static void *seel_job_worker_main(void *arg)
+{
+    struct JobWorker *worker = (struct JobWorker *)arg;
+    struct JobPool *pool = worker->pool;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;)
+    {
+        while (pool->running && pool->generation == worker->generation)
+            pthread_cond_wait(&pool->work_ready, &pool->mutex);
+        if (!pool->running)
+            break;
+
+        worker->generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        seel_job_pool_run(pool, worker->index);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->busy_workers == 0)
+            pthread_cond_signal(&pool->work_done);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+/* num_workers counts the waiting thread; 0 uses one worker per online core */
+bool seel_job_pool_create(struct JobPool *pool, unsigned int num_workers)
+{
+    memset(pool, 0, sizeof(struct JobPool));
+
+    if (num_workers == 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        num_workers = cores > 0 ? (unsigned int)cores : 1;
+    }
+    if (num_workers > SEEL_MAX_JOB_WORKERS)
+        num_workers = SEEL_MAX_JOB_WORKERS;
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+    atomic_init(&pool->next, 0);
+    pool->running = true;
+    pool->num_workers = 1;
+
+    unsigned int i;
+    for (i = 1; i < num_workers; i++)
+    {
+        struct JobWorker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        if (pthread_create(&worker->thread, NULL, seel_job_worker_main, worker) != 0)
+        {
+            fprintf(stderr, "Failed to create job worker thread!\n");
+            seel_job_pool_destroy(pool);
+            return false;
+        }
+        pool->num_workers++;
+    }
+
+    return true;
+}
+
+/* Starts a job over count items; the previous job must have been waited on */
+void seel_job_pool_dispatch(struct JobPool *pool, JobCallback callback, void *context, unsigned int count, unsigned int chunk)
+{
+    if (pool->dispatched)
+        seel_job_pool_wait(pool);
+
+    pool->callback = callback;
+    pool->context = context;
+    pool->count = count;
+    pool->chunk = chunk ? chunk : 1;
+    atomic_store_explicit(&pool->next, 0, memory_order_relaxed);
+    pool->dispatched = true;
+
+    if (pool->num_workers > 1)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        pool->busy_workers = pool->num_workers - 1;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->work_ready);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+/* Helps with the remaining chunks, then blocks until every worker is done */
+void seel_job_pool_wait(struct JobPool *pool)
+{
+    if (!pool->dispatched)
+        return;
+
+    seel_job_pool_run(pool, 0);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->busy_workers > 0)
+        pthread_cond_wait(&pool->work_done, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+
+    pool->dispatched = false;
+}
+
+void seel_job_pool_destroy(struct JobPool *pool)
+{
+    seel_job_pool_wait(pool);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->running = false;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->mutex);
+
+    unsigned int i;
+    for (i = 1; i < pool->num_workers; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    pthread_cond_destroy(&pool->work_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->mutex);
+    pool->num_workers = 0;
+}
+
+#endif /* JOB_POOL_H */
@@ -1,6 +1,9 @@
 #ifndef LIGHT_H
 #define LIGHT_H
 
+#include <float.h>
+#include <math.h>
+
 #include "cglm/cglm.h"
 
 #define MAX_LIGHTS 500
@@ -42,4 +45,17 @@ struct SpotLight
 
 void seel_point_light_set_uniforms();
 
+/* Distance at which the light's attenuation falls to threshold; FLT_MAX when it never does */
+float seel_point_light_range(const struct PointLight *light, float threshold)
+{
+    float target = 1.0f / threshold - light->constant;
+    if (target <= 0.0f)
+        return 0.0f;
+    if (light->quadratic > 0.0f)
+        return (-light->linear + sqrtf(light->linear * light->linear + 4.0f * light->quadratic * target)) / (2.0f * light->quadratic);
+    if (light->linear > 0.0f)
+        return target / light->linear;
+    return FLT_MAX;
+}
+
 #endif /* LIGHT_H */
\ No newline at end of file
@@ -2,13 +2,24 @@
 #define MESH_H
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
 
 #include "cglm/cglm.h"
 #include "texture.h"
 #include "shader.h"
 #include "bone.h"
+#include "geometry_pool.h"
 
 #define MAX_UNIFORM_NAME_LEN 32
+/* Detail levels a mesh carries, the full mesh included */
+#define MAX_MESH_LODS 4
+/* Size limits of a meshlet */
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
 
 struct Vertex
 {
@@ -21,32 +32,248 @@ struct Vertex
     float m_weights[MAX_BONE_INFLUENCE];
 };
 
+/*
+ * GPU side vertex layouts. struct Vertex stays the CPU format every layout
+ * is packed from at upload, or once by the cooker for cooked meshes. The
+ * compact layouts store:
+ * - the normal and tangent as one octahedral frame of four shorts, with
+ *   the bitangent sign in the lowest bit of the last one
+ * - half float texture coordinates
+ * - bone ids as bytes and weights as unorm bytes, only for meshes with
+ *   bone weights
+ * The quantized layout also stores positions as unorm shorts, scaled back
+ * to the mesh bounds in default.vert.
+ */
+enum VertexLayout
+{
+    VERTEX_LAYOUT_FULL,      /* struct Vertex, 88 bytes */
+    VERTEX_LAYOUT_COMPACT,   /* 24 bytes static, 32 skinned */
+    VERTEX_LAYOUT_QUANTIZED, /* 20 bytes static, 28 skinned */
+};
+
+/* Byte offsets within a packed vertex; the position is always first */
+struct VertexFormat
+{
+    unsigned int stride;
+    unsigned int frame;
+    unsigned int tex_coords;
+    unsigned int bone_ids;
+    unsigned int weights;
+};
+
+/*
+ * Range of a detail level in the mesh's index buffer. Every level indexes
+ * the same vertices; error is the largest distance, in mesh units, the
+ * simplification moved the surface by.
+ */
+struct MeshLod
+{
+    unsigned int first_index;
+    unsigned int num_indices;
+    float error;
+};
+
+/*
+ * Cluster of at most MESHLET_MAX_TRIANGLES consecutive triangles of the full
+ * detail level, using at most MESHLET_MAX_VERTICES vertices, with the bounds
+ * meshlet.h culls it by.
+ */
+struct Meshlet
+{
+    vec3 center; /* bounding sphere, in mesh units */
+    float radius;
+    vec3 cone_axis;    /* average facing of the triangles */
+    float cone_cutoff; /* sine of the cone's half angle; 1 never culls */
+    unsigned int first_index;
+    unsigned int num_indices;
+};
+
+/* Axis aligned box (min, max) and the sphere around it (center, radius); the box is invalid when empty */
+struct Bounds
+{
+    vec3 aabb[2];
+    vec4 sphere;
+};
+
+/* Layout meshes are uploaded with unless set otherwise before seel_mesh_setup */
+enum VertexLayout seel_mesh_default_layout = VERTEX_LAYOUT_COMPACT;
+
+/* Shared buffers of every vertex format, indexed by layout and whether it carries bones */
+struct GeometryPool seel_mesh_pools[VERTEX_LAYOUT_QUANTIZED + 1][2];
+
 struct Mesh
 {
     struct Vertex *vertices;
     unsigned int *indices;
+    const void *packed_vertices; /* in layout and index_type already, as cooked meshes store them; vertices and indices are NULL then */
+    const void *packed_indices;
     struct Texture *textures;
     unsigned int num_vertices;
-    unsigned int num_indices;
+    unsigned int num_indices; /* of every detail level */
     unsigned int num_textures;
+    struct MeshLod lods[MAX_MESH_LODS];
+    unsigned int num_lods; /* 0 draws all indices as a single level */
+    struct Meshlet *meshlets;
+    unsigned int num_meshlets;
+    struct Bounds bounds;       /* of the bind pose */
+    struct Bounds *bone_bounds; /* bind pose bounds of the vertices each bone id moves, NULL without bone weights */
+    unsigned int num_bone_bounds;
+    struct Bounds rigid_bounds; /* vertices no bone moves */
+    unsigned int *bone_palette; /* model bone id of every palette slot the vertices index */
+    unsigned int num_palette_bones;
+    enum VertexLayout layout;
+    bool skinned;         /* packed with bone attributes; always true for the full layout */
+    vec3 position_offset; /* dequantization of quantized positions, identity otherwise */
+    vec3 position_scale;
+    unsigned int index_type; /* GL_UNSIGNED_SHORT when every vertex is addressable with 16 bits */
+    struct GeometryPool *pool; /* NULL when VAO, VBO and EBO are the mesh's own */
+    unsigned int base_vertex;  /* of the mesh's vertices in VBO */
+    size_t index_base;         /* byte offset of the mesh's indices in EBO */
     unsigned int VAO, VBO, EBO;
 };
 
-void seel_mesh_setup(struct Mesh *mesh)
+void seel_bounds_clear(struct Bounds *bounds)
 {
-    glGenVertexArrays(1, &mesh->VAO);
-    glGenBuffers(1, &mesh->VBO);
-    glGenBuffers(1, &mesh->EBO);
+    glm_aabb_invalidate(bounds->aabb);
+    glm_vec4_zero(bounds->sphere);
+}
 
-    glBindVertexArray(mesh->VAO);
+/* Fits the sphere around the box */
+void seel_bounds_update_sphere(struct Bounds *bounds)
+{
+    if (!glm_aabb_isvalid(bounds->aabb))
+    {
+        glm_vec4_zero(bounds->sphere);
+        return;
+    }
+    glm_aabb_center(bounds->aabb, bounds->sphere);
+    bounds->sphere[3] = glm_aabb_radius(bounds->aabb);
+}
+
+void seel_bounds_merge(struct Bounds *dest, const struct Bounds *bounds)
+{
+    if (!glm_aabb_isvalid((vec3 *)bounds->aabb))
+        return;
+    if (glm_aabb_isvalid(dest->aabb))
+        glm_aabb_merge(dest->aabb, (vec3 *)bounds->aabb, dest->aabb);
+    else
+        memcpy(dest->aabb, bounds->aabb, sizeof(dest->aabb));
+    seel_bounds_update_sphere(dest);
+}
+
+static void seel_bounds_add_point(struct Bounds *bounds, const vec3 point)
+{
+    glm_vec3_minv(bounds->aabb[0], (float *)point, bounds->aabb[0]);
+    glm_vec3_maxv(bounds->aabb[1], (float *)point, bounds->aabb[1]);
+}
+
+/*
+ * Computes the bind pose bounds of the mesh and, for meshes with bone
+ * weights, the bounds of the vertices each bone id moves, which
+ * seel_mesh_posed_bounds carries along with the pose.
+ */
+bool seel_mesh_compute_bounds(struct Mesh *mesh)
+{
+    free(mesh->bone_bounds);
+    mesh->bone_bounds = NULL;
+    mesh->num_bone_bounds = 0;
+    seel_bounds_clear(&mesh->bounds);
+    seel_bounds_clear(&mesh->rigid_bounds);
+
+    unsigned int num_bones = 0, i;
+    int j;
+    for (i = 0; i < mesh->num_vertices; i++)
+    {
+        const struct Vertex *vertex = &mesh->vertices[i];
+        seel_bounds_add_point(&mesh->bounds, vertex->position);
+        for (j = 0; j < MAX_BONE_INFLUENCE; j++)
+        {
+            if (vertex->m_bone_ids[j] >= 0 && vertex->m_weights[j] > 0.0f && (unsigned int)vertex->m_bone_ids[j] >= num_bones)
+                num_bones = vertex->m_bone_ids[j] + 1;
+        }
+    }
+
+    /* the sphere around the vertices is tighter than the one around the box */
+    if (mesh->num_vertices)
+        glm_aabb_center(mesh->bounds.aabb, mesh->bounds.sphere);
+    for (i = 0; i < mesh->num_vertices; i++)
+        mesh->bounds.sphere[3] = glm_max(mesh->bounds.sphere[3], glm_vec3_distance(mesh->bounds.sphere, (float *)mesh->vertices[i].position));
+
+    if (!num_bones)
+    {
+        mesh->rigid_bounds = mesh->bounds;
+        return true;
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->VBO);
-    glBufferData(GL_ARRAY_BUFFER, mesh->num_vertices * sizeof(struct Vertex), &mesh->vertices[0], GL_STATIC_DRAW);
+    mesh->bone_bounds = malloc(sizeof(struct Bounds) * num_bones);
+    if (!mesh->bone_bounds)
+    {
+        fprintf(stderr, "Failed to allocate memory for mesh bone bounds!\n");
+        mesh->rigid_bounds = mesh->bounds;
+        return false;
+    }
+    mesh->num_bone_bounds = num_bones;
+    for (i = 0; i < num_bones; i++)
+        seel_bounds_clear(&mesh->bone_bounds[i]);
+
+    for (i = 0; i < mesh->num_vertices; i++)
+    {
+        const struct Vertex *vertex = &mesh->vertices[i];
+        bool moved = false;
+        for (j = 0; j < MAX_BONE_INFLUENCE; j++)
+        {
+            if (vertex->m_bone_ids[j] >= 0 && vertex->m_weights[j] > 0.0f)
+            {
+                seel_bounds_add_point(&mesh->bone_bounds[vertex->m_bone_ids[j]], vertex->position);
+                moved = true;
+            }
+        }
+        if (!moved)
+            seel_bounds_add_point(&mesh->rigid_bounds, vertex->position);
+    }
+
+    for (i = 0; i < num_bones; i++)
+        seel_bounds_update_sphere(&mesh->bone_bounds[i]);
+    seel_bounds_update_sphere(&mesh->rigid_bounds);
+    return true;
+}
+
+/*
+ * Bounds of the mesh posed by palette, which is indexed by model bone id
+ * and holds palette_size matrices. A skinned vertex is a weighted average
+ * of its bones' transforms of it, so with weights summing to one it stays
+ * within the union of the boxes its bones carry along.
+ */
+void seel_mesh_posed_bounds(const struct Mesh *mesh, mat4 *palette, unsigned int palette_size, struct Bounds *bounds)
+{
+    if (!mesh->bone_bounds)
+    {
+        *bounds = mesh->bounds;
+        return;
+    }
+
+    *bounds = mesh->rigid_bounds;
+    unsigned int i;
+    for (i = 0; i < mesh->num_bone_bounds; i++)
+    {
+        const struct Bounds *bone_bounds = &mesh->bone_bounds[i];
+        if (!glm_aabb_isvalid((vec3 *)bone_bounds->aabb))
+            continue;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->num_indices * sizeof(unsigned int),
-                 &mesh->indices[0], GL_STATIC_DRAW);
+        /* bone ids are palette slots once the mesh has a palette */
+        unsigned int bone = mesh->bone_palette ? (i < mesh->num_palette_bones ? mesh->bone_palette[i] : palette_size) : i;
+        struct Bounds posed;
+        if (bone < palette_size)
+            glm_aabb_transform((vec3 *)bone_bounds->aabb, palette[bone], posed.aabb);
+        else
+            memcpy(posed.aabb, bone_bounds->aabb, sizeof(posed.aabb));
+        seel_bounds_merge(bounds, &posed);
+    }
+}
 
+/* Points attributes 0-6 at a struct Vertex array in the bound GL_ARRAY_BUFFER */
+void seel_mesh_setup_attributes(void)
+{
     /* vertex positions */
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(struct Vertex), (void *)0);
@@ -68,8 +295,377 @@ void seel_mesh_setup(struct Mesh *mesh)
     /* weights */
     glEnableVertexAttribArray(6);
     glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(struct Vertex), (void *)offsetof(struct Vertex, m_weights));
+}
 
-    glBindVertexArray(0);
+struct VertexFormat seel_vertex_format(enum VertexLayout layout, bool skinned)
+{
+    struct VertexFormat format = {sizeof(struct Vertex), offsetof(struct Vertex, normal), offsetof(struct Vertex, tex_coords),
+                                  offsetof(struct Vertex, m_bone_ids), offsetof(struct Vertex, m_weights)};
+    if (layout == VERTEX_LAYOUT_FULL)
+        return format;
+
+    /* float or four unorm short positions, then the frame, texture coordinates and bones */
+    format.frame = layout == VERTEX_LAYOUT_QUANTIZED ? 8 : 12;
+    format.tex_coords = format.frame + 4 * sizeof(int16_t);
+    format.bone_ids = format.tex_coords + 2 * sizeof(uint16_t);
+    format.weights = format.bone_ids + MAX_BONE_INFLUENCE;
+    format.stride = skinned ? format.weights + MAX_BONE_INFLUENCE : format.bone_ids;
+    return format;
+}
+
+/* Bytes of the mesh's vertex buffer on the GPU */
+size_t seel_mesh_vertex_buffer_size(const struct Mesh *mesh)
+{
+    return (size_t)mesh->num_vertices * seel_vertex_format(mesh->layout, mesh->skinned).stride;
+}
+
+static unsigned int seel_mesh_choose_index_type(const struct Mesh *mesh)
+{
+    return mesh->num_vertices <= UINT16_MAX + 1 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+/* Bytes of the mesh's index buffer on the GPU, or that it will take before seel_mesh_setup */
+size_t seel_mesh_index_buffer_size(const struct Mesh *mesh)
+{
+    unsigned int type = mesh->index_type ? mesh->index_type : seel_mesh_choose_index_type(mesh);
+    return (size_t)mesh->num_indices * (type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t));
+}
+
+static uint16_t seel_float_to_half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent >= 31)
+        return (uint16_t)(sign | 0x7c00); /* too large for a half, or inf and nan */
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return (uint16_t)sign;
+        /* subnormal: shift the implicit one in and round to nearest */
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        return (uint16_t)(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+    }
+
+    /* rounding may carry into the exponent, which is still the right result */
+    return (uint16_t)(sign | (((uint32_t)exponent << 10) + ((mantissa + 0x1000) >> 13)));
+}
+
+static int16_t seel_float_to_snorm16(float value)
+{
+    value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+    return (int16_t)lroundf(value * 32767.0f);
+}
+
+/* Maps a unit vector onto the octahedron unfolded into [-1, 1]^2 */
+static void seel_octahedral_encode(const vec3 v, float out[2])
+{
+    float l1 = fabsf(v[0]) + fabsf(v[1]) + fabsf(v[2]);
+    if (l1 < 1e-12f)
+    {
+        out[0] = 0.0f;
+        out[1] = 0.0f;
+        return;
+    }
+
+    float x = v[0] / l1, y = v[1] / l1;
+    if (v[2] < 0.0f)
+    {
+        float folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+    out[0] = x;
+    out[1] = y;
+}
+
+/* Normal and tangent as four shorts; the last keeps 15 bits of the tangent and the bitangent sign */
+static void seel_vertex_pack_frame(const struct Vertex *vertex, int16_t frame[4])
+{
+    float normal[2], tangent[2];
+    seel_octahedral_encode(vertex->normal, normal);
+    seel_octahedral_encode(vertex->tangent, tangent);
+
+    vec3 cross;
+    glm_vec3_cross((float *)vertex->normal, (float *)vertex->tangent, cross);
+    bool flipped = glm_vec3_dot(cross, (float *)vertex->bitangent) < 0.0f;
+
+    frame[0] = seel_float_to_snorm16(normal[0]);
+    frame[1] = seel_float_to_snorm16(normal[1]);
+    frame[2] = seel_float_to_snorm16(tangent[0]);
+    float tangent_y = tangent[1] < -1.0f ? -1.0f : tangent[1] > 1.0f ? 1.0f : tangent[1];
+    frame[3] = (int16_t)((lroundf(tangent_y * 16383.0f) * 2) | (flipped ? 1 : 0));
+}
+
+/* Unorm byte weights that still sum to exactly 255 */
+static void seel_vertex_pack_weights(const struct Vertex *vertex, uint8_t weights[MAX_BONE_INFLUENCE])
+{
+    int total = 0, largest = 0;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+    {
+        float weight = vertex->m_bone_ids[i] >= 0 ? vertex->m_weights[i] : 0.0f;
+        weight = weight < 0.0f ? 0.0f : weight > 1.0f ? 1.0f : weight;
+        weights[i] = (uint8_t)lroundf(weight * 255.0f);
+        total += weights[i];
+        if (weights[i] > weights[largest])
+            largest = i;
+    }
+    /* only undo rounding drift; weights that never summed to one stay as they are */
+    if (total && abs(total - 255) <= MAX_BONE_INFLUENCE / 2)
+        weights[largest] = (uint8_t)(weights[largest] + 255 - total);
+}
+
+/*
+ * Picks the concrete layout of the mesh: compact meshes without bone
+ * weights drop the bone attributes, and bone ids that do not fit a byte
+ * keep the full layout.
+ */
+static void seel_mesh_choose_layout(struct Mesh *mesh)
+{
+    glm_vec3_zero(mesh->position_offset);
+    glm_vec3_one(mesh->position_scale);
+    mesh->skinned = mesh->layout == VERTEX_LAYOUT_FULL;
+    if (mesh->layout == VERTEX_LAYOUT_FULL)
+        return;
+
+    vec3 low = {FLT_MAX, FLT_MAX, FLT_MAX}, high = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (unsigned int i = 0; i < mesh->num_vertices; i++)
+    {
+        const struct Vertex *vertex = &mesh->vertices[i];
+        glm_vec3_minv(low, (float *)vertex->position, low);
+        glm_vec3_maxv(high, (float *)vertex->position, high);
+        for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+        {
+            if (vertex->m_bone_ids[j] > UINT8_MAX)
+            {
+                mesh->layout = VERTEX_LAYOUT_FULL;
+                mesh->skinned = true;
+                return;
+            }
+            if (vertex->m_bone_ids[j] >= 0 && vertex->m_weights[j] > 0.0f)
+                mesh->skinned = true;
+        }
+    }
+
+    if (mesh->layout == VERTEX_LAYOUT_QUANTIZED && mesh->num_vertices)
+    {
+        glm_vec3_copy(low, mesh->position_offset);
+        glm_vec3_sub(high, low, mesh->position_scale);
+        for (int i = 0; i < 3; i++)
+            mesh->position_scale[i] = mesh->position_scale[i] > 0.0f ? mesh->position_scale[i] : 1.0f;
+    }
+}
+
+/* The mesh's vertices in its layout; NULL for the full layout, which uploads vertices as they are */
+static unsigned char *seel_mesh_pack_vertices(const struct Mesh *mesh)
+{
+    if (mesh->layout == VERTEX_LAYOUT_FULL)
+        return NULL;
+
+    struct VertexFormat format = seel_vertex_format(mesh->layout, mesh->skinned);
+    unsigned char *packed = calloc(mesh->num_vertices ? mesh->num_vertices : 1, format.stride);
+    if (!packed)
+    {
+        fprintf(stderr, "Failed to allocate memory for packed vertices!\n");
+        return NULL;
+    }
+
+    for (unsigned int i = 0; i < mesh->num_vertices; i++)
+    {
+        const struct Vertex *vertex = &mesh->vertices[i];
+        unsigned char *out = packed + (size_t)i * format.stride;
+
+        if (mesh->layout == VERTEX_LAYOUT_QUANTIZED)
+        {
+            uint16_t position[4] = {0};
+            for (int j = 0; j < 3; j++)
+            {
+                float t = (vertex->position[j] - mesh->position_offset[j]) / mesh->position_scale[j];
+                position[j] = (uint16_t)lroundf((t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t) * 65535.0f);
+            }
+            memcpy(out, position, sizeof(position));
+        }
+        else
+        {
+            memcpy(out, vertex->position, sizeof(vec3));
+        }
+
+        int16_t frame[4];
+        seel_vertex_pack_frame(vertex, frame);
+        memcpy(out + format.frame, frame, sizeof(frame));
+
+        uint16_t tex_coords[2] = {seel_float_to_half(vertex->tex_coords[0]), seel_float_to_half(vertex->tex_coords[1])};
+        memcpy(out + format.tex_coords, tex_coords, sizeof(tex_coords));
+
+        if (mesh->skinned)
+        {
+            uint8_t *bone_ids = out + format.bone_ids;
+            for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+                bone_ids[j] = vertex->m_bone_ids[j] >= 0 ? (uint8_t)vertex->m_bone_ids[j] : 0;
+            seel_vertex_pack_weights(vertex, out + format.weights);
+        }
+    }
+    return packed;
+}
+
+/* Points the attributes of the mesh's layout at the bound GL_ARRAY_BUFFER */
+void seel_mesh_setup_layout_attributes(const struct Mesh *mesh)
+{
+    if (mesh->layout == VERTEX_LAYOUT_FULL)
+    {
+        seel_mesh_setup_attributes();
+        return;
+    }
+
+    struct VertexFormat format = seel_vertex_format(mesh->layout, mesh->skinned);
+    glEnableVertexAttribArray(0);
+    if (mesh->layout == VERTEX_LAYOUT_QUANTIZED)
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, format.stride, (void *)0);
+    else
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, format.stride, (void *)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, format.stride, (void *)(uintptr_t)format.tex_coords);
+    glEnableVertexAttribArray(13);
+    glVertexAttribIPointer(13, 4, GL_SHORT, format.stride, (void *)(uintptr_t)format.frame);
+    if (mesh->skinned)
+    {
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, format.stride, (void *)(uintptr_t)format.bone_ids);
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, format.stride, (void *)(uintptr_t)format.weights);
+    }
+}
+
+/* Sub-allocates the mesh from the pool of its vertex format, creating the pool on first use */
+static bool seel_mesh_pool_upload(struct Mesh *mesh, const void *vertices, const void *indices)
+{
+    struct GeometryPool *pool = &seel_mesh_pools[mesh->layout][mesh->skinned];
+    if (!pool->VAO)
+    {
+        if (!seel_geometry_pool_init(pool, seel_vertex_format(mesh->layout, mesh->skinned).stride))
+            return false;
+        seel_mesh_setup_layout_attributes(mesh);
+        glBindVertexArray(0);
+    }
+
+    if (!seel_geometry_pool_alloc(pool, vertices, mesh->num_vertices, indices, seel_mesh_index_buffer_size(mesh), &mesh->base_vertex, &mesh->index_base))
+        return false;
+
+    mesh->pool = pool;
+    mesh->VAO = pool->VAO;
+    mesh->VBO = pool->vertices.buffer;
+    mesh->EBO = pool->indices.buffer;
+    return true;
+}
+
+/*
+ * Picks the mesh's layout and index type and packs its vertices and
+ * indices into them. *vertices and *indices are the packed copies for the
+ * caller to free, NULL where the mesh's own array already is in that
+ * format.
+ */
+void seel_mesh_pack(struct Mesh *mesh, unsigned char **vertices, uint16_t **indices)
+{
+    seel_mesh_choose_layout(mesh);
+    *vertices = seel_mesh_pack_vertices(mesh);
+    if (!*vertices && mesh->layout != VERTEX_LAYOUT_FULL)
+    {
+        /* the vertices go up as they are when there is no memory to pack them */
+        mesh->layout = VERTEX_LAYOUT_FULL;
+        seel_mesh_choose_layout(mesh);
+    }
+
+    /* the CPU copy keeps 32 bit indices, the GPU gets 16 bit ones whenever they fit */
+    mesh->index_type = seel_mesh_choose_index_type(mesh);
+    *indices = NULL;
+    if (mesh->index_type == GL_UNSIGNED_SHORT && (*indices = malloc(sizeof(uint16_t) * mesh->num_indices)))
+    {
+        unsigned int i;
+        for (i = 0; i < mesh->num_indices; i++)
+            (*indices)[i] = (uint16_t)mesh->indices[i];
+    }
+    else
+        mesh->index_type = GL_UNSIGNED_INT;
+}
+
+/* Uploads the mesh, packing its vertices and indices first unless they come packed */
+void seel_mesh_setup(struct Mesh *mesh)
+{
+    unsigned char *packed = NULL;
+    uint16_t *short_indices = NULL;
+    if (!mesh->packed_vertices)
+        seel_mesh_pack(mesh, &packed, &short_indices);
+    const void *vertices = mesh->packed_vertices ? mesh->packed_vertices : packed ? (void *)packed : (void *)&mesh->vertices[0];
+    const void *indices = mesh->packed_indices ? mesh->packed_indices : short_indices ? (void *)short_indices : (void *)&mesh->indices[0];
+
+    mesh->pool = NULL;
+    mesh->base_vertex = 0;
+    mesh->index_base = 0;
+    if (!seel_mesh_pool_upload(mesh, vertices, indices))
+    {
+        /* the mesh gets buffers of its own */
+        glGenVertexArrays(1, &mesh->VAO);
+        glGenBuffers(1, &mesh->VBO);
+        glGenBuffers(1, &mesh->EBO);
+
+        glBindVertexArray(mesh->VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->VBO);
+        glBufferData(GL_ARRAY_BUFFER, seel_mesh_vertex_buffer_size(mesh), vertices, GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, seel_mesh_index_buffer_size(mesh), indices, GL_STATIC_DRAW);
+
+        seel_mesh_setup_layout_attributes(mesh);
+
+        glBindVertexArray(0);
+    }
+    free(packed);
+    free(short_indices);
+}
+
+/* Frees the mesh's GPU geometry: its range of the pool, or its own buffers */
+void seel_mesh_release(struct Mesh *mesh)
+{
+    if (mesh->pool)
+        seel_geometry_pool_free(mesh->pool, mesh->base_vertex, mesh->num_vertices, mesh->index_base, seel_mesh_index_buffer_size(mesh));
+    else if (mesh->VAO)
+    {
+        glDeleteVertexArrays(1, &mesh->VAO);
+        glDeleteBuffers(1, &mesh->VBO);
+        glDeleteBuffers(1, &mesh->EBO);
+    }
+    mesh->pool = NULL;
+    mesh->VAO = mesh->VBO = mesh->EBO = 0;
+}
+
+/* Deletes every geometry pool; call once all meshes are released */
+void seel_mesh_pools_destroy(void)
+{
+    unsigned int layout, skinned;
+    for (layout = 0; layout <= VERTEX_LAYOUT_QUANTIZED; layout++)
+    {
+        for (skinned = 0; skinned < 2; skinned++)
+        {
+            if (seel_mesh_pools[layout][skinned].num_allocations)
+                fprintf(stderr, "Geometry pool destroyed with %u meshes still in it!\n", seel_mesh_pools[layout][skinned].num_allocations);
+            seel_geometry_pool_destroy(&seel_mesh_pools[layout][skinned]);
+        }
+    }
+}
+
+/* Uniforms default.vert decodes the mesh's layout with */
+void seel_mesh_set_layout_uniforms(const struct Mesh *mesh, struct Shader *shader)
+{
+    seel_shader_set_int(shader, "packedFrame", mesh->layout != VERTEX_LAYOUT_FULL);
+    seel_shader_set_int(shader, "meshSkinned", mesh->skinned);
+    seel_shader_set_vec3(shader, "positionOffset", (float *)mesh->position_offset);
+    seel_shader_set_vec3(shader, "positionScale", (float *)mesh->position_scale);
 }
 
 struct Mesh seel_mesh_init(struct Vertex *vertices,
@@ -86,12 +682,34 @@ struct Mesh seel_mesh_init(struct Vertex *vertices,
     mesh.num_vertices = num_vertices;
     mesh.num_indices = num_indices;
     mesh.num_textures = num_textures;
+    mesh.layout = seel_mesh_default_layout;
 
+    seel_mesh_compute_bounds(&mesh);
     seel_mesh_setup(&mesh);
     return mesh;
 }
 
-void seel_mesh_draw(struct Mesh mesh, struct Shader *shader)
+bool seel_mesh_set_bone_palette(struct Mesh *mesh, const unsigned int *palette, unsigned int count)
+{
+    free(mesh->bone_palette);
+    mesh->bone_palette = NULL;
+    mesh->num_palette_bones = 0;
+    if (!count)
+        return true;
+
+    mesh->bone_palette = malloc(sizeof(unsigned int) * count);
+    if (!mesh->bone_palette)
+    {
+        fprintf(stderr, "Failed to allocate memory for mesh bone palette!\n");
+        return false;
+    }
+
+    memcpy(mesh->bone_palette, palette, sizeof(unsigned int) * count);
+    mesh->num_palette_bones = count;
+    return true;
+}
+
+void seel_mesh_bind_material(struct Mesh *mesh, struct Shader *shader)
 {
     unsigned int diffuse_nr = 1;
     unsigned int specular_nr = 1;
@@ -101,11 +719,11 @@ void seel_mesh_draw(struct Mesh mesh, struct Shader *shader)
     unsigned int ambient_nr = 1;
 
     unsigned int i;
-    for (i = 0; i < mesh.num_textures; i++)
+    for (i = 0; i < mesh->num_textures; i++)
     {
         glActiveTexture(GL_TEXTURE0 + i); /* activate proper texture unit before binding */
         /* retrieve texture number (the N in diffuse_textureN) */
-        enum TextureType type = mesh.textures[i].type;
+        enum TextureType type = mesh->textures[i].type;
         unsigned int number = 0;
         if (type == DIFFUSE)
             number = diffuse_nr++;
@@ -130,14 +748,12 @@ void seel_mesh_draw(struct Mesh mesh, struct Shader *shader)
                 number);
 
         seel_shader_set_int(shader, uniform_name, i);
-        glBindTexture(GL_TEXTURE_2D, mesh.textures[i].id);
+        glBindTexture(GL_TEXTURE_2D, mesh->textures[i].id);
     }
+}
 
-    /* draw mesh */
-    glBindVertexArray(mesh.VAO);
-    glDrawElements(GL_TRIANGLES, mesh.num_indices, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
+void seel_mesh_unbind_material(struct Shader *shader)
+{
     seel_shader_set_int(shader, "material.diffuse1", 0);
     seel_shader_set_int(shader, "material.specular1", 0);
     seel_shader_set_int(shader, "material.ambient1", 0);
@@ -148,4 +764,100 @@ void seel_mesh_draw(struct Mesh mesh, struct Shader *shader)
     glActiveTexture(GL_TEXTURE0);
 }
 
+/* Index range of a detail level, clamped to the coarsest one the mesh has */
+struct MeshLod seel_mesh_lod(const struct Mesh *mesh, unsigned int lod)
+{
+    if (!mesh->num_lods)
+        return (struct MeshLod){0, mesh->num_indices, 0.0f};
+    return mesh->lods[lod < mesh->num_lods ? lod : mesh->num_lods - 1];
+}
+
+static void *seel_mesh_index_offset(const struct Mesh *mesh, unsigned int first_index)
+{
+    return (void *)(mesh->index_base + (uintptr_t)first_index * (mesh->index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t)));
+}
+
+void seel_mesh_draw_lod(struct Mesh *mesh, struct Shader *shader, unsigned int lod)
+{
+    seel_mesh_bind_material(mesh, shader);
+    seel_mesh_set_layout_uniforms(mesh, shader);
+
+    /* draw mesh */
+    struct MeshLod range = seel_mesh_lod(mesh, lod);
+    glBindVertexArray(mesh->VAO);
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.num_indices, mesh->index_type, seel_mesh_index_offset(mesh, range.first_index), mesh->base_vertex);
+    glBindVertexArray(0);
+
+    seel_mesh_unbind_material(shader);
+}
+
+/*
+ * Draws index ranges, given as counts, byte offsets into the index buffer
+ * and the base vertex of each, in one call
+ */
+void seel_mesh_draw_ranges(struct Mesh *mesh, struct Shader *shader, const GLsizei *counts, const void *const *offsets, const GLint *base_vertices,
+                           unsigned int num_ranges)
+{
+    if (!num_ranges)
+        return;
+
+    seel_mesh_bind_material(mesh, shader);
+    seel_mesh_set_layout_uniforms(mesh, shader);
+
+    glBindVertexArray(mesh->VAO);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, mesh->index_type, offsets, num_ranges, base_vertices);
+    glBindVertexArray(0);
+
+    seel_mesh_unbind_material(shader);
+}
+
+/* Draws the full detail level */
+void seel_mesh_draw(struct Mesh mesh, struct Shader *shader)
+{
+    seel_mesh_draw_lod(&mesh, shader, 0);
+}
+
+/*
+ * Draws `count` instances whose per-instance data (a CrowdInstance: world
+ * matrix, clip id and clip time) is read from instance_vbo at locations 7-12.
+ */
+void seel_mesh_draw_instanced(struct Mesh *mesh, struct Shader *shader, unsigned int instance_vbo, unsigned int instance_stride, unsigned int count)
+{
+    seel_mesh_bind_material(mesh, shader);
+    seel_mesh_set_layout_uniforms(mesh, shader);
+
+    glBindVertexArray(mesh->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+
+    unsigned int column;
+    for (column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(7 + column);
+        glVertexAttribPointer(7 + column, 4, GL_FLOAT, GL_FALSE, instance_stride, (void *)(column * sizeof(vec4)));
+        glVertexAttribDivisor(7 + column, 1);
+    }
+    glEnableVertexAttribArray(11);
+    glVertexAttribIPointer(11, 1, GL_INT, instance_stride, (void *)sizeof(mat4));
+    glVertexAttribDivisor(11, 1);
+    glEnableVertexAttribArray(12);
+    glVertexAttribPointer(12, 1, GL_FLOAT, GL_FALSE, instance_stride, (void *)(sizeof(mat4) + sizeof(int)));
+    glVertexAttribDivisor(12, 1);
+
+    /* baked bone textures are indexed by model bone, the vertices by palette slot */
+    glUniform1iv(glGetUniformLocation(shader->id, "meshBones"), mesh->num_palette_bones, (const int *)mesh->bone_palette);
+    seel_shader_set_int(shader, "meshBoneCount", mesh->num_palette_bones);
+
+    struct MeshLod range = seel_mesh_lod(mesh, 0);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.num_indices, mesh->index_type, seel_mesh_index_offset(mesh, range.first_index), count,
+                                      mesh->base_vertex);
+
+    /* leave the VAO as regular draws expect it */
+    for (column = 7; column <= 12; column++)
+        glDisableVertexAttribArray(column);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    seel_mesh_unbind_material(shader);
+}
+
 #endif /* MESH_H*/
\ No newline at end of file
@@ -0,0 +1,694 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cglm/cglm.h"
+#include "mesh.h"
+#include "model.h"
+
+/*
+ * .seelmesh: a model cooked by tools/cook_mesh.c from an Assimp import.
+ * The header is followed by 64 byte aligned sections: mesh table, texture
+ * table, per-mesh texture references, bone info, node hierarchy, mesh bone
+ * palettes, mesh bone bounds, meshlets, a string table, and finally the
+ * geometry: every mesh's vertices followed by its indices. Meshes are
+ * stored after optimization, bone palette remapping and splitting, packed
+ * in the vertex layout and index width seel_mesh_pack chose and with their
+ * bounds, so the loader maps the file and hands each mesh's vertex and
+ * index range straight to glBufferData. A mesh's detail levels and
+ * meshlets are ranges of its indices. Matrices are stored as 16 floats,
+ * column major, so the layout does not depend on cglm's alignment settings.
+ */
+#define SEEL_MESH_FILE_MAGIC "SEELMSH"
+#define SEEL_MESH_FILE_VERSION 5
+#define SEEL_MESH_FILE_EXTENSION ".seelmesh"
+#define SEEL_MESH_FILE_ALIGNMENT 64
+#define SEEL_MESH_FILE_ANIMATED 0x1
+
+struct MeshFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t vertex_size;  /* sizeof(struct Vertex) of the cooker, the stride of the full layout */
+    uint32_t meshlet_size; /* sizeof(struct Meshlet) of the cooker */
+    uint32_t flags;
+    uint32_t num_meshes;
+    uint32_t num_textures;
+    uint32_t num_texture_refs;
+    uint32_t num_bones;
+    uint32_t num_nodes;
+    uint32_t num_palette_bones;
+    uint32_t num_bone_bounds;
+    uint32_t strings_size;
+    uint64_t num_meshlets;
+    uint64_t geometry_size; /* in bytes */
+    char source_name[256]; /* model file the animations are loaded from */
+    uint64_t meshes_offset;
+    uint64_t textures_offset;
+    uint64_t texture_refs_offset;
+    uint64_t bones_offset;
+    uint64_t nodes_offset;
+    uint64_t palettes_offset;
+    uint64_t bone_bounds_offset;
+    uint64_t meshlets_offset;
+    uint64_t strings_offset;
+    uint64_t geometry_offset;
+    uint64_t file_size;
+};
+
+/* struct Bounds as floats, box min and max then the sphere */
+struct MeshFileBounds
+{
+    float aabb[6];
+    float sphere[4];
+};
+
+/*
+ * Ranges are in elements of the respective section, the vertex and index
+ * offsets in bytes into the geometry; indices are mesh local.
+ */
+struct MeshFileMesh
+{
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint32_t num_vertices;
+    uint32_t num_indices;
+    uint32_t layout; /* enum VertexLayout the vertices are packed in */
+    uint32_t skinned;
+    uint32_t index_size; /* 2 or 4 bytes */
+    float position_offset[3];
+    float position_scale[3];
+    struct MeshFileBounds bounds;
+    struct MeshFileBounds rigid_bounds;
+    uint32_t first_bone_bounds;
+    uint32_t num_bone_bounds;
+    uint32_t first_texture_ref;
+    uint32_t num_textures;
+    uint32_t first_palette_bone;
+    uint32_t num_palette_bones;
+    uint32_t first_meshlet;
+    uint32_t num_meshlets;
+    uint32_t num_lods;
+    uint32_t lod_first_index[MAX_MESH_LODS]; /* into the mesh's indices */
+    uint32_t lod_num_indices[MAX_MESH_LODS];
+    float lod_error[MAX_MESH_LODS];
+};
+
+struct MeshFileTexture
+{
+    uint32_t type;
+    uint32_t name_offset; /* into the string table, relative to the model directory */
+};
+
+struct MeshFileBone
+{
+    char name[MAX_BONE_NAME_LEN];
+    int32_t id;
+    float offset[16];
+};
+
+struct MeshFileNode
+{
+    char name[MAX_BONE_NAME_LEN];
+    int32_t parent;
+    float transformation[16];
+};
+
+/* Path of the cooked file next to a source model: the extension is replaced */
+void seel_mesh_file_path(const char *source_path, char *dest, size_t size)
+{
+    const char *slash = strrchr(source_path, '/');
+    const char *dot = strrchr(source_path, '.');
+    size_t length = dot && (!slash || dot > slash) ? (size_t)(dot - source_path) : strlen(source_path);
+    snprintf(dest, size, "%.*s%s", (int)length, source_path, SEEL_MESH_FILE_EXTENSION);
+}
+
+static uint64_t seel_mesh_file_align(uint64_t offset)
+{
+    return (offset + SEEL_MESH_FILE_ALIGNMENT - 1) / SEEL_MESH_FILE_ALIGNMENT * SEEL_MESH_FILE_ALIGNMENT;
+}
+
+static bool seel_mesh_file_put(FILE *file, uint64_t offset, const void *data, size_t size)
+{
+    if (!size)
+        return true;
+    return fseek(file, (long)offset, SEEK_SET) == 0 && fwrite(data, 1, size, file) == size;
+}
+
+static void seel_mesh_file_store_bounds(struct MeshFileBounds *dest, const struct Bounds *bounds)
+{
+    memcpy(dest->aabb, bounds->aabb[0], sizeof(float) * 3);
+    memcpy(dest->aabb + 3, bounds->aabb[1], sizeof(float) * 3);
+    memcpy(dest->sphere, bounds->sphere, sizeof(dest->sphere));
+}
+
+static void seel_mesh_file_load_bounds(struct Bounds *dest, const struct MeshFileBounds *bounds)
+{
+    memcpy(dest->aabb[0], bounds->aabb, sizeof(float) * 3);
+    memcpy(dest->aabb[1], bounds->aabb + 3, sizeof(float) * 3);
+    memcpy(dest->sphere, bounds->sphere, sizeof(bounds->sphere));
+}
+
+static int seel_model_find_texture(const struct Model *model, const struct Texture *texture)
+{
+    unsigned int i;
+    for (i = 0; i < model->num_textures; i++)
+    {
+        if (model->textures_loaded[i].type == texture->type && !strcmp(model->textures_loaded[i].name, texture->name))
+            return (int)i;
+    }
+    return -1;
+}
+
+/*
+ * Writes the model's meshes as they are after import, packed like
+ * seel_mesh_setup would upload them; usually run by the cooker on a
+ * cpu_only import. Cooked models no longer hold struct Vertex arrays and
+ * cannot be written again.
+ */
+bool seel_mesh_file_write(const struct Model *model, const char *path)
+{
+    if (model->cooked_data)
+    {
+        fprintf(stderr, "Cannot write cooked model %s again, cook its source instead!\n", model->name);
+        return false;
+    }
+
+    struct MeshFileHeader header;
+    memset(&header, 0, sizeof(struct MeshFileHeader));
+    memcpy(header.magic, SEEL_MESH_FILE_MAGIC, sizeof(SEEL_MESH_FILE_MAGIC));
+    header.version = SEEL_MESH_FILE_VERSION;
+    header.vertex_size = sizeof(struct Vertex);
+    header.meshlet_size = sizeof(struct Meshlet);
+    header.flags = model->animated ? SEEL_MESH_FILE_ANIMATED : 0;
+    header.num_meshes = model->num_meshes;
+    header.num_textures = model->num_textures;
+    header.num_bones = model->bone_counter;
+    header.num_nodes = model->nodes ? model->num_nodes : 0;
+    snprintf(header.source_name, sizeof(header.source_name), "%s", model->name);
+
+    unsigned int i, j;
+    for (i = 0; i < model->num_meshes; i++)
+    {
+        header.num_texture_refs += model->meshes[i].num_textures;
+        header.num_palette_bones += model->meshes[i].num_palette_bones;
+        header.num_bone_bounds += model->meshes[i].num_bone_bounds;
+        header.num_meshlets += model->meshes[i].num_meshlets;
+    }
+    for (i = 0; i < model->num_textures; i++)
+        header.strings_size += strlen(model->textures_loaded[i].name) + 1;
+
+    header.meshes_offset = seel_mesh_file_align(sizeof(struct MeshFileHeader));
+    header.textures_offset = seel_mesh_file_align(header.meshes_offset + sizeof(struct MeshFileMesh) * header.num_meshes);
+    header.texture_refs_offset = seel_mesh_file_align(header.textures_offset + sizeof(struct MeshFileTexture) * header.num_textures);
+    header.bones_offset = seel_mesh_file_align(header.texture_refs_offset + sizeof(uint32_t) * header.num_texture_refs);
+    header.nodes_offset = seel_mesh_file_align(header.bones_offset + sizeof(struct MeshFileBone) * header.num_bones);
+    header.palettes_offset = seel_mesh_file_align(header.nodes_offset + sizeof(struct MeshFileNode) * header.num_nodes);
+    header.bone_bounds_offset = seel_mesh_file_align(header.palettes_offset + sizeof(uint32_t) * header.num_palette_bones);
+    header.meshlets_offset = seel_mesh_file_align(header.bone_bounds_offset + sizeof(struct MeshFileBounds) * header.num_bone_bounds);
+    header.strings_offset = seel_mesh_file_align(header.meshlets_offset + sizeof(struct Meshlet) * header.num_meshlets);
+    header.geometry_offset = seel_mesh_file_align(header.strings_offset + header.strings_size);
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Could not open %s for writing!\n", path);
+        return false;
+    }
+
+    bool ok = true;
+    uint32_t string_offset = 0;
+    for (i = 0; i < model->num_textures && ok; i++)
+    {
+        const struct Texture *texture = &model->textures_loaded[i];
+        struct MeshFileTexture entry = {(uint32_t)texture->type, string_offset};
+        size_t length = strlen(texture->name) + 1;
+        ok = seel_mesh_file_put(file, header.textures_offset + sizeof(struct MeshFileTexture) * i, &entry, sizeof(entry)) &&
+             seel_mesh_file_put(file, header.strings_offset + string_offset, texture->name, length);
+        string_offset += length;
+    }
+
+    for (i = 0; i < model->bone_counter && ok; i++)
+    {
+        struct MeshFileBone bone;
+        memset(&bone, 0, sizeof(struct MeshFileBone));
+        memcpy(bone.name, model->bone_info[i].name, sizeof(bone.name));
+        bone.id = model->bone_info[i].id;
+        memcpy(bone.offset, model->bone_info[i].offset, sizeof(bone.offset));
+        ok = seel_mesh_file_put(file, header.bones_offset + sizeof(struct MeshFileBone) * i, &bone, sizeof(bone));
+    }
+
+    for (i = 0; i < header.num_nodes && ok; i++)
+    {
+        struct MeshFileNode node;
+        memset(&node, 0, sizeof(struct MeshFileNode));
+        memcpy(node.name, model->nodes[i].name, sizeof(node.name));
+        node.parent = model->nodes[i].parent;
+        memcpy(node.transformation, model->nodes[i].transformation, sizeof(node.transformation));
+        ok = seel_mesh_file_put(file, header.nodes_offset + sizeof(struct MeshFileNode) * i, &node, sizeof(node));
+    }
+
+    struct MeshFileMesh entry;
+    memset(&entry, 0, sizeof(struct MeshFileMesh));
+    for (i = 0; i < model->num_meshes && ok; i++)
+    {
+        const struct Mesh *mesh = &model->meshes[i];
+
+        /* the copy takes the layout, quantization and index type the packing picks */
+        struct Mesh packed = *mesh;
+        unsigned char *packed_vertices;
+        uint16_t *short_indices;
+        seel_mesh_pack(&packed, &packed_vertices, &short_indices);
+        size_t vertex_bytes = seel_mesh_vertex_buffer_size(&packed);
+        size_t index_bytes = seel_mesh_index_buffer_size(&packed);
+
+        entry.vertex_offset = seel_mesh_file_align(header.geometry_size);
+        entry.index_offset = seel_mesh_file_align(entry.vertex_offset + vertex_bytes);
+        header.geometry_size = entry.index_offset + index_bytes;
+        entry.num_vertices = mesh->num_vertices;
+        entry.num_indices = mesh->num_indices;
+        entry.layout = packed.layout;
+        entry.skinned = packed.skinned;
+        entry.index_size = packed.index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+        memcpy(entry.position_offset, packed.position_offset, sizeof(entry.position_offset));
+        memcpy(entry.position_scale, packed.position_scale, sizeof(entry.position_scale));
+        seel_mesh_file_store_bounds(&entry.bounds, &mesh->bounds);
+        seel_mesh_file_store_bounds(&entry.rigid_bounds, &mesh->rigid_bounds);
+        entry.num_bone_bounds = mesh->num_bone_bounds;
+        entry.num_textures = mesh->num_textures;
+        entry.num_palette_bones = mesh->num_palette_bones;
+        entry.num_meshlets = mesh->num_meshlets;
+        entry.num_lods = mesh->num_lods;
+        for (j = 0; j < MAX_MESH_LODS; j++)
+        {
+            entry.lod_first_index[j] = j < mesh->num_lods ? mesh->lods[j].first_index : 0;
+            entry.lod_num_indices[j] = j < mesh->num_lods ? mesh->lods[j].num_indices : 0;
+            entry.lod_error[j] = j < mesh->num_lods ? mesh->lods[j].error : 0.0f;
+        }
+
+        for (j = 0; j < mesh->num_textures && ok; j++)
+        {
+            int texture = seel_model_find_texture(model, &mesh->textures[j]);
+            uint32_t ref = texture < 0 ? 0 : (uint32_t)texture;
+            ok = texture >= 0 && seel_mesh_file_put(file, header.texture_refs_offset + sizeof(uint32_t) * (entry.first_texture_ref + j), &ref, sizeof(ref));
+        }
+
+        for (j = 0; j < mesh->num_bone_bounds && ok; j++)
+        {
+            struct MeshFileBounds bone_bounds;
+            seel_mesh_file_store_bounds(&bone_bounds, &mesh->bone_bounds[j]);
+            ok = seel_mesh_file_put(file, header.bone_bounds_offset + sizeof(struct MeshFileBounds) * (entry.first_bone_bounds + j), &bone_bounds, sizeof(bone_bounds));
+        }
+
+        ok = ok &&
+             seel_mesh_file_put(file, header.meshes_offset + sizeof(struct MeshFileMesh) * i, &entry, sizeof(entry)) &&
+             seel_mesh_file_put(file, header.palettes_offset + sizeof(uint32_t) * entry.first_palette_bone, mesh->bone_palette, sizeof(uint32_t) * mesh->num_palette_bones) &&
+             seel_mesh_file_put(file, header.meshlets_offset + sizeof(struct Meshlet) * entry.first_meshlet, mesh->meshlets, sizeof(struct Meshlet) * mesh->num_meshlets) &&
+             seel_mesh_file_put(file, header.geometry_offset + entry.vertex_offset, packed_vertices ? (void *)packed_vertices : (void *)mesh->vertices, vertex_bytes) &&
+             seel_mesh_file_put(file, header.geometry_offset + entry.index_offset, short_indices ? (void *)short_indices : (void *)mesh->indices, index_bytes);
+        free(packed_vertices);
+        free(short_indices);
+
+        entry.first_bone_bounds += mesh->num_bone_bounds;
+        entry.first_texture_ref += mesh->num_textures;
+        entry.first_palette_bone += mesh->num_palette_bones;
+        entry.first_meshlet += mesh->num_meshlets;
+    }
+
+    /* the geometry's size is known once every mesh is packed */
+    header.file_size = header.geometry_offset + header.geometry_size;
+    ok = ok && seel_mesh_file_put(file, 0, &header, sizeof(struct MeshFileHeader));
+
+    if (fclose(file) != 0)
+        ok = false;
+    if (!ok)
+    {
+        fprintf(stderr, "Failed to write cooked mesh %s!\n", path);
+        remove(path);
+    }
+    return ok;
+}
+
+static bool seel_mesh_file_section_fits(const struct MeshFileHeader *header, uint64_t offset, uint64_t count, uint64_t size)
+{
+    return offset <= header->file_size && count <= (header->file_size - offset) / (size ? size : 1);
+}
+
+static bool seel_mesh_file_validate(const struct MeshFileHeader *header, size_t file_size)
+{
+    if (file_size < sizeof(struct MeshFileHeader) || memcmp(header->magic, SEEL_MESH_FILE_MAGIC, sizeof(SEEL_MESH_FILE_MAGIC)) != 0)
+        return false;
+    if (header->version != SEEL_MESH_FILE_VERSION || header->vertex_size != sizeof(struct Vertex) || header->meshlet_size != sizeof(struct Meshlet) ||
+        header->file_size != file_size)
+        return false;
+    if (header->num_bones > MAX_MODEL_BONES)
+        return false;
+
+    return seel_mesh_file_section_fits(header, header->meshes_offset, header->num_meshes, sizeof(struct MeshFileMesh)) &&
+           seel_mesh_file_section_fits(header, header->textures_offset, header->num_textures, sizeof(struct MeshFileTexture)) &&
+           seel_mesh_file_section_fits(header, header->texture_refs_offset, header->num_texture_refs, sizeof(uint32_t)) &&
+           seel_mesh_file_section_fits(header, header->bones_offset, header->num_bones, sizeof(struct MeshFileBone)) &&
+           seel_mesh_file_section_fits(header, header->nodes_offset, header->num_nodes, sizeof(struct MeshFileNode)) &&
+           seel_mesh_file_section_fits(header, header->palettes_offset, header->num_palette_bones, sizeof(uint32_t)) &&
+           seel_mesh_file_section_fits(header, header->bone_bounds_offset, header->num_bone_bounds, sizeof(struct MeshFileBounds)) &&
+           seel_mesh_file_section_fits(header, header->meshlets_offset, header->num_meshlets, sizeof(struct Meshlet)) &&
+           seel_mesh_file_section_fits(header, header->strings_offset, header->strings_size, 1) &&
+           seel_mesh_file_section_fits(header, header->geometry_offset, header->geometry_size, 1) &&
+           header->geometry_offset % SEEL_MESH_FILE_ALIGNMENT == 0;
+}
+
+static bool seel_mesh_file_lods_fit(const struct MeshFileMesh *entry)
+{
+    uint32_t i;
+    for (i = 0; i < entry->num_lods; i++)
+    {
+        if ((uint64_t)entry->lod_first_index[i] + entry->lod_num_indices[i] > entry->num_indices)
+            return false;
+    }
+    return true;
+}
+
+/* Every index must name one of the mesh's vertices before it reaches the GPU */
+static bool seel_mesh_file_indices_fit(const unsigned char *indices, uint32_t index_size, uint32_t num_indices, uint32_t num_vertices)
+{
+    uint32_t max_index = 0;
+    uint32_t i;
+    if (index_size == sizeof(uint16_t))
+    {
+        const uint16_t *short_indices = (const uint16_t *)indices;
+        for (i = 0; i < num_indices; i++)
+            max_index = short_indices[i] > max_index ? short_indices[i] : max_index;
+    }
+    else
+    {
+        const uint32_t *int_indices = (const uint32_t *)indices;
+        for (i = 0; i < num_indices; i++)
+            max_index = int_indices[i] > max_index ? int_indices[i] : max_index;
+    }
+    return !num_indices || max_index < num_vertices;
+}
+
+static bool seel_mesh_file_meshlets_fit(const struct MeshFileMesh *entry, const struct Meshlet *meshlets)
+{
+    uint32_t i;
+    for (i = 0; i < entry->num_meshlets; i++)
+    {
+        const struct Meshlet *meshlet = &meshlets[entry->first_meshlet + i];
+        if ((uint64_t)meshlet->first_index + meshlet->num_indices > entry->num_indices)
+            return false;
+    }
+    return true;
+}
+
+/* Ranges are compared as count <= total - first, so crafted 64 bit firsts cannot wrap around */
+static bool seel_mesh_file_range_fits(uint64_t first, uint64_t count, uint64_t total)
+{
+    return first <= total && count <= total - first;
+}
+
+/* The packed format must be one seel_mesh_setup_layout_attributes knows, stored aligned for its widest element */
+static bool seel_mesh_file_format_fits(const struct MeshFileMesh *entry)
+{
+    if (entry->layout > VERTEX_LAYOUT_QUANTIZED || entry->skinned > 1 || (entry->layout == VERTEX_LAYOUT_FULL && !entry->skinned))
+        return false;
+    if (entry->index_size != sizeof(uint16_t) && entry->index_size != sizeof(uint32_t))
+        return false;
+    if (entry->index_size == sizeof(uint16_t) && entry->num_vertices > UINT16_MAX + 1)
+        return false;
+    return entry->vertex_offset % sizeof(float) == 0 && entry->index_offset % entry->index_size == 0;
+}
+
+static bool seel_mesh_file_mesh_fits(const struct MeshFileHeader *header, const struct MeshFileMesh *entry)
+{
+    uint64_t stride = seel_vertex_format((enum VertexLayout)entry->layout, entry->skinned).stride;
+    return seel_mesh_file_range_fits(entry->vertex_offset, stride * entry->num_vertices, header->geometry_size) &&
+           seel_mesh_file_range_fits(entry->index_offset, (uint64_t)entry->index_size * entry->num_indices, header->geometry_size) &&
+           (uint64_t)entry->first_bone_bounds + entry->num_bone_bounds <= header->num_bone_bounds &&
+           (uint64_t)entry->first_texture_ref + entry->num_textures <= header->num_texture_refs &&
+           (uint64_t)entry->first_palette_bone + entry->num_palette_bones <= header->num_palette_bones &&
+           (uint64_t)entry->first_meshlet + entry->num_meshlets <= header->num_meshlets &&
+           entry->num_palette_bones <= MAX_BONES && entry->num_lods <= MAX_MESH_LODS && seel_mesh_file_lods_fit(entry);
+}
+
+/*
+ * Reads a cooked model by mapping the file: meshes come with their layout
+ * and bounds, their packed vertex and index ranges go to GL as stored and
+ * stay in the mapping, which lives as long as the model. Indices are only
+ * scanned to check they stay within their mesh. Returns false, leaving the model
+ * empty, when the file is missing, from another version or damaged.
+ * Without upload nothing touches GL, like seel_model_import; with it the
+ * texture objects are generated for seel_model_load_textures to fill.
+ */
+bool seel_model_read_cooked(const char *path, struct Model *model, bool upload)
+{
+    memset(model, 0, sizeof(struct Model));
+    model->cpu_only = !upload;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct MeshFileHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    unsigned char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map cooked mesh %s!\n", path);
+        return false;
+    }
+
+    const struct MeshFileHeader *header = (const struct MeshFileHeader *)data;
+    if (!seel_mesh_file_validate(header, size))
+    {
+        fprintf(stderr, "Cooked mesh %s is outdated or damaged, cook it again!\n", path);
+        munmap(data, size);
+        return false;
+    }
+
+    const struct MeshFileMesh *entries = (const struct MeshFileMesh *)(data + header->meshes_offset);
+    const struct MeshFileTexture *textures = (const struct MeshFileTexture *)(data + header->textures_offset);
+    const uint32_t *texture_refs = (const uint32_t *)(data + header->texture_refs_offset);
+    const struct MeshFileBone *bones = (const struct MeshFileBone *)(data + header->bones_offset);
+    const struct MeshFileNode *nodes = (const struct MeshFileNode *)(data + header->nodes_offset);
+    const uint32_t *palettes = (const uint32_t *)(data + header->palettes_offset);
+    const char *strings = (const char *)(data + header->strings_offset);
+    const struct MeshFileBounds *bone_bounds = (const struct MeshFileBounds *)(data + header->bone_bounds_offset);
+    const unsigned char *geometry = data + header->geometry_offset;
+    struct Meshlet *meshlets = (struct Meshlet *)(data + header->meshlets_offset);
+
+    unsigned int i, j;
+    bool valid = true;
+    for (i = 0; i < header->num_meshes && valid; i++)
+        valid = seel_mesh_file_format_fits(&entries[i]) && seel_mesh_file_mesh_fits(header, &entries[i]) && seel_mesh_file_meshlets_fit(&entries[i], meshlets) &&
+                seel_mesh_file_indices_fit(&geometry[entries[i].index_offset], entries[i].index_size, entries[i].num_indices, entries[i].num_vertices);
+    for (i = 0; i < header->num_texture_refs && valid; i++)
+        valid = texture_refs[i] < header->num_textures;
+    for (i = 0; i < header->num_textures && valid; i++)
+        valid = textures[i].name_offset < header->strings_size;
+    for (i = 0; i < header->num_palette_bones && valid; i++)
+        valid = palettes[i] < header->num_bones;
+    if (!valid)
+    {
+        fprintf(stderr, "Cooked mesh %s has an invalid mesh table!\n", path);
+        munmap(data, size);
+        return false;
+    }
+
+    model->cooked_data = data;
+    model->cooked_size = size;
+    model->animated = header->flags & SEEL_MESH_FILE_ANIMATED;
+    snprintf(model->name, sizeof(model->name), "%.*s", (int)strnlen(header->source_name, sizeof(header->source_name)), header->source_name);
+    const char *slash = strrchr(path, '/');
+    if (slash)
+        snprintf(model->directory, sizeof(model->directory), "%.*s", (int)(slash - path + 1), path);
+
+    model->textures_loaded = malloc(sizeof(struct Texture) * (header->num_textures ? header->num_textures : 1));
+    model->nodes = malloc(sizeof(struct ModelNode) * (header->num_nodes ? header->num_nodes : 1));
+    model->meshes = malloc(sizeof(struct Mesh) * (header->num_meshes ? header->num_meshes : 1));
+    if (!model->textures_loaded || !model->nodes || !model->meshes)
+    {
+        fprintf(stderr, "Failed to allocate memory for cooked model!\n");
+        free(model->textures_loaded);
+        free(model->nodes);
+        free(model->meshes);
+        munmap(data, size);
+        memset(model, 0, sizeof(struct Model));
+        return false;
+    }
+
+    for (i = 0; i < header->num_textures; i++)
+    {
+        const char *name = &strings[textures[i].name_offset];
+        size_t name_length = strnlen(name, header->strings_size - textures[i].name_offset);
+        struct Texture texture = {.type = (enum TextureType)textures[i].type};
+        if (upload)
+            glGenTextures(1, &texture.id);
+        snprintf(texture.name, sizeof(texture.name), "%.*s", (int)(name_length < sizeof(texture.name) ? name_length : sizeof(texture.name) - 1), name);
+        model->textures_loaded[model->num_textures++] = texture;
+    }
+
+    for (i = 0; i < header->num_bones; i++)
+    {
+        struct BoneInfo *info = &model->bone_info[i];
+        snprintf(info->name, sizeof(info->name), "%.*s", (int)strnlen(bones[i].name, sizeof(bones[i].name)), bones[i].name);
+        info->id = bones[i].id;
+        memcpy(info->offset, bones[i].offset, sizeof(bones[i].offset));
+    }
+    model->bone_counter = header->num_bones;
+
+    for (i = 0; i < header->num_nodes; i++)
+    {
+        struct ModelNode *node = &model->nodes[i];
+        snprintf(node->name, sizeof(node->name), "%.*s", (int)strnlen(nodes[i].name, sizeof(nodes[i].name)), nodes[i].name);
+        node->parent = nodes[i].parent < (int32_t)i ? nodes[i].parent : -1;
+        memcpy(node->transformation, nodes[i].transformation, sizeof(nodes[i].transformation));
+    }
+    model->num_nodes = header->num_nodes;
+
+    for (i = 0; i < header->num_meshes; i++)
+    {
+        const struct MeshFileMesh *entry = &entries[i];
+        struct Texture *mesh_textures = malloc(sizeof(struct Texture) * (entry->num_textures ? entry->num_textures : 1));
+        if (!mesh_textures)
+        {
+            fprintf(stderr, "Failed to allocate memory for cooked mesh textures!\n");
+            continue;
+        }
+        for (j = 0; j < entry->num_textures; j++)
+        {
+            mesh_textures[j] = model->textures_loaded[texture_refs[entry->first_texture_ref + j]];
+        }
+
+        struct Mesh mesh = {0};
+        mesh.packed_vertices = &geometry[entry->vertex_offset];
+        mesh.packed_indices = &geometry[entry->index_offset];
+        mesh.textures = mesh_textures;
+        mesh.num_vertices = entry->num_vertices;
+        mesh.num_indices = entry->num_indices;
+        mesh.num_textures = entry->num_textures;
+        mesh.layout = (enum VertexLayout)entry->layout;
+        mesh.skinned = entry->skinned;
+        memcpy(mesh.position_offset, entry->position_offset, sizeof(entry->position_offset));
+        memcpy(mesh.position_scale, entry->position_scale, sizeof(entry->position_scale));
+        mesh.index_type = entry->index_size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        seel_mesh_file_load_bounds(&mesh.bounds, &entry->bounds);
+        seel_mesh_file_load_bounds(&mesh.rigid_bounds, &entry->rigid_bounds);
+        if (entry->num_bone_bounds && (mesh.bone_bounds = malloc(sizeof(struct Bounds) * entry->num_bone_bounds)))
+        {
+            for (j = 0; j < entry->num_bone_bounds; j++)
+                seel_mesh_file_load_bounds(&mesh.bone_bounds[j], &bone_bounds[entry->first_bone_bounds + j]);
+            mesh.num_bone_bounds = entry->num_bone_bounds;
+        }
+        else if (entry->num_bone_bounds)
+            fprintf(stderr, "Failed to allocate memory for mesh bone bounds!\n");
+        if (upload)
+            seel_mesh_setup(&mesh);
+
+        for (j = 0; j < entry->num_lods; j++)
+            mesh.lods[j] = (struct MeshLod){entry->lod_first_index[j], entry->lod_num_indices[j], entry->lod_error[j]};
+        mesh.num_lods = entry->num_lods;
+        mesh.meshlets = &meshlets[entry->first_meshlet];
+        mesh.num_meshlets = entry->num_meshlets;
+        seel_mesh_set_bone_palette(&mesh, &palettes[entry->first_palette_bone], entry->num_palette_bones);
+        model->meshes[model->num_meshes++] = mesh;
+    }
+    seel_model_update_bounds(model);
+
+    return true;
+}
+
+/* Loads a cooked model and decodes its textures on pool like seel_model_load */
+bool seel_model_load_cooked(const char *path, struct Model *model, struct JobPool *pool)
+{
+    if (!seel_model_read_cooked(path, model, true))
+        return false;
+
+    seel_model_load_textures(model, pool);
+    return true;
+}
+
+/* True when both files exist and the source was modified after the cooked file was written */
+static bool seel_mesh_file_stale(const char *source_path, const char *cooked_path)
+{
+    struct stat source, cooked;
+    if (stat(source_path, &source) != 0 || stat(cooked_path, &cooked) != 0)
+        return false;
+
+    if (source.st_mtim.tv_sec != cooked.st_mtim.tv_sec)
+        return source.st_mtim.tv_sec > cooked.st_mtim.tv_sec;
+    return source.st_mtim.tv_nsec > cooked.st_mtim.tv_nsec;
+}
+
+/*
+ * Imports the source like tools/cook_mesh.c and replaces the cooked file
+ * with it, returning the cpu_only import. The new file is renamed over the
+ * old one, so models still mapping the old file keep reading it.
+ */
+static struct Model seel_mesh_file_recook(const char *path, const char *cooked_path)
+{
+    struct Model model = seel_model_import(path, false);
+    if (!model.num_meshes)
+        return model;
+
+    char temp_path[MAX_DIRECTORY_LEN + 4];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", cooked_path);
+    if (!seel_mesh_file_write(&model, temp_path) || rename(temp_path, cooked_path) != 0)
+    {
+        fprintf(stderr, "Failed to re-cook %s!\n", cooked_path);
+        unlink(temp_path);
+    }
+    return model;
+}
+
+/* CPU side of seel_model_load_cached: nothing is uploaded and texture ids stay 0 */
+struct Model seel_model_import_cached(const char *path)
+{
+    struct Model model;
+    char cooked_path[MAX_DIRECTORY_LEN];
+    seel_mesh_file_path(path, cooked_path, sizeof(cooked_path));
+    if (seel_mesh_file_stale(path, cooked_path))
+        return seel_mesh_file_recook(path, cooked_path);
+    if (seel_model_read_cooked(cooked_path, &model, false))
+        return model;
+
+    return seel_model_import(path, false);
+}
+
+/*
+ * Prefers the cooked file next to path and falls back to importing path
+ * through Assimp. A cooked file older than path is cooked again first.
+ */
+struct Model seel_model_load_cached(const char *path, struct JobPool *pool)
+{
+    struct Model model;
+    char cooked_path[MAX_DIRECTORY_LEN];
+    seel_mesh_file_path(path, cooked_path, sizeof(cooked_path));
+    if (seel_mesh_file_stale(path, cooked_path))
+    {
+        struct Model cooked = seel_mesh_file_recook(path, cooked_path);
+        seel_model_destroy(&cooked);
+        if (seel_mesh_file_stale(path, cooked_path))
+            return seel_model_load(path, pool);
+    }
+    if (seel_model_load_cooked(cooked_path, &model, pool))
+        return model;
+
+    return seel_model_load(path, pool);
+}
+
+#endif /* MESH_FILE_H */
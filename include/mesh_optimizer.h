@@ -0,0 +1,488 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "cglm/cglm.h"
+#include "mesh.h"
+
+/*
+ * Mesh optimizer, run on every imported mesh and therefore baked into
+ * cooked files. The stages are, in order:
+ * - weld bitwise identical vertices
+ * - reorder triangles for the post-transform vertex cache (Forsyth's
+ *   scoring)
+ * - reorder clusters of those triangles outside-in against overdraw
+ *   (Sander et al.)
+ * - renumber vertices in first-use order for fetch locality
+ * All stages work on the CPU struct Vertex arrays, before any upload.
+ */
+
+#define SEEL_OPTIMIZER_CACHE_SIZE 32 /* LRU cache Forsyth's scores model */
+#define SEEL_ANALYZE_CACHE_SIZE 16   /* FIFO cache the statistics simulate */
+
+/* Post-transform cache efficiency of an index order */
+struct MeshCacheStats
+{
+    float acmr; /* vertex shader invocations per triangle: 0.5 is ideal, 3 is no reuse */
+    float atvr; /* vertex shader invocations per vertex: 1 is ideal */
+};
+
+struct MeshOptimizeReport
+{
+    unsigned int num_triangles;
+    unsigned int vertices_before;
+    unsigned int vertices_after;
+    struct MeshCacheStats before;
+    struct MeshCacheStats after;
+};
+
+/* Simulates a FIFO post-transform cache of cache_size entries over the triangles */
+struct MeshCacheStats seel_mesh_analyze_cache(const unsigned int *indices, unsigned int num_indices, unsigned int num_vertices, unsigned int cache_size)
+{
+    struct MeshCacheStats stats = {0.0f, 0.0f};
+    if (num_indices < 3 || !num_vertices)
+        return stats;
+
+    /* a vertex is cached while fewer than cache_size misses happened since its own */
+    unsigned int *missed_at = malloc(sizeof(unsigned int) * num_vertices);
+    if (!missed_at)
+        return stats;
+
+    unsigned int misses = 0, i;
+    for (i = 0; i < num_vertices; i++)
+        missed_at[i] = UINT32_MAX;
+    for (i = 0; i < num_indices; i++)
+    {
+        unsigned int vertex = indices[i];
+        if (missed_at[vertex] == UINT32_MAX || misses - missed_at[vertex] >= cache_size)
+            missed_at[vertex] = misses++;
+    }
+    free(missed_at);
+
+    stats.acmr = (float)misses / (float)(num_indices / 3);
+    stats.atvr = (float)misses / (float)num_vertices;
+    return stats;
+}
+
+static uint32_t seel_vertex_hash(const struct Vertex *vertex)
+{
+    /* FNV-1a over the vertex bytes; importers clear padding, so equal vertices hash equally */
+    const unsigned char *bytes = (const unsigned char *)vertex;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(struct Vertex); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+/* Merges bitwise identical vertices, keeping first occurrences in order; returns the new vertex count */
+unsigned int seel_mesh_weld(struct Vertex *vertices, unsigned int num_vertices, unsigned int *indices, unsigned int num_indices)
+{
+    unsigned int table_size = 1;
+    while (table_size < num_vertices * 2)
+        table_size *= 2;
+
+    unsigned int *table = malloc(sizeof(unsigned int) * table_size);
+    unsigned int *remap = malloc(sizeof(unsigned int) * (num_vertices ? num_vertices : 1));
+    if (!table || !remap)
+    {
+        fprintf(stderr, "Failed to allocate memory for vertex welding!\n");
+        free(table);
+        free(remap);
+        return num_vertices;
+    }
+    memset(table, 0xff, sizeof(unsigned int) * table_size);
+
+    unsigned int unique = 0, i;
+    for (i = 0; i < num_vertices; i++)
+    {
+        unsigned int slot = seel_vertex_hash(&vertices[i]) & (table_size - 1);
+        while (table[slot] != UINT32_MAX && memcmp(&vertices[table[slot]], &vertices[i], sizeof(struct Vertex)) != 0)
+            slot = (slot + 1) & (table_size - 1);
+
+        if (table[slot] == UINT32_MAX)
+        {
+            /* unique vertices only move towards the front, so the table keeps pointing at valid copies */
+            vertices[unique] = vertices[i];
+            table[slot] = unique++;
+        }
+        remap[i] = table[slot];
+    }
+
+    for (i = 0; i < num_indices; i++)
+        indices[i] = remap[indices[i]];
+
+    free(table);
+    free(remap);
+    return unique;
+}
+
+static float seel_forsyth_vertex_score(int cache_position, unsigned int remaining)
+{
+    if (!remaining)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cache_position >= 0)
+    {
+        /* the last triangle's vertices get a fixed score so the next one does not reuse them all */
+        if (cache_position < 3)
+            score = 0.75f;
+        else
+            score = powf(1.0f - (float)(cache_position - 3) / (SEEL_OPTIMIZER_CACHE_SIZE - 3), 1.5f);
+    }
+    /* vertices with few triangles left are finished first, so they leave the cache for good */
+    return score + 2.0f / sqrtf((float)remaining);
+}
+
+/* Reorders triangles for vertex reuse with Tom Forsyth's linear-speed cache optimization */
+void seel_mesh_optimize_vertex_cache(unsigned int *indices, unsigned int num_indices, unsigned int num_vertices)
+{
+    unsigned int num_triangles = num_indices / 3;
+    if (num_triangles < 2 || !num_vertices)
+        return;
+
+    unsigned int *remaining = calloc(num_vertices, sizeof(unsigned int));
+    unsigned int *offsets = malloc(sizeof(unsigned int) * (num_vertices + 1));
+    unsigned int *adjacency = malloc(sizeof(unsigned int) * num_triangles * 3);
+    int *cache_position = malloc(sizeof(int) * num_vertices);
+    float *vertex_score = malloc(sizeof(float) * num_vertices);
+    float *triangle_score = malloc(sizeof(float) * num_triangles);
+    bool *emitted = calloc(num_triangles, sizeof(bool));
+    unsigned int *output = malloc(sizeof(unsigned int) * num_triangles * 3);
+    if (!remaining || !offsets || !adjacency || !cache_position || !vertex_score || !triangle_score || !emitted || !output)
+    {
+        fprintf(stderr, "Failed to allocate memory for vertex cache optimization!\n");
+        goto cleanup;
+    }
+
+    unsigned int i, j;
+    for (i = 0; i < num_triangles * 3; i++)
+        remaining[indices[i]]++;
+    offsets[0] = 0;
+    for (i = 0; i < num_vertices; i++)
+        offsets[i + 1] = offsets[i] + remaining[i];
+
+    /* triangles of every vertex; remaining doubles as the fill cursor and is restored by the pass */
+    for (i = 0; i < num_vertices; i++)
+        remaining[i] = 0;
+    for (i = 0; i < num_triangles; i++)
+    {
+        for (j = 0; j < 3; j++)
+        {
+            unsigned int vertex = indices[i * 3 + j];
+            adjacency[offsets[vertex] + remaining[vertex]++] = i;
+        }
+    }
+
+    for (i = 0; i < num_vertices; i++)
+    {
+        cache_position[i] = -1;
+        vertex_score[i] = seel_forsyth_vertex_score(-1, remaining[i]);
+    }
+    for (i = 0; i < num_triangles; i++)
+        triangle_score[i] = vertex_score[indices[i * 3]] + vertex_score[indices[i * 3 + 1]] + vertex_score[indices[i * 3 + 2]];
+
+    /* cache holds up to CACHE_SIZE vertices plus the three the emitted triangle pushes in */
+    unsigned int cache[SEEL_OPTIMIZER_CACHE_SIZE + 3], next_cache[SEEL_OPTIMIZER_CACHE_SIZE + 3];
+    unsigned int cache_count = 0, next_cache_count;
+    unsigned int cursor = 0, emitted_count = 0;
+    int best = -1;
+
+    while (emitted_count < num_triangles)
+    {
+        if (best < 0)
+        {
+            /* nothing in the cache has triangles left, continue with the first unemitted triangle */
+            while (emitted[cursor])
+                cursor++;
+            best = (int)cursor;
+        }
+
+        unsigned int *triangle = &indices[best * 3];
+        for (j = 0; j < 3; j++)
+            output[emitted_count * 3 + j] = triangle[j];
+        emitted[best] = true;
+        emitted_count++;
+
+        /* drop the triangle from its vertices' adjacency */
+        for (j = 0; j < 3; j++)
+        {
+            unsigned int vertex = triangle[j];
+            unsigned int *list = &adjacency[offsets[vertex]];
+            for (unsigned int k = 0; k < remaining[vertex]; k++)
+            {
+                if (list[k] == (unsigned int)best)
+                {
+                    list[k] = list[remaining[vertex] - 1];
+                    break;
+                }
+            }
+            remaining[vertex]--;
+        }
+
+        /* the triangle's vertices move to the front, the rest of the cache follows in order */
+        next_cache_count = 0;
+        for (j = 0; j < 3; j++)
+            next_cache[next_cache_count++] = triangle[j];
+        for (j = 0; j < cache_count; j++)
+        {
+            unsigned int vertex = cache[j];
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                next_cache[next_cache_count++] = vertex;
+        }
+
+        for (j = 0; j < next_cache_count; j++)
+        {
+            unsigned int vertex = next_cache[j];
+            cache_position[vertex] = j < SEEL_OPTIMIZER_CACHE_SIZE ? (int)j : -1;
+            vertex_score[vertex] = seel_forsyth_vertex_score(cache_position[vertex], remaining[vertex]);
+            for (unsigned int k = 0; k < remaining[vertex]; k++)
+            {
+                unsigned int t = adjacency[offsets[vertex] + k];
+                triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+            }
+        }
+
+        cache_count = next_cache_count < SEEL_OPTIMIZER_CACHE_SIZE ? next_cache_count : SEEL_OPTIMIZER_CACHE_SIZE;
+        memcpy(cache, next_cache, sizeof(unsigned int) * cache_count);
+
+        /* the next triangle is the best one touching the cache */
+        best = -1;
+        float best_score = -1.0f;
+        for (j = 0; j < cache_count; j++)
+        {
+            unsigned int vertex = cache[j];
+            for (unsigned int k = 0; k < remaining[vertex]; k++)
+            {
+                unsigned int t = adjacency[offsets[vertex] + k];
+                if (triangle_score[t] > best_score)
+                {
+                    best_score = triangle_score[t];
+                    best = (int)t;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output, sizeof(unsigned int) * num_triangles * 3);
+
+cleanup:
+    free(remaining);
+    free(offsets);
+    free(adjacency);
+    free(cache_position);
+    free(vertex_score);
+    free(triangle_score);
+    free(emitted);
+    free(output);
+}
+
+struct OverdrawCluster
+{
+    unsigned int first; /* first triangle */
+    unsigned int count;
+    float sort_key;
+};
+
+static int seel_overdraw_cluster_compare(const void *a, const void *b)
+{
+    const struct OverdrawCluster *x = (const struct OverdrawCluster *)a, *y = (const struct OverdrawCluster *)b;
+    if (x->sort_key != y->sort_key)
+        return x->sort_key > y->sort_key ? -1 : 1;
+    return x->first < y->first ? -1 : 1; /* keeps the sort stable */
+}
+
+/*
+ * Cuts the cache-optimized triangle order into clusters wherever the
+ * simulated cache misses all three vertices, which costs no reuse. The
+ * clusters are then sorted so those facing outwards from the mesh centre
+ * draw first and occlude the rest.
+ */
+void seel_mesh_optimize_overdraw(unsigned int *indices, unsigned int num_indices, const struct Vertex *vertices, unsigned int num_vertices)
+{
+    unsigned int num_triangles = num_indices / 3;
+    if (num_triangles < 2)
+        return;
+
+    struct OverdrawCluster *clusters = malloc(sizeof(struct OverdrawCluster) * num_triangles);
+    unsigned int *missed_at = malloc(sizeof(unsigned int) * num_vertices);
+    unsigned int *output = malloc(sizeof(unsigned int) * num_triangles * 3);
+    if (!clusters || !missed_at || !output)
+    {
+        fprintf(stderr, "Failed to allocate memory for overdraw optimization!\n");
+        free(clusters);
+        free(missed_at);
+        free(output);
+        return;
+    }
+
+    unsigned int i, j, num_clusters = 0, misses = 0;
+    for (i = 0; i < num_vertices; i++)
+        missed_at[i] = UINT32_MAX;
+    for (i = 0; i < num_triangles; i++)
+    {
+        unsigned int triangle_misses = 0;
+        for (j = 0; j < 3; j++)
+        {
+            unsigned int vertex = indices[i * 3 + j];
+            if (missed_at[vertex] == UINT32_MAX || misses - missed_at[vertex] >= SEEL_ANALYZE_CACHE_SIZE)
+            {
+                missed_at[vertex] = misses++;
+                triangle_misses++;
+            }
+        }
+        if (i == 0 || triangle_misses == 3)
+            clusters[num_clusters++] = (struct OverdrawCluster){i, 0, 0.0f};
+        clusters[num_clusters - 1].count++;
+    }
+
+    /* area weighted centroid of the mesh */
+    vec3 mesh_centroid = GLM_VEC3_ZERO_INIT;
+    float mesh_area = 0.0f;
+    for (i = 0; i < num_triangles; i++)
+    {
+        const float *a = vertices[indices[i * 3]].position, *b = vertices[indices[i * 3 + 1]].position, *c = vertices[indices[i * 3 + 2]].position;
+        vec3 ab, ac, normal, centre;
+        glm_vec3_sub((float *)b, (float *)a, ab);
+        glm_vec3_sub((float *)c, (float *)a, ac);
+        glm_vec3_cross(ab, ac, normal);
+        float area = glm_vec3_norm(normal);
+        glm_vec3_add((float *)a, (float *)b, centre);
+        glm_vec3_add(centre, (float *)c, centre);
+        glm_vec3_muladds(centre, area / 3.0f, mesh_centroid);
+        mesh_area += area;
+    }
+    if (mesh_area > 0.0f)
+        glm_vec3_scale(mesh_centroid, 1.0f / mesh_area, mesh_centroid);
+
+    /* how far a cluster faces away from the centre: its centroid's offset along its average normal */
+    for (i = 0; i < num_clusters; i++)
+    {
+        vec3 centroid = GLM_VEC3_ZERO_INIT, normal_sum = GLM_VEC3_ZERO_INIT;
+        float area_sum = 0.0f;
+        for (j = clusters[i].first; j < clusters[i].first + clusters[i].count; j++)
+        {
+            const float *a = vertices[indices[j * 3]].position, *b = vertices[indices[j * 3 + 1]].position, *c = vertices[indices[j * 3 + 2]].position;
+            vec3 ab, ac, normal, centre;
+            glm_vec3_sub((float *)b, (float *)a, ab);
+            glm_vec3_sub((float *)c, (float *)a, ac);
+            glm_vec3_cross(ab, ac, normal);
+            float area = glm_vec3_norm(normal);
+            glm_vec3_add((float *)a, (float *)b, centre);
+            glm_vec3_add(centre, (float *)c, centre);
+            glm_vec3_muladds(centre, area / 3.0f, centroid);
+            glm_vec3_add(normal_sum, normal, normal_sum);
+            area_sum += area;
+        }
+        if (area_sum > 0.0f)
+            glm_vec3_scale(centroid, 1.0f / area_sum, centroid);
+        glm_vec3_normalize(normal_sum);
+        glm_vec3_sub(centroid, mesh_centroid, centroid);
+        clusters[i].sort_key = glm_vec3_dot(centroid, normal_sum);
+    }
+
+    qsort(clusters, num_clusters, sizeof(struct OverdrawCluster), seel_overdraw_cluster_compare);
+
+    unsigned int written = 0;
+    for (i = 0; i < num_clusters; i++)
+    {
+        memcpy(&output[written], &indices[clusters[i].first * 3], sizeof(unsigned int) * clusters[i].count * 3);
+        written += clusters[i].count * 3;
+    }
+    memcpy(indices, output, sizeof(unsigned int) * written);
+
+    free(clusters);
+    free(missed_at);
+    free(output);
+}
+
+/* Renumbers vertices in the order the indices first use them and drops unused ones; returns the new vertex count */
+unsigned int seel_mesh_optimize_vertex_fetch(struct Vertex *vertices, unsigned int num_vertices, unsigned int *indices, unsigned int num_indices)
+{
+    unsigned int *remap = malloc(sizeof(unsigned int) * (num_vertices ? num_vertices : 1));
+    struct Vertex *reordered = malloc(sizeof(struct Vertex) * (num_vertices ? num_vertices : 1));
+    if (!remap || !reordered)
+    {
+        fprintf(stderr, "Failed to allocate memory for vertex fetch optimization!\n");
+        free(remap);
+        free(reordered);
+        return num_vertices;
+    }
+
+    unsigned int used = 0, i;
+    memset(remap, 0xff, sizeof(unsigned int) * num_vertices);
+    for (i = 0; i < num_indices; i++)
+    {
+        unsigned int vertex = indices[i];
+        if (remap[vertex] == UINT32_MAX)
+        {
+            reordered[used] = vertices[vertex];
+            remap[vertex] = used++;
+        }
+        indices[i] = remap[vertex];
+    }
+
+    memcpy(vertices, reordered, sizeof(struct Vertex) * used);
+    free(remap);
+    free(reordered);
+    return used;
+}
+
+/* Runs every stage on a triangle list; vertices are compacted in place and *num_vertices updated */
+void seel_mesh_optimize(struct Vertex *vertices, unsigned int *num_vertices, unsigned int *indices, unsigned int num_indices, struct MeshOptimizeReport *report)
+{
+    if (report)
+    {
+        report->num_triangles = num_indices / 3;
+        report->vertices_before = *num_vertices;
+        report->before = seel_mesh_analyze_cache(indices, num_indices, *num_vertices, SEEL_ANALYZE_CACHE_SIZE);
+    }
+
+    if (num_indices % 3 == 0)
+    {
+        *num_vertices = seel_mesh_weld(vertices, *num_vertices, indices, num_indices);
+        seel_mesh_optimize_vertex_cache(indices, num_indices, *num_vertices);
+        seel_mesh_optimize_overdraw(indices, num_indices, vertices, *num_vertices);
+        *num_vertices = seel_mesh_optimize_vertex_fetch(vertices, *num_vertices, indices, num_indices);
+    }
+
+    if (report)
+    {
+        report->vertices_after = *num_vertices;
+        report->after = seel_mesh_analyze_cache(indices, num_indices, *num_vertices, SEEL_ANALYZE_CACHE_SIZE);
+    }
+}
+
+static void seel_mesh_cache_stats_add(struct MeshCacheStats *total, unsigned int total_triangles, unsigned int total_vertices,
+                                      const struct MeshCacheStats *stats, unsigned int triangles, unsigned int vertices)
+{
+    /* both ratios divide the same vertex shader invocations */
+    float invocations = total->acmr * total_triangles + stats->acmr * triangles;
+    total->acmr = total_triangles + triangles ? invocations / (total_triangles + triangles) : 0.0f;
+    total->atvr = total_vertices + vertices ? invocations / (total_vertices + vertices) : 0.0f;
+}
+
+/* Folds one mesh's report into the totals of several, weighting the ratios by their meshes' sizes */
+void seel_mesh_optimize_report_add(struct MeshOptimizeReport *total, const struct MeshOptimizeReport *report)
+{
+    seel_mesh_cache_stats_add(&total->before, total->num_triangles, total->vertices_before, &report->before, report->num_triangles,
+                              report->vertices_before);
+    seel_mesh_cache_stats_add(&total->after, total->num_triangles, total->vertices_after, &report->after, report->num_triangles,
+                              report->vertices_after);
+    total->num_triangles += report->num_triangles;
+    total->vertices_before += report->vertices_before;
+    total->vertices_after += report->vertices_after;
+}
+
+void seel_mesh_print_optimize_report(const char *name, const struct MeshOptimizeReport *report)
+{
+    printf("Optimized mesh %s: %u -> %u vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name, report->vertices_before,
+           report->vertices_after, report->before.acmr, report->after.acmr, report->before.atvr, report->after.atvr);
+}
+
+#endif /* MESH_OPTIMIZER_H */
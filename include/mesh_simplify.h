@@ -0,0 +1,615 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "cglm/cglm.h"
+#include "mesh.h"
+#include "mesh_optimizer.h"
+
+/*
+ * Quadric error metric simplifier building the detail levels of a mesh.
+ *
+ * Edges are collapsed onto one of their vertices, so every level indexes
+ * the original vertex buffer and levels only cost index memory. Vertices
+ * sharing a position but not attributes (UV and normal seams) are wedges
+ * of one position; a collapse has to move every wedge onto a wedge of the
+ * target it shares triangles with, so seams only shorten along themselves.
+ * Open borders only collapse along the border, vertices where borders,
+ * seams or non-manifold edges meet stay put, and skinned vertices only
+ * collapse onto vertices driven by the same dominant bone.
+ */
+
+/* Each level aims for this fraction of the previous level's triangles */
+#define SEEL_LOD_TRIANGLE_RATIO 0.5f
+/* A level removing less than this fraction of the previous one is not kept */
+#define SEEL_LOD_MIN_REDUCTION 0.2f
+/* Weight of the planes keeping borders and seams in place, relative to surface planes */
+#define SEEL_SIMPLIFY_BORDER_WEIGHT 2.0f
+/* Wedges of one position a collapse handles */
+#define SEEL_SIMPLIFY_MAX_WEDGES 8
+
+enum SimplifyVertexKind
+{
+    SIMPLIFY_VERTEX_MANIFOLD,
+    SIMPLIFY_VERTEX_BORDER,
+    SIMPLIFY_VERTEX_SEAM,
+    SIMPLIFY_VERTEX_LOCKED
+};
+
+/* Symmetric 4x4 quadric of squared plane distances, weighted by area */
+struct Quadric
+{
+    float a00, a11, a22, a10, a20, a21;
+    float b0, b1, b2;
+    float c;
+    float weight;
+};
+
+struct SimplifyCollapse
+{
+    unsigned int from; /* positions, i.e. remapped vertices */
+    unsigned int to;
+    float error;
+};
+
+/* Simplification state, kept across levels so quadrics accumulate from the full mesh */
+struct MeshSimplifier
+{
+    const struct Vertex *vertices;
+    unsigned int num_vertices;
+    unsigned int *indices; /* current level */
+    unsigned int num_indices;
+    unsigned int *remap;   /* vertex -> first vertex with its position */
+    unsigned int *wedge;   /* vertex -> next vertex with its position, circular */
+    int *bone;             /* dominant bone of every vertex, -1 when unskinned */
+    struct Quadric *quadrics; /* by position */
+    float error;           /* squared, largest collapse so far */
+};
+
+static void seel_quadric_from_plane(struct Quadric *q, vec3 normal, float distance, float weight)
+{
+    q->a00 = weight * normal[0] * normal[0];
+    q->a11 = weight * normal[1] * normal[1];
+    q->a22 = weight * normal[2] * normal[2];
+    q->a10 = weight * normal[1] * normal[0];
+    q->a20 = weight * normal[2] * normal[0];
+    q->a21 = weight * normal[2] * normal[1];
+    q->b0 = weight * normal[0] * distance;
+    q->b1 = weight * normal[1] * distance;
+    q->b2 = weight * normal[2] * distance;
+    q->c = weight * distance * distance;
+    q->weight = weight;
+}
+
+static void seel_quadric_add(struct Quadric *q, const struct Quadric *r)
+{
+    q->a00 += r->a00;
+    q->a11 += r->a11;
+    q->a22 += r->a22;
+    q->a10 += r->a10;
+    q->a20 += r->a20;
+    q->a21 += r->a21;
+    q->b0 += r->b0;
+    q->b1 += r->b1;
+    q->b2 += r->b2;
+    q->c += r->c;
+    q->weight += r->weight;
+}
+
+/* Weighted mean squared distance of p to the quadric's planes */
+static float seel_quadric_error(const struct Quadric *q, const float *p)
+{
+    float rx = q->a00 * p[0] + q->a10 * p[1] + q->a20 * p[2];
+    float ry = q->a10 * p[0] + q->a11 * p[1] + q->a21 * p[2];
+    float rz = q->a20 * p[0] + q->a21 * p[1] + q->a22 * p[2];
+    float error = rx * p[0] + ry * p[1] + rz * p[2] + 2.0f * (q->b0 * p[0] + q->b1 * p[1] + q->b2 * p[2]) + q->c;
+    return fabsf(error) / (q->weight > 0.0f ? q->weight : 1.0f);
+}
+
+/* Open-addressed set of directed edges, also reused to find vertices by position */
+struct SimplifyEdgeSet
+{
+    uint64_t *keys;
+    unsigned int mask;
+};
+
+static bool seel_edge_set_init(struct SimplifyEdgeSet *set, unsigned int num_edges)
+{
+    unsigned int size = 1;
+    while (size < num_edges * 2)
+        size *= 2;
+    set->keys = malloc(sizeof(uint64_t) * size);
+    set->mask = size - 1;
+    if (set->keys)
+        memset(set->keys, 0xff, sizeof(uint64_t) * size);
+    return set->keys != NULL;
+}
+
+static unsigned int seel_edge_set_slot(const struct SimplifyEdgeSet *set, uint64_t key)
+{
+    unsigned int slot = (unsigned int)((key * 0x9e3779b97f4a7c15ull) >> 32) & set->mask;
+    while (set->keys[slot] != UINT64_MAX && set->keys[slot] != key)
+        slot = (slot + 1) & set->mask;
+    return slot;
+}
+
+static void seel_edge_set_insert(struct SimplifyEdgeSet *set, unsigned int a, unsigned int b)
+{
+    uint64_t key = (uint64_t)a << 32 | b;
+    set->keys[seel_edge_set_slot(set, key)] = key;
+}
+
+static bool seel_edge_set_contains(const struct SimplifyEdgeSet *set, unsigned int a, unsigned int b)
+{
+    uint64_t key = (uint64_t)a << 32 | b;
+    return set->keys[seel_edge_set_slot(set, key)] == key;
+}
+
+static int seel_simplify_dominant_bone(const struct Vertex *vertex)
+{
+    int bone = -1;
+    float weight = 0.0f;
+    unsigned int i;
+    for (i = 0; i < MAX_BONE_INFLUENCE; i++)
+    {
+        if (vertex->m_bone_ids[i] >= 0 && vertex->m_weights[i] > weight)
+        {
+            bone = vertex->m_bone_ids[i];
+            weight = vertex->m_weights[i];
+        }
+    }
+    return bone;
+}
+
+/*
+ * Maps every vertex to the first vertex with a bitwise equal position; wedge,
+ * which may be NULL, links the vertices of each position in a ring.
+ */
+bool seel_mesh_remap_positions(const struct Vertex *vertices, unsigned int num_vertices, unsigned int *remap, unsigned int *wedge)
+{
+    struct SimplifyEdgeSet positions;
+    if (!seel_edge_set_init(&positions, num_vertices))
+    {
+        fprintf(stderr, "Failed to allocate memory for position remap!\n");
+        return false;
+    }
+
+    unsigned int i;
+    for (i = 0; i < num_vertices; i++)
+    {
+        uint32_t bits[3];
+        memcpy(bits, vertices[i].position, sizeof(bits));
+        uint64_t key = ((uint64_t)bits[0] * 73856093u) ^ ((uint64_t)bits[1] * 19349663u) ^ ((uint64_t)bits[2] * 83492791u);
+        unsigned int slot = (unsigned int)((key * 0x9e3779b97f4a7c15ull) >> 32) & positions.mask;
+        while (positions.keys[slot] != UINT64_MAX &&
+               memcmp(vertices[positions.keys[slot]].position, vertices[i].position, sizeof(vec3)) != 0)
+            slot = (slot + 1) & positions.mask;
+
+        unsigned int first = i;
+        if (positions.keys[slot] == UINT64_MAX)
+            positions.keys[slot] = i;
+        else
+            first = (unsigned int)positions.keys[slot];
+
+        remap[i] = first;
+        if (wedge)
+        {
+            wedge[i] = first == i ? i : wedge[first];
+            wedge[first] = i;
+        }
+    }
+
+    free(positions.keys);
+    return true;
+}
+
+void seel_mesh_simplifier_destroy(struct MeshSimplifier *simplifier)
+{
+    free(simplifier->indices);
+    free(simplifier->remap);
+    free(simplifier->wedge);
+    free(simplifier->bone);
+    free(simplifier->quadrics);
+    memset(simplifier, 0, sizeof(struct MeshSimplifier));
+}
+
+/* Copies the triangle list and builds the quadrics of its surface, borders and seams */
+bool seel_mesh_simplifier_init(struct MeshSimplifier *simplifier, const struct Vertex *vertices, unsigned int num_vertices,
+                               const unsigned int *indices, unsigned int num_indices)
+{
+    memset(simplifier, 0, sizeof(struct MeshSimplifier));
+    simplifier->vertices = vertices;
+    simplifier->num_vertices = num_vertices;
+    simplifier->num_indices = num_indices / 3 * 3;
+
+    struct SimplifyEdgeSet edges = {0};
+    simplifier->indices = malloc(sizeof(unsigned int) * (num_indices ? num_indices : 1));
+    simplifier->remap = malloc(sizeof(unsigned int) * (num_vertices ? num_vertices : 1));
+    simplifier->wedge = malloc(sizeof(unsigned int) * (num_vertices ? num_vertices : 1));
+    simplifier->bone = malloc(sizeof(int) * (num_vertices ? num_vertices : 1));
+    simplifier->quadrics = calloc(num_vertices ? num_vertices : 1, sizeof(struct Quadric));
+    if (!simplifier->indices || !simplifier->remap || !simplifier->wedge || !simplifier->bone || !simplifier->quadrics ||
+        !seel_edge_set_init(&edges, simplifier->num_indices) ||
+        !seel_mesh_remap_positions(vertices, num_vertices, simplifier->remap, simplifier->wedge))
+    {
+        fprintf(stderr, "Failed to allocate memory for mesh simplification!\n");
+        free(edges.keys);
+        seel_mesh_simplifier_destroy(simplifier);
+        return false;
+    }
+
+    unsigned int i, j;
+    for (i = 0; i < num_vertices; i++)
+        simplifier->bone[i] = seel_simplify_dominant_bone(&vertices[i]);
+
+    /* triangles with two corners at one position cover nothing and would collapse onto themselves */
+    unsigned int *remap = simplifier->remap, written = 0;
+    for (i = 0; i < simplifier->num_indices; i += 3)
+    {
+        if (remap[indices[i]] == remap[indices[i + 1]] || remap[indices[i + 1]] == remap[indices[i + 2]] || remap[indices[i]] == remap[indices[i + 2]])
+            continue;
+        memcpy(&simplifier->indices[written], &indices[i], sizeof(unsigned int) * 3);
+        written += 3;
+    }
+    simplifier->num_indices = written;
+
+    for (i = 0; i < simplifier->num_indices; i++)
+        seel_edge_set_insert(&edges, simplifier->indices[i], simplifier->indices[i - i % 3 + (i + 1) % 3]);
+
+    for (i = 0; i < simplifier->num_indices; i += 3)
+    {
+        const unsigned int *triangle = &simplifier->indices[i];
+        vec3 ab, ac, normal;
+        glm_vec3_sub((float *)vertices[triangle[1]].position, (float *)vertices[triangle[0]].position, ab);
+        glm_vec3_sub((float *)vertices[triangle[2]].position, (float *)vertices[triangle[0]].position, ac);
+        glm_vec3_cross(ab, ac, normal);
+        float area = glm_vec3_norm(normal) * 0.5f;
+        if (area <= 0.0f)
+            continue;
+        glm_vec3_normalize(normal);
+
+        struct Quadric q;
+        seel_quadric_from_plane(&q, normal, -glm_vec3_dot(normal, (float *)vertices[triangle[0]].position), area);
+        for (j = 0; j < 3; j++)
+            seel_quadric_add(&simplifier->quadrics[remap[triangle[j]]], &q);
+
+        /* edges without a twin in vertex space are borders or seams: pin them with a perpendicular plane */
+        for (j = 0; j < 3; j++)
+        {
+            unsigned int a = triangle[j], b = triangle[(j + 1) % 3];
+            if (seel_edge_set_contains(&edges, b, a))
+                continue;
+
+            vec3 edge, perpendicular;
+            glm_vec3_sub((float *)vertices[b].position, (float *)vertices[a].position, edge);
+            float length = glm_vec3_norm(edge);
+            glm_vec3_cross(edge, normal, perpendicular);
+            if (length <= 0.0f)
+                continue;
+            glm_vec3_normalize(perpendicular);
+
+            struct Quadric border;
+            seel_quadric_from_plane(&border, perpendicular, -glm_vec3_dot(perpendicular, (float *)vertices[a].position),
+                                    length * length * SEEL_SIMPLIFY_BORDER_WEIGHT);
+            seel_quadric_add(&simplifier->quadrics[remap[a]], &border);
+            seel_quadric_add(&simplifier->quadrics[remap[b]], &border);
+        }
+    }
+    free(edges.keys);
+    return true;
+}
+
+static int seel_simplify_collapse_compare(const void *a, const void *b)
+{
+    const struct SimplifyCollapse *x = (const struct SimplifyCollapse *)a, *y = (const struct SimplifyCollapse *)b;
+    if (x->error != y->error)
+        return x->error < y->error ? -1 : 1;
+    return x->from < y->from ? -1 : x->from > y->from;
+}
+
+/* True when replacing position from by to folds none of the triangles around from */
+static bool seel_simplify_keeps_orientation(const struct MeshSimplifier *simplifier, const unsigned int *triangles, unsigned int count,
+                                            unsigned int from, unsigned int to)
+{
+    const struct Vertex *vertices = simplifier->vertices;
+    unsigned int i, j;
+    for (i = 0; i < count; i++)
+    {
+        const unsigned int *triangle = &simplifier->indices[triangles[i] * 3];
+        bool collapses = false;
+        for (j = 0; j < 3; j++)
+            collapses |= simplifier->remap[triangle[j]] == to;
+        if (collapses)
+            continue;
+
+        vec3 corners[3];
+        for (j = 0; j < 3; j++)
+            glm_vec3_copy((float *)vertices[simplifier->remap[triangle[j]] == from ? to : triangle[j]].position, corners[j]);
+
+        vec3 ab, ac, before, after;
+        glm_vec3_sub((float *)vertices[triangle[1]].position, (float *)vertices[triangle[0]].position, ab);
+        glm_vec3_sub((float *)vertices[triangle[2]].position, (float *)vertices[triangle[0]].position, ac);
+        glm_vec3_cross(ab, ac, before);
+        glm_vec3_sub(corners[1], corners[0], ab);
+        glm_vec3_sub(corners[2], corners[0], ac);
+        glm_vec3_cross(ab, ac, after);
+        if (glm_vec3_dot(before, after) <= 1e-2f * glm_vec3_norm(before) * glm_vec3_norm(after))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Finds the wedge every wedge of from lands on: the single wedge of to it
+ * shares triangles with. Fails when a wedge has no such partner or several,
+ * which would tear a seam, or when skinned partners follow different bones.
+ */
+static unsigned int seel_simplify_match_wedges(const struct MeshSimplifier *simplifier, const unsigned int *triangles, unsigned int count,
+                                               unsigned int from, unsigned int to, unsigned int *sources, unsigned int *targets)
+{
+    unsigned int num_wedges = 0, i, j, k;
+    for (i = 0; i < count; i++)
+    {
+        const unsigned int *triangle = &simplifier->indices[triangles[i] * 3];
+        unsigned int source = UINT32_MAX, target = UINT32_MAX;
+        for (j = 0; j < 3; j++)
+        {
+            if (simplifier->remap[triangle[j]] == from)
+                source = triangle[j];
+            else if (simplifier->remap[triangle[j]] == to)
+                target = triangle[j];
+        }
+
+        for (k = 0; k < num_wedges && sources[k] != source; k++)
+            ;
+        if (k == num_wedges)
+        {
+            if (num_wedges == SEEL_SIMPLIFY_MAX_WEDGES)
+                return 0;
+            sources[k] = source;
+            targets[k] = UINT32_MAX;
+            num_wedges++;
+        }
+        if (target == UINT32_MAX)
+            continue;
+        if (targets[k] != UINT32_MAX && targets[k] != target)
+            return 0;
+        targets[k] = target;
+    }
+
+    for (k = 0; k < num_wedges; k++)
+    {
+        if (targets[k] == UINT32_MAX || simplifier->bone[sources[k]] != simplifier->bone[targets[k]])
+            return 0;
+    }
+    return num_wedges;
+}
+
+/*
+ * Collapses edges, cheapest first, until at most target_indices remain or
+ * nothing can collapse. Returns the index count reached; the current level
+ * is in simplifier->indices.
+ */
+unsigned int seel_mesh_simplify(struct MeshSimplifier *simplifier, unsigned int target_indices)
+{
+    unsigned int num_vertices = simplifier->num_vertices;
+    unsigned int *offsets = malloc(sizeof(unsigned int) * (num_vertices + 1));
+    unsigned int *adjacency = malloc(sizeof(unsigned int) * (simplifier->num_indices ? simplifier->num_indices : 1));
+    unsigned char *kinds = malloc(num_vertices ? num_vertices : 1);
+    unsigned int *open_out = malloc(sizeof(unsigned int) * (num_vertices ? num_vertices : 1));
+    unsigned int *open_in = malloc(sizeof(unsigned int) * (num_vertices ? num_vertices : 1));
+    unsigned int *collapse = malloc(sizeof(unsigned int) * (num_vertices ? num_vertices : 1));
+    bool *locked = malloc(sizeof(bool) * (num_vertices ? num_vertices : 1));
+    struct SimplifyCollapse *candidates = malloc(sizeof(struct SimplifyCollapse) * (simplifier->num_indices ? simplifier->num_indices : 1));
+    struct SimplifyEdgeSet edges = {0};
+    if (!offsets || !adjacency || !kinds || !open_out || !open_in || !collapse || !locked || !candidates ||
+        !seel_edge_set_init(&edges, simplifier->num_indices))
+    {
+        fprintf(stderr, "Failed to allocate memory for mesh simplification!\n");
+        goto cleanup;
+    }
+
+    const unsigned int *remap = simplifier->remap;
+    unsigned int *indices = simplifier->indices;
+    unsigned int i, j;
+    while (simplifier->num_indices > target_indices)
+    {
+        unsigned int num_triangles = simplifier->num_indices / 3;
+
+        /* triangles around every position */
+        memset(offsets, 0, sizeof(unsigned int) * (num_vertices + 1));
+        for (i = 0; i < simplifier->num_indices; i++)
+            offsets[remap[indices[i]] + 1]++;
+        for (i = 0; i < num_vertices; i++)
+            offsets[i + 1] += offsets[i];
+        for (i = 0; i < simplifier->num_indices; i++)
+            adjacency[offsets[remap[indices[i]]]++] = i / 3;
+        for (i = num_vertices; i > 0; i--)
+            offsets[i] = offsets[i - 1];
+        offsets[0] = 0;
+
+        /* kinds from the position space edges without a twin and the wedges in use */
+        memset(edges.keys, 0xff, sizeof(uint64_t) * (edges.mask + 1));
+        for (i = 0; i < simplifier->num_indices; i++)
+            seel_edge_set_insert(&edges, remap[indices[i]], remap[indices[i - i % 3 + (i + 1) % 3]]);
+        memset(open_out, 0, sizeof(unsigned int) * num_vertices);
+        memset(open_in, 0, sizeof(unsigned int) * num_vertices);
+        for (i = 0; i < simplifier->num_indices; i++)
+        {
+            unsigned int a = remap[indices[i]], b = remap[indices[i - i % 3 + (i + 1) % 3]];
+            if (!seel_edge_set_contains(&edges, b, a))
+            {
+                open_out[a]++;
+                open_in[b]++;
+            }
+        }
+
+        /* collapse doubles as a marker of the vertices in use here */
+        memset(collapse, 0, sizeof(unsigned int) * num_vertices);
+        for (i = 0; i < simplifier->num_indices; i++)
+            collapse[indices[i]] = 1;
+        for (i = 0; i < num_vertices; i++)
+        {
+            if (remap[i] != i)
+                continue;
+            unsigned int wedges = 0, v = i;
+            do
+            {
+                wedges += collapse[v];
+                v = simplifier->wedge[v];
+            } while (v != i);
+
+            if (!open_out[i] && !open_in[i])
+                kinds[i] = wedges > 1 ? SIMPLIFY_VERTEX_SEAM : SIMPLIFY_VERTEX_MANIFOLD;
+            else if (open_out[i] == 1 && open_in[i] == 1 && wedges == 1)
+                kinds[i] = SIMPLIFY_VERTEX_BORDER;
+            else
+                kinds[i] = SIMPLIFY_VERTEX_LOCKED;
+        }
+
+        /* the cheaper direction of every edge, borders only along themselves */
+        unsigned int num_candidates = 0;
+        for (i = 0; i < simplifier->num_indices; i++)
+        {
+            unsigned int a = remap[indices[i]], b = remap[indices[i - i % 3 + (i + 1) % 3]];
+            bool open = !seel_edge_set_contains(&edges, b, a);
+            if (!open && a > b)
+                continue;
+
+            struct SimplifyCollapse best = {0, 0, FLT_MAX};
+            for (j = 0; j < 2; j++)
+            {
+                unsigned int from = j ? b : a, to = j ? a : b;
+                if (kinds[from] == SIMPLIFY_VERTEX_LOCKED || (kinds[from] == SIMPLIFY_VERTEX_BORDER && !open))
+                    continue;
+
+                struct Quadric q = simplifier->quadrics[from];
+                seel_quadric_add(&q, &simplifier->quadrics[to]);
+                float error = seel_quadric_error(&q, simplifier->vertices[to].position);
+                if (error < best.error)
+                    best = (struct SimplifyCollapse){from, to, error};
+            }
+            if (best.error < FLT_MAX)
+                candidates[num_candidates++] = best;
+        }
+        qsort(candidates, num_candidates, sizeof(struct SimplifyCollapse), seel_simplify_collapse_compare);
+
+        /* apply collapses that touch no triangle changed earlier in this pass */
+        memset(collapse, 0xff, sizeof(unsigned int) * num_vertices);
+        memset(locked, 0, sizeof(bool) * num_vertices);
+        unsigned int goal = (simplifier->num_indices - target_indices) / 3, removed = 0, collapsed = 0;
+        for (i = 0; i < num_candidates && removed < goal; i++)
+        {
+            struct SimplifyCollapse *candidate = &candidates[i];
+            if (locked[candidate->from] || locked[candidate->to])
+                continue;
+
+            const unsigned int *triangles = &adjacency[offsets[candidate->from]];
+            unsigned int count = offsets[candidate->from + 1] - offsets[candidate->from];
+            unsigned int sources[SEEL_SIMPLIFY_MAX_WEDGES], targets[SEEL_SIMPLIFY_MAX_WEDGES];
+            unsigned int num_wedges = seel_simplify_match_wedges(simplifier, triangles, count, candidate->from, candidate->to, sources, targets);
+            if (!num_wedges || !seel_simplify_keeps_orientation(simplifier, triangles, count, candidate->from, candidate->to))
+                continue;
+
+            for (j = 0; j < num_wedges; j++)
+                collapse[sources[j]] = targets[j];
+            seel_quadric_add(&simplifier->quadrics[candidate->to], &simplifier->quadrics[candidate->from]);
+            if (candidate->error > simplifier->error)
+                simplifier->error = candidate->error;
+
+            for (j = 0; j < count; j++)
+            {
+                const unsigned int *triangle = &indices[triangles[j] * 3];
+                bool degenerate = false;
+                for (unsigned int k = 0; k < 3; k++)
+                {
+                    locked[remap[triangle[k]]] = true;
+                    degenerate |= remap[triangle[k]] == candidate->to;
+                }
+                removed += degenerate;
+            }
+            collapsed++;
+        }
+        if (!collapsed)
+            break;
+
+        /* targets were locked, so one lookup resolves every collapse */
+        unsigned int written = 0;
+        for (i = 0; i < num_triangles; i++)
+        {
+            unsigned int triangle[3];
+            for (j = 0; j < 3; j++)
+            {
+                unsigned int v = indices[i * 3 + j];
+                triangle[j] = collapse[v] != UINT32_MAX ? collapse[v] : v;
+            }
+            if (remap[triangle[0]] == remap[triangle[1]] || remap[triangle[1]] == remap[triangle[2]] || remap[triangle[0]] == remap[triangle[2]])
+                continue;
+            memcpy(&indices[written], triangle, sizeof(triangle));
+            written += 3;
+        }
+        simplifier->num_indices = written;
+    }
+
+cleanup:
+    free(offsets);
+    free(adjacency);
+    free(kinds);
+    free(open_out);
+    free(open_in);
+    free(collapse);
+    free(locked);
+    free(candidates);
+    free(edges.keys);
+    return simplifier->num_indices;
+}
+
+/*
+ * Appends simplified levels to a triangle list, reallocating *indices, and
+ * fills lods with every level's range; lods[0] is the list as given.
+ * Levels are cache optimized on their own. Returns the number of levels.
+ */
+unsigned int seel_mesh_build_lods(const struct Vertex *vertices, unsigned int num_vertices, unsigned int **indices, unsigned int *num_indices,
+                                  struct MeshLod *lods, unsigned int max_lods)
+{
+    lods[0] = (struct MeshLod){0, *num_indices, 0.0f};
+    if (max_lods < 2 || *num_indices < 3 || *num_indices % 3)
+        return 1;
+
+    struct MeshSimplifier simplifier;
+    if (!seel_mesh_simplifier_init(&simplifier, vertices, num_vertices, *indices, *num_indices))
+        return 1;
+
+    unsigned int num_lods = 1;
+    while (num_lods < max_lods)
+    {
+        unsigned int previous = lods[num_lods - 1].num_indices;
+        unsigned int target = (unsigned int)(previous / 3 * SEEL_LOD_TRIANGLE_RATIO) * 3;
+        unsigned int reached = seel_mesh_simplify(&simplifier, target);
+        if (!reached || reached > previous * (1.0f - SEEL_LOD_MIN_REDUCTION))
+            break;
+
+        unsigned int *grown = realloc(*indices, sizeof(unsigned int) * (*num_indices + reached));
+        if (!grown)
+        {
+            fprintf(stderr, "Failed to reallocate memory for mesh LODs!\n");
+            break;
+        }
+        *indices = grown;
+
+        memcpy(&grown[*num_indices], simplifier.indices, sizeof(unsigned int) * reached);
+        seel_mesh_optimize_vertex_cache(&grown[*num_indices], reached, num_vertices);
+        lods[num_lods++] = (struct MeshLod){*num_indices, reached, sqrtf(simplifier.error)};
+        *num_indices += reached;
+    }
+
+    seel_mesh_simplifier_destroy(&simplifier);
+    return num_lods;
+}
+
+#endif /* MESH_SIMPLIFY_H */
@@ -0,0 +1,222 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "cglm/cglm.h"
+#include "mesh.h"
+#include "mesh_simplify.h"
+
+/*
+ * Meshlets split the full detail level of a mesh into clusters small enough
+ * to be culled on their own. The builder cuts the cache optimized triangle
+ * order into consecutive runs, so a meshlet is a range of the existing
+ * index buffer and visible meshlets are drawn as a list of ranges.
+ */
+
+/* Meshlets whose triangles face more than this far apart get no cone */
+#define SEEL_MESHLET_MIN_CONE_DOT 0.1f
+
+/* Bounding sphere and normal cone of the triangles in indices[first, first + count) */
+static void seel_meshlet_bounds(struct Meshlet *meshlet, const struct Vertex *vertices, const unsigned int *indices, bool cone)
+{
+    vec3 min = {FLT_MAX, FLT_MAX, FLT_MAX}, max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    const unsigned int *triangles = &indices[meshlet->first_index];
+    unsigned int i, j;
+    for (i = 0; i < meshlet->num_indices; i++)
+    {
+        glm_vec3_minv(min, (float *)vertices[triangles[i]].position, min);
+        glm_vec3_maxv(max, (float *)vertices[triangles[i]].position, max);
+    }
+    glm_vec3_center(min, max, meshlet->center);
+    meshlet->radius = 0.0f;
+    for (i = 0; i < meshlet->num_indices; i++)
+        meshlet->radius = glm_max(meshlet->radius, glm_vec3_distance(meshlet->center, (float *)vertices[triangles[i]].position));
+
+    vec3 normals[MESHLET_MAX_TRIANGLES];
+    unsigned int num_normals = 0;
+    glm_vec3_zero(meshlet->cone_axis);
+    for (i = 0; i < meshlet->num_indices; i += 3)
+    {
+        vec3 ab, ac;
+        glm_vec3_sub((float *)vertices[triangles[i + 1]].position, (float *)vertices[triangles[i]].position, ab);
+        glm_vec3_sub((float *)vertices[triangles[i + 2]].position, (float *)vertices[triangles[i]].position, ac);
+        glm_vec3_cross(ab, ac, normals[num_normals]);
+        if (glm_vec3_norm(normals[num_normals]) <= 0.0f)
+            continue;
+        glm_vec3_normalize(normals[num_normals]);
+        glm_vec3_add(meshlet->cone_axis, normals[num_normals], meshlet->cone_axis);
+        num_normals++;
+    }
+
+    /* the cone holds every triangle normal; too wide a cone, or an open mesh whose back faces show, never culls */
+    meshlet->cone_cutoff = 1.0f;
+    if (!cone || !num_normals || glm_vec3_norm(meshlet->cone_axis) <= 0.0f)
+        return;
+    glm_vec3_normalize(meshlet->cone_axis);
+
+    float min_dot = 1.0f;
+    for (j = 0; j < num_normals; j++)
+        min_dot = glm_min(min_dot, glm_vec3_dot(meshlet->cone_axis, normals[j]));
+    if (min_dot > SEEL_MESHLET_MIN_CONE_DOT)
+        meshlet->cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+}
+
+/* True when every edge between positions has a twin, i.e. no back face can be seen from outside */
+static bool seel_meshlet_mesh_closed(const struct Vertex *vertices, unsigned int num_vertices, const unsigned int *indices, unsigned int num_indices)
+{
+    unsigned int *remap = malloc(sizeof(unsigned int) * (num_vertices ? num_vertices : 1));
+    struct SimplifyEdgeSet edges = {0};
+    if (!remap || !seel_edge_set_init(&edges, num_indices) || !seel_mesh_remap_positions(vertices, num_vertices, remap, NULL))
+    {
+        free(remap);
+        free(edges.keys);
+        return false;
+    }
+
+    unsigned int i;
+    for (i = 0; i < num_indices; i++)
+        seel_edge_set_insert(&edges, remap[indices[i]], remap[indices[i - i % 3 + (i + 1) % 3]]);
+
+    bool closed = true;
+    for (i = 0; i < num_indices && closed; i++)
+        closed = seel_edge_set_contains(&edges, remap[indices[i - i % 3 + (i + 1) % 3]], remap[indices[i]]);
+
+    free(remap);
+    free(edges.keys);
+    return closed;
+}
+
+/*
+ * Cuts the triangles in indices[0, num_indices) into meshlets in order and
+ * returns how many; *meshlets is allocated and owned by the caller.
+ */
+unsigned int seel_meshlet_build(const struct Vertex *vertices, unsigned int num_vertices, const unsigned int *indices, unsigned int num_indices,
+                                struct Meshlet **meshlets)
+{
+    *meshlets = NULL;
+    if (num_indices < 3)
+        return 0;
+
+    /* never more meshlets than triangles */
+    struct Meshlet *built = malloc(sizeof(struct Meshlet) * (num_indices / 3));
+    unsigned int *owner = malloc(sizeof(unsigned int) * (num_vertices ? num_vertices : 1));
+    if (!built || !owner)
+    {
+        fprintf(stderr, "Failed to allocate memory for meshlets!\n");
+        free(built);
+        free(owner);
+        return 0;
+    }
+    memset(owner, 0xff, sizeof(unsigned int) * num_vertices);
+
+    bool cone = seel_meshlet_mesh_closed(vertices, num_vertices, indices, num_indices);
+    unsigned int num_meshlets = 0, meshlet_vertices = 0, i, j;
+    struct Meshlet *meshlet = NULL;
+    for (i = 0; i + 2 < num_indices; i += 3)
+    {
+        unsigned int added = 0;
+        for (j = 0; j < 3; j++)
+            added += !meshlet || owner[indices[i + j]] != num_meshlets - 1;
+
+        if (!meshlet || meshlet_vertices + added > MESHLET_MAX_VERTICES || meshlet->num_indices / 3 == MESHLET_MAX_TRIANGLES)
+        {
+            if (meshlet)
+                seel_meshlet_bounds(meshlet, vertices, indices, cone);
+            meshlet = &built[num_meshlets++];
+            memset(meshlet, 0, sizeof(struct Meshlet));
+            meshlet->first_index = i;
+            meshlet_vertices = 0;
+        }
+
+        for (j = 0; j < 3; j++)
+        {
+            if (owner[indices[i + j]] != num_meshlets - 1)
+            {
+                owner[indices[i + j]] = num_meshlets - 1;
+                meshlet_vertices++;
+            }
+        }
+        meshlet->num_indices += 3;
+    }
+    seel_meshlet_bounds(meshlet, vertices, indices, cone);
+
+    free(owner);
+    *meshlets = realloc(built, sizeof(struct Meshlet) * num_meshlets);
+    if (!*meshlets)
+        *meshlets = built;
+    return num_meshlets;
+}
+
+/* What a mesh is culled against: frustum planes and camera position in the mesh's own space */
+struct MeshletCullView
+{
+    vec4 planes[6];
+    vec3 camera;
+};
+
+/*
+ * Brings the world space view into model space. Plane tests and the cone
+ * test only depend on signs that an affine model matrix preserves, so the
+ * meshlet bounds never need transforming.
+ */
+void seel_meshlet_cull_view(struct MeshletCullView *view, mat4 view_projection, mat4 model, vec3 camera_position)
+{
+    mat4 model_view_projection, inverse;
+    glm_mat4_mul(view_projection, model, model_view_projection);
+    glm_frustum_planes(model_view_projection, view->planes);
+    glm_mat4_inv(model, inverse);
+    glm_mat4_mulv3(inverse, camera_position, 1.0f, view->camera);
+}
+
+static bool seel_meshlet_visible(const struct Meshlet *meshlet, const struct MeshletCullView *view)
+{
+    unsigned int i;
+    for (i = 0; i < 6; i++)
+    {
+        if (glm_vec3_dot((float *)view->planes[i], (float *)meshlet->center) + view->planes[i][3] < -meshlet->radius)
+            return false;
+    }
+
+    /* back facing when the camera sits inside the cone's negative half everywhere on the sphere */
+    vec3 to_center;
+    glm_vec3_sub((float *)meshlet->center, (float *)view->camera, to_center);
+    return glm_vec3_dot(to_center, (float *)meshlet->cone_axis) < meshlet->cone_cutoff * glm_vec3_norm(to_center) + meshlet->radius;
+}
+
+/*
+ * Culls the mesh's meshlets and writes the visible ones as index ranges for
+ * seel_mesh_draw_ranges, merging neighbours; counts, offsets and
+ * base_vertices hold num_meshlets entries. Returns the number of ranges and
+ * adds the visible triangles to *triangles.
+ */
+unsigned int seel_meshlet_cull(const struct Mesh *mesh, const struct MeshletCullView *view, GLsizei *counts, const void **offsets, GLint *base_vertices,
+                               unsigned int *triangles)
+{
+    unsigned int num_ranges = 0, end = UINT32_MAX, i;
+    for (i = 0; i < mesh->num_meshlets; i++)
+    {
+        const struct Meshlet *meshlet = &mesh->meshlets[i];
+        if (!seel_meshlet_visible(meshlet, view))
+            continue;
+
+        if (meshlet->first_index == end)
+            counts[num_ranges - 1] += meshlet->num_indices;
+        else
+        {
+            counts[num_ranges] = meshlet->num_indices;
+            offsets[num_ranges] = seel_mesh_index_offset(mesh, meshlet->first_index);
+            base_vertices[num_ranges] = (GLint)mesh->base_vertex;
+            num_ranges++;
+        }
+        end = meshlet->first_index + meshlet->num_indices;
+        *triangles += meshlet->num_indices / 3;
+    }
+    return num_ranges;
+}
+
+#endif /* MESHLET_H */
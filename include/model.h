@@ -1,6 +1,8 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <sys/mman.h>
+
 #include "assimp/cimport.h"
 #include "assimp/scene.h"
 #include "assimp/postprocess.h"
@@ -8,12 +10,28 @@
 #include "cglm/cglm.h"
 
 #include "mesh.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplify.h"
+#include "meshlet.h"
 #include "shader.h"
 #include "texture.h"
+#include "texture_file.h"
 #include "bone.h"
+#include "job_pool.h"
 
 #define MAX_DIRECTORY_LEN 1024
+/* Bones a single draw skins with, i.e. the size limit of a mesh's bone palette */
 #define MAX_BONES 100
+/* Bones of a whole model; meshes only reference MAX_BONES of them each */
+#define MAX_MODEL_BONES 1024
+
+/* Node of the model's hierarchy, flattened so parents come before their children */
+struct ModelNode
+{
+    char name[MAX_BONE_NAME_LEN];
+    int parent;
+    mat4 transformation;
+};
 
 struct Model
 {
@@ -23,9 +41,16 @@ struct Model
     unsigned int num_meshes;
     char name[256];
     char directory[MAX_DIRECTORY_LEN];
-    struct BoneInfo bone_info[MAX_BONES];
+    struct BoneInfo bone_info[MAX_MODEL_BONES];
     unsigned int bone_counter;
+    struct ModelNode *nodes;
+    unsigned int num_nodes;
     bool animated;
+    struct Bounds bounds; /* of every mesh's bind pose */
+    struct MeshOptimizeReport optimize_report; /* totals of an Assimp import, for the cooker to print */
+    bool cpu_only;      /* imported for cooking: nothing is uploaded to GL */
+    void *cooked_data;  /* mapping of a .seelmesh file the meshes' packed vertices and indices point into */
+    size_t cooked_size;
 };
 
 void seel_set_vertex_bone_data_to_default(struct Vertex *vertex)
@@ -95,6 +120,12 @@ void seel_extract_bone_weight_for_vertices(struct Vertex *vertices, struct aiMes
         /* If not found, create a new bone entry */
         if (bone_id == -1)
         {
+            if (model->bone_counter >= MAX_MODEL_BONES)
+            {
+                fprintf(stderr, "Too many bones in model, skipping bone %s!\n", bone_name);
+                continue;
+            }
+
             bone_id = model->bone_counter;
             model->bone_info[model->bone_counter].id = bone_id;
             strcpy(model->bone_info[model->bone_counter].name, bone_name);
@@ -147,9 +178,9 @@ struct Texture *seel_load_material_textures(struct Model *m, struct aiMaterial *
         }
         if (!skip)
         { /* if texture hasn't been loaded already, load it */
-            char path[MAX_DIRECTORY_LEN];
-            strcpy(path, m->directory);
-            struct Texture texture = seel_texture_create(strcat(path, str.data), tex_type);
+            struct Texture texture = {.type = tex_type};
+            if (!m->cpu_only)
+                glGenTextures(1, &texture.id); /* filled by seel_model_load_textures once every image is decoded */
             strcpy(texture.name, str.data);
             textures[i] = texture;
             m->textures_loaded = realloc(m->textures_loaded, sizeof(struct Texture) * (m->num_textures + 1));
@@ -161,7 +192,313 @@ struct Texture *seel_load_material_textures(struct Model *m, struct aiMaterial *
     return textures;
 }
 
-struct Mesh seel_process_mesh(struct Model *model, struct aiMesh *mesh, const struct aiScene *scene)
+/* Decodes one image per texture of textures_loaded, indexed like it */
+struct ModelTextureJob
+{
+    const struct Model *model;
+    struct TextureImage *images;
+};
+
+static void seel_model_texture_job(void *context, unsigned int begin, unsigned int end, unsigned int worker)
+{
+    struct ModelTextureJob *job = (struct ModelTextureJob *)context;
+    (void)worker;
+
+    unsigned int i;
+    for (i = begin; i < end; i++)
+    {
+        char path[MAX_DIRECTORY_LEN + MAX_TEXTURE_NAME_LEN];
+        snprintf(path, sizeof(path), "%s%s", job->model->directory, job->model->textures_loaded[i].name);
+        seel_texture_decode_cached(path, &job->images[i]);
+    }
+}
+
+/*
+ * Fills the texture objects generated for textures_loaded. All images are
+ * decoded first, spread over the job pool when there is one, and only then
+ * uploaded on the calling thread, which owns the GL context.
+ */
+void seel_model_load_textures(struct Model *model, struct JobPool *pool)
+{
+    if (model->cpu_only || !model->num_textures)
+        return;
+
+    struct ModelTextureJob job = {model, calloc(model->num_textures, sizeof(struct TextureImage))};
+    if (!job.images)
+    {
+        fprintf(stderr, "Failed to allocate memory for decoded textures!\n");
+        return;
+    }
+
+    if (pool)
+    {
+        seel_job_pool_dispatch(pool, seel_model_texture_job, &job, model->num_textures, 1);
+        seel_job_pool_wait(pool);
+    }
+    else
+    {
+        seel_model_texture_job(&job, 0, model->num_textures, 0);
+    }
+
+    unsigned int i;
+    for (i = 0; i < model->num_textures; i++)
+    {
+        seel_texture_upload(model->textures_loaded[i].id, &job.images[i]);
+        seel_texture_image_free(&job.images[i]);
+    }
+    free(job.images);
+}
+
+/* Points the meshes' copies of textures_loaded entries at texture objects generated after the meshes were built */
+void seel_model_bind_texture_ids(struct Model *model)
+{
+    unsigned int i, j, k;
+    for (i = 0; i < model->num_meshes; i++)
+    {
+        struct Mesh *mesh = &model->meshes[i];
+        for (j = 0; j < mesh->num_textures; j++)
+        {
+            for (k = 0; k < model->num_textures; k++)
+            {
+                if (strcmp(mesh->textures[j].name, model->textures_loaded[k].name) == 0)
+                {
+                    mesh->textures[j].id = model->textures_loaded[k].id;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void seel_model_append_mesh(struct Model *model, struct Mesh mesh)
+{
+    struct Mesh *meshes = realloc(model->meshes, sizeof(struct Mesh) * (model->num_meshes + 1));
+    if (!meshes)
+    {
+        fprintf(stderr, "Failed to reallocate memory for model meshes!\n");
+        return;
+    }
+    model->meshes = meshes;
+    model->meshes[model->num_meshes++] = mesh;
+}
+
+/* Cooking imports keep meshes on the CPU only */
+static struct Mesh seel_model_create_mesh(struct Model *model, struct Vertex *vertices, unsigned int *indices, struct Texture *textures,
+                                          unsigned int num_vertices, unsigned int num_indices, unsigned int num_textures)
+{
+    if (!model->cpu_only)
+        return seel_mesh_init(vertices, indices, textures, num_vertices, num_indices, num_textures);
+
+    struct Mesh mesh = {0};
+    mesh.vertices = vertices;
+    mesh.indices = indices;
+    mesh.textures = textures;
+    mesh.num_vertices = num_vertices;
+    mesh.num_indices = num_indices;
+    mesh.num_textures = num_textures;
+    mesh.layout = seel_mesh_default_layout;
+    seel_mesh_compute_bounds(&mesh);
+    return mesh;
+}
+
+/*
+ * Builds the detail levels of an imported mesh, which reallocates indices,
+ * and the meshlets of its full level, then creates it with its bone palette
+ * and appends it to the model.
+ */
+static void seel_model_add_mesh_lods(struct Model *model, struct Vertex *vertices, unsigned int *indices, struct Texture *textures, unsigned int num_vertices,
+                                     unsigned int num_indices, unsigned int num_textures, const unsigned int *palette, unsigned int num_palette)
+{
+    struct MeshLod lods[MAX_MESH_LODS];
+    unsigned int num_lods = seel_mesh_build_lods(vertices, num_vertices, &indices, &num_indices, lods, MAX_MESH_LODS);
+
+    struct Meshlet *meshlets;
+    unsigned int num_meshlets = seel_meshlet_build(vertices, num_vertices, indices, lods[0].num_indices, &meshlets);
+
+    struct Mesh mesh = seel_model_create_mesh(model, vertices, indices, textures, num_vertices, num_indices, num_textures);
+    memcpy(mesh.lods, lods, sizeof(struct MeshLod) * num_lods);
+    mesh.num_lods = num_lods;
+    mesh.meshlets = meshlets;
+    mesh.num_meshlets = num_meshlets;
+    seel_mesh_set_bone_palette(&mesh, palette, num_palette);
+    seel_model_append_mesh(model, mesh);
+}
+
+/*
+ * Adds the bones of a vertex's influences to the palette being built;
+ * local maps model bone ids to palette slots (-1 when not in the palette).
+ * Returns how many bones the vertex would add, without adding them when
+ * that exceeds MAX_BONES.
+ */
+static unsigned int seel_palette_add_vertex(const struct Vertex *vertex, int *local, unsigned int *palette, unsigned int *num_palette, bool commit)
+{
+    unsigned int added = 0;
+    unsigned int i;
+    for (i = 0; i < MAX_BONE_INFLUENCE; i++)
+    {
+        int bone = vertex->m_bone_ids[i];
+        if (bone < 0 || local[bone] >= 0)
+            continue;
+        if (commit)
+        {
+            local[bone] = *num_palette;
+            palette[(*num_palette)++] = bone;
+        }
+        added++;
+    }
+    return added;
+}
+
+static void seel_vertex_remap_bones(struct Vertex *vertex, const int *local)
+{
+    unsigned int i;
+    for (i = 0; i < MAX_BONE_INFLUENCE; i++)
+    {
+        if (vertex->m_bone_ids[i] >= 0)
+            vertex->m_bone_ids[i] = local[vertex->m_bone_ids[i]];
+    }
+}
+
+/* Part of a mesh being split, with its own vertices and bone palette */
+struct MeshPart
+{
+    struct Vertex *vertices;
+    unsigned int *indices;
+    unsigned int num_vertices;
+    unsigned int num_indices;
+    unsigned int *palette;
+    unsigned int num_palette;
+    int *local;      /* model bone id -> palette slot, -1 when absent */
+    int *vertex_map; /* source vertex -> part vertex, -1 when absent */
+};
+
+static void seel_mesh_part_flush(struct Model *model, struct MeshPart *part, struct Texture *textures, unsigned int num_textures, unsigned int num_source_vertices)
+{
+    if (!part->num_indices)
+        return;
+
+    unsigned int i;
+    for (i = 0; i < part->num_vertices; i++)
+        seel_vertex_remap_bones(&part->vertices[i], part->local);
+
+    struct Vertex *vertices = malloc(sizeof(struct Vertex) * part->num_vertices);
+    unsigned int *indices = malloc(sizeof(unsigned int) * part->num_indices);
+    struct Texture *part_textures = malloc(sizeof(struct Texture) * (num_textures ? num_textures : 1));
+    if (vertices && indices && part_textures)
+    {
+        memcpy(vertices, part->vertices, sizeof(struct Vertex) * part->num_vertices);
+        memcpy(indices, part->indices, sizeof(unsigned int) * part->num_indices);
+        memcpy(part_textures, textures, sizeof(struct Texture) * num_textures);
+
+        seel_model_add_mesh_lods(model, vertices, indices, part_textures, part->num_vertices, part->num_indices, num_textures, part->palette, part->num_palette);
+    }
+    else
+    {
+        fprintf(stderr, "Failed to allocate memory for mesh part!\n");
+        free(vertices);
+        free(indices);
+        free(part_textures);
+    }
+
+    for (i = 0; i < part->num_palette; i++)
+        part->local[part->palette[i]] = -1;
+    memset(part->vertex_map, -1, sizeof(int) * num_source_vertices);
+    part->num_palette = 0;
+    part->num_vertices = 0;
+    part->num_indices = 0;
+}
+
+/*
+ * Appends a mesh whose vertex bone ids are model bone ids. The ids are
+ * remapped into a compact mesh palette of only the bones the mesh uses,
+ * so a draw uploads just those matrices. A mesh needing more than
+ * MAX_BONES bones is split by triangles into parts that each fit.
+ */
+void seel_model_add_mesh(struct Model *model, struct Vertex *vertices, unsigned int *indices, struct Texture *textures, unsigned int num_vertices, unsigned int num_indices, unsigned int num_textures)
+{
+    struct MeshPart part = {0};
+    part.local = malloc(sizeof(int) * MAX_MODEL_BONES);
+    part.palette = malloc(sizeof(unsigned int) * MAX_MODEL_BONES);
+    if (!part.local || !part.palette)
+    {
+        fprintf(stderr, "Failed to allocate memory for mesh bone palette!\n");
+        free(part.local);
+        free(part.palette);
+        return;
+    }
+    memset(part.local, -1, sizeof(int) * MAX_MODEL_BONES);
+
+    unsigned int i;
+    for (i = 0; i < num_vertices; i++)
+        seel_palette_add_vertex(&vertices[i], part.local, part.palette, &part.num_palette, true);
+
+    if (part.num_palette <= MAX_BONES)
+    {
+        for (i = 0; i < num_vertices; i++)
+            seel_vertex_remap_bones(&vertices[i], part.local);
+
+        seel_model_add_mesh_lods(model, vertices, indices, textures, num_vertices, num_indices, num_textures, part.palette, part.num_palette);
+        free(part.local);
+        free(part.palette);
+        return;
+    }
+
+    part.vertex_map = malloc(sizeof(int) * num_vertices);
+    part.vertices = malloc(sizeof(struct Vertex) * num_vertices);
+    part.indices = malloc(sizeof(unsigned int) * num_indices);
+    if (!part.vertex_map || !part.vertices || !part.indices)
+    {
+        fprintf(stderr, "Failed to allocate memory for mesh split!\n");
+    }
+    else
+    {
+        memset(part.vertex_map, -1, sizeof(int) * num_vertices);
+        memset(part.local, -1, sizeof(int) * MAX_MODEL_BONES);
+        part.num_palette = 0;
+
+        unsigned int num_parts = 0;
+        unsigned int triangle;
+        for (triangle = 0; triangle + 2 < num_indices; triangle += 3)
+        {
+            /* start a new part when the triangle's bones would overflow the palette */
+            unsigned int needed = 0;
+            for (i = 0; i < 3; i++)
+                needed += seel_palette_add_vertex(&vertices[indices[triangle + i]], part.local, part.palette, &part.num_palette, false);
+            if (part.num_palette + needed > MAX_BONES)
+            {
+                seel_mesh_part_flush(model, &part, textures, num_textures, num_vertices);
+                num_parts++;
+            }
+
+            for (i = 0; i < 3; i++)
+            {
+                unsigned int index = indices[triangle + i];
+                seel_palette_add_vertex(&vertices[index], part.local, part.palette, &part.num_palette, true);
+                if (part.vertex_map[index] < 0)
+                {
+                    part.vertex_map[index] = part.num_vertices;
+                    part.vertices[part.num_vertices++] = vertices[index];
+                }
+                part.indices[part.num_indices++] = part.vertex_map[index];
+            }
+        }
+        seel_mesh_part_flush(model, &part, textures, num_textures, num_vertices);
+        num_parts++;
+
+        fprintf(stderr, "Split mesh skinned by more than %d bones into %u parts!\n", MAX_BONES, num_parts);
+    }
+
+    free(part.vertex_map);
+    free(part.vertices);
+    free(part.indices);
+    free(part.local);
+    free(part.palette);
+    free(vertices);
+    free(indices);
+    free(textures);
+}
+
+void seel_process_mesh(struct Model *model, struct aiMesh *mesh, const struct aiScene *scene)
 {
     struct Vertex *vertices = malloc(sizeof(struct Vertex) * mesh->mNumVertices);
     unsigned int *indices = NULL;
@@ -170,7 +507,9 @@ struct Mesh seel_process_mesh(struct Model *model, struct aiMesh *mesh, const st
     unsigned int i;
     for (i = 0; i < mesh->mNumVertices; i++)
     {
+        /* cleared so padding and missing attributes compare equal when welding */
         struct Vertex vertex;
+        memset(&vertex, 0, sizeof(struct Vertex));
         seel_set_vertex_bone_data_to_default(&vertex);
 
         vec3 vector;
@@ -220,7 +559,7 @@ struct Mesh seel_process_mesh(struct Model *model, struct aiMesh *mesh, const st
         }
         else
         {
-            glm_vec2_copy(vertex.tex_coords, (vec2){0.0f, 0.0f});
+            glm_vec2_zero(vertex.tex_coords);
         }
         /* process vertex positions, normals and texture coordinates */
         vertices[i] = vertex;
@@ -291,7 +630,13 @@ struct Mesh seel_process_mesh(struct Model *model, struct aiMesh *mesh, const st
 
     seel_extract_bone_weight_for_vertices(vertices, mesh, model);
 
-    return seel_mesh_init(vertices, indices, textures, mesh->mNumVertices, num_indices, num_textures);
+    /* weld and reorder once bone weights are in, so only truly identical vertices merge */
+    unsigned int num_vertices = mesh->mNumVertices;
+    struct MeshOptimizeReport report;
+    seel_mesh_optimize(vertices, &num_vertices, indices, num_indices, &report);
+    seel_mesh_optimize_report_add(&model->optimize_report, &report);
+
+    seel_model_add_mesh(model, vertices, indices, textures, num_vertices, num_indices, num_textures);
 }
 
 void seel_process_node(struct Model *model, struct aiNode *node, const struct aiScene *scene)
@@ -301,8 +646,7 @@ void seel_process_node(struct Model *model, struct aiNode *node, const struct ai
     for (i = 0; i < node->mNumMeshes; i++)
     {
         struct aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        model->meshes = realloc(model->meshes, sizeof(struct Mesh) * (model->num_meshes + 1));
-        model->meshes[model->num_meshes++] = seel_process_mesh(model, mesh, scene);
+        seel_process_mesh(model, mesh, scene);
     }
 
     /* then do the same for each of its children */
@@ -312,9 +656,59 @@ void seel_process_node(struct Model *model, struct aiNode *node, const struct ai
     }
 }
 
-struct Model seel_model_load(const char *path)
+static unsigned int seel_count_nodes(const struct aiNode *node)
+{
+    unsigned int count = 1;
+    unsigned int i;
+    for (i = 0; i < node->mNumChildren; i++)
+        count += seel_count_nodes(node->mChildren[i]);
+    return count;
+}
+
+static void seel_flatten_nodes(struct Model *model, const struct aiNode *node, int parent)
+{
+    int index = model->num_nodes++;
+    struct ModelNode *flat = &model->nodes[index];
+    snprintf(flat->name, sizeof(flat->name), "%.*s", (int)sizeof(flat->name) - 1, node->mName.data);
+    flat->parent = parent;
+    seel_ai_matrix_to_glm_mat4(&node->mTransformation, flat->transformation);
+
+    unsigned int i;
+    for (i = 0; i < node->mNumChildren; i++)
+        seel_flatten_nodes(model, node->mChildren[i], index);
+}
+
+/* Fits the model's bounds around those of its meshes */
+void seel_model_update_bounds(struct Model *model)
+{
+    seel_bounds_clear(&model->bounds);
+    unsigned int i;
+    for (i = 0; i < model->num_meshes; i++)
+        seel_bounds_merge(&model->bounds, &model->meshes[i].bounds);
+}
+
+/* Bounds of the model posed by palette, see seel_mesh_posed_bounds */
+void seel_model_posed_bounds(const struct Model *model, mat4 *palette, unsigned int palette_size, struct Bounds *bounds)
+{
+    seel_bounds_clear(bounds);
+    unsigned int i;
+    for (i = 0; i < model->num_meshes; i++)
+    {
+        struct Bounds mesh_bounds;
+        seel_mesh_posed_bounds(&model->meshes[i], palette, palette_size, &mesh_bounds);
+        seel_bounds_merge(bounds, &mesh_bounds);
+    }
+}
+
+/*
+ * Loads a model through Assimp; without upload nothing touches GL, which is
+ * how the cooker imports. With upload the texture objects are only generated,
+ * seel_model_load_textures fills them.
+ */
+struct Model seel_model_import(const char *path, bool upload)
 {
     struct Model m = {0};
+    m.cpu_only = !upload;
 
     const struct aiScene *scene = aiImportFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
 
@@ -333,17 +727,141 @@ struct Model seel_model_load(const char *path)
     strncpy(m.name, name + 1, strlen(name + 1));
 
     seel_process_node(&m, scene->mRootNode, scene);
+    seel_model_update_bounds(&m);
+
+    m.nodes = malloc(sizeof(struct ModelNode) * seel_count_nodes(scene->mRootNode));
+    if (m.nodes)
+        seel_flatten_nodes(&m, scene->mRootNode, -1);
+    else
+        fprintf(stderr, "Failed to allocate memory for model nodes!\n");
 
     aiReleaseImport(scene);
 
     return m;
 }
 
+/* pool decodes the model's textures in parallel; NULL decodes them on the calling thread */
+struct Model seel_model_load(const char *path, struct JobPool *pool)
+{
+    struct Model m = seel_model_import(path, true);
+    seel_model_load_textures(&m, pool);
+    return m;
+}
+
+/* Bytes the model holds on the CPU: the struct, mesh arrays (or the cooked mapping), textures and nodes */
+size_t seel_model_cpu_size(const struct Model *model)
+{
+    size_t size = sizeof(struct Model) + model->cooked_size + model->num_textures * sizeof(struct Texture) +
+                  model->num_nodes * sizeof(struct ModelNode) + model->num_meshes * sizeof(struct Mesh);
+
+    unsigned int i;
+    for (i = 0; i < model->num_meshes; i++)
+    {
+        const struct Mesh *mesh = &model->meshes[i];
+        size += mesh->num_textures * sizeof(struct Texture) + mesh->num_palette_bones * sizeof(unsigned int) +
+                mesh->num_bone_bounds * sizeof(struct Bounds);
+        if (!model->cooked_data)
+            size += mesh->num_vertices * sizeof(struct Vertex) + mesh->num_indices * sizeof(unsigned int) + mesh->num_meshlets * sizeof(struct Meshlet);
+    }
+    return size;
+}
+
+/* Bytes of the model's vertex, index and texture objects; call on the GL thread */
+size_t seel_model_gpu_size(const struct Model *model)
+{
+    if (model->cpu_only)
+        return 0;
+
+    size_t size = 0;
+    unsigned int i;
+    for (i = 0; i < model->num_meshes; i++)
+        size += seel_mesh_vertex_buffer_size(&model->meshes[i]) + seel_mesh_index_buffer_size(&model->meshes[i]);
+    for (i = 0; i < model->num_textures; i++)
+        size += seel_texture_gpu_size(model->textures_loaded[i].id);
+    return size;
+}
+
+/* Releases the model's GL objects and every array it owns; call on the GL thread unless the model is cpu_only */
+void seel_model_destroy(struct Model *model)
+{
+    unsigned int i;
+    for (i = 0; i < model->num_meshes; i++)
+    {
+        struct Mesh *mesh = &model->meshes[i];
+        seel_mesh_release(mesh);
+        if (!model->cooked_data)
+        {
+            free(mesh->vertices);
+            free(mesh->indices);
+            free(mesh->meshlets);
+        }
+        free(mesh->textures);
+        free(mesh->bone_palette);
+        free(mesh->bone_bounds);
+    }
+
+    for (i = 0; i < model->num_textures; i++)
+    {
+        if (model->textures_loaded[i].id)
+            glDeleteTextures(1, &model->textures_loaded[i].id);
+    }
+
+    free(model->meshes);
+    free(model->textures_loaded);
+    free(model->nodes);
+    if (model->cooked_data)
+        munmap(model->cooked_data, model->cooked_size);
+    memset(model, 0, sizeof(struct Model));
+}
+
+/* Detail levels of the model: those of its most detailed mesh, at least one */
+unsigned int seel_model_num_lods(const struct Model *model)
+{
+    unsigned int num_lods = 1, i;
+    for (i = 0; i < model->num_meshes; i++)
+    {
+        if (model->meshes[i].num_lods > num_lods)
+            num_lods = model->meshes[i].num_lods;
+    }
+    return num_lods;
+}
+
+/* Largest error of any mesh drawn at the level, in model units */
+float seel_model_lod_error(const struct Model *model, unsigned int lod)
+{
+    float error = 0.0f;
+    unsigned int i;
+    for (i = 0; i < model->num_meshes; i++)
+        error = glm_max(error, seel_mesh_lod(&model->meshes[i], lod).error);
+    return error;
+}
+
+/* Triangles the model submits at the level */
+unsigned int seel_model_lod_triangles(const struct Model *model, unsigned int lod)
+{
+    unsigned int triangles = 0, i;
+    for (i = 0; i < model->num_meshes; i++)
+        triangles += seel_mesh_lod(&model->meshes[i], lod).num_indices / 3;
+    return triangles;
+}
+
+void seel_model_draw_lod(struct Model *model, struct Shader *shader, unsigned int lod)
+{
+    unsigned int i;
+    for (i = 0; i < model->num_meshes; i++)
+        seel_mesh_draw_lod(&model->meshes[i], shader, lod);
+}
+
 void seel_model_draw(struct Model *model, struct Shader *shader)
+{
+    seel_model_draw_lod(model, shader, 0);
+}
+
+void seel_model_draw_instanced(struct Model *model, struct Shader *shader, unsigned int instance_vbo, unsigned int instance_stride, unsigned int count)
 {
     unsigned int i;
     for (i = 0; i < model->num_meshes; i++)
-        seel_mesh_draw(model->meshes[i], shader);
+        seel_mesh_draw_instanced(&model->meshes[i], shader, instance_vbo, instance_stride, count);
 }
 
 #endif /* MODEL_H */
\ No newline at end of file
@@ -16,6 +16,32 @@
 #include "light.h"
 #include "animator.h"
 #include "texture.h"
+#include "baked_animation.h"
+#include "skinning.h"
+#include "meshlet.h"
+#include "frustum.h"
+
+/* Shader storage binding of the BonePalette block in default.vert */
+#define SEEL_BONE_PALETTE_BINDING 0
+/* Palettes remembered per frame so draws sharing a pose upload it once */
+#define SEEL_BONE_PALETTE_CACHE_SIZE 16
+
+/* Frustum culling counters, reset by seel_renderer_begin_frame */
+struct RendererCullStats
+{
+    unsigned int nodes_visible;
+    unsigned int nodes_culled;
+    unsigned int meshes_visible;
+    unsigned int meshes_culled;
+};
+
+struct BonePaletteUpload
+{
+    const mat4 *matrices;
+    const unsigned int *remap;
+    unsigned int count;
+    unsigned int offset;
+};
 
 struct Renderer
 {
@@ -29,12 +55,34 @@ struct Renderer
     bool enable_blending;
     struct Shader *active_shader;
     struct Camera *camera;
+    unsigned int bone_palette_ssbo;
+    unsigned int bone_palette_size;
+    unsigned int bone_palette_offset;
+    int bone_palette_alignment;
+    struct BonePaletteUpload bone_palette_uploads[SEEL_BONE_PALETTE_CACHE_SIZE];
+    unsigned int num_bone_palette_uploads;
+    mat4 bone_palette_scratch[MAX_BONES];
+    unsigned int crowd_instance_vbo;
+    unsigned int frame;
+    unsigned int triangles; /* submitted this frame, instances included */
+    bool compute_skinning;
+    bool skinning_pending; /* dispatches not yet made visible to vertex fetch */
+    struct SkinningProgram skinning_program;
+    bool cluster_culling;
+    GLsizei *cull_counts; /* visible meshlet ranges of the mesh being drawn */
+    const void **cull_offsets;
+    GLint *cull_base_vertices;
+    unsigned int cull_capacity;
+    bool frustum_culling;
+    struct RendererCullStats cull_stats;
 };
 
 void seel_renderer_init(struct Renderer *renderer, struct RendererConfig *config, struct Camera *cam);
 void seel_renderer_begin_frame(struct Renderer *renderer);
 void seel_renderer_end_frame(void);
 void seel_renderer_set_clear_color(struct Renderer *renderer, vec3 color);
+bool seel_renderer_enable_compute_skinning(struct Renderer *renderer, const char *cs_path);
+void seel_renderer_cleanup(struct Renderer *renderer);
 
 void seel_renderer_init(struct Renderer *renderer, struct RendererConfig *config, struct Camera *cam)
 {
@@ -58,6 +106,38 @@ void seel_renderer_init(struct Renderer *renderer, struct RendererConfig *config
         glDebugMessageCallback(seel_gl_debug_output, NULL);
         glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
     }
+
+    /*
+     * Bone palettes of every skinned draw in a frame are appended to one
+     * shader storage buffer, which is orphaned at the start of the next frame.
+     */
+    renderer->bone_palette_size = config->bone_palette_buffer_size;
+    renderer->bone_palette_offset = 0;
+    renderer->num_bone_palette_uploads = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &renderer->bone_palette_alignment);
+    if (renderer->bone_palette_alignment <= 0)
+        renderer->bone_palette_alignment = 256;
+
+    glGenBuffers(1, &renderer->bone_palette_ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderer->bone_palette_ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, renderer->bone_palette_size, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenBuffers(1, &renderer->crowd_instance_vbo);
+
+    renderer->frame = 0;
+    renderer->triangles = 0;
+    renderer->compute_skinning = false;
+    renderer->skinning_pending = false;
+
+    renderer->cluster_culling = config->enable_cluster_culling;
+    renderer->cull_counts = NULL;
+    renderer->cull_offsets = NULL;
+    renderer->cull_base_vertices = NULL;
+    renderer->cull_capacity = 0;
+
+    renderer->frustum_culling = config->enable_frustum_culling;
+    memset(&renderer->cull_stats, 0, sizeof(struct RendererCullStats));
 }
 
 void seel_renderer_begin_frame(struct Renderer *renderer)
@@ -66,6 +146,72 @@ void seel_renderer_begin_frame(struct Renderer *renderer)
     glViewport(0, 0, renderer->width, renderer->height);
     glClearColor(renderer->clear_color[0], renderer->clear_color[1], renderer->clear_color[2], 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderer->bone_palette_ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, renderer->bone_palette_size, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    renderer->bone_palette_offset = 0;
+    renderer->num_bone_palette_uploads = 0;
+    renderer->triangles = 0;
+    memset(&renderer->cull_stats, 0, sizeof(struct RendererCullStats));
+    renderer->frame++;
+}
+
+/*
+ * Appends a bone palette to this frame's storage buffer and binds it for the
+ * next draw. With a remap only matrices[remap[0..count)] are uploaded, which
+ * is how a mesh ships just its own palette. A palette already uploaded this
+ * frame is only rebound, so the matrices must not change until the frame ends.
+ */
+void seel_renderer_upload_bone_palette(struct Renderer *renderer, mat4 *matrices, const unsigned int *remap, unsigned int count)
+{
+    unsigned int size = count * sizeof(mat4);
+    if (!count || size > renderer->bone_palette_size || (remap && count > MAX_BONES))
+        return;
+
+    unsigned int cached = renderer->num_bone_palette_uploads < SEEL_BONE_PALETTE_CACHE_SIZE ? renderer->num_bone_palette_uploads : SEEL_BONE_PALETTE_CACHE_SIZE;
+    unsigned int i;
+    for (i = 0; i < cached; i++)
+    {
+        struct BonePaletteUpload *upload = &renderer->bone_palette_uploads[i];
+        if (upload->matrices == matrices && upload->remap == remap && upload->count == count)
+        {
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, SEEL_BONE_PALETTE_BINDING, renderer->bone_palette_ssbo, upload->offset, size);
+            return;
+        }
+    }
+
+    unsigned int alignment = (unsigned int)renderer->bone_palette_alignment;
+    unsigned int offset = (renderer->bone_palette_offset + alignment - 1) / alignment * alignment;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderer->bone_palette_ssbo);
+    if (offset + size > renderer->bone_palette_size)
+    {
+        /* out of room this frame: orphan the storage, draws already issued keep the old one */
+        glBufferData(GL_SHADER_STORAGE_BUFFER, renderer->bone_palette_size, NULL, GL_STREAM_DRAW);
+        offset = 0;
+        renderer->num_bone_palette_uploads = 0;
+    }
+
+    mat4 *source = matrices;
+    if (remap)
+    {
+        for (i = 0; i < count; i++)
+            glm_mat4_copy(matrices[remap[i]], renderer->bone_palette_scratch[i]);
+        source = renderer->bone_palette_scratch;
+    }
+
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, size, &source[0][0][0]);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, SEEL_BONE_PALETTE_BINDING, renderer->bone_palette_ssbo, offset, size);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    renderer->bone_palette_offset = offset + size;
+
+    struct BonePaletteUpload *upload = &renderer->bone_palette_uploads[renderer->num_bone_palette_uploads++ % SEEL_BONE_PALETTE_CACHE_SIZE];
+    upload->matrices = matrices;
+    upload->remap = remap;
+    upload->count = count;
+    upload->offset = offset;
 }
 
 void seel_renderer_end_frame(void)
@@ -74,7 +220,185 @@ void seel_renderer_end_frame(void)
     glfwPollEvents();
 }
 
-void seel_renderer_draw_scene_node(struct Renderer *renderer, struct Model *model, struct Animator *animator, mat4 model_matrix)
+static void seel_renderer_projection(struct Renderer *renderer, mat4 projection)
+{
+    glm_perspective(glm_rad(renderer->camera->zoom),
+                    (float)renderer->width / (float)renderer->height,
+                    renderer->camera->near_clip, renderer->camera->far_clip, projection);
+}
+
+/* Projection times view of the renderer's camera, i.e. clip space from world space */
+void seel_renderer_view_projection(struct Renderer *renderer, mat4 view_projection)
+{
+    mat4 view;
+    seel_camera_get_view_matrix(renderer->camera, view);
+    seel_renderer_projection(renderer, view_projection);
+    glm_mat4_mul(view_projection, view, view_projection);
+}
+
+static void seel_renderer_set_camera_uniforms(struct Renderer *renderer, struct Shader *shader)
+{
+    mat4 view;
+    seel_camera_get_view_matrix(renderer->camera, view);
+    seel_shader_set_mat4(shader, "view", &view[0][0]);
+
+    mat4 projection;
+    seel_renderer_projection(renderer, projection);
+    seel_shader_set_mat4(shader, "projection", &projection[0][0]);
+
+    /* Set camera position */
+    seel_shader_set_vec3(shader, "viewPos", renderer->camera->position);
+}
+
+/*
+ * Compute skinning pre-pass: poses every mesh of the model into the node's
+ * skinned buffers once, so all passes of this frame draw it as static
+ * geometry. Returns false when the model has to be skinned in default.vert.
+ */
+bool seel_renderer_skin_model(struct Renderer *renderer, struct Model *model, struct Animator *animator, struct SkinnedModel *skinned)
+{
+    if (!renderer->compute_skinning || !model->animated || !animator->final_bone_matrices)
+        return false;
+
+    if (skinned->num_meshes != model->num_meshes)
+    {
+        seel_skinned_model_destroy(skinned);
+        if (!seel_skinned_model_create(skinned, model->meshes, model->num_meshes))
+            return false;
+    }
+
+    seel_shader_use(&renderer->skinning_program.shader);
+
+    mat4 *palette = seel_animator_palette(animator);
+    unsigned int i;
+    for (i = 0; i < model->num_meshes; i++)
+    {
+        struct Mesh *mesh = &model->meshes[i];
+        seel_renderer_upload_bone_palette(renderer, palette, mesh->bone_palette, mesh->num_palette_bones);
+        seel_skinning_dispatch(&renderer->skinning_program, mesh, skinned->vbos[i]);
+    }
+
+    skinned->frame = renderer->frame;
+    renderer->skinning_pending = true;
+    return true;
+}
+
+static bool seel_renderer_reserve_cull_ranges(struct Renderer *renderer, unsigned int count)
+{
+    if (count <= renderer->cull_capacity)
+        return true;
+
+    GLsizei *counts = realloc(renderer->cull_counts, sizeof(GLsizei) * count);
+    if (counts)
+        renderer->cull_counts = counts;
+    const void **offsets = realloc(renderer->cull_offsets, sizeof(void *) * count);
+    if (offsets)
+        renderer->cull_offsets = offsets;
+    GLint *base_vertices = realloc(renderer->cull_base_vertices, sizeof(GLint) * count);
+    if (base_vertices)
+        renderer->cull_base_vertices = base_vertices;
+    if (!counts || !offsets || !base_vertices)
+    {
+        fprintf(stderr, "Failed to allocate memory for meshlet culling!\n");
+        return false;
+    }
+
+    renderer->cull_capacity = count;
+    return true;
+}
+
+/* The palette the model is posed with this frame, NULL when it is drawn in bind pose */
+static mat4 *seel_renderer_pose(struct Model *model, struct Animator *animator)
+{
+    return model->animated && animator && animator->final_bone_matrices ? seel_animator_palette(animator) : NULL;
+}
+
+/*
+ * Tests a mesh's model space bounds, in the pose it is drawn in, against
+ * the model space frustum and counts it. frustum is NULL when culling is
+ * off, bounds when the pose's bounds are unknown; neither culls.
+ */
+static bool seel_renderer_mesh_visible(struct Renderer *renderer, const struct Bounds *bounds, const struct Frustum *frustum)
+{
+    if (!frustum || !bounds)
+        return true;
+
+    bool visible = seel_frustum_test_aabb(frustum, (vec3 *)bounds->aabb);
+    if (visible)
+        renderer->cull_stats.meshes_visible++;
+    else
+        renderer->cull_stats.meshes_culled++;
+    return visible;
+}
+
+/*
+ * Tests the model space bounds of a node's model, posed like it is drawn
+ * this frame, against the view frustum and counts the node. Scenes call it
+ * before skinning or drawing a node; seel_renderer_draw_scene_node then
+ * culls the node's meshes.
+ */
+bool seel_renderer_node_visible(struct Renderer *renderer, const struct Bounds *bounds, mat4 model_matrix)
+{
+    if (!renderer->frustum_culling || !renderer->camera)
+        return true;
+
+    mat4 clip_from_model;
+    seel_renderer_view_projection(renderer, clip_from_model);
+    glm_mat4_mul(clip_from_model, model_matrix, clip_from_model);
+    struct Frustum frustum;
+    seel_frustum_init(&frustum, clip_from_model);
+
+    bool visible = seel_frustum_test_aabb(&frustum, (vec3 *)bounds->aabb);
+    if (visible)
+        renderer->cull_stats.nodes_visible++;
+    else
+        renderer->cull_stats.nodes_culled++;
+    return visible;
+}
+
+/*
+ * Draws a model that needs no skinning. Meshes outside the frustum are
+ * skipped, and at full detail each mesh only submits the meshlets inside
+ * the view frustum that can face the camera; bind pose bounds do not hold
+ * for animated meshes, so those never get here.
+ */
+static void seel_renderer_draw_static_model(struct Renderer *renderer, struct Model *model, struct Shader *shader, mat4 view_projection,
+                                            mat4 model_matrix, const struct Frustum *frustum, unsigned int lod)
+{
+    struct MeshletCullView view;
+    if (renderer->cluster_culling)
+        seel_meshlet_cull_view(&view, view_projection, model_matrix, renderer->camera->position);
+
+    unsigned int i;
+    for (i = 0; i < model->num_meshes; i++)
+    {
+        struct Mesh *mesh = &model->meshes[i];
+        if (!seel_renderer_mesh_visible(renderer, &mesh->bounds, frustum))
+            continue;
+
+        bool full_detail = lod == 0 || mesh->num_lods <= 1;
+        if (!renderer->cluster_culling || !full_detail || !mesh->num_meshlets || !seel_renderer_reserve_cull_ranges(renderer, mesh->num_meshlets))
+        {
+            renderer->triangles += seel_mesh_lod(mesh, lod).num_indices / 3;
+            seel_mesh_draw_lod(mesh, shader, lod);
+            continue;
+        }
+
+        unsigned int num_ranges = seel_meshlet_cull(mesh, &view, renderer->cull_counts, renderer->cull_offsets, renderer->cull_base_vertices,
+                                                    &renderer->triangles);
+        seel_mesh_draw_ranges(mesh, shader, renderer->cull_counts, renderer->cull_offsets, renderer->cull_base_vertices, num_ranges);
+    }
+}
+
+/*
+ * skinned may be NULL; when it was skinned this frame it is drawn instead of
+ * skinning in default.vert. lod is the detail level every mesh is drawn at.
+ * Meshes outside the view frustum are skipped: an animated model's by
+ * mesh_bounds, every mesh's bounds in the animator's pose, and not at all
+ * when it is NULL.
+ */
+void seel_renderer_draw_scene_node(struct Renderer *renderer, struct Model *model, struct Animator *animator, struct SkinnedModel *skinned,
+                                   const struct Bounds *mesh_bounds, mat4 model_matrix, unsigned int lod)
 {
     if (!renderer->active_shader)
     {
@@ -86,39 +410,120 @@ void seel_renderer_draw_scene_node(struct Renderer *renderer, struct Model *mode
 
     /* Set matrices */
     seel_shader_set_mat4(shader, "model", &model_matrix[0][0]);
-
-    mat4 view;
-    seel_camera_get_view_matrix(renderer->camera, view);
-    seel_shader_set_mat4(shader, "view", &view[0][0]);
-
-    mat4 projection;
-    glm_perspective(glm_rad(renderer->camera->zoom),
-                    (float)renderer->width / (float)renderer->height,
-                    renderer->camera->near_clip, renderer->camera->far_clip, projection);
-    seel_shader_set_mat4(shader, "projection", &projection[0][0]);
+    seel_renderer_set_camera_uniforms(renderer, shader);
 
     mat4 normal_matrix = GLM_MAT4_IDENTITY_INIT;
     glm_mat4_inv(model_matrix, normal_matrix);
     glm_mat4_transpose(normal_matrix);
     seel_shader_set_mat4(shader, "normalMatrix", &normal_matrix[0][0]);
 
-    /* Set camera position */
-    seel_shader_set_vec3(shader, "viewPos", renderer->camera->position);
+    mat4 view_projection;
+    seel_renderer_view_projection(renderer, view_projection);
+    struct Frustum model_frustum;
+    const struct Frustum *frustum = NULL;
+    if (renderer->frustum_culling)
+    {
+        mat4 clip_from_model;
+        glm_mat4_mul(view_projection, model_matrix, clip_from_model);
+        seel_frustum_init(&model_frustum, clip_from_model);
+        frustum = &model_frustum;
+    }
+    mat4 *palette = seel_renderer_pose(model, animator);
+
+    unsigned int i;
+    if (skinned && skinned->frame == renderer->frame && skinned->num_meshes == model->num_meshes)
+    {
+        /* one barrier covers every dispatch of the pre-pass */
+        if (renderer->skinning_pending)
+        {
+            glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+            renderer->skinning_pending = false;
+        }
+
+        seel_shader_set_int(shader, "animate", 0);
+        for (i = 0; i < model->num_meshes; i++)
+        {
+            struct Mesh *mesh = &model->meshes[i];
+            if (!seel_renderer_mesh_visible(renderer, mesh_bounds ? &mesh_bounds[i] : NULL, frustum))
+                continue;
+            renderer->triangles += seel_mesh_lod(mesh, lod).num_indices / 3;
+            seel_skinned_mesh_draw(mesh, skinned->vaos[i], shader, lod);
+        }
+        return;
+    }
 
     seel_shader_set_int(shader, "animate", model->animated);
 
-    if (model->animated && animator->final_bone_matrices)
+    if (!palette)
+    {
+        seel_renderer_draw_static_model(renderer, model, shader, view_projection, model_matrix, frustum, lod);
+        return;
+    }
+
+    /* every mesh ships only the bones its vertices reference */
+    for (i = 0; i < model->num_meshes; i++)
+    {
+        struct Mesh *mesh = &model->meshes[i];
+        if (!seel_renderer_mesh_visible(renderer, mesh_bounds ? &mesh_bounds[i] : NULL, frustum))
+            continue;
+        renderer->triangles += seel_mesh_lod(mesh, lod).num_indices / 3;
+        seel_renderer_upload_bone_palette(renderer, palette, mesh->bone_palette, mesh->num_palette_bones);
+        seel_mesh_draw_lod(mesh, shader, lod);
+    }
+}
+
+/*
+ * Skinned instancing: draws every instance of the model in one instanced
+ * draw per mesh. Each instance only carries its world matrix, clip id and
+ * clip time; default.vert fetches and blends the bone matrices from the
+ * baked animation texture itself.
+ */
+void seel_renderer_draw_crowd(struct Renderer *renderer, struct Model *model, struct BakedAnimationSet *baked, struct CrowdInstance *instances, unsigned int count)
+{
+    if (!renderer->active_shader)
     {
-        for (int i = 0; i < animator->num_matrices; i++)
+        fprintf(stderr, "No active shader set for renderer.\n");
+        return;
+    }
+    if (!count)
+        return;
+
+    struct Shader *shader = renderer->active_shader;
+    seel_shader_use(shader);
+    seel_renderer_set_camera_uniforms(renderer, shader);
+
+    bool animate = model->animated && baked && baked->texture;
+    seel_shader_set_int(shader, "crowd", 1);
+    seel_shader_set_int(shader, "animate", animate);
+
+    if (animate)
+    {
+        int clip_frames[MAX_BAKED_CLIPS * 2];
+        unsigned int i;
+        for (i = 0; i < baked->num_clips; i++)
         {
-            char uniform_name[32];
-            snprintf(uniform_name, sizeof(uniform_name), "boneMatrices[%d]", i);
-            seel_shader_set_mat4(shader, uniform_name, &animator->final_bone_matrices[i][0][0]);
+            clip_frames[i * 2] = baked->clips[i].first_frame;
+            clip_frames[i * 2 + 1] = baked->clips[i].num_frames;
         }
+
+        glActiveTexture(GL_TEXTURE0 + SEEL_BAKED_ANIMATION_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, baked->texture);
+        glActiveTexture(GL_TEXTURE0);
+        seel_shader_set_int(shader, "bakedBones", SEEL_BAKED_ANIMATION_TEXTURE_UNIT);
+        seel_shader_set_int(shader, "bakedBoneCount", baked->num_bones);
+        seel_shader_set_int(shader, "bakedClipCount", baked->num_clips);
+        seel_shader_set_float(shader, "bakedSampleRate", baked->sample_rate);
+        glUniform2iv(glGetUniformLocation(shader->id, "bakedClipFrames"), baked->num_clips, clip_frames);
     }
 
-    /* Draw model */
-    seel_model_draw(model, shader);
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->crowd_instance_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(struct CrowdInstance) * count, instances, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    seel_model_draw_instanced(model, shader, renderer->crowd_instance_vbo, sizeof(struct CrowdInstance), count);
+    renderer->triangles += seel_model_lod_triangles(model, 0) * count;
+
+    seel_shader_set_int(shader, "crowd", 0);
 }
 
 void seel_renderer_draw_billboard(struct Shader *shader, struct Texture *texture, vec3 position, float scale, vec3 color, struct Camera *camera)
@@ -203,4 +608,35 @@ void seel_renderer_set_active_shader(struct Renderer *renderer, struct Shader *s
     renderer->active_shader = shader;
 }
 
+/* Needs GL 4.3; without it animated models keep skinning in default.vert */
+bool seel_renderer_enable_compute_skinning(struct Renderer *renderer, const char *cs_path)
+{
+    if (!seel_skinning_supported())
+    {
+        fprintf(stderr, "Compute skinning needs OpenGL 4.3!\n");
+        return false;
+    }
+
+    renderer->compute_skinning = seel_skinning_program_create(&renderer->skinning_program, cs_path);
+    return renderer->compute_skinning;
+}
+
+/* Releases the renderer's buffers and skinning program; call on the GL thread */
+void seel_renderer_cleanup(struct Renderer *renderer)
+{
+    glDeleteBuffers(1, &renderer->bone_palette_ssbo);
+    glDeleteBuffers(1, &renderer->crowd_instance_vbo);
+    if (renderer->compute_skinning)
+        seel_skinning_program_destroy(&renderer->skinning_program);
+    renderer->compute_skinning = false;
+
+    free(renderer->cull_counts);
+    free(renderer->cull_offsets);
+    free(renderer->cull_base_vertices);
+    renderer->cull_counts = NULL;
+    renderer->cull_offsets = NULL;
+    renderer->cull_base_vertices = NULL;
+    renderer->cull_capacity = 0;
+}
+
 #endif /* RENDERER_H */
\ No newline at end of file
@@ -5,36 +5,257 @@
 #include "animator.h"
 #include "renderer.h"
 #include "asset_manager.h"
+#include "bvh.h"
+#include "light.h"
 
 #define MAX_NODE_NAME_LEN 512
+/* Consecutive nodes per job pool chunk of the animation update */
+#define SEEL_SCENE_ANIMATION_CHUNK 8
+
+/*
+ * Animation LOD thresholds on the screen size of a node, i.e. its projected
+ * radius relative to half the viewport height.
+ */
+struct AnimationLodPolicy
+{
+    float full_size;               /* at or above: pose evaluated every frame */
+    float reduced_size;            /* at or above: pose evaluated every reduced_interval frames */
+    unsigned int reduced_interval; /* below reduced_size the pose is frozen */
+};
+
+/* Mesh LOD selection on the simplification error projected to the screen, in pixels */
+struct MeshLodPolicy
+{
+    float pixel_error; /* the coarsest level within this error is drawn */
+    float hysteresis;  /* coarser levels are only taken within pixel_error * (1 - hysteresis) */
+};
+
+/* Per-frame animation counters, reset by seel_scene_update */
+struct SceneAnimationStats
+{
+    unsigned int bones_evaluated;
+    unsigned int full_nodes;
+    unsigned int reduced_nodes;
+    unsigned int frozen_nodes;
+    unsigned int unique_poses; /* poses evaluated by full-rate nodes */
+    unsigned int shared_poses; /* full-rate nodes that reused another node's pose */
+};
+
+/* Open-addressed table of the poses evaluated this frame */
+struct PoseShareEntry
+{
+    struct PoseKey key;
+    struct Animator *owner;
+};
+
+/* Animation work of a node left for the job pool after the serial part of the update */
+enum AnimationJob
+{
+    ANIMATION_JOB_NONE,
+    ANIMATION_JOB_EVALUATE,
+    ANIMATION_JOB_LOD
+};
 
 struct SceneNode
 {
     char name[MAX_NODE_NAME_LEN];
     struct Model *model;
-    struct Animation animation;
+    struct Animation *animation;
     struct Animator animator;
+    enum AnimationLod animation_lod;
+    enum AnimationJob animation_job;
+    unsigned int mesh_lod; /* detail level drawn, kept across frames for the hysteresis */
+    struct SkinnedModel skinned; /* compute skinning output, see seel_renderer_skin_model */
+    struct AssetHandle model_asset;     /* referenced until seel_scene_cleanup */
+    struct AssetHandle animation_asset; /* referenced while the node plays it */
+    bool model_pending; /* drawn as the streaming placeholder until seel_scene_refresh_assets sees it ready */
+    int bvh_proxy;      /* leaf of the node in the scene's BVH */
+    struct Bounds bounds;       /* model space, in the pose of the last BVH refit */
+    struct Bounds *mesh_bounds; /* every mesh's bounds in that pose, NULL unless the node plays an animation */
+    unsigned int num_mesh_bounds;
     mat4 transform;
     struct SceneNode *children;
     unsigned int num_children;
 };
 
+/* Many instances of one rigged model, skinned on the GPU from a baked animation set */
+struct SceneCrowd
+{
+    struct Model *model;
+    struct AssetHandle model_asset; /* referenced until seel_scene_cleanup, the baked set copies the animation */
+    bool model_pending; /* baked once the streamed model is ready */
+    struct BakedAnimationSet baked;
+    struct CrowdInstance *instances;
+    unsigned int num_instances;
+};
+
 struct Scene
 {
     struct SceneNode *root_nodes;
     unsigned int num_root_nodes;
+    struct Bvh bvh;               /* world bounds of the root nodes, items are node indices */
+    unsigned int *visible_nodes;  /* root nodes drawn this frame, one slot per root node */
+    unsigned int num_visible_nodes;
+    struct SceneCrowd *crowds;
+    unsigned int num_crowds;
+    struct AnimationLodPolicy animation_lod;
+    struct MeshLodPolicy mesh_lod;
+    struct SceneAnimationStats animation_stats;
+    float pose_time_quantum; /* seconds; shared poses snap to this grid, 0 shares exact times only */
+    struct PoseShareEntry *pose_table;
+    unsigned int pose_table_size;
+    struct JobPool *job_pool; /* evaluates poses in parallel when set */
+    float animation_delta_time;
+    bool animation_pending;
+    bool compress_animations; /* compresses clips as they load, see clip_compression.h */
+    struct ClipCompressionSettings animation_compression;
+    bool log_compression; /* prints the compression stats of every clip compressed on load */
 };
 
 void seel_scene_init(struct Scene *scene);
 void seel_scene_add_model(struct Scene *scene, struct AssetManager *asset_manager, const char *model_id, const char *asset_name, vec3 scale, vec3 translate);
-void seel_scene_update(struct Scene *scene, float delta_time);
+struct SceneCrowd *seel_scene_add_crowd(struct Scene *scene, struct AssetManager *asset_manager, const char *asset_name, mat4 *transforms, unsigned int count);
+void seel_scene_refresh_assets(struct Scene *scene, struct AssetManager *asset_manager);
+void seel_scene_update(struct Scene *scene, struct Camera *camera, float delta_time);
+void seel_scene_wait_animation(struct Scene *scene);
 void seel_scene_render(struct Scene *scene, struct Renderer *renderer);
-void seel_scene_cleanup(struct Scene *scene);
+void seel_scene_set_node_transform(struct Scene *scene, unsigned int node_index, mat4 transform);
+int seel_scene_pick(struct Scene *scene, vec3 origin, vec3 direction, float max_distance, float *distance);
+unsigned int seel_scene_query_radius(struct Scene *scene, vec3 center, float radius, unsigned int *nodes, unsigned int max_nodes);
+unsigned int seel_scene_point_light_nodes(struct Scene *scene, const struct PointLight *light, float threshold, unsigned int *nodes, unsigned int max_nodes);
+void seel_scene_cleanup(struct Scene *scene, struct AssetManager *asset_manager);
 
 void seel_scene_init(struct Scene *scene)
 {
     scene->root_nodes = NULL;
     scene->num_root_nodes = 0;
+    seel_bvh_init(&scene->bvh);
+    scene->visible_nodes = NULL;
+    scene->num_visible_nodes = 0;
+    scene->crowds = NULL;
+    scene->num_crowds = 0;
+
+    scene->animation_lod.full_size = 0.25f;
+    scene->animation_lod.reduced_size = 0.05f;
+    scene->animation_lod.reduced_interval = 3;
+    scene->mesh_lod.pixel_error = 1.0f;
+    scene->mesh_lod.hysteresis = 0.25f;
+    memset(&scene->animation_stats, 0, sizeof(struct SceneAnimationStats));
+
+    scene->pose_time_quantum = 0.0f;
+    scene->pose_table = NULL;
+    scene->pose_table_size = 0;
+
+    scene->job_pool = NULL;
+    scene->animation_delta_time = 0.0f;
+    scene->animation_pending = false;
+
+    scene->compress_animations = false;
+    scene->log_compression = false;
+    seel_clip_compression_defaults(&scene->animation_compression);
+}
+
+/*
+ * Poses the node's bounds and every mesh's once, for the BVH, the
+ * renderer's culling and picking to share until the next refit. Without
+ * memory for the mesh bounds only the model's are posed.
+ */
+static void seel_scene_node_pose_bounds(struct SceneNode *node)
+{
+    struct Model *model = node->model;
+    if (!model->animated || !node->animator.final_bone_matrices)
+    {
+        node->bounds = model->bounds;
+        free(node->mesh_bounds);
+        node->mesh_bounds = NULL;
+        node->num_mesh_bounds = 0;
+        return;
+    }
+
+    mat4 *palette = seel_animator_palette(&node->animator);
+    if (node->num_mesh_bounds != model->num_meshes)
+    {
+        free(node->mesh_bounds);
+        node->mesh_bounds = malloc(sizeof(struct Bounds) * (model->num_meshes ? model->num_meshes : 1));
+        node->num_mesh_bounds = node->mesh_bounds ? model->num_meshes : 0;
+        if (!node->mesh_bounds)
+        {
+            fprintf(stderr, "Failed to allocate memory for posed mesh bounds!\n");
+            seel_model_posed_bounds(model, palette, model->bone_counter, &node->bounds);
+            return;
+        }
+    }
+
+    seel_bounds_clear(&node->bounds);
+    for (unsigned int i = 0; i < model->num_meshes; i++)
+    {
+        seel_mesh_posed_bounds(&model->meshes[i], palette, model->bone_counter, &node->mesh_bounds[i]);
+        seel_bounds_merge(&node->bounds, &node->mesh_bounds[i]);
+    }
+}
+
+/* World space box of the node's model as last posed */
+static void seel_scene_node_world_bounds(struct SceneNode *node, vec3 aabb[2])
+{
+    if (glm_aabb_isvalid(node->bounds.aabb))
+        glm_aabb_transform(node->bounds.aabb, node->transform, aabb);
+    else
+    {
+        glm_vec3_copy(node->transform[3], aabb[0]);
+        glm_vec3_copy(node->transform[3], aabb[1]);
+    }
+}
+
+/* Inserts the node into the BVH or moves its leaf to the node's current bounds */
+static void seel_scene_node_update_bvh(struct Scene *scene, unsigned int node_index)
+{
+    struct SceneNode *node = &scene->root_nodes[node_index];
+    seel_scene_node_pose_bounds(node);
+    vec3 aabb[2];
+    seel_scene_node_world_bounds(node, aabb);
+    if (node->bvh_proxy == SEEL_BVH_NULL)
+        node->bvh_proxy = seel_bvh_insert(&scene->bvh, aabb, node_index);
+    else
+        seel_bvh_move(&scene->bvh, node->bvh_proxy, aabb);
+}
+
+/*
+ * Every user of the same model shares one animation asset. The animation
+ * points into the model's bone info, so it keeps the model loaded.
+ */
+static struct Animation *seel_scene_get_animation(struct Scene *scene, struct AssetManager *asset_manager, struct Model *model, struct AssetHandle model_asset, const char *asset_name, struct AssetHandle *handle)
+{
+    struct Animation *animation = (struct Animation *)SEEL_ASSET_MANAGER_GET(asset_manager, ANIMATION, asset_name);
+    if (!animation)
+    {
+        char temp[256];
+        snprintf(temp, sizeof(temp), "%s%s", model->directory, model->name);
+        SEEL_ASSET_MANAGER_LOAD(asset_manager, ASSET_ANIMATION, asset_name, temp, model);
+        animation = (struct Animation *)SEEL_ASSET_MANAGER_GET(asset_manager, ANIMATION, asset_name);
+        seel_asset_manager_set_dependency(asset_manager, seel_asset_manager_find(asset_manager, ASSET_ANIMATION, asset_name), model_asset);
+
+        struct ClipCompressionStats stats;
+        if (animation && scene->compress_animations && seel_animation_compress(animation, &scene->animation_compression, &stats) &&
+            scene->log_compression)
+            seel_clip_print_compression_stats(animation->name, &stats);
+    }
+    *handle = seel_asset_manager_find(asset_manager, ASSET_ANIMATION, asset_name);
+    return animation;
+}
+
+/* Starts the model's animation on the node, if it has one */
+static void seel_scene_node_play_model(struct Scene *scene, struct AssetManager *asset_manager, struct SceneNode *node, const char *asset_name)
+{
+    if (!node->model->animated)
+        return;
+
+    struct Animation *animation = seel_scene_get_animation(scene, asset_manager, node->model, node->model_asset, asset_name, &node->animation_asset);
+    node->animation = animation;
+    if (animation)
+    {
+        seel_asset_manager_acquire(asset_manager, node->animation_asset);
+        seel_play_animation(&node->animator, animation, true);
+    }
 }
 
 void seel_scene_add_model(struct Scene *scene, struct AssetManager *asset_manager, const char *model_id, const char *asset_name, vec3 scale, vec3 translate)
@@ -47,52 +268,39 @@ void seel_scene_add_model(struct Scene *scene, struct AssetManager *asset_manage
     /* Apply translation */
     glm_translate(model_matrix, translate);
 
+    /* nodes may move in memory, so no evaluation can be in flight */
+    seel_scene_wait_animation(scene);
+
     /* Retrieve the model and add it to the scene */
     struct Model *model = (struct Model *)SEEL_ASSET_MANAGER_GET(asset_manager, MODEL, asset_name);
     if (model)
     {
-        struct SceneNode *old_nodes = scene->root_nodes;
-
         scene->root_nodes = realloc(scene->root_nodes, sizeof(struct SceneNode) * (scene->num_root_nodes + 1));
-        if (!scene->root_nodes)
+        scene->visible_nodes = realloc(scene->visible_nodes, sizeof(unsigned int) * (scene->num_root_nodes + 1));
+        if (!scene->root_nodes || !scene->visible_nodes)
         {
             /* Handle allocation failure */
             fprintf(stderr, "Failed to reallocate memory for scene nodes.\n");
             exit(EXIT_FAILURE);
         }
 
-        /* Check if realloc moved the memory */
-        if (scene->root_nodes != old_nodes)
-        {
-            /* Fix all internal pointers within existing nodes */
-            for (unsigned int i = 0; i < scene->num_root_nodes; i++)
-            {
-                struct SceneNode *node = &scene->root_nodes[i];
-                if (node->animator.current_animation)
-                {
-                    node->animator.current_animation = (struct Animation *)((char *)node->animator.current_animation + ((char *)scene->root_nodes - (char *)old_nodes));
-                }
-                /* Repeat this for other pointers if needed */
-            }
-        }
-
         struct SceneNode *node = &scene->root_nodes[scene->num_root_nodes++];
         memset(node, 0, sizeof(struct SceneNode));
 
         strcpy(node->name, model_id);
         node->model = model;
         seel_animator_create(&node->animator);
-        if (model->animated)
-        {
-            char temp[256];
-            strcpy(temp, model->directory);
-            snprintf(temp, sizeof(temp), "%s%s", model->directory, model->name);
-            node->animation = seel_animation_create(temp, model);
-            seel_play_animation(&node->animator, &node->animation, true);
-        }
+        node->animation_lod = ANIMATION_LOD_FULL;
+        node->model_asset = seel_asset_manager_find(asset_manager, ASSET_MODEL, asset_name);
+        seel_asset_manager_acquire(asset_manager, node->model_asset);
+        node->model_pending = seel_asset_manager_state(asset_manager, node->model_asset) == ASSET_STATE_LOADING;
+        if (!node->model_pending)
+            seel_scene_node_play_model(scene, asset_manager, node, asset_name);
         glm_mat4_copy(model_matrix, node->transform);
         node->children = NULL;
         node->num_children = 0;
+        node->bvh_proxy = SEEL_BVH_NULL;
+        seel_scene_node_update_bvh(scene, scene->num_root_nodes - 1);
     }
     else
     {
@@ -100,25 +308,591 @@ void seel_scene_add_model(struct Scene *scene, struct AssetManager *asset_manage
     }
 }
 
-void seel_scene_update(struct Scene *scene, float delta_time)
+/* Bakes the model's animation for the crowd and staggers its instances over the clip */
+static void seel_scene_crowd_bake(struct Scene *scene, struct AssetManager *asset_manager, struct SceneCrowd *crowd, const char *asset_name)
+{
+    int clip = -1;
+    if (crowd->model->animated)
+    {
+        struct AssetHandle animation_asset;
+        struct Animation *animation = seel_scene_get_animation(scene, asset_manager, crowd->model, crowd->model_asset, asset_name, &animation_asset);
+        seel_baked_animation_init(&crowd->baked, crowd->model->bone_counter, SEEL_BAKE_SAMPLE_RATE);
+        clip = seel_baked_animation_add_clip(&crowd->baked, animation);
+        if (clip >= 0)
+            seel_baked_animation_upload(&crowd->baked);
+    }
+
+    float duration = seel_baked_clip_duration(&crowd->baked, clip);
+    unsigned int count = crowd->num_instances;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        crowd->instances[i].clip = clip < 0 ? 0 : clip;
+        crowd->instances[i].time = count > 1 ? duration * (float)i / (float)count : 0.0f;
+    }
+}
+
+/*
+ * Adds one instance per transform, all drawn in a single instanced draw per mesh.
+ * The model's animation is baked once; instances start at staggered times.
+ */
+struct SceneCrowd *seel_scene_add_crowd(struct Scene *scene, struct AssetManager *asset_manager, const char *asset_name, mat4 *transforms, unsigned int count)
+{
+    struct Model *model = (struct Model *)SEEL_ASSET_MANAGER_GET(asset_manager, MODEL, asset_name);
+    if (!model)
+    {
+        printf("Error: Model asset '%s' not found.\n", asset_name);
+        return NULL;
+    }
+
+    struct SceneCrowd *crowds = realloc(scene->crowds, sizeof(struct SceneCrowd) * (scene->num_crowds + 1));
+    if (!crowds)
+    {
+        fprintf(stderr, "Failed to reallocate memory for scene crowds.\n");
+        return NULL;
+    }
+    scene->crowds = crowds;
+
+    struct SceneCrowd *crowd = &scene->crowds[scene->num_crowds];
+    memset(crowd, 0, sizeof(struct SceneCrowd));
+    crowd->model = model;
+    crowd->instances = (struct CrowdInstance *)malloc(sizeof(struct CrowdInstance) * count);
+    if (!crowd->instances)
+    {
+        fprintf(stderr, "Failed to allocate memory for crowd instances!\n");
+        return NULL;
+    }
+    crowd->num_instances = count;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        glm_mat4_copy(transforms[i], crowd->instances[i].transform);
+        crowd->instances[i].clip = 0;
+        crowd->instances[i].time = 0.0f;
+    }
+
+    crowd->model_asset = seel_asset_manager_find(asset_manager, ASSET_MODEL, asset_name);
+    seel_asset_manager_acquire(asset_manager, crowd->model_asset);
+    crowd->model_pending = seel_asset_manager_state(asset_manager, crowd->model_asset) == ASSET_STATE_LOADING;
+    if (!crowd->model_pending)
+        seel_scene_crowd_bake(scene, asset_manager, crowd, asset_name);
+
+    scene->num_crowds++;
+    return crowd;
+}
+
+/*
+ * Picks up models that finished streaming since the last call: nodes and
+ * crowds added while their model was still a placeholder now draw the real
+ * one, so they start its animation. Call after seel_asset_manager_update.
+ */
+void seel_scene_refresh_assets(struct Scene *scene, struct AssetManager *asset_manager)
+{
+    seel_scene_wait_animation(scene);
+
+    for (unsigned int i = 0; i < scene->num_root_nodes; i++)
+    {
+        struct SceneNode *node = &scene->root_nodes[i];
+        if (!node->model_pending)
+            continue;
+
+        enum AssetState state = seel_asset_manager_state(asset_manager, node->model_asset);
+        if (state == ASSET_STATE_LOADING)
+            continue;
+
+        node->model_pending = false;
+        if (state == ASSET_STATE_READY)
+            seel_scene_node_play_model(scene, asset_manager, node, seel_asset_manager_name(asset_manager, node->model_asset));
+        /* the placeholder's bounds give way to the model's */
+        seel_scene_node_update_bvh(scene, i);
+    }
+
+    for (unsigned int i = 0; i < scene->num_crowds; i++)
+    {
+        struct SceneCrowd *crowd = &scene->crowds[i];
+        if (!crowd->model_pending)
+            continue;
+
+        enum AssetState state = seel_asset_manager_state(asset_manager, crowd->model_asset);
+        if (state == ASSET_STATE_LOADING)
+            continue;
+
+        crowd->model_pending = false;
+        if (state == ASSET_STATE_READY)
+            seel_scene_crowd_bake(scene, asset_manager, crowd, seel_asset_manager_name(asset_manager, crowd->model_asset));
+    }
+}
+
+/* Picks the animation LOD of a node from its projected size, without a camera everything runs at full rate */
+static enum AnimationLod seel_scene_node_animation_lod(struct Scene *scene, struct SceneNode *node, struct Camera *camera)
+{
+    if (!camera)
+        return ANIMATION_LOD_FULL;
+
+    /* the bind pose sphere; poses rarely reach much further */
+    vec3 scale, center;
+    glm_decompose_scalev(node->transform, scale);
+    float radius = node->model->bounds.sphere[3] * glm_vec3_max(scale);
+    glm_mat4_mulv3(node->transform, node->model->bounds.sphere, 1.0f, center);
+    float distance = glm_vec3_distance(center, camera->position);
+    if (distance <= radius)
+        return ANIMATION_LOD_FULL;
+
+    float size = radius / (distance * tanf(glm_rad(camera->zoom) * 0.5f));
+    if (size >= scene->animation_lod.full_size)
+        return ANIMATION_LOD_FULL;
+    if (size >= scene->animation_lod.reduced_size)
+        return ANIMATION_LOD_REDUCED;
+    return ANIMATION_LOD_FROZEN;
+}
+
+/*
+ * Picks the coarsest detail level of a node's model whose error projects to
+ * at most the policy's pixel error. Levels get finer as soon as the current
+ * one exceeds it, and coarser only once the next one is within the
+ * hysteresis margin, so nodes near a threshold do not flicker between levels.
+ */
+static unsigned int seel_scene_node_mesh_lod(struct Scene *scene, struct SceneNode *node, struct Renderer *renderer)
+{
+    struct Camera *camera = renderer->camera;
+    unsigned int num_lods = seel_model_num_lods(node->model);
+    if (!camera || num_lods < 2 || !renderer->height)
+        return 0;
+
+    vec3 scale;
+    glm_decompose_scalev(node->transform, scale);
+    float distance = glm_max(glm_vec3_distance(node->transform[3], camera->position), camera->near_clip);
+    /* pixels a model unit covers at the node's distance */
+    float to_pixels = glm_vec3_max(scale) * renderer->height * 0.5f / (distance * tanf(glm_rad(camera->zoom) * 0.5f));
+
+    unsigned int lod = node->mesh_lod < num_lods ? node->mesh_lod : num_lods - 1;
+    while (lod > 0 && seel_model_lod_error(node->model, lod) * to_pixels > scene->mesh_lod.pixel_error)
+        lod--;
+    float coarsen = scene->mesh_lod.pixel_error * (1.0f - scene->mesh_lod.hysteresis);
+    while (lod + 1 < num_lods && seel_model_lod_error(node->model, lod + 1) * to_pixels <= coarsen)
+        lod++;
+    return lod;
+}
+
+static bool seel_pose_key_equal(const struct PoseKey *a, const struct PoseKey *b)
+{
+    return a->current_animation == b->current_animation && a->next_animation == b->next_animation &&
+           a->interpolating == b->interpolating && a->time == b->time && a->halt_time == b->halt_time;
+}
+
+static unsigned int seel_pose_key_hash(const struct PoseKey *key)
+{
+    /* FNV-1a over the key fields */
+    uintptr_t words[5];
+    words[0] = (uintptr_t)key->current_animation;
+    words[1] = (uintptr_t)key->next_animation;
+    words[2] = key->interpolating;
+    uint32_t bits;
+    memcpy(&bits, &key->time, sizeof(bits));
+    words[3] = bits;
+    memcpy(&bits, &key->halt_time, sizeof(bits));
+    words[4] = bits;
+
+    uint32_t hash = 2166136261u;
+    const unsigned char *bytes = (const unsigned char *)words;
+    for (size_t i = 0; i < sizeof(words); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+/* Sizes the pose table for every root node and forgets last frame's poses */
+static bool seel_scene_reset_pose_table(struct Scene *scene)
+{
+    unsigned int size = 16;
+    while (size < scene->num_root_nodes * 2)
+        size *= 2;
+
+    if (size > scene->pose_table_size)
+    {
+        struct PoseShareEntry *table = (struct PoseShareEntry *)realloc(scene->pose_table, sizeof(struct PoseShareEntry) * size);
+        if (!table)
+        {
+            fprintf(stderr, "Failed to allocate memory for the pose table!\n");
+            return false;
+        }
+        scene->pose_table = table;
+        scene->pose_table_size = size;
+    }
+
+    memset(scene->pose_table, 0, sizeof(struct PoseShareEntry) * scene->pose_table_size);
+    return true;
+}
+
+/* Returns the entry holding the key, or the empty slot it belongs in */
+static struct PoseShareEntry *seel_scene_find_pose(struct Scene *scene, const struct PoseKey *key)
 {
+    unsigned int mask = scene->pose_table_size - 1;
+    unsigned int index = seel_pose_key_hash(key) & mask;
+    while (scene->pose_table[index].owner && !seel_pose_key_equal(&scene->pose_table[index].key, key))
+        index = (index + 1) & mask;
+    return &scene->pose_table[index];
+}
+
+/*
+ * Full-rate update of a node. Nodes in the same pose this frame (same clip,
+ * transition and quantized time) evaluate it once: the first one owns the
+ * palette and the others draw with it. Returns whether the node has to
+ * evaluate its pose.
+ */
+static bool seel_scene_update_shared_pose(struct Scene *scene, struct Animator *animator, float delta_time, bool share)
+{
+    struct SceneAnimationStats *stats = &scene->animation_stats;
+    animator->bones_evaluated = 0;
+    animator->poses_valid = false;
+
+    /* a palette shared last frame is stale, so evaluate even when the clock has nothing new */
+    if (!seel_animator_advance(animator, delta_time) && !animator->shared_palette)
+        return false;
+
+    struct PoseKey key;
+    seel_animator_pose_key(animator, scene->pose_time_quantum, &key);
+    struct PoseShareEntry *entry = share ? seel_scene_find_pose(scene, &key) : NULL;
+    if (entry && entry->owner)
+    {
+        animator->shared_palette = entry->owner->final_bone_matrices;
+        stats->shared_poses++;
+        return false;
+    }
+
+    animator->shared_palette = NULL;
+    stats->unique_poses++;
+    if (entry)
+    {
+        entry->key = key;
+        entry->owner = animator;
+    }
+    return true;
+}
+
+/* Job pool callback: the pose evaluation left over by seel_scene_update for nodes [begin, end) */
+static void seel_scene_animation_job(void *context, unsigned int begin, unsigned int end, unsigned int worker)
+{
+    struct Scene *scene = (struct Scene *)context;
+    (void)worker;
+
+    unsigned int i;
+    for (i = begin; i < end; i++)
+    {
+        struct SceneNode *node = &scene->root_nodes[i];
+        if (node->animation_job == ANIMATION_JOB_EVALUATE)
+            seel_animator_evaluate(&node->animator, scene->pose_time_quantum);
+        else if (node->animation_job == ANIMATION_JOB_LOD)
+            /* the node index staggers reduced-rate updates across frames */
+            seel_update_animation_lod(&node->animator, scene->animation_delta_time, node->animation_lod, scene->animation_lod.reduced_interval, i);
+    }
+}
+
+/*
+ * Clocks, LOD selection and pose sharing run on the calling thread; pose
+ * evaluation, the bulk of the work, is dispatched to the scene's job pool
+ * and joined by seel_scene_wait_animation (called by seel_scene_render).
+ * Each node's evaluation only writes to its own animator.
+ */
+void seel_scene_update(struct Scene *scene, struct Camera *camera, float delta_time)
+{
+    seel_scene_wait_animation(scene);
+
+    struct SceneAnimationStats *stats = &scene->animation_stats;
+    memset(stats, 0, sizeof(struct SceneAnimationStats));
+    bool share = seel_scene_reset_pose_table(scene);
+
     for (unsigned int i = 0; i < scene->num_root_nodes; i++)
     {
         struct SceneNode *node = &scene->root_nodes[i];
+        node->animation_job = ANIMATION_JOB_NONE;
         if (node->animator.current_animation)
         {
-            seel_update_animation(&node->animator, delta_time);
+            node->animation_lod = seel_scene_node_animation_lod(scene, node, camera);
+            if (node->animation_lod == ANIMATION_LOD_FULL)
+            {
+                if (seel_scene_update_shared_pose(scene, &node->animator, delta_time, share))
+                    node->animation_job = ANIMATION_JOB_EVALUATE;
+            }
+            else
+            {
+                /* copy a shared palette before its owner is evaluated again */
+                seel_animator_unshare(&node->animator);
+                node->animation_job = ANIMATION_JOB_LOD;
+            }
+
+            if (node->animation_lod == ANIMATION_LOD_FULL)
+                stats->full_nodes++;
+            else if (node->animation_lod == ANIMATION_LOD_REDUCED)
+                stats->reduced_nodes++;
+            else
+                stats->frozen_nodes++;
+        }
+    }
+
+    scene->animation_delta_time = delta_time;
+    scene->animation_pending = true;
+    if (scene->job_pool)
+        seel_job_pool_dispatch(scene->job_pool, seel_scene_animation_job, scene, scene->num_root_nodes, SEEL_SCENE_ANIMATION_CHUNK);
+    else
+        seel_scene_animation_job(scene, 0, scene->num_root_nodes, 0);
+
+    for (unsigned int i = 0; i < scene->num_crowds; i++)
+    {
+        struct SceneCrowd *crowd = &scene->crowds[i];
+        for (unsigned int j = 0; j < crowd->num_instances; j++)
+        {
+            struct CrowdInstance *instance = &crowd->instances[j];
+            float duration = seel_baked_clip_duration(&crowd->baked, instance->clip);
+            instance->time += delta_time;
+            if (duration > 0.0f)
+                instance->time = fmodf(instance->time, duration);
         }
     }
 }
 
+/* Joins the pose evaluation started by seel_scene_update and totals its bone count */
+void seel_scene_wait_animation(struct Scene *scene)
+{
+    if (!scene->animation_pending)
+        return;
+
+    if (scene->job_pool)
+        seel_job_pool_wait(scene->job_pool);
+    scene->animation_pending = false;
+
+    scene->animation_stats.bones_evaluated = 0;
+    for (unsigned int i = 0; i < scene->num_root_nodes; i++)
+        scene->animation_stats.bones_evaluated += scene->root_nodes[i].animator.bones_evaluated;
+}
+
+static void seel_scene_collect_node(void *context, unsigned int item)
+{
+    struct Scene *scene = (struct Scene *)context;
+    scene->visible_nodes[scene->num_visible_nodes++] = item;
+}
+
+/*
+ * Fills visible_nodes: the BVH drops nodes whose world box is outside the
+ * view, then the renderer tests the rest against their model space bounds.
+ */
+static void seel_scene_collect_visible(struct Scene *scene, struct Renderer *renderer)
+{
+    scene->num_visible_nodes = 0;
+    if (!renderer->frustum_culling || !renderer->camera)
+    {
+        for (unsigned int i = 0; i < scene->num_root_nodes; ++i)
+            scene->visible_nodes[scene->num_visible_nodes++] = i;
+        return;
+    }
+
+    mat4 view_projection;
+    seel_renderer_view_projection(renderer, view_projection);
+    struct Frustum frustum;
+    seel_frustum_init(&frustum, view_projection);
+    seel_bvh_query_frustum(&scene->bvh, &frustum, seel_scene_collect_node, scene);
+    renderer->cull_stats.nodes_culled += scene->num_root_nodes - scene->num_visible_nodes;
+
+    unsigned int candidates = scene->num_visible_nodes;
+    scene->num_visible_nodes = 0;
+    for (unsigned int i = 0; i < candidates; ++i)
+    {
+        struct SceneNode *node = &scene->root_nodes[scene->visible_nodes[i]];
+        if (seel_renderer_node_visible(renderer, &node->bounds, node->transform))
+            scene->visible_nodes[scene->num_visible_nodes++] = scene->visible_nodes[i];
+    }
+}
+
 void seel_scene_render(struct Scene *scene, struct Renderer *renderer)
 {
+    seel_scene_wait_animation(scene);
+
+    /* poses move animated nodes' bounds; leaves only change once they leave their margin */
+    for (unsigned int i = 0; i < scene->num_root_nodes; ++i)
+    {
+        if (scene->root_nodes[i].model->animated)
+            seel_scene_node_update_bvh(scene, i);
+    }
+    seel_scene_collect_visible(scene, renderer);
+
+    /* skin every visible animated node once up front; the draws below only read the results */
+    for (unsigned int i = 0; renderer->compute_skinning && i < scene->num_visible_nodes; ++i)
+    {
+        struct SceneNode *node = &scene->root_nodes[scene->visible_nodes[i]];
+        if (!node->model->animated)
+            continue;
+
+        /* a frozen pose is still in last frame's buffers */
+        if (node->animation_lod == ANIMATION_LOD_FROZEN && node->skinned.frame && node->skinned.frame + 1 == renderer->frame)
+            node->skinned.frame = renderer->frame;
+        else
+            seel_renderer_skin_model(renderer, node->model, &node->animator, &node->skinned);
+    }
+
+    for (unsigned int i = 0; i < scene->num_visible_nodes; ++i)
+    {
+        struct SceneNode *node = &scene->root_nodes[scene->visible_nodes[i]];
+        node->mesh_lod = seel_scene_node_mesh_lod(scene, node, renderer);
+        seel_renderer_draw_scene_node(renderer, node->model, &node->animator, &node->skinned, node->mesh_bounds, node->transform, node->mesh_lod);
+    }
+
+    for (unsigned int i = 0; i < scene->num_crowds; ++i)
+    {
+        struct SceneCrowd *crowd = &scene->crowds[i];
+        seel_renderer_draw_crowd(renderer, crowd->model, &crowd->baked, crowd->instances, crowd->num_instances);
+    }
+}
+
+/* Moves a root node, updating its leaf in the BVH */
+void seel_scene_set_node_transform(struct Scene *scene, unsigned int node_index, mat4 transform)
+{
+    if (node_index >= scene->num_root_nodes)
+    {
+        fprintf(stderr, "Scene node %u does not exist!\n", node_index);
+        return;
+    }
+    /* the node's bounds are read from a palette the animation jobs may still be writing */
+    seel_scene_wait_animation(scene);
+    glm_mat4_copy(transform, scene->root_nodes[node_index].transform);
+    seel_scene_node_update_bvh(scene, node_index);
+}
+
+struct ScenePick
+{
+    struct Scene *scene;
+    int node;
+    float distance;
+};
+
+/*
+ * Ray against the node's model space bounds. The direction is carried into
+ * model space unnormalized, so distances along it stay world distances.
+ */
+static float seel_scene_pick_node(void *context, unsigned int item, vec3 origin, vec3 direction, float max_distance)
+{
+    struct ScenePick *pick = (struct ScenePick *)context;
+    struct SceneNode *node = &pick->scene->root_nodes[item];
+
+    /* the bounds the BVH was refit with */
+    struct Bounds bounds = node->bounds;
+    if (!glm_aabb_isvalid(bounds.aabb))
+        return max_distance;
+
+    mat4 model_from_world;
+    glm_mat4_inv(node->transform, model_from_world);
+    vec3 model_origin, model_direction, inverse_direction;
+    glm_mat4_mulv3(model_from_world, origin, 1.0f, model_origin);
+    glm_mat4_mulv3(model_from_world, direction, 0.0f, model_direction);
+    glm_vec3_div(GLM_VEC3_ONE, model_direction, inverse_direction);
+
+    float distance = seel_bvh_ray_box(bounds.aabb, model_origin, inverse_direction, max_distance);
+    if (distance < pick->distance)
+    {
+        pick->node = (int)item;
+        pick->distance = distance;
+    }
+    return glm_min(distance, max_distance);
+}
+
+/*
+ * Returns the root node whose bounds a ray, direction normalized, enters
+ * first within max_distance and writes its distance; -1 when it hits none.
+ */
+int seel_scene_pick(struct Scene *scene, vec3 origin, vec3 direction, float max_distance, float *distance)
+{
+    struct ScenePick pick = {scene, -1, max_distance};
+    seel_bvh_ray_cast(&scene->bvh, origin, direction, max_distance, seel_scene_pick_node, &pick);
+    if (pick.node >= 0 && distance)
+        *distance = pick.distance;
+    return pick.node;
+}
+
+struct SceneRadiusQuery
+{
+    struct Scene *scene;
+    vec3 center;
+    float radius;
+    unsigned int *nodes;
+    unsigned int num_nodes;
+    unsigned int max_nodes;
+};
+
+static void seel_scene_radius_node(void *context, unsigned int item)
+{
+    struct SceneRadiusQuery *query = (struct SceneRadiusQuery *)context;
+    if (query->num_nodes == query->max_nodes)
+        return;
+
+    /* the leaf box is fattened, test the node's own */
+    vec3 aabb[2], closest;
+    seel_scene_node_world_bounds(&query->scene->root_nodes[item], aabb);
+    glm_vec3_maxv(aabb[0], query->center, closest);
+    glm_vec3_minv(aabb[1], closest, closest);
+    if (glm_vec3_distance2(query->center, closest) <= query->radius * query->radius)
+        query->nodes[query->num_nodes++] = item;
+}
+
+/* Writes up to max_nodes root nodes whose bounds touch the sphere, returns how many */
+unsigned int seel_scene_query_radius(struct Scene *scene, vec3 center, float radius, unsigned int *nodes, unsigned int max_nodes)
+{
+    struct SceneRadiusQuery query = {scene, {center[0], center[1], center[2]}, radius, nodes, 0, max_nodes};
+    seel_bvh_query_sphere(&scene->bvh, center, radius, seel_scene_radius_node, &query);
+    return query.num_nodes;
+}
+
+/*
+ * Root nodes a point light reaches before its attenuation drops below
+ * threshold, for assigning lights to the objects they affect.
+ */
+unsigned int seel_scene_point_light_nodes(struct Scene *scene, const struct PointLight *light, float threshold, unsigned int *nodes,
+                                          unsigned int max_nodes)
+{
+    float range = seel_point_light_range(light, threshold);
+    if (range == FLT_MAX)
+    {
+        unsigned int count = glm_min(scene->num_root_nodes, max_nodes);
+        for (unsigned int i = 0; i < count; ++i)
+            nodes[i] = i;
+        return count;
+    }
+    vec3 position;
+    glm_vec3_copy((float *)light->position, position);
+    return seel_scene_query_radius(scene, position, range, nodes, max_nodes);
+}
+
+/* Releases the scene's asset references, the assets stay loaded until evicted or unloaded */
+void seel_scene_cleanup(struct Scene *scene, struct AssetManager *asset_manager)
+{
+    seel_scene_wait_animation(scene);
+
     for (unsigned int i = 0; i < scene->num_root_nodes; ++i)
     {
         struct SceneNode *node = &scene->root_nodes[i];
-        seel_renderer_draw_scene_node(renderer, node->model, &node->animator, node->transform);
+        seel_skinned_model_destroy(&node->skinned);
+        free(node->mesh_bounds);
+        seel_animator_destroy(&node->animator);
+        seel_asset_manager_release(asset_manager, node->animation_asset);
+        seel_asset_manager_release(asset_manager, node->model_asset);
+    }
+    free(scene->root_nodes);
+    free(scene->visible_nodes);
+    seel_bvh_destroy(&scene->bvh);
+
+    for (unsigned int i = 0; i < scene->num_crowds; ++i)
+    {
+        seel_baked_animation_destroy(&scene->crowds[i].baked);
+        free(scene->crowds[i].instances);
+        seel_asset_manager_release(asset_manager, scene->crowds[i].model_asset);
     }
+    free(scene->crowds);
+    free(scene->pose_table);
+
+    scene->root_nodes = NULL;
+    scene->num_root_nodes = 0;
+    scene->visible_nodes = NULL;
+    scene->num_visible_nodes = 0;
+    scene->crowds = NULL;
+    scene->num_crowds = 0;
+    scene->pose_table = NULL;
+    scene->pose_table_size = 0;
 }
 
 #endif /* SCENE_H */
\ No newline at end of file
@@ -12,7 +12,8 @@
 enum ShaderType
 {
     FRAGMENT_SHADER = 0x8B30,
-    VERTEX_SHADER = 0x8B31
+    VERTEX_SHADER = 0x8B31,
+    COMPUTE_SHADER = 0x91B9
 };
 
 struct Shader
@@ -78,8 +79,9 @@ static unsigned int seel_shader_make(const char *shader_path, int type)
     {
         glGetShaderInfoLog(shader, MAX_INFO_LEN, NULL, info);
         fprintf(stderr, "Error in compiling %s shader!\n\n%s\n",
-                type == VERTEX_SHADER ? "vertex" : "fragment",
+                type == VERTEX_SHADER ? "vertex" : type == COMPUTE_SHADER ? "compute" : "fragment",
                 info);
+        glDeleteShader(shader);
         free(shader_source);
         return -1;
     }
@@ -115,6 +117,35 @@ struct Shader seel_shader_create(const char *vs_path, const char *fs_path)
     return (struct Shader){program};
 }
 
+/* Compute programs need GL 4.3 */
+struct Shader seel_shader_create_compute(const char *cs_path)
+{
+    unsigned int compute_shader = seel_shader_make(cs_path, COMPUTE_SHADER);
+    if (compute_shader == (unsigned int)-1)
+        return (struct Shader){-1};
+
+    unsigned int program;
+    program = glCreateProgram();
+
+    glAttachShader(program, compute_shader);
+    glLinkProgram(program);
+
+    int success;
+    char info[MAX_INFO_LEN];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(program, MAX_INFO_LEN, NULL, info);
+        fprintf(stderr, "Error in creating compute shader program!\n\n, %s\n", info);
+        glDeleteShader(compute_shader);
+        glDeleteProgram(program);
+        return (struct Shader){-1};
+    }
+
+    glDeleteShader(compute_shader);
+    return (struct Shader){program};
+}
+
 void seel_shader_use(struct Shader *s)
 {
     glUseProgram(s->id);
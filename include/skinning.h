@@ -0,0 +1,175 @@
+#ifndef SKINNING_H
+#define SKINNING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glad/gl.h"
+#include "shader.h"
+#include "mesh.h"
+
+/* Shader storage bindings of shaders/skinning.comp; the bone palette stays on binding 0 */
+#define SEEL_SKINNING_BIND_POSE_BINDING 1
+#define SEEL_SKINNING_OUTPUT_BINDING 2
+#define SEEL_SKINNING_GROUP_SIZE 64
+
+/*
+ * Skinned copy of every mesh of one animated model instance. The compute
+ * pre-pass reads the mesh's vertices in whatever layout and buffer they
+ * live in and writes the posed vertices once per frame in the full vertex
+ * layout, and every pass of that frame draws them through vaos as static
+ * geometry with the mesh's own indices.
+ */
+struct SkinnedModel
+{
+    unsigned int *vbos;
+    unsigned int *vaos;
+    unsigned int num_meshes;
+    unsigned int frame; /* renderer frame the buffers were last skinned in, 0 if never */
+};
+
+/* The skinning compute program and its uniform locations, looked up once when it is created */
+struct SkinningProgram
+{
+    struct Shader shader;
+    int vertex_count;
+    int base_vertex;
+    int input_layout;
+    int input_skinned;
+    int input_stride;
+    int frame_offset;
+    int tex_coord_offset;
+    int bone_id_offset;
+    int weight_offset;
+    int position_offset;
+    int position_scale;
+};
+
+bool seel_skinning_supported(void)
+{
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+bool seel_skinned_model_create(struct SkinnedModel *skinned, struct Mesh *meshes, unsigned int num_meshes)
+{
+    memset(skinned, 0, sizeof(struct SkinnedModel));
+    if (!num_meshes)
+        return true;
+
+    skinned->vbos = (unsigned int *)malloc(sizeof(unsigned int) * num_meshes);
+    skinned->vaos = (unsigned int *)malloc(sizeof(unsigned int) * num_meshes);
+    if (!skinned->vbos || !skinned->vaos)
+    {
+        fprintf(stderr, "Failed to allocate memory for skinned model buffers!\n");
+        free(skinned->vbos);
+        free(skinned->vaos);
+        skinned->vbos = NULL;
+        skinned->vaos = NULL;
+        return false;
+    }
+
+    skinned->num_meshes = num_meshes;
+    glGenBuffers(skinned->num_meshes, skinned->vbos);
+    glGenVertexArrays(skinned->num_meshes, skinned->vaos);
+
+    unsigned int i;
+    for (i = 0; i < skinned->num_meshes; i++)
+    {
+        struct Mesh *mesh = &meshes[i];
+        glBindVertexArray(skinned->vaos[i]);
+
+        glBindBuffer(GL_ARRAY_BUFFER, skinned->vbos[i]);
+        glBufferData(GL_ARRAY_BUFFER, mesh->num_vertices * sizeof(struct Vertex), NULL, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->EBO);
+        seel_mesh_setup_attributes();
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return true;
+}
+
+void seel_skinned_model_destroy(struct SkinnedModel *skinned)
+{
+    if (skinned->num_meshes)
+    {
+        glDeleteVertexArrays(skinned->num_meshes, skinned->vaos);
+        glDeleteBuffers(skinned->num_meshes, skinned->vbos);
+    }
+    free(skinned->vaos);
+    free(skinned->vbos);
+    memset(skinned, 0, sizeof(struct SkinnedModel));
+}
+
+/* Compiles shaders/skinning.comp, or whatever cs_path names, and looks up its uniforms */
+bool seel_skinning_program_create(struct SkinningProgram *program, const char *cs_path)
+{
+    memset(program, 0, sizeof(struct SkinningProgram));
+    program->shader = seel_shader_create_compute(cs_path);
+    if (program->shader.id == (unsigned int)-1)
+        return false;
+
+    unsigned int id = program->shader.id;
+    program->vertex_count = glGetUniformLocation(id, "vertexCount");
+    program->base_vertex = glGetUniformLocation(id, "baseVertex");
+    program->input_layout = glGetUniformLocation(id, "inputLayout");
+    program->input_skinned = glGetUniformLocation(id, "inputSkinned");
+    program->input_stride = glGetUniformLocation(id, "inputStride");
+    program->frame_offset = glGetUniformLocation(id, "frameOffset");
+    program->tex_coord_offset = glGetUniformLocation(id, "texCoordOffset");
+    program->bone_id_offset = glGetUniformLocation(id, "boneIdOffset");
+    program->weight_offset = glGetUniformLocation(id, "weightOffset");
+    program->position_offset = glGetUniformLocation(id, "positionOffset");
+    program->position_scale = glGetUniformLocation(id, "positionScale");
+    return true;
+}
+
+void seel_skinning_program_destroy(struct SkinningProgram *program)
+{
+    if (program->shader.id && program->shader.id != (unsigned int)-1)
+        seel_shader_delete(&program->shader);
+    memset(program, 0, sizeof(struct SkinningProgram));
+}
+
+/*
+ * Skins one mesh into output with the palette currently bound to binding 0.
+ * The skinning program must be in use. Callers issue a single
+ * GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT barrier after the last dispatch of the frame.
+ */
+void seel_skinning_dispatch(const struct SkinningProgram *program, struct Mesh *mesh, unsigned int output)
+{
+    if (!mesh->num_vertices)
+        return;
+
+    struct VertexFormat format = seel_vertex_format(mesh->layout, mesh->skinned);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SEEL_SKINNING_BIND_POSE_BINDING, mesh->VBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SEEL_SKINNING_OUTPUT_BINDING, output);
+    glUniform1ui(program->vertex_count, mesh->num_vertices);
+    glUniform1ui(program->base_vertex, mesh->base_vertex);
+    glUniform1ui(program->input_layout, mesh->layout);
+    glUniform1i(program->input_skinned, mesh->skinned);
+    glUniform1ui(program->input_stride, format.stride);
+    glUniform1ui(program->frame_offset, format.frame);
+    glUniform1ui(program->tex_coord_offset, format.tex_coords);
+    glUniform1ui(program->bone_id_offset, format.bone_ids);
+    glUniform1ui(program->weight_offset, format.weights);
+    glUniform3fv(program->position_offset, 1, mesh->position_offset);
+    glUniform3fv(program->position_scale, 1, mesh->position_scale);
+    glDispatchCompute((mesh->num_vertices + SEEL_SKINNING_GROUP_SIZE - 1) / SEEL_SKINNING_GROUP_SIZE, 1, 1);
+}
+
+/* Draws the skinned copy as static geometry with the mesh's material */
+void seel_skinned_mesh_draw(struct Mesh *mesh, unsigned int vao, struct Shader *shader, unsigned int lod)
+{
+    struct Mesh skinned_mesh = *mesh;
+    skinned_mesh.VAO = vao;
+    skinned_mesh.base_vertex = 0; /* the skinned copy starts at the mesh's first vertex */
+    skinned_mesh.layout = VERTEX_LAYOUT_FULL;
+    skinned_mesh.skinned = true;
+    glm_vec3_zero(skinned_mesh.position_offset);
+    glm_vec3_one(skinned_mesh.position_scale);
+    seel_mesh_draw_lod(&skinned_mesh, shader, lod);
+}
+
+#endif /* SKINNING_H */
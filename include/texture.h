@@ -1,6 +1,9 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include <stdio.h>
+#include <stdbool.h>
+
 #include "glad/gl.h"
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -32,10 +35,91 @@ void seel_texture_init_stb(void)
     stbi_set_flip_vertically_on_load(true);
 }
 
-struct Texture seel_texture_create(const char *path, enum TextureType type)
+/*
+ * Decoded pixels of an image file, kept on the CPU until they are uploaded
+ * on the GL thread. Cooked images (see texture_file.h) hold their whole mip
+ * chain as compressed blocks instead, level after level.
+ */
+struct TextureImage
+{
+    unsigned char *data;
+    int width;
+    int height;
+    int channels;
+    unsigned int compressed_format; /* 0 for plain pixels */
+    int levels;                     /* mip levels in data when compressed */
+};
+
+/* Only touches stb_image, so worker threads may decode several images at once */
+bool seel_texture_decode(const char *path, struct TextureImage *image)
+{
+    image->compressed_format = 0;
+    image->levels = 1;
+    image->data = stbi_load(path, &image->width, &image->height, &image->channels, 0);
+    if (!image->data)
+    {
+        fprintf(stderr, "Failed to load texture %s!\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+void seel_texture_image_free(struct TextureImage *image)
+{
+    if (image->compressed_format)
+        free(image->data);
+    else
+        stbi_image_free(image->data);
+    image->data = NULL;
+}
+
+/* Pixel format images are uploaded with */
+unsigned int seel_texture_image_format(const struct TextureImage *image)
+{
+    if (image->compressed_format)
+        return image->compressed_format;
+    return image->channels >= 4 ? GL_RGBA : GL_RGB;
+}
+
+static int seel_texture_level_extent(int extent, int level)
+{
+    extent >>= level;
+    return extent > 0 ? extent : 1;
+}
+
+/* Bytes of one mip level in a block compressed format: 4x4 texel blocks of 8 or 16 bytes */
+size_t seel_texture_level_size(unsigned int format, int width, int height)
+{
+    size_t block_size = format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ||
+                                format == GL_COMPRESSED_RED_RGTC1
+                            ? 8
+                            : 16;
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * block_size;
+}
+
+/* Offset of a mip level within a compressed image's data */
+size_t seel_texture_level_offset(const struct TextureImage *image, int level)
+{
+    size_t offset = 0;
+    for (int i = 0; i < level; i++)
+        offset += seel_texture_level_size(image->compressed_format, seel_texture_level_extent(image->width, i),
+                                          seel_texture_level_extent(image->height, i));
+    return offset;
+}
+
+/* Sends one level of a compressed image to the bound texture; data may be an offset into a bound unpack buffer */
+void seel_texture_upload_level(const struct TextureImage *image, int level, const void *data)
+{
+    int width = seel_texture_level_extent(image->width, level);
+    int height = seel_texture_level_extent(image->height, level);
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, image->compressed_format, width, height, 0,
+                           (GLsizei)seel_texture_level_size(image->compressed_format, width, height), data);
+}
+
+/* Fills the texture object tex, which may have been generated before its image was decoded */
+void seel_texture_upload(unsigned int tex, const struct TextureImage *image)
 {
-    unsigned int tex;
-    glGenTextures(1, &tex);
     glBindTexture(GL_TEXTURE_2D, tex);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -43,25 +127,70 @@ struct Texture seel_texture_create(const char *path, enum TextureType type)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    int width, height, channels;
-    unsigned char *data = stbi_load(path, &width, &height, &channels, 0);
-    if (data)
+    if (image->data && image->compressed_format)
     {
-        unsigned int is_alpha = channels >= 4 ? GL_RGBA : GL_RGB;
-        glTexImage2D(GL_TEXTURE_2D, 0, is_alpha, width, height, 0, is_alpha, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        /* the mip chain was built by the cooker, so the GPU has nothing to generate */
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image->levels - 1);
+        for (int level = 0; level < image->levels; level++)
+            seel_texture_upload_level(image, level, image->data + seel_texture_level_offset(image, level));
     }
-    else
+    else if (image->data)
     {
-        fprintf(stderr, "Failed to load texture %s!\n", path);
+        unsigned int is_alpha = seel_texture_image_format(image);
+        glTexImage2D(GL_TEXTURE_2D, 0, is_alpha, image->width, image->height, 0, is_alpha, GL_UNSIGNED_BYTE, image->data);
+        glGenerateMipmap(GL_TEXTURE_2D);
     }
 
-    stbi_image_free(data);
-
     glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+struct Texture seel_texture_create(const char *path, enum TextureType type)
+{
+    unsigned int tex;
+    glGenTextures(1, &tex);
+
+    struct TextureImage image;
+    seel_texture_decode(path, &image);
+    seel_texture_upload(tex, &image);
+    seel_texture_image_free(&image);
+
     return (struct Texture){.id = tex, .type = type};
 }
 
+/* GPU memory of a texture object and its mip chain; call on the GL thread */
+size_t seel_texture_gpu_size(unsigned int tex)
+{
+    if (!tex)
+        return 0;
+
+    size_t size = 0;
+    int level, width, compressed, format;
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+    for (level = 0;; level++)
+    {
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+        if (width <= 0)
+            break;
+
+        if (compressed)
+        {
+            int level_size;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &level_size);
+            size += level_size;
+        }
+        else
+        {
+            int height;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+            size += (size_t)width * height * (format == GL_RGB || format == GL_RGB8 ? 3 : 4);
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return size;
+}
+
 void seel_texture_bind(struct Texture t)
 {
     glBindTexture(GL_TEXTURE_2D, t.id);
@@ -0,0 +1,630 @@
+#ifndef TEXTURE_FILE_H
+#define TEXTURE_FILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "glad/gl.h"
+#include "texture.h"
+
+/*
+ * Cooked textures are DDS files written by tools/cook_texture.c: a block
+ * compressed mip chain that is handed level by level to
+ * glCompressedTexImage2D, so loading neither decodes a PNG nor runs
+ * glGenerateMipmap. Rows are stored bottom-up, the way the engine uploads
+ * every image. The cooker writes BC1 for opaque images, BC3 for images
+ * with alpha and BC5 for normal maps; the loader also accepts BC7 files.
+ */
+
+#define SEEL_TEXTURE_FILE_EXTENSION ".dds"
+#define SEEL_TEXTURE_FILE_MAX_EXTENT 16384
+#define SEEL_TEXTURE_FILE_MAX_LEVELS 15
+
+#define SEEL_DDS_MAGIC 0x20534444u   /* "DDS " */
+#define SEEL_DDS_FOURCC_DX10 0x30315844u
+#define SEEL_DDS_FOURCC_DXT1 0x31545844u
+#define SEEL_DDS_FOURCC_DXT5 0x35545844u
+#define SEEL_DDS_FOURCC_ATI2 0x32495441u
+#define SEEL_DDS_FOURCC_BC5U 0x55354342u
+#define SEEL_DDS_PIXEL_FOURCC 0x4
+#define SEEL_DDS_REQUIRED_FLAGS 0x1007 /* caps, height, width, pixel format */
+#define SEEL_DDS_MIPMAP_COUNT 0x20000
+#define SEEL_DDS_LINEAR_SIZE 0x80000
+#define SEEL_DDS_CAPS_TEXTURE 0x1000
+#define SEEL_DDS_CAPS_COMPLEX 0x8
+#define SEEL_DDS_CAPS_MIPMAP 0x400000
+#define SEEL_DDS_TEXTURE_2D 3
+
+struct DdsPixelFormat
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t four_cc;
+    uint32_t rgb_bit_count;
+    uint32_t bit_masks[4];
+};
+
+struct DdsHeader
+{
+    uint32_t magic;
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitch_or_linear_size;
+    uint32_t depth;
+    uint32_t mip_map_count;
+    uint32_t reserved[11];
+    struct DdsPixelFormat pixel_format;
+    uint32_t caps[4];
+    uint32_t reserved2;
+};
+
+struct DdsHeaderDx10
+{
+    uint32_t dxgi_format;
+    uint32_t resource_dimension;
+    uint32_t misc_flag;
+    uint32_t array_size;
+    uint32_t misc_flags2;
+};
+
+/* DXGI formats of the DX10 header and the GL formats they upload as */
+static const struct
+{
+    uint32_t dxgi_format;
+    unsigned int gl_format;
+} seel_texture_file_formats[] = {
+    {71, GL_COMPRESSED_RGB_S3TC_DXT1_EXT},  /* BC1 */
+    {77, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT}, /* BC3 */
+    {83, GL_COMPRESSED_RG_RGTC2},           /* BC5 */
+    {98, GL_COMPRESSED_RGBA_BPTC_UNORM},    /* BC7 */
+};
+
+/* Path of the cooked file next to a source image: the extension is replaced */
+void seel_texture_file_path(const char *source_path, char *dest, size_t size)
+{
+    const char *slash = strrchr(source_path, '/');
+    const char *dot = strrchr(source_path, '.');
+    size_t length = dot && (!slash || dot > slash) ? (size_t)(dot - source_path) : strlen(source_path);
+    snprintf(dest, size, "%.*s%s", (int)length, source_path, SEEL_TEXTURE_FILE_EXTENSION);
+}
+
+static unsigned int seel_texture_file_gl_format(const struct DdsHeader *header, const struct DdsHeaderDx10 *dx10)
+{
+    if (dx10)
+    {
+        for (size_t i = 0; i < sizeof(seel_texture_file_formats) / sizeof(seel_texture_file_formats[0]); i++)
+        {
+            if (seel_texture_file_formats[i].dxgi_format == dx10->dxgi_format)
+                return seel_texture_file_formats[i].gl_format;
+        }
+        return 0;
+    }
+
+    switch (header->pixel_format.four_cc)
+    {
+    case SEEL_DDS_FOURCC_DXT1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case SEEL_DDS_FOURCC_DXT5:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case SEEL_DDS_FOURCC_ATI2:
+    case SEEL_DDS_FOURCC_BC5U:
+        return GL_COMPRESSED_RG_RGTC2;
+    default:
+        return 0;
+    }
+}
+
+static int seel_texture_file_channels(unsigned int format)
+{
+    switch (format)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        return 3;
+    case GL_COMPRESSED_RG_RGTC2:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+/*
+ * Reads a cooked texture into image, leaving it empty when the file is
+ * missing, not a 2D block compressed DDS or truncated. Only touches the
+ * file, so worker threads may read several at once.
+ */
+bool seel_texture_read_cooked(const char *path, struct TextureImage *image)
+{
+    memset(image, 0, sizeof(struct TextureImage));
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    struct DdsHeader header;
+    struct DdsHeaderDx10 dx10;
+    bool has_dx10 = false;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == SEEL_DDS_MAGIC &&
+                 header.size == sizeof(header) - sizeof(header.magic) &&
+                 (header.flags & SEEL_DDS_REQUIRED_FLAGS) == SEEL_DDS_REQUIRED_FLAGS &&
+                 (header.pixel_format.flags & SEEL_DDS_PIXEL_FOURCC) && header.depth <= 1;
+    if (valid && header.pixel_format.four_cc == SEEL_DDS_FOURCC_DX10)
+    {
+        has_dx10 = true;
+        valid = fread(&dx10, sizeof(dx10), 1, file) == 1 && dx10.resource_dimension == SEEL_DDS_TEXTURE_2D &&
+                dx10.array_size <= 1;
+    }
+
+    unsigned int format = valid ? seel_texture_file_gl_format(&header, has_dx10 ? &dx10 : NULL) : 0;
+    int levels = header.flags & SEEL_DDS_MIPMAP_COUNT && header.mip_map_count ? (int)header.mip_map_count : 1;
+    valid = format && header.width && header.height && header.width <= SEEL_TEXTURE_FILE_MAX_EXTENT &&
+            header.height <= SEEL_TEXTURE_FILE_MAX_EXTENT && levels <= SEEL_TEXTURE_FILE_MAX_LEVELS;
+    if (!valid)
+    {
+        fprintf(stderr, "Cooked texture %s is not a supported DDS file, cook it again!\n", path);
+        fclose(file);
+        return false;
+    }
+
+    image->width = (int)header.width;
+    image->height = (int)header.height;
+    image->channels = seel_texture_file_channels(format);
+    image->compressed_format = format;
+    image->levels = levels;
+
+    size_t size = seel_texture_level_offset(image, levels);
+    image->data = malloc(size);
+    if (!image->data || fread(image->data, 1, size, file) != size)
+    {
+        fprintf(stderr, "Failed to read cooked texture %s!\n", path);
+        free(image->data);
+        memset(image, 0, sizeof(struct TextureImage));
+        fclose(file);
+        return false;
+    }
+
+    fclose(file);
+    return true;
+}
+
+/* Prefers the cooked file next to path and falls back to decoding path itself */
+bool seel_texture_decode_cached(const char *path, struct TextureImage *image)
+{
+    char cooked_path[MAX_TEXTURE_NAME_LEN];
+    seel_texture_file_path(path, cooked_path, sizeof(cooked_path));
+    if (seel_texture_read_cooked(cooked_path, image))
+        return true;
+
+    return seel_texture_decode(path, image);
+}
+
+/* seel_texture_create through seel_texture_decode_cached */
+struct Texture seel_texture_create_cached(const char *path, enum TextureType type)
+{
+    unsigned int tex;
+    glGenTextures(1, &tex);
+
+    struct TextureImage image;
+    seel_texture_decode_cached(path, &image);
+    seel_texture_upload(tex, &image);
+    seel_texture_image_free(&image);
+
+    return (struct Texture){.id = tex, .type = type};
+}
+
+/* Cooker side: block encoders and the writer */
+
+static void seel_bc_fetch_block(const unsigned char *rgba, int width, int height, int block_x, int block_y, unsigned char block[16][4])
+{
+    /* blocks over the edge repeat the last row and column */
+    for (int y = 0; y < 4; y++)
+    {
+        int sy = block_y * 4 + y < height ? block_y * 4 + y : height - 1;
+        for (int x = 0; x < 4; x++)
+        {
+            int sx = block_x * 4 + x < width ? block_x * 4 + x : width - 1;
+            memcpy(block[y * 4 + x], rgba + ((size_t)sy * width + sx) * 4, 4);
+        }
+    }
+}
+
+static uint16_t seel_bc1_pack_565(const float color[3])
+{
+    int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+    r = r < 0 ? 0 : r > 31 ? 31 : r;
+    g = g < 0 ? 0 : g > 63 ? 63 : g;
+    b = b < 0 ? 0 : b > 31 ? 31 : b;
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+static void seel_bc1_unpack_565(uint16_t packed, int color[3])
+{
+    int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+/* Picks the nearest of the four palette colors per texel and returns the total squared error */
+static int seel_bc1_fit_indices(const unsigned char block[16][4], uint16_t c0, uint16_t c1, uint32_t *indices)
+{
+    int palette[4][3];
+    seel_bc1_unpack_565(c0, palette[0]);
+    seel_bc1_unpack_565(c1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    int total = 0;
+    *indices = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, best_error = INT32_MAX;
+        for (int p = 0; p < 4; p++)
+        {
+            int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+            int error = dr * dr + dg * dg + db * db;
+            if (error < best_error)
+            {
+                best = p;
+                best_error = error;
+            }
+        }
+        *indices |= (uint32_t)best << (2 * i);
+        total += best_error;
+    }
+    return total;
+}
+
+/* Endpoints that best reproduce the block for the given indices, in the least squares sense */
+static bool seel_bc1_refit(const unsigned char block[16][4], uint32_t indices, float endpoints[2][3])
+{
+    static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = {0.0f}, bx[3] = {0.0f};
+    for (int i = 0; i < 16; i++)
+    {
+        float a = weights[(indices >> (2 * i)) & 3], b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < 3; c++)
+        {
+            ax[c] += a * block[i][c];
+            bx[c] += b * block[i][c];
+        }
+    }
+
+    float det = aa * bb - ab * ab;
+    if (fabsf(det) < 1e-6f)
+        return false;
+
+    for (int c = 0; c < 3; c++)
+    {
+        endpoints[0][c] = (ax[c] * bb - bx[c] * ab) / det;
+        endpoints[1][c] = (bx[c] * aa - ax[c] * ab) / det;
+    }
+    return true;
+}
+
+/* Range fit along the principal axis of the block's colors, then one least squares refinement */
+static void seel_bc1_encode_block(const unsigned char block[16][4], unsigned char *out)
+{
+    float mean[3] = {0.0f}, covariance[6] = {0.0f};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += block[i][c] / 16.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float d[3] = {block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2]};
+        covariance[0] += d[0] * d[0];
+        covariance[1] += d[0] * d[1];
+        covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1];
+        covariance[4] += d[1] * d[2];
+        covariance[5] += d[2] * d[2];
+    }
+
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[3] = {covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                         covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                         covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]};
+        float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float low = 0.0f, high = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+        low = t < low ? t : low;
+        high = t > high ? t : high;
+    }
+
+    float endpoints[2][3];
+    for (int c = 0; c < 3; c++)
+    {
+        endpoints[0][c] = mean[c] + axis[c] * high;
+        endpoints[1][c] = mean[c] + axis[c] * low;
+    }
+
+    uint16_t c0 = seel_bc1_pack_565(endpoints[0]), c1 = seel_bc1_pack_565(endpoints[1]);
+    uint32_t indices;
+    int error = seel_bc1_fit_indices(block, c0, c1, &indices);
+    if (seel_bc1_refit(block, indices, endpoints))
+    {
+        uint16_t r0 = seel_bc1_pack_565(endpoints[0]), r1 = seel_bc1_pack_565(endpoints[1]);
+        uint32_t refit_indices;
+        if (seel_bc1_fit_indices(block, r0, r1, &refit_indices) < error)
+        {
+            c0 = r0;
+            c1 = r1;
+            indices = refit_indices;
+        }
+    }
+
+    /* c0 > c1 selects the four color mode; swapping endpoints swaps index pairs 0/1 and 2/3 */
+    if (c0 < c1)
+    {
+        uint16_t swap = c0;
+        c0 = c1;
+        c1 = swap;
+        indices ^= 0x55555555u;
+    }
+    else if (c0 == c1)
+    {
+        indices = 0;
+    }
+
+    out[0] = (unsigned char)c0;
+    out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)c1;
+    out[3] = (unsigned char)(c1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+/* One channel in the eight value mode between the block's extremes (BC4, BC3 alpha, BC5 halves) */
+static void seel_bc4_encode_block(const unsigned char block[16][4], int channel, unsigned char *out)
+{
+    int low = 255, high = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        low = block[i][channel] < low ? block[i][channel] : low;
+        high = block[i][channel] > high ? block[i][channel] : high;
+    }
+
+    int palette[8] = {high, low};
+    for (int i = 2; i < 8; i++)
+        palette[i] = ((8 - i) * high + (i - 1) * low + 3) / 7;
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 16 && high != low; i++)
+    {
+        int best = 0, best_error = INT32_MAX;
+        for (int p = 0; p < 8; p++)
+        {
+            int error = abs(block[i][channel] - palette[p]);
+            if (error < best_error)
+            {
+                best = p;
+                best_error = error;
+            }
+        }
+        indices |= (uint64_t)best << (3 * i);
+    }
+
+    out[0] = (unsigned char)high;
+    out[1] = (unsigned char)low;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+static void seel_texture_file_encode_level(const unsigned char *rgba, int width, int height, unsigned int format, unsigned char *out)
+{
+    int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+    for (int by = 0; by < blocks_y; by++)
+    {
+        for (int bx = 0; bx < blocks_x; bx++)
+        {
+            unsigned char block[16][4];
+            seel_bc_fetch_block(rgba, width, height, bx, by, block);
+            switch (format)
+            {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+                seel_bc1_encode_block(block, out);
+                out += 8;
+                break;
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                seel_bc4_encode_block(block, 3, out);
+                seel_bc1_encode_block(block, out + 8);
+                out += 16;
+                break;
+            case GL_COMPRESSED_RG_RGTC2:
+                seel_bc4_encode_block(block, 0, out);
+                seel_bc4_encode_block(block, 1, out + 8);
+                out += 16;
+                break;
+            }
+        }
+    }
+}
+
+/* 2x2 box filter into the next mip level; normal maps are renormalized afterwards */
+static void seel_texture_file_downsample(const unsigned char *source, int width, int height, unsigned char *dest, bool normal_map)
+{
+    int next_width = width > 1 ? width / 2 : 1, next_height = height > 1 ? height / 2 : 1;
+    for (int y = 0; y < next_height; y++)
+    {
+        int y0 = y * 2, y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+        for (int x = 0; x < next_width; x++)
+        {
+            int x0 = x * 2, x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+            unsigned char *texel = dest + ((size_t)y * next_width + x) * 4;
+            for (int c = 0; c < 4; c++)
+            {
+                int sum = source[((size_t)y0 * width + x0) * 4 + c] + source[((size_t)y0 * width + x1) * 4 + c] +
+                          source[((size_t)y1 * width + x0) * 4 + c] + source[((size_t)y1 * width + x1) * 4 + c];
+                texel[c] = (unsigned char)((sum + 2) / 4);
+            }
+
+            if (normal_map)
+            {
+                float n[3], length = 0.0f;
+                for (int c = 0; c < 3; c++)
+                {
+                    n[c] = texel[c] / 127.5f - 1.0f;
+                    length += n[c] * n[c];
+                }
+                length = sqrtf(length);
+                for (int c = 0; c < 3 && length > 1e-6f; c++)
+                    texel[c] = (unsigned char)((n[c] / length + 1.0f) * 127.5f + 0.5f);
+            }
+        }
+    }
+}
+
+/*
+ * Builds the full mip chain of a decoded image and compresses every level
+ * to format (BC1, BC3 or BC5, given by its GL format). cooked owns the
+ * result and is freed with seel_texture_image_free.
+ */
+bool seel_texture_file_compress(const struct TextureImage *source, unsigned int format, struct TextureImage *cooked)
+{
+    memset(cooked, 0, sizeof(struct TextureImage));
+    if (format != GL_COMPRESSED_RGB_S3TC_DXT1_EXT && format != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT && format != GL_COMPRESSED_RG_RGTC2)
+    {
+        fprintf(stderr, "The cooker cannot encode texture format 0x%x!\n", format);
+        return false;
+    }
+
+    cooked->width = source->width;
+    cooked->height = source->height;
+    cooked->channels = seel_texture_file_channels(format);
+    cooked->compressed_format = format;
+    cooked->levels = 1;
+    while ((source->width >> cooked->levels) || (source->height >> cooked->levels))
+        cooked->levels++;
+
+    size_t pixels = (size_t)source->width * source->height;
+    unsigned char *level = malloc(pixels * 4);
+    unsigned char *next = malloc(pixels * 4);
+    cooked->data = malloc(seel_texture_level_offset(cooked, cooked->levels));
+    if (!level || !next || !cooked->data)
+    {
+        fprintf(stderr, "Failed to allocate memory for texture compression!\n");
+        free(level);
+        free(next);
+        free(cooked->data);
+        cooked->data = NULL;
+        return false;
+    }
+
+    /* expand to RGBA: grey images repeat their value, missing alpha is opaque */
+    for (size_t i = 0; i < pixels; i++)
+    {
+        const unsigned char *texel = source->data + i * source->channels;
+        unsigned char *rgba = level + i * 4;
+        rgba[0] = texel[0];
+        rgba[1] = source->channels >= 3 ? texel[1] : texel[0];
+        rgba[2] = source->channels >= 3 ? texel[2] : texel[0];
+        rgba[3] = source->channels == 4 ? texel[3] : source->channels == 2 ? texel[1] : 255;
+    }
+
+    int width = source->width, height = source->height;
+    for (int i = 0; i < cooked->levels; i++)
+    {
+        seel_texture_file_encode_level(level, width, height, format, cooked->data + seel_texture_level_offset(cooked, i));
+        if (i + 1 == cooked->levels)
+            break;
+
+        seel_texture_file_downsample(level, width, height, next, format == GL_COMPRESSED_RG_RGTC2);
+        unsigned char *swap = level;
+        level = next;
+        next = swap;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    free(level);
+    free(next);
+    return true;
+}
+
+/* Format the cooker picks when none is asked for: BC3 if any texel is not opaque, BC1 otherwise */
+unsigned int seel_texture_file_default_format(const struct TextureImage *source)
+{
+    if (source->channels == 2 || source->channels == 4)
+    {
+        size_t pixels = (size_t)source->width * source->height;
+        for (size_t i = 0; i < pixels; i++)
+        {
+            if (source->data[i * source->channels + source->channels - 1] != 255)
+                return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        }
+    }
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+/* Writes a compressed image as a DDS file with a DX10 header */
+bool seel_texture_file_write(const struct TextureImage *image, const char *path)
+{
+    struct DdsHeader header;
+    struct DdsHeaderDx10 dx10;
+    memset(&header, 0, sizeof(header));
+    memset(&dx10, 0, sizeof(dx10));
+
+    for (size_t i = 0; i < sizeof(seel_texture_file_formats) / sizeof(seel_texture_file_formats[0]); i++)
+    {
+        if (seel_texture_file_formats[i].gl_format == image->compressed_format)
+            dx10.dxgi_format = seel_texture_file_formats[i].dxgi_format;
+    }
+    if (!dx10.dxgi_format)
+    {
+        fprintf(stderr, "Cannot write texture format 0x%x to %s!\n", image->compressed_format, path);
+        return false;
+    }
+    dx10.resource_dimension = SEEL_DDS_TEXTURE_2D;
+    dx10.array_size = 1;
+
+    header.magic = SEEL_DDS_MAGIC;
+    header.size = sizeof(header) - sizeof(header.magic);
+    header.flags = SEEL_DDS_REQUIRED_FLAGS | SEEL_DDS_MIPMAP_COUNT | SEEL_DDS_LINEAR_SIZE;
+    header.height = (uint32_t)image->height;
+    header.width = (uint32_t)image->width;
+    header.pitch_or_linear_size = (uint32_t)seel_texture_level_size(image->compressed_format, image->width, image->height);
+    header.mip_map_count = (uint32_t)image->levels;
+    header.pixel_format.size = sizeof(struct DdsPixelFormat);
+    header.pixel_format.flags = SEEL_DDS_PIXEL_FOURCC;
+    header.pixel_format.four_cc = SEEL_DDS_FOURCC_DX10;
+    header.caps[0] = SEEL_DDS_CAPS_TEXTURE | (image->levels > 1 ? SEEL_DDS_CAPS_COMPLEX | SEEL_DDS_CAPS_MIPMAP : 0);
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to open %s for writing!\n", path);
+        return false;
+    }
+
+    size_t size = seel_texture_level_offset(image, image->levels);
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(&dx10, sizeof(dx10), 1, file) == 1 &&
+                   fwrite(image->data, 1, size, file) == size;
+    written = fclose(file) == 0 && written;
+    if (!written)
+        fprintf(stderr, "Failed to write cooked texture %s!\n", path);
+    return written;
+}
+
+#endif /* TEXTURE_FILE_H */
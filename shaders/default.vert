@@ -1,58 +1,130 @@
-#version 460 core
+#version 450 core
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 layout (location = 2) in vec3 aNormal;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec3 aBiTangent;
-layout (location = 5) in ivec4 boneIds; // Bone IDs affecting this vertex
+layout (location = 5) in ivec4 boneIds; // Mesh palette slots of the bones affecting this vertex
 layout (location = 6) in vec4 weights;  // Corresponding bone weights
+layout (location = 13) in ivec4 aFrame; // Compact layouts: octahedral normal and tangent, bitangent sign in the lowest bit
+
+// Per-instance data of crowd draws
+layout (location = 7) in mat4 aInstanceModel; // World matrix, locations 7-10
+layout (location = 11) in int aInstanceClip;  // Baked clip id
+layout (location = 12) in float aInstanceTime; // Seconds into the clip
 
 out vec2 TexCoord;  // Texture coordinates
 out vec3 Normal;    // Transformed normal vector
 out vec3 FragPos;   // Position of fragment in world space
 
 // Animation parameters
-const int MAX_BONES = 100;
 const int MAX_BONE_INFLUENCE = 4;
 
-uniform mat4 boneMatrices[MAX_BONES];  // Bone transformation matrices
+// Mesh bone palette of the current draw, bound as a range of the per-frame palette buffer
+layout (std430, binding = 0) readonly buffer BonePalette
+{
+    mat4 boneMatrices[];
+};
 uniform bool animate;                 // Toggle animation on/off
 
+// Baked animation texture for crowds: one row per frame, three texels per bone
+const int MAX_BAKED_CLIPS = 16;
+uniform bool crowd;
+uniform sampler2D bakedBones;
+uniform int bakedBoneCount;
+uniform int bakedClipCount;
+uniform float bakedSampleRate;
+uniform ivec2 bakedClipFrames[MAX_BAKED_CLIPS]; // First frame and frame count per clip
+const int MAX_MESH_BONES = 100;
+uniform int meshBones[MAX_MESH_BONES]; // Model bone of every mesh palette slot
+uniform int meshBoneCount;
+
+// Vertex layout of the current mesh, see enum VertexLayout
+uniform bool packedFrame;     // normal comes from aFrame instead of aNormal
+uniform bool meshSkinned;     // mesh has bone attributes
+uniform vec3 positionOffset;  // quantized positions are scaled back to the mesh bounds
+uniform vec3 positionScale;
+
 // Matrices for non-animated transformations
 uniform mat4 model;        // Model matrix
 uniform mat4 view;         // View matrix
 uniform mat4 projection;   // Projection matrix
 uniform mat4 normalMatrix; // Model-view normal transformation matrix
 
+mat4 bakedBoneMatrix(int bone, int frame)
+{
+    int x = bone * 3;
+    vec4 row0 = texelFetch(bakedBones, ivec2(x, frame), 0);
+    vec4 row1 = texelFetch(bakedBones, ivec2(x + 1, frame), 0);
+    vec4 row2 = texelFetch(bakedBones, ivec2(x + 2, frame), 0);
+    return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+int boneCount()
+{
+    return crowd ? meshBoneCount : boneMatrices.length();
+}
+
+mat4 boneMatrix(int bone)
+{
+    if (!crowd)
+        return boneMatrices[bone];
+
+    // Blend the two baked frames around the instance time, wrapping at the clip end
+    ivec2 clip = bakedClipFrames[clamp(aInstanceClip, 0, bakedClipCount - 1)];
+    float frame = aInstanceTime * bakedSampleRate;
+    int frame0 = int(floor(frame)) % clip.y;
+    int frame1 = (frame0 + 1) % clip.y;
+    float blend = fract(frame);
+    int modelBone = min(meshBones[bone], bakedBoneCount - 1);
+    return bakedBoneMatrix(modelBone, clip.x + frame0) * (1.0 - blend) + bakedBoneMatrix(modelBone, clip.x + frame1) * blend;
+}
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
 void main()
 {
     vec4 updatedPosition = vec4(0.0f);
     vec3 updatedNormal = vec3(0.0f);
 
-    if (animate)
+    // aFrame.zw carry the tangent for when normal mapping needs it
+    vec3 position = aPos * positionScale + positionOffset;
+    vec3 normal = packedFrame ? octahedralDecode(max(vec2(aFrame.xy) / 32767.0, -1.0)) : aNormal;
+
+    if (animate && meshSkinned)
     {
         for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
         {
-            if (weights[i] > 0.0 && boneIds[i] < MAX_BONES)
+            if (weights[i] > 0.0 && boneIds[i] >= 0 && boneIds[i] < boneCount())
             {
-                vec4 bonePosition = boneMatrices[boneIds[i]] * vec4(aPos, 1.0);
+                mat4 bone = boneMatrix(boneIds[i]);
+                vec4 bonePosition = bone * vec4(position, 1.0);
                 updatedPosition += bonePosition * weights[i];
 
-                mat3 boneNormalMatrix = mat3(boneMatrices[boneIds[i]]);
-                updatedNormal += weights[i] * normalize(boneNormalMatrix * aNormal);
+                mat3 boneNormalMatrix = mat3(bone);
+                updatedNormal += weights[i] * normalize(boneNormalMatrix * normal);
             }
         }
     }
     else
     {
-        updatedPosition = vec4(aPos, 1.0f);
-        updatedNormal = aNormal;
+        updatedPosition = vec4(position, 1.0f);
+        updatedNormal = normal;
     }
 
+    mat4 modelMatrix = crowd ? aInstanceModel : model;
+    mat3 normalTransform = crowd ? transpose(inverse(mat3(aInstanceModel))) : mat3(normalMatrix);
+
     TexCoord = aTexCoord;
-    FragPos = vec3(model * updatedPosition);
-    Normal = normalize(mat3(normalMatrix) * updatedNormal);
+    FragPos = vec3(modelMatrix * updatedPosition);
+    Normal = normalize(normalTransform * updatedNormal);
     
-    gl_Position = projection * view * model * updatedPosition;
+    gl_Position = projection * view * modelMatrix * updatedPosition;
 }
\ No newline at end of file
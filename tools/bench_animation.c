@@ -0,0 +1,363 @@
+/*
+ * Keyframe sampling microbenchmark.
+ *
+ * Samples a single channel at a steady frame rate for clips of increasing
+ * key count and reports the cost per sample for the old linear scan, a plain
+ * binary search and the cached cursor used by the animator. Then samples a
+ * whole skeleton through seel_bone_sample and through the batched SoA clip
+ * sampler, after checking that the batched sampler matches the per bone
+ * path on a clip with moving keys. Finally evaluates a crowd of characters on 1 to N job pool
+ * workers to show how the animation update scales with cores.
+ *
+ *     make bench_animation && ./bench_animation
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "../include/bone.h"
+#include "../include/clip.h"
+#include "../include/job_pool.h"
+
+#define BENCH_SAMPLES 2000000
+#define BENCH_FRAME_STEP 0.5f
+#define BENCH_POSE_BONES 64
+#define BENCH_POSE_KEYS 300
+#define BENCH_POSES 20000
+#define BENCH_CHARACTERS 512
+#define BENCH_CROWD_FRAMES 100
+/* batched rotations are nlerped, per bone ones slerped */
+#define BENCH_VERIFY_TOLERANCE 1e-3f
+
+static double bench_now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+static struct Bone bench_make_bone(unsigned int num_keys)
+{
+    struct Bone bone = {0};
+    bone.num_positions = bone.num_rotations = bone.num_scalings = num_keys;
+    bone.positions = malloc(sizeof(struct KeyPosition) * num_keys);
+    bone.rotations = malloc(sizeof(struct KeyRotation) * num_keys);
+    bone.scalings = malloc(sizeof(struct KeyScale) * num_keys);
+
+    unsigned int i;
+    for (i = 0; i < num_keys; i++)
+    {
+        float t = (float)i;
+        bone.positions[i] = (struct KeyPosition){{t, 0.0f, 0.0f}, t};
+        bone.rotations[i] = (struct KeyRotation){{0.0f, 0.0f, 0.0f, 1.0f}, t};
+        bone.scalings[i] = (struct KeyScale){{1.0f, 1.0f, 1.0f}, t};
+    }
+    return bone;
+}
+
+/* Keys that walk through positions, rotations and scales, so every matrix element varies */
+static struct Bone bench_make_moving_bone(unsigned int num_keys, unsigned int seed)
+{
+    struct Bone bone = bench_make_bone(num_keys);
+    vec3 axis = {(float)(seed % 3) + 0.5f, (float)(seed % 5) - 2.0f, 1.0f};
+    glm_vec3_normalize(axis);
+
+    unsigned int i;
+    for (i = 0; i < num_keys; i++)
+    {
+        float t = (float)i;
+        bone.positions[i].position[0] = sinf(t * 0.1f + (float)seed);
+        bone.positions[i].position[1] = cosf(t * 0.07f) * (float)(seed % 4);
+        bone.positions[i].position[2] = t * 0.01f;
+        glm_quatv(bone.rotations[i].rotation, t * 0.05f + (float)seed, axis);
+        bone.scalings[i].scale[0] = 1.0f + 0.2f * sinf(t * 0.03f);
+        bone.scalings[i].scale[1] = 1.0f;
+        bone.scalings[i].scale[2] = 0.8f + 0.1f * (float)(seed % 3);
+    }
+    return bone;
+}
+
+/*
+ * Largest difference between the batched sampler and seel_bone_sample over
+ * a run of frames. Starts one channel in and stops short of the last, so
+ * unaligned and partial batches are covered too.
+ */
+static float bench_verify_batched(void)
+{
+    struct Bone bones[BENCH_POSE_BONES];
+    struct KeyCursor bone_cursors[BENCH_POSE_BONES] = {0};
+    struct KeyCursor clip_cursors[BENCH_POSE_BONES] = {0};
+    mat4 *expected = malloc(sizeof(mat4) * BENCH_POSE_BONES);
+    mat4 *batched = malloc(sizeof(mat4) * BENCH_POSE_BONES);
+    unsigned int i, b, c;
+
+    for (b = 0; b < BENCH_POSE_BONES; b++)
+        bones[b] = bench_make_moving_bone(BENCH_POSE_KEYS, b);
+
+    struct AnimationClip clip;
+    seel_clip_create_from_bones(&clip, bones, BENCH_POSE_BONES);
+
+    float duration = (float)(BENCH_POSE_KEYS - 1);
+    float max_error = 0.0f;
+    float t = 0.0f;
+    for (i = 0; i < 2 * BENCH_POSE_KEYS; i++)
+    {
+        seel_clip_sample(&clip, 1, BENCH_POSE_BONES - 2, t, clip_cursors, batched);
+        for (b = 1; b < BENCH_POSE_BONES - 1; b++)
+        {
+            seel_bone_sample(&bones[b], t, &bone_cursors[b], expected[b]);
+            for (c = 0; c < 16; c++)
+                max_error = glm_max(max_error, fabsf(expected[b][c / 4][c % 4] - batched[b][c / 4][c % 4]));
+        }
+        t = fmodf(t + BENCH_FRAME_STEP * 0.73f, duration);
+    }
+
+    seel_clip_destroy(&clip);
+    for (b = 0; b < BENCH_POSE_BONES; b++)
+    {
+        free(bones[b].positions);
+        free(bones[b].rotations);
+        free(bones[b].scalings);
+    }
+    free(expected);
+    free(batched);
+    return max_error;
+}
+
+/* The per-sample search the animator used before cursors were introduced */
+static unsigned int bench_linear_index(const struct Bone *bone, float animation_time)
+{
+    int index;
+    for (index = 0; index < bone->num_rotations - 1; index++)
+    {
+        if (animation_time < bone->rotations[index + 1].time_stamp)
+            return index;
+    }
+    return bone->num_rotations - 2;
+}
+
+static bool bench_pose(void)
+{
+    struct Bone bones[BENCH_POSE_BONES];
+    struct KeyCursor cursors[BENCH_POSE_BONES] = {0};
+    mat4 *transforms = malloc(sizeof(mat4) * BENCH_POSE_BONES);
+    unsigned int i, b;
+
+    for (b = 0; b < BENCH_POSE_BONES; b++)
+        bones[b] = bench_make_bone(BENCH_POSE_KEYS);
+
+    struct AnimationClip clip;
+    seel_clip_create_from_bones(&clip, bones, BENCH_POSE_BONES);
+
+    float duration = (float)(BENCH_POSE_KEYS - 1);
+    volatile float sink = 0.0f;
+    float t = 0.0f;
+    double start = bench_now();
+    for (i = 0; i < BENCH_POSES; i++)
+    {
+        for (b = 0; b < BENCH_POSE_BONES; b++)
+            seel_bone_sample(&bones[b], t, &cursors[b], transforms[b]);
+        sink += transforms[BENCH_POSE_BONES - 1][3][0];
+        t = fmodf(t + BENCH_FRAME_STEP, duration);
+    }
+    double per_bone = (bench_now() - start) * 1e9 / ((double)BENCH_POSES * BENCH_POSE_BONES);
+
+    memset(cursors, 0, sizeof(cursors));
+    t = 0.0f;
+    start = bench_now();
+    for (i = 0; i < BENCH_POSES; i++)
+    {
+        seel_clip_sample(&clip, 0, BENCH_POSE_BONES, t, cursors, transforms);
+        sink += transforms[BENCH_POSE_BONES - 1][3][0];
+        t = fmodf(t + BENCH_FRAME_STEP, duration);
+    }
+    double batched = (bench_now() - start) * 1e9 / ((double)BENCH_POSES * BENCH_POSE_BONES);
+
+    float max_error = bench_verify_batched();
+    printf("\n%u bones, %d lanes per batch, max error vs per bone %.2e\n", BENCH_POSE_BONES, SEEL_CLIP_LANES, max_error);
+    printf("%-12s %10.2f ns/bone %10.0f poses/s\n", "per bone", per_bone, 1e9 / (per_bone * BENCH_POSE_BONES));
+    printf("%-12s %10.2f ns/bone %10.0f poses/s\n", "batched", batched, 1e9 / (batched * BENCH_POSE_BONES));
+
+    seel_clip_destroy(&clip);
+    for (b = 0; b < BENCH_POSE_BONES; b++)
+    {
+        free(bones[b].positions);
+        free(bones[b].rotations);
+        free(bones[b].scalings);
+    }
+    free(transforms);
+
+    if (max_error > BENCH_VERIFY_TOLERANCE)
+    {
+        fprintf(stderr, "Batched clip sampling does not match the per bone path!\n");
+        return false;
+    }
+    return true;
+}
+
+/* One character of the crowd: its own cursors and scratch, like an Animator */
+struct BenchCharacter
+{
+    struct KeyCursor cursors[BENCH_POSE_BONES];
+    mat4 locals[BENCH_POSE_BONES];
+    mat4 globals[BENCH_POSE_BONES];
+    float time;
+};
+
+struct BenchCrowd
+{
+    struct AnimationClip *clip;
+    struct BenchCharacter *characters;
+    float duration;
+};
+
+static void bench_crowd_job(void *context, unsigned int begin, unsigned int end, unsigned int worker)
+{
+    struct BenchCrowd *crowd = (struct BenchCrowd *)context;
+    unsigned int i, b;
+    (void)worker;
+
+    for (i = begin; i < end; i++)
+    {
+        struct BenchCharacter *character = &crowd->characters[i];
+        character->time = fmodf(character->time + BENCH_FRAME_STEP, crowd->duration);
+        seel_clip_sample(crowd->clip, 0, BENCH_POSE_BONES, character->time, character->cursors, character->locals);
+
+        /* a chain is the worst case for the hierarchy pass */
+        glm_mat4_copy(character->locals[0], character->globals[0]);
+        for (b = 1; b < BENCH_POSE_BONES; b++)
+            glm_mat4_mul(character->globals[b - 1], character->locals[b], character->globals[b]);
+    }
+}
+
+static void bench_threads(void)
+{
+    struct Bone bones[BENCH_POSE_BONES];
+    unsigned int i, b;
+
+    for (b = 0; b < BENCH_POSE_BONES; b++)
+        bones[b] = bench_make_bone(BENCH_POSE_KEYS);
+
+    struct AnimationClip clip;
+    seel_clip_create_from_bones(&clip, bones, BENCH_POSE_BONES);
+
+    struct BenchCrowd crowd;
+    crowd.clip = &clip;
+    crowd.duration = (float)(BENCH_POSE_KEYS - 1);
+    crowd.characters = aligned_alloc(SEEL_CACHE_LINE_SIZE, sizeof(struct BenchCharacter) * BENCH_CHARACTERS);
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int max_workers = cores > 4 ? (unsigned int)cores : 4;
+    if (max_workers > SEEL_MAX_JOB_WORKERS)
+        max_workers = SEEL_MAX_JOB_WORKERS;
+
+    printf("\n%u characters x %u bones, %ld online cores\n", BENCH_CHARACTERS, BENCH_POSE_BONES, cores);
+    printf("%8s %14s %10s\n", "workers", "ms/frame", "speedup");
+
+    double single = 0.0;
+    unsigned int workers;
+    for (workers = 1; workers <= max_workers; workers *= 2)
+    {
+        memset(crowd.characters, 0, sizeof(struct BenchCharacter) * BENCH_CHARACTERS);
+        for (i = 0; i < BENCH_CHARACTERS; i++)
+            crowd.characters[i].time = fmodf((float)i * 7.0f, crowd.duration);
+
+        struct JobPool pool;
+        if (!seel_job_pool_create(&pool, workers))
+            break;
+
+        double start = bench_now();
+        for (i = 0; i < BENCH_CROWD_FRAMES; i++)
+        {
+            seel_job_pool_dispatch(&pool, bench_crowd_job, &crowd, BENCH_CHARACTERS, 8);
+            seel_job_pool_wait(&pool);
+        }
+        double frame = (bench_now() - start) * 1e3 / BENCH_CROWD_FRAMES;
+        seel_job_pool_destroy(&pool);
+
+        if (workers == 1)
+            single = frame;
+        printf("%8u %14.3f %10.2f\n", workers, frame, single / frame);
+    }
+
+    free(crowd.characters);
+    seel_clip_destroy(&clip);
+    for (b = 0; b < BENCH_POSE_BONES; b++)
+    {
+        free(bones[b].positions);
+        free(bones[b].rotations);
+        free(bones[b].scalings);
+    }
+}
+
+int main(void)
+{
+    unsigned int key_counts[] = {16, 256, 4096, 65536};
+    unsigned int num_counts = sizeof(key_counts) / sizeof(key_counts[0]);
+
+    printf("%8s %14s %14s %14s %14s\n", "keys", "linear ns", "binary ns", "cursor ns", "sample ns");
+
+    unsigned int c;
+    for (c = 0; c < num_counts; c++)
+    {
+        struct Bone bone = bench_make_bone(key_counts[c]);
+        float duration = (float)(key_counts[c] - 1);
+        volatile unsigned int sink = 0;
+        unsigned int samples = key_counts[c] > 4096 ? BENCH_SAMPLES / 100 : BENCH_SAMPLES;
+        unsigned int i;
+        float t;
+
+        t = 0.0f;
+        double start = bench_now();
+        for (i = 0; i < samples; i++)
+        {
+            sink += bench_linear_index(&bone, t);
+            t = fmodf(t + BENCH_FRAME_STEP, duration);
+        }
+        double linear = (bench_now() - start) * 1e9 / samples;
+
+        t = 0.0f;
+        start = bench_now();
+        for (i = 0; i < BENCH_SAMPLES; i++)
+        {
+            sink += seel_find_key_index(&bone.rotations[0].time_stamp, sizeof(struct KeyRotation), bone.num_rotations, t, 0);
+            t = fmodf(t + BENCH_FRAME_STEP, duration);
+        }
+        double binary = (bench_now() - start) * 1e9 / BENCH_SAMPLES;
+
+        unsigned int hint = 0;
+        t = 0.0f;
+        start = bench_now();
+        for (i = 0; i < BENCH_SAMPLES; i++)
+        {
+            hint = seel_find_key_index(&bone.rotations[0].time_stamp, sizeof(struct KeyRotation), bone.num_rotations, t, hint);
+            sink += hint;
+            t = fmodf(t + BENCH_FRAME_STEP, duration);
+        }
+        double cursor = (bench_now() - start) * 1e9 / BENCH_SAMPLES;
+
+        struct KeyCursor key_cursor = {0};
+        mat4 transform;
+        t = 0.0f;
+        start = bench_now();
+        for (i = 0; i < BENCH_SAMPLES; i++)
+        {
+            seel_bone_sample(&bone, t, &key_cursor, transform);
+            sink += (unsigned int)transform[3][0];
+            t = fmodf(t + BENCH_FRAME_STEP, duration);
+        }
+        double sample = (bench_now() - start) * 1e9 / BENCH_SAMPLES;
+
+        printf("%8u %14.2f %14.2f %14.2f %14.2f\n", key_counts[c], linear, binary, cursor, sample);
+
+        free(bone.positions);
+        free(bone.rotations);
+        free(bone.scalings);
+    }
+
+    if (!bench_pose())
+        return 1;
+    bench_threads();
+
+    return 0;
+}
@@ -0,0 +1,295 @@
+/*
+ * Skinning benchmark.
+ *
+ * Draws a crowd of skinned grid meshes into an offscreen framebuffer with 1
+ * to BENCH_MAX_PASSES passes per frame, once skinning in default.vert on
+ * every pass and once with the compute pre-pass of skinning.h followed by
+ * static draws. Runs headless on any EGL driver with GL 4.3, including
+ * Mesa's llvmpipe:
+ *
+ *     make bench_skinning && ./bench_skinning
+ *
+ * Run it from the repository root so the shaders are found.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "../include/glad/gl.h"
+#include "../include/skinning.h"
+
+#define BENCH_GRID 128 /* vertices per side of every character mesh */
+#define BENCH_BONES 64
+#define BENCH_CHARACTERS 32
+#define BENCH_MAX_PASSES 4
+#define BENCH_FRAMES 20
+#define BENCH_WIDTH 640
+#define BENCH_HEIGHT 360
+
+static double bench_now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+static bool bench_create_context(void)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay display = get_platform_display ? get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : EGL_NO_DISPLAY;
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) || !eglBindAPI(EGL_OPENGL_API))
+    {
+        fprintf(stderr, "Failed to initialize EGL!\n");
+        return false;
+    }
+
+    EGLint config_attributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint num_configs = 0;
+    if (!eglChooseConfig(display, config_attributes, &config, 1, &num_configs) || num_configs == 0)
+    {
+        fprintf(stderr, "No EGL config for desktop OpenGL!\n");
+        return false;
+    }
+
+    EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        fprintf(stderr, "Failed to create an OpenGL 4.3 context!\n");
+        return false;
+    }
+
+    return gladLoadGL((GLADloadfunc)eglGetProcAddress) != 0;
+}
+
+/* Small grid in the xy plane, rows weighted between neighbouring bones; few pixels keep the draws vertex bound */
+static struct Mesh bench_make_mesh(void)
+{
+    unsigned int num_vertices = BENCH_GRID * BENCH_GRID;
+    unsigned int num_indices = (BENCH_GRID - 1) * (BENCH_GRID - 1) * 6;
+    struct Vertex *vertices = calloc(num_vertices, sizeof(struct Vertex));
+    unsigned int *indices = malloc(sizeof(unsigned int) * num_indices);
+
+    unsigned int x, y, i = 0;
+    for (y = 0; y < BENCH_GRID; y++)
+    {
+        for (x = 0; x < BENCH_GRID; x++)
+        {
+            struct Vertex *vertex = &vertices[y * BENCH_GRID + x];
+            float u = (float)x / (BENCH_GRID - 1), v = (float)y / (BENCH_GRID - 1);
+            glm_vec3_copy((vec3){u * 0.04f - 0.02f, v * 0.08f - 0.04f, 0.0f}, vertex->position);
+            glm_vec3_copy((vec3){0.0f, 0.0f, 1.0f}, vertex->normal);
+            glm_vec3_copy((vec3){1.0f, 0.0f, 0.0f}, vertex->tangent);
+            glm_vec3_copy((vec3){0.0f, 1.0f, 0.0f}, vertex->bitangent);
+            vertex->tex_coords[0] = u;
+            vertex->tex_coords[1] = v;
+
+            float bone = v * (BENCH_BONES - 1);
+            unsigned int k;
+            for (k = 0; k < MAX_BONE_INFLUENCE; k++)
+            {
+                vertex->m_bone_ids[k] = ((unsigned int)bone + k) % BENCH_BONES;
+                vertex->m_weights[k] = k < 2 ? (k == 0 ? 1.0f - (bone - floorf(bone)) : bone - floorf(bone)) * 0.8f : 0.1f;
+            }
+        }
+    }
+    for (y = 0; y + 1 < BENCH_GRID; y++)
+    {
+        for (x = 0; x + 1 < BENCH_GRID; x++)
+        {
+            unsigned int corner = y * BENCH_GRID + x;
+            indices[i++] = corner;
+            indices[i++] = corner + 1;
+            indices[i++] = corner + BENCH_GRID;
+            indices[i++] = corner + 1;
+            indices[i++] = corner + BENCH_GRID + 1;
+            indices[i++] = corner + BENCH_GRID;
+        }
+    }
+
+    return seel_mesh_init(vertices, indices, NULL, num_vertices, num_indices, 0);
+}
+
+static void bench_pose(mat4 *palette, unsigned int character, unsigned int frame)
+{
+    unsigned int bone;
+    for (bone = 0; bone < BENCH_BONES; bone++)
+    {
+        float angle = sinf((float)(frame + character * 7 + bone) * 0.1f) * 0.2f;
+        glm_rotate_make(palette[bone], angle, (vec3){0.0f, 0.0f, 1.0f});
+    }
+}
+
+/* Uploads every character's palette into one buffer, one aligned range each */
+static void bench_upload_palettes(unsigned int ssbo, unsigned int stride, unsigned int frame)
+{
+    static mat4 palette[BENCH_BONES];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    unsigned int c;
+    for (c = 0; c < BENCH_CHARACTERS; c++)
+    {
+        bench_pose(palette, c, frame);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, c * stride, sizeof(palette), palette);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+static void bench_set_character(struct Shader *shader, unsigned int c)
+{
+    mat4 model = GLM_MAT4_IDENTITY_INIT;
+    glm_translate(model, (vec3){(float)(c % 8) * 0.25f - 0.875f, (float)(c / 8) * 0.4f - 0.6f, 0.0f});
+    seel_shader_set_mat4(shader, "model", &model[0][0]);
+}
+
+int main(void)
+{
+    if (!bench_create_context())
+        return 1;
+    printf("%s, OpenGL %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+    if (!seel_skinning_supported())
+    {
+        fprintf(stderr, "Compute skinning needs OpenGL 4.3!\n");
+        return 1;
+    }
+
+    struct Shader draw_shader = seel_shader_create("shaders/default.vert", "shaders/default.frag");
+    struct SkinningProgram skinning_program;
+    if (!seel_skinning_program_create(&skinning_program, "shaders/skinning.comp") || draw_shader.id == (unsigned int)-1)
+        return 1;
+
+    unsigned int fbo, color, depth;
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &color);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, BENCH_WIDTH, BENCH_HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, BENCH_WIDTH, BENCH_HEIGHT);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    glViewport(0, 0, BENCH_WIDTH, BENCH_HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+
+    struct Mesh mesh = bench_make_mesh();
+    struct SkinnedModel skinned[BENCH_CHARACTERS];
+    unsigned int c;
+    for (c = 0; c < BENCH_CHARACTERS; c++)
+        seel_skinned_model_create(&skinned[c], &mesh, 1);
+
+    int alignment = 256;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    unsigned int palette_size = sizeof(mat4) * BENCH_BONES;
+    unsigned int stride = (palette_size + alignment - 1) / alignment * alignment;
+    unsigned int palette_ssbo;
+    glGenBuffers(1, &palette_ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, palette_ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, stride * BENCH_CHARACTERS, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    seel_shader_use(&draw_shader);
+    seel_shader_set_mat4(&draw_shader, "view", (float *)GLM_MAT4_IDENTITY);
+    seel_shader_set_mat4(&draw_shader, "projection", (float *)GLM_MAT4_IDENTITY);
+    seel_shader_set_mat4(&draw_shader, "normalMatrix", (float *)GLM_MAT4_IDENTITY);
+
+    printf("%d characters, %u vertices and %d bones each\n", BENCH_CHARACTERS, mesh.num_vertices, BENCH_BONES);
+    printf("%8s %16s %16s %10s\n", "passes", "vertex ms/frame", "compute ms/frame", "speedup");
+
+    unsigned int passes;
+    for (passes = 1; passes <= BENCH_MAX_PASSES; passes++)
+    {
+        double times[2];
+        unsigned int mode;
+        for (mode = 0; mode < 2; mode++)
+        {
+            bool compute = mode == 1;
+            unsigned int frame, pass;
+            double start = 0.0;
+            for (frame = 0; frame < BENCH_FRAMES + 2; frame++)
+            {
+                /* the first two frames warm up shader variants and buffers */
+                if (frame == 2)
+                {
+                    glFinish();
+                    start = bench_now();
+                }
+
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                bench_upload_palettes(palette_ssbo, stride, frame);
+
+                if (compute)
+                {
+                    seel_shader_use(&skinning_program.shader);
+                    for (c = 0; c < BENCH_CHARACTERS; c++)
+                    {
+                        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, palette_ssbo, c * stride, palette_size);
+                        seel_skinning_dispatch(&skinning_program, &mesh, skinned[c].vbos[0]);
+                    }
+                    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+                }
+
+                seel_shader_use(&draw_shader);
+                seel_shader_set_int(&draw_shader, "animate", !compute);
+                for (pass = 0; pass < passes; pass++)
+                {
+                    for (c = 0; c < BENCH_CHARACTERS; c++)
+                    {
+                        bench_set_character(&draw_shader, c);
+                        if (compute)
+                        {
+                            seel_skinned_mesh_draw(&mesh, skinned[c].vaos[0], &draw_shader, 0);
+                        }
+                        else
+                        {
+                            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, palette_ssbo, c * stride, palette_size);
+                            seel_mesh_draw(mesh, &draw_shader);
+                        }
+                    }
+                }
+                glFinish();
+            }
+            times[mode] = (bench_now() - start) * 1e3 / BENCH_FRAMES;
+        }
+        printf("%8u %16.2f %16.2f %9.2fx\n", passes, times[0], times[1], times[0] / times[1]);
+    }
+
+    /* compare the last compute pose against the same skinning on the CPU */
+    mat4 palette[BENCH_BONES];
+    bench_pose(palette, BENCH_CHARACTERS - 1, BENCH_FRAMES + 1);
+    struct Vertex *gpu = malloc(sizeof(struct Vertex) * mesh.num_vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, skinned[BENCH_CHARACTERS - 1].vbos[0]);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(struct Vertex) * mesh.num_vertices, gpu);
+    float max_error = 0.0f;
+    unsigned int v;
+    for (v = 0; v < mesh.num_vertices; v++)
+    {
+        vec3 expected = GLM_VEC3_ZERO_INIT;
+        unsigned int k;
+        for (k = 0; k < MAX_BONE_INFLUENCE; k++)
+        {
+            vec3 posed;
+            glm_mat4_mulv3(palette[mesh.vertices[v].m_bone_ids[k]], mesh.vertices[v].position, 1.0f, posed);
+            glm_vec3_muladds(posed, mesh.vertices[v].m_weights[k], expected);
+        }
+        max_error = fmaxf(max_error, glm_vec3_distance(expected, gpu[v].position));
+    }
+    printf("max compute skinning error vs CPU: %g\n", max_error);
+
+    free(gpu);
+    for (c = 0; c < BENCH_CHARACTERS; c++)
+        seel_skinned_model_destroy(&skinned[c]);
+    seel_skinning_program_destroy(&skinning_program);
+    seel_shader_delete(&draw_shader);
+    return 0;
+}
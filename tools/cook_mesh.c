@@ -0,0 +1,67 @@
+/*
+ * Mesh cooker.
+ *
+ * Imports a model through Assimp, runs the same mesh optimization, bone
+ * palette remapping and splitting as a runtime import, and writes the
+ * result as a .seelmesh file next to the source (or to the given output
+ * path). The engine loads the cooked file instead of the source whenever it
+ * is present, so Assimp only parses models here.
+ *
+ *     make cook_mesh && ./cook_mesh assets/models/vampire/dancing_vampire.dae
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/model.h"
+#include "../include/mesh_file.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "usage: %s model [output%s]\n", argv[0], SEEL_MESH_FILE_EXTENSION);
+        return 1;
+    }
+
+    char output[MAX_DIRECTORY_LEN];
+    if (argc == 3)
+        snprintf(output, sizeof(output), "%s", argv[2]);
+    else
+        seel_mesh_file_path(argv[1], output, sizeof(output));
+
+    /* the model is large, keep it off the stack */
+    struct Model *model = malloc(sizeof(struct Model));
+    if (!model)
+    {
+        fprintf(stderr, "Failed to allocate memory for model!\n");
+        return 1;
+    }
+
+    *model = seel_model_import(argv[1], false);
+    if (!model->num_meshes)
+    {
+        fprintf(stderr, "Nothing to cook in %s!\n", argv[1]);
+        return 1;
+    }
+
+    if (!seel_mesh_file_write(model, output))
+        return 1;
+
+    unsigned long long num_vertices = 0, num_indices = 0;
+    unsigned int i, lod;
+    for (i = 0; i < model->num_meshes; i++)
+    {
+        const struct Mesh *mesh = &model->meshes[i];
+        num_vertices += mesh->num_vertices;
+        num_indices += mesh->num_indices;
+
+        printf("Mesh %u LODs:", i);
+        for (lod = 0; lod < mesh->num_lods; lod++)
+            printf(" %u triangles (error %g)", mesh->lods[lod].num_indices / 3, mesh->lods[lod].error);
+        printf("\n");
+    }
+    seel_mesh_print_optimize_report(model->name, &model->optimize_report);
+    printf("Cooked %s: %u meshes, %llu vertices, %llu indices, %u textures, %u bones, %u nodes\n",
+           output, model->num_meshes, num_vertices, num_indices, model->num_textures, model->bone_counter, model->num_nodes);
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Texture cooker.
+ *
+ * Decodes an image the way the engine does, builds its full mip chain and
+ * block compresses every level into a .dds file next to the source (or to
+ * the given output path). The engine loads the cooked file instead of the
+ * source whenever it is present. Opaque images become BC1 and images with
+ * alpha BC3 unless a format is given; cook normal maps with -f bc5.
+ *
+ *     make cook_texture && ./cook_texture -f bc5 assets/models/vampire/textures/Vampire_normal.png
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/texture.h"
+#include "../include/texture_file.h"
+
+int main(int argc, char **argv)
+{
+    unsigned int format = 0;
+    int arg = 1;
+    if (argc > 2 && !strcmp(argv[1], "-f"))
+    {
+        if (!strcmp(argv[2], "bc1"))
+            format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        else if (!strcmp(argv[2], "bc3"))
+            format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        else if (!strcmp(argv[2], "bc5"))
+            format = GL_COMPRESSED_RG_RGTC2;
+        else
+        {
+            fprintf(stderr, "Unknown format %s, expected bc1, bc3 or bc5!\n", argv[2]);
+            return 1;
+        }
+        arg = 3;
+    }
+
+    if (argc - arg < 1 || argc - arg > 2)
+    {
+        fprintf(stderr, "usage: %s [-f bc1|bc3|bc5] image [output%s]\n", argv[0], SEEL_TEXTURE_FILE_EXTENSION);
+        return 1;
+    }
+
+    char output[MAX_TEXTURE_NAME_LEN];
+    if (argc - arg == 2)
+        snprintf(output, sizeof(output), "%s", argv[arg + 1]);
+    else
+        seel_texture_file_path(argv[arg], output, sizeof(output));
+
+    /* same orientation as the images the engine uploads */
+    seel_texture_init_stb();
+
+    struct TextureImage source;
+    if (!seel_texture_decode(argv[arg], &source))
+        return 1;
+    if (!format)
+        format = seel_texture_file_default_format(&source);
+
+    struct TextureImage cooked;
+    if (!seel_texture_file_compress(&source, format, &cooked) || !seel_texture_file_write(&cooked, output))
+        return 1;
+
+    /* what the engine allocates for the source: 3 or 4 bytes a texel plus a third for the mips */
+    size_t uncompressed = (size_t)source.width * source.height * (source.channels >= 4 ? 4 : 3) * 4 / 3;
+    size_t compressed = seel_texture_level_offset(&cooked, cooked.levels);
+    const char *name = format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? "BC1" : format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? "BC3" : "BC5";
+    printf("Cooked %s: %dx%d %s, %d levels, %.2f MiB instead of %.2f MiB (%.1fx)\n", output, cooked.width, cooked.height, name,
+           cooked.levels, compressed / (1024.0 * 1024.0), uncompressed / (1024.0 * 1024.0), (double)uncompressed / compressed);
+
+    seel_texture_image_free(&cooked);
+    seel_texture_image_free(&source);
+    return 0;
+}